@@ -27,6 +27,7 @@
 #include <core/property.h>
 
 #include <chrono>
+#include <future>
 #include <iosfwd>
 #include <memory>
 
@@ -170,6 +171,20 @@ class Player : public std::enable_shared_from_this<Player>
     virtual void stop() = 0;
     virtual void seek_to(const std::chrono::microseconds& offset) = 0;
 
+    /**
+     * Asynchronous counterparts of the calls above. They return right away
+     * and calls issued one after the other don't wait for each other. The
+     * future holds the result or the exception the blocking call would throw.
+     */
+    virtual std::future<bool> open_uri_async(const Track::UriType& uri);
+    virtual std::future<bool> open_uri_async(const Track::UriType& uri, const HeadersType&);
+    virtual std::future<void> next_async();
+    virtual std::future<void> previous_async();
+    virtual std::future<void> play_async();
+    virtual std::future<void> pause_async();
+    virtual std::future<void> stop_async();
+    virtual std::future<void> seek_to_async(const std::chrono::microseconds& offset);
+
     virtual const core::Property<bool>& can_play() const = 0;
     virtual const core::Property<bool>& can_pause() const = 0;
     virtual const core::Property<bool>& can_seek() const = 0;
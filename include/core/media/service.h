@@ -20,6 +20,7 @@
 
 #include <core/media/player.h>
 
+#include <future>
 #include <memory>
 
 namespace core
@@ -45,6 +46,9 @@ class Service : public std::enable_shared_from_this<Service>
     /** @brief Creates a session with the media-hub service. */
     virtual std::shared_ptr<Player> create_session(const Player::Configuration&) = 0;
 
+    /** @brief Creates a session without blocking the caller until the service replied. */
+    virtual std::future<std::shared_ptr<Player>> create_session_async(const Player::Configuration&);
+
     /** @brief Detaches a UUID-identified session for later resuming. */
     virtual void detach_session(const std::string& uuid, const Player::Configuration&) = 0;
 
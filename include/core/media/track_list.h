@@ -23,10 +23,14 @@
 #include <core/property.h>
 #include <core/signal.h>
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 namespace core
@@ -44,6 +48,7 @@ class TrackList : public std::enable_shared_from_this<TrackList>
     typedef std::vector<Track::UriType> ContainerURI;
     typedef std::tuple<std::vector<Track::Id>, Track::Id> ContainerTrackIdTuple;
     typedef std::tuple<Track::Id, Track::Id> TrackIdTuple;
+    typedef std::tuple<Track::UriType, std::uint64_t, bool> PlaylistImportProgressTuple;
     typedef Container::iterator Iterator;
     typedef Container::const_iterator ConstIterator;
 
@@ -75,6 +80,11 @@ class TrackList : public std::enable_shared_from_this<TrackList>
         {
             TrackNotFound();
         };
+
+        struct QuotaExceeded : public std::runtime_error
+        {
+            QuotaExceeded(const std::string& err);
+        };
     };
 
     static const Track::Id& after_empty_track();
@@ -106,6 +116,15 @@ class TrackList : public std::enable_shared_from_this<TrackList>
     /** Moves track 'id' from its old position in the TrackList to new position. */
     virtual bool move_track(const Track::Id& id, const Track::Id& to) = 0;
 
+    /** Adds the entries of a M3U, PLS or XSPF playlist into the TrackList. The playlist is
+     *  read in the background and its entries are added in batches, the first of which is
+     *  kept small so that playback can start right away. See on_playlist_import_progress. */
+    virtual void add_tracks_from_playlist(const Track::UriType& playlist, const Track::Id& position) = 0;
+
+    /** Replaces the whole TrackList with a list of URIs in a single step. The track at index
+     *  'current' becomes the current track and playback of it resumes from 'position'. */
+    virtual void replace_tracks(const ContainerURI& uris, std::size_t current, const std::chrono::microseconds& position) = 0;
+
     /** Removes a Track from the TrackList. */
     virtual void remove_track(const Track::Id& id) = 0;
 
@@ -127,6 +146,19 @@ class TrackList : public std::enable_shared_from_this<TrackList>
     /** Clears and resets the TrackList to the same as a newly constructed instance. */
     virtual void reset() = 0;
 
+    /** Asynchronous counterparts of the calls above. They return right away and calls
+     *  issued one after the other don't wait for each other. The future holds the result
+     *  or the exception the blocking call would throw. Note that the service only lets a
+     *  client have a limited number of metadata queries waiting at a time. */
+    virtual std::future<Track::MetaData> query_meta_data_for_track_async(const Track::Id& id);
+    virtual std::future<Track::UriType> query_uri_for_track_async(const Track::Id& id);
+    virtual std::future<void> add_track_with_uri_at_async(const Track::UriType& uri, const Track::Id& position, bool make_current);
+    virtual std::future<void> add_tracks_with_uri_at_async(const ContainerURI& uris, const Track::Id& position);
+    virtual std::future<bool> move_track_async(const Track::Id& id, const Track::Id& to);
+    virtual std::future<void> remove_track_async(const Track::Id& id);
+    virtual std::future<void> go_to_async(const Track::Id& track);
+    virtual std::future<void> reset_async();
+
     /** Indicates that the entire tracklist has been replaced. */
     virtual const core::Signal<ContainerTrackIdTuple>& on_track_list_replaced() const = 0;
 
@@ -144,6 +176,10 @@ class TrackList : public std::enable_shared_from_this<TrackList>
     /** Indicates that a track has been removed from the track list. */
     virtual const core::Signal<Track::Id>& on_track_removed() const = 0;
 
+    /** Reports the progress of a playlist import: the playlist URI, the number of tracks
+     *  added so far and whether the import has finished. */
+    virtual const core::Signal<PlaylistImportProgressTuple>& on_playlist_import_progress() const = 0;
+
     /** Indicates that the track list has been reset and there are no tracks now */
     virtual const core::Signal<void>& on_track_list_reset() const = 0;
 
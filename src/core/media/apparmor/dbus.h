@@ -24,8 +24,11 @@
 #include <core/dbus/object.h>
 #include <core/dbus/service.h>
 
-#include <string>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
 
 // TODO(tvoss): This really should live in trust-store, providing a straightforward
 // way for parties involved in managing trust relationships to query peers' apparmor
@@ -50,6 +53,16 @@ struct DBus
     // org.freedesktop.DBus.Error.AppArmorSecurityContextUnknown error is returned.
     DBUS_CPP_METHOD_DEF(GetConnectionAppArmorSecurityContext, DBus)
 
+    struct Signals
+    {
+        // (name, old owner, new owner)
+        typedef std::tuple<std::string, std::string, std::string> NameOwnerChangedArgs;
+
+        // Emitted whenever a name gets a new owner or loses it. A unique
+        // name losing its owner means that the peer left the bus.
+        DBUS_CPP_SIGNAL_DEF(NameOwnerChanged, DBus, NameOwnerChangedArgs)
+    };
+
     struct Stub
     {
         // Creates a new stub instance for the given object to access
@@ -72,19 +85,36 @@ struct DBus
         // D-Bus is not performing AppArmor mediation, the
         // org.freedesktop.DBus.Error.AppArmorSecurityContextUnknown error is returned.
         //
-        // Invokes the given handler on completion.
+        // Invokes the given handler on completion, or on_error if the call failed.
         void get_connection_app_armor_security_async(
                     const std::string& name,
-                    std::function<void(const std::string&)> handler)
+                    std::function<void(const std::string&)> handler,
+                    std::function<void()> on_error = std::function<void()>{})
         {
             object->invoke_method_asynchronously_with_callback<GetConnectionAppArmorSecurityContext, std::string>(
-                        [handler](const core::dbus::Result<std::string>& result)
+                        [handler, on_error](const core::dbus::Result<std::string>& result)
                         {
                             if (not result.is_error()) handler(result.value());
+                            else if (on_error) on_error();
                         }, name);
         }
 
+        // Invokes the given handler with (name, old owner, new owner) whenever
+        // the owner of a name on the bus changes, for as long as the stub lives.
+        void on_name_owner_changed(
+                    std::function<void(const std::string&, const std::string&, const std::string&)> handler)
+        {
+            if (not name_owner_changed)
+                name_owner_changed = object->get_signal<Signals::NameOwnerChanged>();
+
+            name_owner_changed->connect([handler](const Signals::NameOwnerChangedArgs& args)
+            {
+                handler(std::get<0>(args), std::get<1>(args), std::get<2>(args));
+            });
+        }
+
         core::dbus::Object::Ptr object;
+        std::shared_ptr<core::dbus::Signal<Signals::NameOwnerChanged, Signals::NameOwnerChanged::ArgumentType>> name_owner_changed;
     };
 };
 }
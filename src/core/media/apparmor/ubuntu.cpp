@@ -22,7 +22,11 @@
 
 #include "core/media/logger/logger.h"
 
-#include <regex>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace apparmor = core::ubuntu::media::apparmor;
 namespace media = core::ubuntu::media;
@@ -39,40 +43,47 @@ struct Uri
     std::string fragment;
 };
 
-// Poor mans version of a uri parser.
-// See https://tools.ietf.org/html/rfc3986#appendix-B
+// Poor mans version of a uri parser, splitting the uri the way the regular
+// expression in https://tools.ietf.org/html/rfc3986#appendix-B does.
 Uri parse_uri(const std::string& s)
 {
-    // Indices into the regex match go here.
-    struct Index
-    {
-        const std::size_t scheme{2};
-        const std::size_t authority{4};
-        const std::size_t path{5};
-        const std::size_t query{7};
-        const std::size_t fragment{9};
-    } static index;
+    Uri uri;
+    std::size_t pos = 0;
 
-    static const std::regex regex{R"delim(^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))?)delim"};
-    std::smatch match;
+    // scheme: a non-empty run of anything but ":/?#", followed by ':'
+    const auto scheme_end = s.find_first_of(":/?#");
+    if (scheme_end != std::string::npos and scheme_end > 0 and s[scheme_end] == ':')
+    {
+        uri.scheme = s.substr(0, scheme_end);
+        pos = scheme_end + 1;
+    }
 
-    if (not std::regex_match(s, match, regex)) throw std::runtime_error
+    // authority: introduced by "//", up to the next "/?#"
+    if (s.compare(pos, 2, "//") == 0)
     {
-        "Not a valid URI: " + s
-    };
+        pos += 2;
+        const auto authority_end = std::min(s.find_first_of("/?#", pos), s.size());
+        uri.authority = s.substr(pos, authority_end - pos);
+        pos = authority_end;
+    }
+
+    const auto path_end = std::min(s.find_first_of("?#", pos), s.size());
+    uri.path = s.substr(pos, path_end - pos);
+    pos = path_end;
 
-    return Uri
+    if (pos < s.size() and s[pos] == '?')
     {
-        match.str(index.scheme),
-        match.str(index.authority),
-        match.str(index.path),
-        match.str(index.query),
-        match.str(index.fragment)
-    };
+        const auto query_end = std::min(s.find('#', pos), s.size());
+        uri.query = s.substr(pos + 1, query_end - pos - 1);
+        pos = query_end;
+    }
+
+    if (pos < s.size())
+        uri.fragment = s.substr(pos + 1);
+
+    return uri;
 }
 
-static constexpr std::size_t index_package{1};
-static constexpr std::size_t index_app{2};
 static const std::string unity_name{"unity8-dash"};
 static const std::string unity8_snap_name{"snap.unity8-session.unity8-session"};
 
@@ -80,27 +91,46 @@ static const std::string unity8_snap_name{"snap.unity8-session.unity8-session"};
 // Bug #1642611
 static const std::string mediaplayer_snap_name{"snap.mediaplayer-app.mediaplayer-app"};
 static const std::string music_snap_name{"snap.music-app.music-app"};
+
+// Splits s at the last occurrence of separator, returns false if there is none.
+bool split_at_last(const std::string& s, char separator, std::string& head, std::string& tail)
+{
+    const auto pos = s.rfind(separator);
+    if (pos == std::string::npos)
+        return false;
+
+    head = s.substr(0, pos);
+    tail = s.substr(pos + 1);
+    return true;
+}
+
 // Returns true if the context name is a valid Ubuntu app id.
-// If it is, out is populated with the package and app name.
-bool process_context_name(const std::string& s, std::smatch& out,
-        std::string& pkg_name)
+// If it is, package and app are populated with the two halves
+// of the profile name, and pkg_name with the package name.
+bool process_context_name(const std::string& s, std::string& package,
+        std::string& app, std::string& pkg_name)
 {
     // See https://wiki.ubuntu.com/AppStore/Interfaces/ApplicationId.
-    static const std::regex short_re{"(.*)_(.*)"};
-    static const std::regex full_re{"(.*)_(.*)_(.*)"};
-    static const std::regex trust_store_re{"(.*)-(.*)"};
-
+    // Trust store names split at their last '-'
     if ((s == "messaging-app" or s == unity_name or s == unity8_snap_name or
             s == mediaplayer_snap_name or s == music_snap_name)
-            and std::regex_match(s, out, trust_store_re))
+            and split_at_last(s, '-', package, app))
     {
         pkg_name = s;
         return true;
     }
 
-    if (std::regex_match(s, out, full_re) or std::regex_match(s, out, short_re))
+    // Full app ids look like package_app_version, short ones like package_app
+    std::string head, version;
+    if (split_at_last(s, '_', head, version))
     {
-        pkg_name = out[index_package];
+        if (not split_at_last(head, '_', package, app))
+        {
+            package = head;
+            app = version;
+        }
+
+        pkg_name = package;
         return true;
     }
 
@@ -112,7 +142,7 @@ apparmor::ubuntu::Context::Context(const std::string& name)
     : apparmor::Context{name},
       unconfined_{str() == ubuntu::unconfined},
       unity_{name == unity_name || name == unity8_snap_name},
-      has_package_name_{process_context_name(str(), match_, pkg_name_)}
+      has_package_name_{process_context_name(str(), profile_package_, profile_app_, pkg_name_)}
 {
     MH_DEBUG("apparmor profile name: %s", name);
     MH_DEBUG("is_unconfined(): %s", (is_unconfined() ? "true" : "false"));
@@ -146,99 +176,313 @@ std::string apparmor::ubuntu::Context::package_name() const
 
 std::string apparmor::ubuntu::Context::profile_name() const
 {
-    return std::string{match_[index_package]} + "-" + std::string{match_[index_app]};
+    return profile_package_ + "-" + profile_app_;
 }
 
-apparmor::ubuntu::DBusDaemonRequestContextResolver::DBusDaemonRequestContextResolver(const core::dbus::Bus::Ptr& bus) : dbus_daemon{bus}
+struct apparmor::ubuntu::CachingRequestContextResolver::Cache
 {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Pending
+    {
+        // Requests waiting for the query, along with the time they came in
+        std::vector<std::pair<ResolveCallback, Clock::time_point>> requests;
+        // Set if the name got invalidated while the query was in flight
+        bool invalidated;
+    };
+
+    // Hands the answer of a query to everyone waiting for it
+    void on_context_name(const std::string& name, const std::string& context_name)
+    {
+        std::shared_ptr<const Context> context;
+        try
+        {
+            context = std::make_shared<const Context>(context_name);
+        }
+        catch (const std::exception& e)
+        {
+            MH_WARNING("Failed to resolve apparmor context of %s: %s", name, e.what());
+        }
+
+        Pending resolved;
+        {
+            std::lock_guard<std::mutex> lg{guard};
+
+            const auto it = pending.find(name);
+            if (it == pending.end())
+                return;
+
+            resolved = std::move(it->second);
+            pending.erase(it);
+
+            const auto now = Clock::now();
+            for (const auto& request : resolved.requests)
+                statistics.miss_latency += std::chrono::duration_cast<std::chrono::microseconds>(now - request.second);
+
+            if (context and not resolved.invalidated)
+                contexts[name] = context;
+        }
+
+        if (not context)
+            return;
+
+        for (const auto& request : resolved.requests)
+            request.first(*context);
+    }
+
+    std::mutex guard;
+    std::unordered_map<std::string, std::shared_ptr<const Context>> contexts;
+    std::unordered_map<std::string, Pending> pending;
+    Statistics statistics{0, 0, std::chrono::microseconds{0}};
+};
+
+double apparmor::ubuntu::CachingRequestContextResolver::Statistics::hit_rate() const
+{
+    const auto total = hits + misses;
+    return total == 0 ? 0. : static_cast<double>(hits) / total;
 }
 
-void apparmor::ubuntu::DBusDaemonRequestContextResolver::resolve_context_for_dbus_name_async(
+std::chrono::microseconds apparmor::ubuntu::CachingRequestContextResolver::Statistics::saved_latency() const
+{
+    if (misses == 0)
+        return std::chrono::microseconds{0};
+
+    return std::chrono::microseconds{miss_latency.count() / static_cast<std::int64_t>(misses) * static_cast<std::int64_t>(hits)};
+}
+
+apparmor::ubuntu::CachingRequestContextResolver::CachingRequestContextResolver()
+    : cache{std::make_shared<Cache>()}
+{
+}
+
+void apparmor::ubuntu::CachingRequestContextResolver::resolve_context_for_dbus_name_async(
         const std::string& name,
         apparmor::ubuntu::RequestContextResolver::ResolveCallback cb)
 {
-    dbus_daemon.get_connection_app_armor_security_async(name, [cb](const std::string& context_name)
+    std::shared_ptr<const Context> context;
+    {
+        std::lock_guard<std::mutex> lg{cache->guard};
+
+        const auto it = cache->contexts.find(name);
+        if (it != cache->contexts.end())
+        {
+            ++cache->statistics.hits;
+            context = it->second;
+        }
+        else
+        {
+            ++cache->statistics.misses;
+
+            const auto pending = cache->pending.find(name);
+            const bool in_flight = pending != cache->pending.end();
+            auto& requests = cache->pending[name];
+            if (not in_flight)
+                requests.invalidated = false;
+
+            requests.requests.push_back(std::make_pair(cb, Cache::Clock::now()));
+            // Someone else already asked, the answer will be shared
+            if (in_flight)
+                return;
+        }
+    }
+
+    if (context)
     {
-        cb(apparmor::ubuntu::Context{context_name});
+        cb(*context);
+        return;
+    }
+
+    const std::weak_ptr<Cache> weak_cache{cache};
+    query_context_name_async(name, [weak_cache, name](const std::string& context_name)
+    {
+        if (const auto sp = weak_cache.lock())
+            sp->on_context_name(name, context_name);
     });
 }
 
-apparmor::ubuntu::RequestAuthenticator::Result apparmor::ubuntu::ExistingAuthenticator::authenticate_open_uri_request(const apparmor::ubuntu::Context& context, const std::string& uri)
+void apparmor::ubuntu::CachingRequestContextResolver::invalidate(const std::string& name)
 {
-    if (context.is_unconfined())
-        return Result{true, "Client allowed access since it's unconfined"};
+    std::lock_guard<std::mutex> lg{cache->guard};
 
-    Uri parsed_uri = parse_uri(uri);
+    cache->contexts.erase(name);
 
-    MH_DEBUG("context.profile_name(): %s", context.profile_name());
-    MH_DEBUG("parsed_uri.path: %s", parsed_uri.path);
+    const auto it = cache->pending.find(name);
+    if (it != cache->pending.end())
+        it->second.invalidated = true;
+}
+
+apparmor::ubuntu::CachingRequestContextResolver::Statistics apparmor::ubuntu::CachingRequestContextResolver::statistics() const
+{
+    std::lock_guard<std::mutex> lg{cache->guard};
+    return cache->statistics;
+}
 
-    // All confined apps can access their own files
-    if (parsed_uri.path.find(std::string(".local/share/" + context.package_name() + "/")) != std::string::npos ||
-        parsed_uri.path.find(std::string(".cache/" + context.package_name() + "/")) != std::string::npos)
+apparmor::ubuntu::DBusDaemonRequestContextResolver::DBusDaemonRequestContextResolver(const core::dbus::Bus::Ptr& bus,
+                                                                                     const media::PeerDepartures::Ptr& departures)
+    : dbus_daemon{bus}
+{
+    departure_connections.emplace_back(departures->peer_gone().connect([this](const std::string& name)
     {
-        return Result
-        {
-            true,
-            "Client can access content in ~/.local/share/" + context.package_name() + " or ~/.cache/" + context.package_name()
-        };
-    }
-    // Check for trust-store compatible path name using full messaging-app profile_name
-    else if (context.profile_name() == "messaging-app" &&
-             /* Since the full APP_ID is not available yet (see aa_query_file_path()), add an exception: */
-             (parsed_uri.path.find(std::string(".local/share/com.ubuntu." + context.profile_name() + "/")) != std::string::npos ||
-             parsed_uri.path.find(std::string(".cache/com.ubuntu." + context.profile_name() + "/")) != std::string::npos))
+        // Unique names are never handed out twice, once gone their context is of no use anymore
+        invalidate(name);
+
+        const auto stats = statistics();
+        MH_DEBUG("apparmor context cache: %d hits, %d misses, hit rate %f, saved %d us",
+                 stats.hits, stats.misses, stats.hit_rate(), stats.saved_latency().count());
+    }));
+}
+
+void apparmor::ubuntu::DBusDaemonRequestContextResolver::query_context_name_async(
+        const std::string& name,
+        std::function<void(const std::string&)> cb)
+{
+    // An empty context name fails to resolve, so that the next request queries again
+    dbus_daemon.get_connection_app_armor_security_async(name, cb, [cb]() { cb(std::string{}); });
+}
+
+// The rules of the existing logic, with everything that only depends on the
+// context worked out up front.
+struct apparmor::ubuntu::ExistingAuthenticator::Rules
+{
+    // Decisions are remembered for this many distinct directories per context
+    static constexpr std::size_t max_decisions{4096};
+
+    explicit Rules(const Context& context)
+        : own_local_share{".local/share/" + context.package_name() + "/"},
+          own_cache{".cache/" + context.package_name() + "/"},
+          own_reason{"Client can access content in ~/.local/share/" + context.package_name() +
+                     " or ~/.cache/" + context.package_name()},
+          messaging_app{context.profile_name() == "messaging-app"},
+          messaging_local_share{".local/share/com.ubuntu." + context.profile_name() + "/"},
+          messaging_cache{".cache/com.ubuntu." + context.profile_name() + "/"},
+          messaging_reason{"Client can access content in ~/.local/share/" + context.profile_name() +
+                           " or ~/.cache/" + context.profile_name()},
+          package_name{context.package_name()},
+          camera{context.package_name() == "com.ubuntu.camera"},
+          music_and_videos{context.package_name() == "com.ubuntu.music" ||
+                           context.package_name() == "com.ubuntu.gallery" ||
+                           context.profile_name() == unity_name || context.profile_name() == unity8_snap_name ||
+                           context.profile_name() == mediaplayer_snap_name || context.profile_name() == music_snap_name}
     {
-        return Result
-        {
-            true,
-            "Client can access content in ~/.local/share/" + context.profile_name() + " or ~/.cache/" + context.profile_name()
-        };
     }
-    else if (parsed_uri.path.find(std::string("opt/click.ubuntu.com/")) != std::string::npos &&
-             parsed_uri.path.find(context.package_name()) != std::string::npos)
+
+    static bool contains(const std::string& path, const char* s)
     {
-        return Result{true, "Client can access content in own opt directory"};
+        return path.find(s) != std::string::npos;
     }
-    else if ((parsed_uri.path.find(std::string("/system/media/audio/ui/")) != std::string::npos ||
-              parsed_uri.path.find(std::string("/android/system/media/audio/ui/")) != std::string::npos) &&
-              context.package_name() == "com.ubuntu.camera")
+
+    static bool contains(const std::string& path, const std::string& s)
     {
-        return Result{true, "Camera app can access ui sounds"};
+        return path.find(s) != std::string::npos;
     }
 
-    // TODO: Check if the trust store previously allowed direct access to uri
-
-    // Check in ~/Music and ~/Videos
-    // TODO: when the trust store lands, check it to see if this app can access the dirs and
-    // then remove the explicit whitelist of the music-app, and gallery-app
-    else if ((context.package_name() == "com.ubuntu.music" || context.package_name() == "com.ubuntu.gallery" ||
-              context.profile_name() == unity_name || context.profile_name() == unity8_snap_name ||
-              context.profile_name() == mediaplayer_snap_name || context.profile_name() == music_snap_name) &&
-            (parsed_uri.path.find(std::string("Music/")) != std::string::npos ||
-             parsed_uri.path.find(std::string("Videos/")) != std::string::npos ||
-             parsed_uri.path.find(std::string("/media")) != std::string::npos))
+    // Applies the rules to the given path, or any prefix of it.
+    Result decide(const std::string& path, const std::string& scheme) const
     {
-        return Result{true, "Client can access content in ~/Music or ~/Videos"};
+        // All confined apps can access their own files
+        if (contains(path, own_local_share) || contains(path, own_cache))
+            return Result{true, own_reason};
+        // Check for trust-store compatible path name using full messaging-app profile_name
+        else if (messaging_app &&
+                 /* Since the full APP_ID is not available yet (see aa_query_file_path()), add an exception: */
+                 (contains(path, messaging_local_share) || contains(path, messaging_cache)))
+            return Result{true, messaging_reason};
+        else if (contains(path, "opt/click.ubuntu.com/") && contains(path, package_name))
+            return Result{true, "Client can access content in own opt directory"};
+        else if (camera && (contains(path, "/system/media/audio/ui/") || contains(path, "/android/system/media/audio/ui/")))
+            return Result{true, "Camera app can access ui sounds"};
+
+        // TODO: Check if the trust store previously allowed direct access to uri
+
+        // Check in ~/Music and ~/Videos
+        // TODO: when the trust store lands, check it to see if this app can access the dirs and
+        // then remove the explicit whitelist of the music-app, and gallery-app
+        else if (music_and_videos &&
+                 (contains(path, "Music/") || contains(path, "Videos/") || contains(path, "/media")))
+            return Result{true, "Client can access content in ~/Music or ~/Videos"};
+        else if (contains(path, "/usr/share/sounds"))
+            return Result{true, "Client can access content in /usr/share/sounds"};
+        else if (scheme == "http" || scheme == "https" || scheme == "rtsp")
+            return Result{true, "Client can access streaming content"};
+
+        return Result{false, std::string{}};
     }
-    else if (parsed_uri.path.find(std::string("/usr/share/sounds")) != std::string::npos)
+
+    const std::string own_local_share;
+    const std::string own_cache;
+    const std::string own_reason;
+    const bool messaging_app;
+    const std::string messaging_local_share;
+    const std::string messaging_cache;
+    const std::string messaging_reason;
+    const std::string package_name;
+    const bool camera;
+    const bool music_and_videos;
+
+    // Keyed by scheme and directory, guarded by the authenticator
+    std::unordered_map<std::string, Result> decisions;
+};
+
+constexpr std::size_t apparmor::ubuntu::ExistingAuthenticator::Rules::max_decisions;
+
+std::shared_ptr<apparmor::ubuntu::ExistingAuthenticator::Rules> apparmor::ubuntu::ExistingAuthenticator::rules_for(const apparmor::ubuntu::Context& context)
+{
+    // Called with guard held
+    auto& entry = rules[context.str()];
+    if (not entry)
+        entry = std::make_shared<Rules>(context);
+
+    return entry;
+}
+
+apparmor::ubuntu::RequestAuthenticator::Result apparmor::ubuntu::ExistingAuthenticator::authenticate_open_uri_request(const apparmor::ubuntu::Context& context, const std::string& uri)
+{
+    if (context.is_unconfined())
+        return Result{true, "Client allowed access since it's unconfined"};
+
+    const Uri parsed_uri = parse_uri(uri);
+
+    MH_DEBUG("context.profile_name(): %s", context.profile_name());
+    MH_DEBUG("parsed_uri.path: %s", parsed_uri.path);
+
+    // Every rule that holds for the directory holds for all files in it
+    const auto slash = parsed_uri.path.rfind('/');
+    const std::string directory = slash == std::string::npos ? std::string{} : parsed_uri.path.substr(0, slash + 1);
+    const std::string key = parsed_uri.scheme + ":" + directory;
+
+    std::shared_ptr<Rules> context_rules;
     {
-        return Result{true, "Client can access content in /usr/share/sounds"};
+        std::lock_guard<std::mutex> lg{guard};
+        context_rules = rules_for(context);
+
+        // Only decisions allowing access are remembered
+        const auto it = context_rules->decisions.find(key);
+        if (it != context_rules->decisions.end())
+            return it->second;
     }
-    else if (parsed_uri.scheme == "http" ||
-             parsed_uri.scheme == "https" ||
-             parsed_uri.scheme == "rtsp")
+
+    auto result = context_rules->decide(directory, parsed_uri.scheme);
+    if (std::get<0>(result))
     {
-        return Result{true, "Client can access streaming content"};
+        std::lock_guard<std::mutex> lg{guard};
+        if (context_rules->decisions.size() >= Rules::max_decisions)
+            context_rules->decisions.clear();
+        context_rules->decisions.emplace(key, result);
+        return result;
     }
 
+    // Rules not ending in a '/' may still match the file name itself
+    result = context_rules->decide(parsed_uri.path, parsed_uri.scheme);
+    if (std::get<0>(result))
+        return result;
+
     return Result{false, "Client is not allowed to access: " + uri};
 }
 
 // Returns the platform-default implementation of RequestContextResolver.
 apparmor::ubuntu::RequestContextResolver::Ptr apparmor::ubuntu::make_platform_default_request_context_resolver(media::helper::ExternalServices& es)
 {
-    return std::make_shared<apparmor::ubuntu::DBusDaemonRequestContextResolver>(es.session);
+    return std::make_shared<apparmor::ubuntu::DBusDaemonRequestContextResolver>(es.session, es.session_departures());
 }
 
 // Returns the platform-default implementation of RequestAuthenticator.
@@ -20,11 +20,16 @@
 
 #include <core/media/apparmor/context.h>
 #include <core/media/apparmor/dbus.h>
+#include <core/media/peer_departures.h>
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <list>
 #include <memory>
-#include <regex>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace core
@@ -79,7 +84,9 @@ public:
     virtual std::string profile_name() const;
 
 private:
-    std::smatch match_;
+    // The two halves of the profile name
+    std::string profile_package_;
+    std::string profile_app_;
     std::string pkg_name_;
     const bool unconfined_;
     const bool unity_;
@@ -107,22 +114,73 @@ protected:
     RequestContextResolver& operator=(const RequestContextResolver&) = delete;
 };
 
+// Remembers the apparmor context of every unique bus name it resolved. The
+// context of a unique name cannot change as long as the name exists, so
+// only the first request of a peer needs to be resolved by
+// query_context_name_async, all later ones get answered synchronously.
+// Concurrent first requests of the same peer share one query.
+class CachingRequestContextResolver : public RequestContextResolver
+{
+public:
+    // To save us some typing.
+    typedef std::shared_ptr<CachingRequestContextResolver> Ptr;
+
+    struct Statistics
+    {
+        // Requests answered from the cache.
+        std::uint64_t hits;
+        // Requests that had to wait for a query.
+        std::uint64_t misses;
+        // Total time spent waiting for queries.
+        std::chrono::microseconds miss_latency;
+
+        double hit_rate() const;
+        // Estimated time the hits saved, at the average latency of a miss.
+        std::chrono::microseconds saved_latency() const;
+    };
+
+    // From RequestContextResolver
+    void resolve_context_for_dbus_name_async(const std::string& name, ResolveCallback) override;
+
+    // Forgets the context of the given name, e.g. once the name left the bus.
+    void invalidate(const std::string& name);
+
+    Statistics statistics() const;
+
+protected:
+    CachingRequestContextResolver();
+
+    // Resolves the given name to the raw name of its apparmor context, invoking
+    // the callback once the result is available.
+    virtual void query_context_name_async(const std::string& name,
+                                          std::function<void(const std::string&)> cb) = 0;
+
+private:
+    struct Cache;
+    std::shared_ptr<Cache> cache;
+};
+
 // An implementation of RequestContextResolver that queries the dbus
-// daemon to resolve the apparmor context.
-class DBusDaemonRequestContextResolver : public RequestContextResolver
+// daemon to resolve the apparmor context, and caches the results until
+// the peer leaves the bus.
+class DBusDaemonRequestContextResolver : public CachingRequestContextResolver
 {
 public:
     // To save us some typing.
     typedef std::shared_ptr<DBusDaemonRequestContextResolver> Ptr;
 
-    // Constructs a new instance for the given bus connection.
-    DBusDaemonRequestContextResolver(const core::dbus::Bus::Ptr &);
+    // Constructs a new instance for the given bus connection, forgetting the
+    // contexts of the peers departures tells about.
+    DBusDaemonRequestContextResolver(const core::dbus::Bus::Ptr& bus, const PeerDepartures::Ptr& departures);
 
-    // From RequestContextResolver
-    void resolve_context_for_dbus_name_async(const std::string& name, ResolveCallback) override;
+protected:
+    // From CachingRequestContextResolver
+    void query_context_name_async(const std::string& name, std::function<void(const std::string&)> cb) override;
 
 private:
     org::freedesktop::dbus::DBus::Stub dbus_daemon;
+    // Declared last, so that nobody leaves while the rest is torn down
+    std::list<core::ScopedConnection> departure_connections;
 };
 
 // Abstracts an apparmor-based authentication of
@@ -153,12 +211,22 @@ protected:
 };
 
 // Takes the existing logic and exposes it as an implementation
-// of the RequestAuthenticator interface.
+// of the RequestAuthenticator interface. The rules are prepared once per
+// context, and decisions are remembered per context and directory.
 struct ExistingAuthenticator : public RequestAuthenticator
 {
     ExistingAuthenticator() = default;
     // From RequestAuthenticator
     Result authenticate_open_uri_request(const Context&, const std::string& uri) override;
+
+private:
+    struct Rules;
+
+    std::shared_ptr<Rules> rules_for(const Context& context);
+
+    std::mutex guard;
+    // Keyed by the raw context name
+    std::unordered_map<std::string, std::shared_ptr<Rules>> rules;
 };
 
 // Returns the platform-default implementation of RequestContextResolver.
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_ASYNC_CALL_H_
+#define CORE_UBUNTU_MEDIA_ASYNC_CALL_H_
+
+#include <core/dbus/object.h>
+#include <core/dbus/result.h>
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Turns a failed reply into the exception the blocking call would throw.
+// Returning without throwing falls back to a std::runtime_error.
+typedef std::function<void(const core::dbus::Error&)> ErrorTranslator;
+
+// Runs f right away, for implementations that have nothing to wait for.
+template<typename T, typename F>
+std::future<T> complete_now(F f)
+{
+    std::promise<T> promise;
+    try
+    {
+        promise.set_value(f());
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+    }
+    return promise.get_future();
+}
+
+template<typename F>
+std::future<void> complete_now_void(F f)
+{
+    std::promise<void> promise;
+    try
+    {
+        f();
+        promise.set_value();
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+    }
+    return promise.get_future();
+}
+
+template<typename T>
+void complete(std::promise<T>& promise, const core::dbus::Result<T>& result, const ErrorTranslator& translate)
+{
+    try
+    {
+        if (result.is_error())
+        {
+            if (translate)
+                translate(result.error());
+            throw std::runtime_error{result.error().print()};
+        }
+
+        promise.set_value(result.value());
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+inline void complete(std::promise<void>& promise, const core::dbus::Result<void>& result, const ErrorTranslator& translate)
+{
+    try
+    {
+        if (result.is_error())
+        {
+            if (translate)
+                translate(result.error());
+            throw std::runtime_error{result.error().print()};
+        }
+
+        promise.set_value();
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+    }
+}
+
+// Sends Method without waiting for the reply, so that any number of
+// independent calls can be in flight on the connection at the same time.
+// The future becomes ready on the bus thread once the reply arrives. If the
+// call went through, succeeded runs first, for callers that keep state the
+// call changed.
+template<typename Method, typename Result, typename... Args>
+std::future<Result> invoke_async_then(const core::dbus::Object::Ptr& object,
+                                      const ErrorTranslator& translate,
+                                      const std::function<void()>& succeeded,
+                                      const Args&... args)
+{
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+
+    try
+    {
+        object->invoke_method_asynchronously_with_callback<Method, Result>(
+                    [promise, translate, succeeded](const core::dbus::Result<Result>& result)
+                    {
+                        if (not result.is_error() and succeeded)
+                            succeeded();
+
+                        complete(*promise, result, translate);
+                    }, args...);
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    return future;
+}
+
+template<typename Method, typename Result, typename... Args>
+std::future<Result> invoke_async(const core::dbus::Object::Ptr& object,
+                                 const ErrorTranslator& translate,
+                                 const Args&... args)
+{
+    return invoke_async_then<Method, Result>(object, translate, std::function<void()>{}, args...);
+}
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_ASYNC_CALL_H_
@@ -0,0 +1,246 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CORE_UBUNTU_MEDIA_CACHED_REMOTE_PROPERTY_H_
+#define CORE_UBUNTU_MEDIA_CACHED_REMOTE_PROPERTY_H_
+
+#include <core/property.h>
+#include <core/signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Taken over all remote properties of the process
+struct RemotePropertyStatistics
+{
+    // Reads answered from the local copy, each one a Get that didn't go out
+    std::atomic<std::uint64_t> answered_locally{0};
+    // Reads that had to ask the service
+    std::atomic<std::uint64_t> fetched{0};
+
+    static RemotePropertyStatistics& instance()
+    {
+        static RemotePropertyStatistics statistics; return statistics;
+    }
+};
+
+// Keeps a local copy of a property of a remote object. Values the remote
+// object announces are taken over, reads are answered from the copy and
+// only go to the remote object if there is no valid value. Writes are
+// passed on to the remote object.
+template<typename T>
+class CachedRemoteProperty : public core::Property<T>
+{
+public:
+    typedef std::shared_ptr<CachedRemoteProperty<T>> Ptr;
+
+    explicit CachedRemoteProperty(const std::shared_ptr<core::Property<T>>& remote)
+        : remote(remote),
+          valid(false),
+          connection(remote->changed().connect([this](const T& value)
+          {
+              refresh(value);
+          }))
+    {
+    }
+
+    CachedRemoteProperty(const CachedRemoteProperty&) = delete;
+    CachedRemoteProperty& operator=(const CachedRemoteProperty&) = delete;
+
+    const T& get() const override
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (valid)
+        {
+            ++RemotePropertyStatistics::instance().answered_locally;
+            return core::Property<T>::get();
+        }
+
+        ++RemotePropertyStatistics::instance().fetched;
+        core::Property<T>::mutable_get() = remote->get();
+        valid = true;
+        return core::Property<T>::get();
+    }
+
+    void set(const T& value) override
+    {
+        remote->set(value);
+        refresh(value);
+    }
+
+    // Takes over a value the remote object told about
+    void refresh(const T& value)
+    {
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            valid = true;
+        }
+        core::Property<T>::set(value);
+    }
+
+    // For values that change without the remote object telling about it,
+    // the next read goes to the remote object again.
+    void invalidate()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        valid = false;
+    }
+
+private:
+    std::shared_ptr<core::Property<T>> remote;
+
+    mutable std::mutex guard;
+    mutable bool valid;
+
+    // Declared last, so that no change comes in while the rest is torn down
+    core::ScopedConnection connection;
+};
+
+// Answers reads of the playback position of a remote player locally, by
+// moving the last position the service told about along with the clock
+// while playing. Goes back to the service whenever the position jumps, and
+// every now and then to make up for drift.
+class ExtrapolatedPosition : public core::Property<std::int64_t>
+{
+public:
+    typedef std::shared_ptr<ExtrapolatedPosition> Ptr;
+    typedef std::chrono::steady_clock Clock;
+
+    ExtrapolatedPosition(const std::shared_ptr<core::Property<std::int64_t>>& remote,
+                         const std::chrono::milliseconds& resync_after = std::chrono::seconds{10},
+                         const std::function<Clock::time_point()>& now = &Clock::now)
+        : remote(remote),
+          resync_after(resync_after),
+          now(now),
+          valid(false),
+          playing(false),
+          rate(1.),
+          position(0),
+          connection(remote->changed().connect([this](std::int64_t value)
+          {
+              refresh(value);
+          }))
+    {
+    }
+
+    ExtrapolatedPosition(const ExtrapolatedPosition&) = delete;
+    ExtrapolatedPosition& operator=(const ExtrapolatedPosition&) = delete;
+
+    const std::int64_t& get() const override
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        const auto t = now();
+        if (valid and not (playing and t - sampled_at >= resync_after))
+        {
+            ++RemotePropertyStatistics::instance().answered_locally;
+            mutable_get() = estimate_at(t);
+            return mutable_get();
+        }
+
+        ++RemotePropertyStatistics::instance().fetched;
+        position = remote->get();
+        sampled_at = t;
+        valid = true;
+        mutable_get() = position;
+        return mutable_get();
+    }
+
+    // Takes over a position the remote object told about
+    void refresh(std::int64_t value)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        position = value;
+        sampled_at = now();
+        valid = true;
+    }
+
+    // A seek or a change of the playback status moves the position in ways
+    // that can't be told from here, the next read asks the service.
+    void invalidate()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        valid = false;
+    }
+
+    void set_playing(bool is_playing)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        resample();
+        playing = is_playing;
+    }
+
+    void set_rate(double new_rate)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        resample();
+        rate = new_rate;
+    }
+
+private:
+    // Called with guard held, moves the last position to now
+    void resample()
+    {
+        if (not valid)
+            return;
+
+        const auto t = now();
+        position = estimate_at(t);
+        sampled_at = t;
+    }
+
+    // Called with guard held
+    std::int64_t estimate_at(const Clock::time_point& t) const
+    {
+        if (not playing)
+            return position;
+
+        // Positions are in nanoseconds
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(t - sampled_at);
+        return std::max<std::int64_t>(0, position + static_cast<std::int64_t>(elapsed.count() * rate));
+    }
+
+    std::shared_ptr<core::Property<std::int64_t>> remote;
+    std::chrono::milliseconds resync_after;
+    std::function<Clock::time_point()> now;
+
+    mutable std::mutex guard;
+    mutable bool valid;
+    bool playing;
+    double rate;
+    mutable std::int64_t position;
+    mutable Clock::time_point sampled_at;
+
+    // Declared last, so that no change comes in while the rest is torn down
+    core::ScopedConnection connection;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_CACHED_REMOTE_PROPERTY_H_
@@ -0,0 +1,202 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "client_quotas.h"
+
+#include "apparmor/ubuntu.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace media = core::ubuntu::media;
+
+media::ClientQuotas::Configuration media::ClientQuotas::Configuration::from_environment()
+{
+    Configuration configuration;
+
+    if (const char *sessions = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_MAX_SESSIONS_PER_CLIENT"))
+        configuration.max_sessions = std::strtoul(sessions, nullptr, 10);
+
+    if (const char *tracks = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_MAX_TRACKS_PER_CLIENT"))
+        configuration.max_tracks = std::strtoul(tracks, nullptr, 10);
+
+    if (const char *requests = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_MAX_METADATA_REQUESTS_PER_CLIENT"))
+        configuration.max_metadata_requests = std::strtoul(requests, nullptr, 10);
+
+    return configuration;
+}
+
+std::string media::ClientQuotas::client_for(const media::apparmor::ubuntu::Context& context,
+                                            const std::string& bus_name)
+{
+    if (context.has_package_name())
+        return context.package_name();
+
+    if (context.is_unconfined())
+        return bus_name;
+
+    return context.str();
+}
+
+media::ClientQuotas::ClientQuotas(const Configuration& configuration)
+    : config(configuration)
+{
+}
+
+const media::ClientQuotas::Configuration& media::ClientQuotas::configuration() const
+{
+    return config;
+}
+
+std::size_t media::ClientQuotas::live_sessions(Client& client)
+{
+    client.sessions.erase(std::remove_if(client.sessions.begin(), client.sessions.end(),
+                                         [](const std::weak_ptr<void>& owner) { return owner.expired(); }),
+                          client.sessions.end());
+    return client.sessions.size();
+}
+
+void media::ClientQuotas::forget_if_idle(const std::string& name)
+{
+    const auto it = clients.find(name);
+    if (it == clients.end())
+        return;
+
+    if (live_sessions(it->second) == 0 and it->second.tracks == 0 and it->second.metadata_requests == 0)
+        clients.erase(it);
+}
+
+std::shared_ptr<void> media::ClientQuotas::admit_session(const std::string& client)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    auto& usage = clients[client];
+    if (live_sessions(usage) >= config.max_sessions)
+    {
+        forget_if_idle(client);
+        return std::shared_ptr<void>{};
+    }
+
+    const auto slot = std::make_shared<char>(0);
+    usage.sessions.push_back(slot);
+    return slot;
+}
+
+void media::ClientQuotas::bind_session(const std::string& client,
+                                       const std::shared_ptr<void>& slot,
+                                       const std::weak_ptr<void>& owner)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    auto& sessions = clients[client].sessions;
+    const auto it = std::find_if(sessions.begin(), sessions.end(), [&slot](const std::weak_ptr<void>& session)
+    {
+        return not session.owner_before(slot) and not slot.owner_before(session);
+    });
+
+    if (it != sessions.end())
+        *it = owner;
+    else
+        sessions.push_back(owner);
+}
+
+bool media::ClientQuotas::acquire_tracks(const std::string& client, std::size_t n)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    auto& usage = clients[client];
+    if (n > config.max_tracks - std::min(config.max_tracks, usage.tracks))
+    {
+        forget_if_idle(client);
+        return false;
+    }
+
+    usage.tracks += n;
+    return true;
+}
+
+void media::ClientQuotas::release_tracks(const std::string& client, std::size_t n)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = clients.find(client);
+    if (it == clients.end())
+        return;
+
+    it->second.tracks -= std::min(n, it->second.tracks);
+    forget_if_idle(client);
+}
+
+bool media::ClientQuotas::acquire_metadata_request(const std::string& client)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    auto& usage = clients[client];
+    if (usage.metadata_requests >= config.max_metadata_requests)
+    {
+        forget_if_idle(client);
+        return false;
+    }
+
+    ++usage.metadata_requests;
+    return true;
+}
+
+void media::ClientQuotas::release_metadata_request(const std::string& client)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = clients.find(client);
+    if (it == clients.end() or it->second.metadata_requests == 0)
+        return;
+
+    --it->second.metadata_requests;
+    forget_if_idle(client);
+}
+
+media::ClientQuotas::Usage media::ClientQuotas::usage(const std::string& client)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = clients.find(client);
+    if (it == clients.end())
+        return Usage{0, 0, 0};
+
+    return Usage{live_sessions(it->second), it->second.tracks, it->second.metadata_requests};
+}
+
+std::map<std::string, media::ClientQuotas::Usage> media::ClientQuotas::usage()
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    std::map<std::string, Usage> result;
+    for (auto it = clients.begin(); it != clients.end();)
+    {
+        Client& client = it->second;
+        const Usage usage{live_sessions(client), client.tracks, client.metadata_requests};
+        if (usage.sessions == 0 and usage.tracks == 0 and usage.metadata_requests == 0)
+        {
+            it = clients.erase(it);
+            continue;
+        }
+
+        result[it->first] = usage;
+        ++it;
+    }
+
+    return result;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_CLIENT_QUOTAS_H_
+#define CORE_UBUNTU_MEDIA_CLIENT_QUOTAS_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+namespace apparmor
+{
+namespace ubuntu
+{
+class Context;
+}
+}
+
+// Limits how much of the service a single client gets to use, so that one
+// misbehaving app can neither exhaust memory nor threads for everyone else.
+// Clients are told apart by their apparmor package name.
+class ClientQuotas
+{
+public:
+    typedef std::shared_ptr<ClientQuotas> Ptr;
+
+    struct Configuration
+    {
+        // Sessions a client may hold at the same time.
+        std::size_t max_sessions{16};
+        // Entries in all the tracklists of a client taken together.
+        std::size_t max_tracks{20000};
+        // Metadata requests of a client waiting to be answered.
+        std::size_t max_metadata_requests{64};
+
+        // Reads CORE_UBUNTU_MEDIA_SERVICE_MAX_SESSIONS_PER_CLIENT,
+        // CORE_UBUNTU_MEDIA_SERVICE_MAX_TRACKS_PER_CLIENT and
+        // CORE_UBUNTU_MEDIA_SERVICE_MAX_METADATA_REQUESTS_PER_CLIENT,
+        // falling back to the defaults.
+        static Configuration from_environment();
+    };
+
+    struct Usage
+    {
+        std::size_t sessions;
+        std::size_t tracks;
+        std::size_t metadata_requests;
+    };
+
+    // The name requests of the given context are charged to. Unconfined
+    // clients have no package name and are kept apart by their bus name.
+    static std::string client_for(const apparmor::ubuntu::Context& context, const std::string& bus_name);
+
+    explicit ClientQuotas(const Configuration& configuration);
+
+    ClientQuotas(const ClientQuotas&) = delete;
+    ClientQuotas& operator=(const ClientQuotas&) = delete;
+
+    const Configuration& configuration() const;
+
+    // Checked before building a session, as that is the expensive part. Takes
+    // one of the sessions of the client right away, so that requests arriving
+    // at the same time can't both be admitted to the last one. Returns nullptr
+    // if there is none left. The session stays taken while the slot lives.
+    std::shared_ptr<void> admit_session(const std::string& client);
+    // Hands the slot over to the session that got built, which counts against
+    // the quota of the client until owner is gone.
+    void bind_session(const std::string& client, const std::shared_ptr<void>& slot, const std::weak_ptr<void>& owner);
+
+    // Returns false, charging nothing, if n more would exceed the quota of the client.
+    bool acquire_tracks(const std::string& client, std::size_t n);
+    void release_tracks(const std::string& client, std::size_t n);
+
+    bool acquire_metadata_request(const std::string& client);
+    void release_metadata_request(const std::string& client);
+
+    Usage usage(const std::string& client);
+    // Usage of all clients currently using anything at all.
+    std::map<std::string, Usage> usage();
+
+private:
+    struct Client
+    {
+        std::vector<std::weak_ptr<void>> sessions;
+        std::size_t tracks{0};
+        std::size_t metadata_requests{0};
+    };
+
+    // Called with guard held
+    static std::size_t live_sessions(Client& client);
+    // Called with guard held, forgets about clients that use nothing anymore
+    void forget_if_idle(const std::string& name);
+
+    Configuration config;
+    std::mutex guard;
+    std::unordered_map<std::string, Client> clients;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_CLIENT_QUOTAS_H_
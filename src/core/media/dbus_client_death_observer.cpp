@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <core/media/dbus_client_death_observer.h>
+
+#include "core/media/logger/logger.h"
+
+namespace media = core::ubuntu::media;
+
+// Creates an instance of the DBusClientDeathObserver.
+media::DBusClientDeathObserver::Ptr media::DBusClientDeathObserver::create(const media::PeerDepartures::Ptr& departures,
+                                                                           boost::asio::io_service& io_service)
+{
+    Ptr observer{new media::DBusClientDeathObserver{io_service}};
+
+    const std::weak_ptr<media::DBusClientDeathObserver> weak_observer{observer};
+    observer->departures.emplace_back(departures->peer_gone().connect([weak_observer](const std::string& name)
+    {
+        if (const auto sp = weak_observer.lock())
+            sp->on_peer_gone(name);
+    }));
+
+    return observer;
+}
+
+media::DBusClientDeathObserver::DBusClientDeathObserver(boost::asio::io_service& io_service)
+    : io_service(io_service),
+      tear_down_posted(false)
+{
+}
+
+media::DBusClientDeathObserver::~DBusClientDeathObserver()
+{
+}
+
+void media::DBusClientDeathObserver::set_session_lookup(const SessionLookup& lookup)
+{
+    std::lock_guard<std::mutex> lg(guard);
+    this->lookup = lookup;
+}
+
+void media::DBusClientDeathObserver::on_peer_gone(const std::string& name)
+{
+    std::lock_guard<std::mutex> lg(guard);
+    if (not lookup)
+        return;
+
+    gone.push_back(name);
+    if (tear_down_posted)
+        return;
+
+    // Apps tend to leave in bursts, e.g. when a session of the user ends, and
+    // every client that leaves until this runs is handled along with it
+    tear_down_posted = true;
+    const std::weak_ptr<media::DBusClientDeathObserver> weak_observer{shared_from_this()};
+    io_service.post([weak_observer]()
+    {
+        if (const auto sp = weak_observer.lock())
+            sp->tear_down();
+    });
+}
+
+void media::DBusClientDeathObserver::tear_down()
+{
+    std::vector<std::string> names;
+    SessionLookup lookup;
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        names.swap(gone);
+        lookup = this->lookup;
+        tear_down_posted = false;
+    }
+
+    if (not lookup)
+        return;
+
+    std::vector<media::Player::PlayerKey> keys;
+    for (const auto& name : names)
+    {
+        const auto owned = lookup(name);
+        keys.insert(keys.end(), owned.begin(), owned.end());
+    }
+
+    if (keys.empty())
+        return;
+
+    MH_INFO("Tearing down %d sessions of %d clients that left the bus", keys.size(), names.size());
+    for (const auto key : keys)
+        client_with_key_died(key);
+}
+
+void media::DBusClientDeathObserver::register_for_death_notifications_with_key(const media::Player::PlayerKey&)
+{
+}
+
+const core::Signal<media::Player::PlayerKey>& media::DBusClientDeathObserver::on_client_with_key_died() const
+{
+    return client_with_key_died;
+}
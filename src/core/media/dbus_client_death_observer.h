@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_DBUS_CLIENT_DEATH_OBSERVER_H_
+#define CORE_UBUNTU_MEDIA_DBUS_CLIENT_DEATH_OBSERVER_H_
+
+#include <core/media/client_death_observer.h>
+
+#include "peer_departures.h"
+
+#include <boost/asio/io_service.hpp>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Models functionality to be notified whenever a client
+// of the service goes away, and thus allows us to clean
+// up in that case.
+// Implementation for any platform, watching clients leave the bus.
+class DBusClientDeathObserver : public ClientDeathObserver,
+                                public std::enable_shared_from_this<DBusClientDeathObserver>
+{
+public:
+    typedef std::shared_ptr<DBusClientDeathObserver> Ptr;
+
+    // Returns the keys of the sessions to tear down now that the client with
+    // the given unique bus name left the bus.
+    typedef std::function<std::vector<Player::PlayerKey>(const std::string&)> SessionLookup;
+
+    // Creates an instance listening to departures. Sessions of clients that
+    // left are torn down on io_service, all that left meanwhile at once.
+    static Ptr create(const PeerDepartures::Ptr& departures, boost::asio::io_service& io_service);
+
+    ~DBusClientDeathObserver();
+
+    // The owners of sessions are only known to the service skeleton, which
+    // installs the lookup once it is up.
+    void set_session_lookup(const SessionLookup& lookup);
+
+    // Called whenever a unique name loses its owner.
+    void on_peer_gone(const std::string& name);
+
+    // Owners are looked up when they leave, there is nothing to register.
+    void register_for_death_notifications_with_key(const Player::PlayerKey&) override;
+
+    // Emitted whenever a client dies, reporting the key under which the
+    // respective client was known.
+    const core::Signal<Player::PlayerKey>& on_client_with_key_died() const override;
+
+private:
+    explicit DBusClientDeathObserver(boost::asio::io_service& io_service);
+
+    // Runs on io_service, handling all the clients that left since it got posted
+    void tear_down();
+
+    boost::asio::io_service& io_service;
+
+    std::mutex guard;
+    SessionLookup lookup;
+    std::vector<std::string> gone;
+    bool tear_down_posted;
+
+    core::Signal<media::Player::PlayerKey> client_with_key_died;
+
+    // Declared last, so that nobody leaves while the rest is torn down
+    std::list<core::ScopedConnection> departures;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_DBUS_CLIENT_DEATH_OBSERVER_H_
@@ -87,6 +87,12 @@ public:
     virtual bool pause() = 0;
     virtual bool seek_to(const std::chrono::microseconds& ts) = 0;
 
+    // Frees the decoders, buffers and audio stream of a paused pipeline while keeping
+    // track of uri, position and stream selection. The next play() transparently loads
+    // the pipeline again and resumes where it left off. Returns false if nothing was released.
+    virtual bool release_pipeline() = 0;
+    virtual bool is_pipeline_released() const = 0;
+
     virtual const core::Property<bool>& is_video_source() const = 0;
     virtual const core::Property<bool>& is_audio_source() const = 0;
 
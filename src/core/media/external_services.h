@@ -22,8 +22,13 @@
 
 #include <core/dbus/asio/executor.h>
 
+#include "peer_departures.h"
+
 #include <boost/asio.hpp>
 
+#include <memory>
+#include <mutex>
+
 namespace core
 {
 namespace ubuntu
@@ -69,11 +74,27 @@ struct ExternalServices
         io_service.stop();
     }
 
+    // Peers leaving the session bus. Shared by everyone who keeps state per
+    // client, so that the bus delivers NameOwnerChanged to us only once.
+    std::shared_ptr<PeerDepartures> session_departures()
+    {
+        std::call_once(departures_once, [this]()
+        {
+            departures = std::make_shared<PeerDepartures>(session);
+        });
+
+        return departures;
+    }
+
     boost::asio::io_service io_service;
     boost::asio::io_service::work keep_alive;
 
     core::dbus::Bus::Ptr session;
     core::dbus::Bus::Ptr system;
+
+private:
+    std::once_flag departures_once;
+    std::shared_ptr<PeerDepartures> departures;
 };
 }
 }
@@ -28,7 +28,9 @@
 
 #include "core/media/logger/logger.h"
 
+#include <atomic>
 #include <cassert>
+#include <mutex>
 
 namespace media = core::ubuntu::media;
 
@@ -52,6 +54,16 @@ struct Init
 
 struct gstreamer::Engine::Private
 {
+    // Where a pipeline was when it got released, positions are in nanoseconds
+    struct Suspended
+    {
+        uint64_t position = 0;
+        uint64_t duration = 0;
+        gint audio_stream_id = -1;
+        gint video_stream_id = -1;
+        gstreamer::Playbin::MediaFileType file_type = gstreamer::Playbin::MEDIA_FILE_TYPE_NONE;
+    };
+
     media::Player::PlaybackStatus gst_state_to_player_status(const gstreamer::Bus::Message::Detail::StateChanged& state)
     {
         if (state.new_state == GST_STATE_PLAYING)
@@ -73,6 +85,13 @@ struct gstreamer::Engine::Private
             MH_INFO("State changed on playbin: %s",
                       gst_element_state_get_name(p.first.new_state));
             const auto status = gst_state_to_player_status(p.first);
+            // Releasing an idle pipeline and bringing it back is invisible to clients
+            if (hide_transitions)
+            {
+                if (status != media::Player::PlaybackStatus::playing)
+                    return;
+                hide_transitions = false;
+            }
             /*
              * When state moves to "paused" the pipeline is already set. We check that we
              * have streams to play.
@@ -273,9 +292,11 @@ struct gstreamer::Engine::Private
         buffering_changed(value);
     }
 
-    Private(const core::ubuntu::media::Player::PlayerKey key)
+    Private(const core::ubuntu::media::Player::PlayerKey key,
+            const std::shared_ptr<Engine::MetaDataExtractor>& meta_data_extractor)
         : playbin(key),
-          meta_data_extractor(new gstreamer::MetaDataExtractor()),
+          meta_data_extractor(meta_data_extractor ? meta_data_extractor
+                                                  : std::make_shared<gstreamer::SharedMetaDataExtractor>()),
           volume(media::Engine::Volume(1.)),
           orientation(media::Player::Orientation::rotate0),
           is_video_source(false),
@@ -370,11 +391,41 @@ struct gstreamer::Engine::Private
     {
     }
 
+    // Loads the released pipeline again and puts it back to where it was
+    // released, leaving it paused. Blocks until the pipeline is loaded, so it
+    // is called without pipeline_guard held, with starting set instead.
+    bool rehydrate(const Suspended& at)
+    {
+        MH_INFO("Engine: restoring released pipeline for uri: %s", playbin.uri());
+        playbin.file_type = at.file_type;
+        if (not playbin.set_state_and_wait(GST_STATE_PAUSED))
+            return false;
+
+        if (at.audio_stream_id >= 0)
+            g_object_set(G_OBJECT(playbin.pipeline), "current-audio", at.audio_stream_id, NULL);
+        if (at.video_stream_id >= 0)
+            g_object_set(G_OBJECT(playbin.pipeline), "current-video", at.video_stream_id, NULL);
+        if (at.position > 0)
+            playbin.seek(std::chrono::microseconds{at.position / 1000});
+
+        return true;
+    }
+
     // Ensure the playbin is the last item destroyed
     // otherwise properties could try to access a dead playbin object
     gstreamer::Playbin playbin;
 
     std::shared_ptr<Engine::MetaDataExtractor> meta_data_extractor;
+
+    // Serializes releasing the pipeline against the calls that need it loaded
+    std::mutex pipeline_guard;
+    std::atomic<bool> released{false};
+    std::atomic<bool> hide_transitions{false};
+    // Set while play() waits for the pipeline to come up, which it does without
+    // pipeline_guard held. Keeps the pipeline from being released meanwhile.
+    bool starting = false;
+    Suspended suspended;
+
     core::Property<Engine::State> state;
     core::Property<std::tuple<media::Track::UriType, media::Track::MetaData>> track_meta_data;
     core::Property<uint64_t> position;
@@ -412,8 +463,9 @@ struct gstreamer::Engine::Private
     core::Signal<int> buffering_changed;
 };
 
-gstreamer::Engine::Engine(const core::ubuntu::media::Player::PlayerKey key)
-    : d(new Private{key})
+gstreamer::Engine::Engine(const core::ubuntu::media::Player::PlayerKey key,
+                          const std::shared_ptr<MetaDataExtractor>& meta_data_extractor)
+    : d(new Private{key, meta_data_extractor})
 {
     d->state = media::Engine::State::no_media;
 }
@@ -438,6 +490,9 @@ const core::Property<media::Engine::State>& gstreamer::Engine::state() const
 bool gstreamer::Engine::open_resource_for_uri(const media::Track::UriType& uri,
                                               bool do_pipeline_reset)
 {
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    d->released = false;
+    d->hide_transitions = false;
     d->playbin.set_uri(uri, core::ubuntu::media::Player::HeadersType{}, do_pipeline_reset);
     return true;
 }
@@ -445,6 +500,9 @@ bool gstreamer::Engine::open_resource_for_uri(const media::Track::UriType& uri,
 bool gstreamer::Engine::open_resource_for_uri(const media::Track::UriType& uri,
                                               const core::ubuntu::media::Player::HeadersType& headers)
 {
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    d->released = false;
+    d->hide_transitions = false;
     d->playbin.set_uri(uri, headers);
     return true;
 }
@@ -456,7 +514,33 @@ void gstreamer::Engine::create_video_sink(uint32_t texture_id)
 
 bool gstreamer::Engine::play(bool use_main_thread /* = false */)
 {
-    const auto result = d->playbin.set_state_and_wait(GST_STATE_PLAYING, use_main_thread);
+    bool rehydrate = false;
+    Private::Suspended at;
+    {
+        std::lock_guard<std::mutex> lg(d->pipeline_guard);
+        rehydrate = d->released;
+        at = d->suspended;
+        d->released = false;
+        d->starting = true;
+    }
+
+    // Changing state can take a while, e.g. for network streams, during which
+    // the pipeline must not block everyone else trying to release pipelines
+    const bool restored = not rehydrate or d->rehydrate(at);
+    const bool result = restored
+            and d->playbin.set_state_and_wait(GST_STATE_PLAYING, use_main_thread);
+
+    {
+        std::lock_guard<std::mutex> lg(d->pipeline_guard);
+        d->starting = false;
+        if (not restored)
+        {
+            MH_ERROR("Engine: failed to restore released pipeline");
+            // Left where it was, to be restored by the next attempt to play
+            d->released = true;
+            d->hide_transitions = false;
+        }
+    }
 
     if (result)
     {
@@ -470,6 +554,17 @@ bool gstreamer::Engine::play(bool use_main_thread /* = false */)
 
 bool gstreamer::Engine::stop(bool use_main_thread /* = false */)
 {
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    // A released pipeline is already in the null state, only the status has to change
+    if (d->released)
+    {
+        d->released = false;
+        d->hide_transitions = false;
+        d->state = media::Engine::State::stopped;
+        d->playback_status_changed(media::Player::PlaybackStatus::stopped);
+        return true;
+    }
+
     // No need to wait, and we can immediately return.
     if (d->state == media::Engine::State::stopped)
     {
@@ -490,6 +585,11 @@ bool gstreamer::Engine::stop(bool use_main_thread /* = false */)
 
 bool gstreamer::Engine::pause()
 {
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    // Paused is what a released pipeline looks like to clients anyways
+    if (d->released)
+        return true;
+
     const auto result = d->playbin.set_state_and_wait(GST_STATE_PAUSED);
 
     if (result)
@@ -504,12 +604,53 @@ bool gstreamer::Engine::pause()
 
 bool gstreamer::Engine::seek_to(const std::chrono::microseconds& ts)
 {
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    if (d->released)
+    {
+        // Applied once the pipeline is restored
+        d->suspended.position = ts.count() * 1000;
+        d->seeked_to(ts.count());
+        return true;
+    }
+
     return d->playbin.seek(ts);
 }
 
+bool gstreamer::Engine::release_pipeline()
+{
+    std::lock_guard<std::mutex> lg(d->pipeline_guard);
+    if (d->released or d->starting)
+        return false;
+
+    // Only paused pipelines hold on to resources worth releasing. Video sinks are
+    // bound to the surface of the client, so those are left alone.
+    if (d->state != media::Engine::State::paused
+            or d->playbin.file_type == gstreamer::Playbin::MEDIA_FILE_TYPE_VIDEO)
+        return false;
+
+    d->suspended.position = d->playbin.position();
+    d->suspended.duration = d->playbin.duration();
+    d->suspended.audio_stream_id = d->playbin.audio_stream_id;
+    d->suspended.video_stream_id = d->playbin.video_stream_id;
+    d->suspended.file_type = d->playbin.file_type;
+
+    d->hide_transitions = true;
+    d->released = true;
+    // Keeps uri and request headers, but frees decoders, buffer pools and the audio stream
+    d->playbin.reset_pipeline();
+
+    MH_INFO("Engine: released idle pipeline for uri: %s", d->playbin.uri());
+    return true;
+}
+
+bool gstreamer::Engine::is_pipeline_released() const
+{
+    return d->released;
+}
+
 const core::Property<bool>& gstreamer::Engine::is_video_source() const
 {
-    gstreamer::Playbin::MediaFileType type = d->playbin.media_file_type();
+    gstreamer::Playbin::MediaFileType type = d->released ? d->suspended.file_type : d->playbin.media_file_type();
     if (type == gstreamer::Playbin::MediaFileType::MEDIA_FILE_TYPE_VIDEO)
         d->is_video_source.set(true);
     else
@@ -520,7 +661,7 @@ const core::Property<bool>& gstreamer::Engine::is_video_source() const
 
 const core::Property<bool>& gstreamer::Engine::is_audio_source() const
 {
-    gstreamer::Playbin::MediaFileType type = d->playbin.media_file_type();
+    gstreamer::Playbin::MediaFileType type = d->released ? d->suspended.file_type : d->playbin.media_file_type();
     if (type == gstreamer::Playbin::MediaFileType::MEDIA_FILE_TYPE_AUDIO)
         d->is_audio_source.set(true);
     else
@@ -531,13 +672,13 @@ const core::Property<bool>& gstreamer::Engine::is_audio_source() const
 
 const core::Property<uint64_t>& gstreamer::Engine::position() const
 {
-    d->position.set(d->playbin.position());
+    d->position.set(d->released ? d->suspended.position : d->playbin.position());
     return d->position;
 }
 
 const core::Property<uint64_t>& gstreamer::Engine::duration() const
 {
-    d->duration.set(d->playbin.duration());
+    d->duration.set(d->released ? d->suspended.duration : d->playbin.duration());
     return d->duration;
 }
 
@@ -26,7 +26,10 @@ namespace gstreamer
 class Engine : public core::ubuntu::media::Engine
 {
 public:
-    Engine(const core::ubuntu::media::Player::PlayerKey key);
+    // All engines of a service are meant to share the same meta_data_extractor,
+    // if none is given the engine gets one of its own.
+    Engine(const core::ubuntu::media::Player::PlayerKey key,
+           const std::shared_ptr<MetaDataExtractor>& meta_data_extractor = nullptr);
     ~Engine();
 
     const std::shared_ptr<MetaDataExtractor>& meta_data_extractor() const;
@@ -43,6 +46,9 @@ public:
     bool pause();
     bool seek_to(const std::chrono::microseconds& ts);
 
+    bool release_pipeline();
+    bool is_pipeline_released() const;
+
     const core::Property<bool>& is_video_source() const;
     const core::Property<bool>& is_audio_source() const;
 
@@ -28,8 +28,13 @@
 
 #include <gst/gst.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <exception>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace gstreamer
 {
@@ -270,6 +275,91 @@ private:
     GstElement* decoder;
     Bus bus;
 };
+
+// Serves the metadata requests of all sessions of the service from a small
+// pool of MetaDataExtractors, which are only created once metadata is asked
+// for. Each pipeline can only look at one uri at a time, so up to
+// max_pipelines requests are served in parallel and the rest wait for one of
+// them to finish.
+class SharedMetaDataExtractor : public core::ubuntu::media::Engine::MetaDataExtractor
+{
+public:
+    explicit SharedMetaDataExtractor(std::size_t size = 3)
+        : max_pipelines(std::max<std::size_t>(size, 1)),
+          created(0)
+    {
+    }
+
+    core::ubuntu::media::Track::MetaData meta_data_for_track_with_uri(const core::ubuntu::media::Track::UriType& uri)
+    {
+        // Hands the extractor back to the pool, also if extraction fails
+        struct Lease
+        {
+            ~Lease()
+            {
+                {
+                    std::lock_guard<std::mutex> lg(pool.guard);
+                    pool.idle.push_back(std::move(extractor));
+                }
+                pool.returned.notify_one();
+            }
+
+            SharedMetaDataExtractor& pool;
+            std::unique_ptr<gstreamer::MetaDataExtractor> extractor;
+        } lease{*this, acquire()};
+
+        return lease.extractor->meta_data_for_track_with_uri(uri);
+    }
+
+    bool has_pipeline() const
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        return created > 0;
+    }
+
+    // Number of pipelines brought up so far, never more than max_pipelines
+    std::size_t pipelines() const
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        return created;
+    }
+
+private:
+    std::unique_ptr<gstreamer::MetaDataExtractor> acquire()
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        returned.wait(ul, [this]() { return not idle.empty() or created < max_pipelines; });
+
+        if (not idle.empty())
+        {
+            std::unique_ptr<gstreamer::MetaDataExtractor> extractor{std::move(idle.back())};
+            idle.pop_back();
+            return extractor;
+        }
+
+        // Brought up without the lock held, which would stall everyone else
+        ++created;
+        ul.unlock();
+        try
+        {
+            return std::unique_ptr<gstreamer::MetaDataExtractor>(new gstreamer::MetaDataExtractor());
+        }
+        catch (...)
+        {
+            ul.lock();
+            --created;
+            ul.unlock();
+            returned.notify_one();
+            throw;
+        }
+    }
+
+    const std::size_t max_pipelines;
+    mutable std::mutex guard;
+    std::condition_variable returned;
+    std::size_t created;
+    std::vector<std::unique_ptr<gstreamer::MetaDataExtractor>> idle;
+};
 }
 
 #endif // GSTREAMER_META_DATA_EXTRACTOR_H_
@@ -21,9 +21,50 @@
 namespace media = core::ubuntu::media;
 
 media::HashedKeyedPlayerStore::HashedKeyedPlayerStore()
+    : map{std::make_shared<const Map>()}
 {
 }
 
+const std::shared_ptr<media::Player>& media::HashedKeyedPlayerStore::CurrentPlayer::get() const
+{
+    // Handed out by reference, so every thread reads into a copy of its own
+    // that no writer touches. It holds on to the player last read by the
+    // thread until the thread reads again.
+    static thread_local std::shared_ptr<media::Player> copy;
+    copy = load();
+    return copy;
+}
+
+void media::HashedKeyedPlayerStore::CurrentPlayer::set(const std::shared_ptr<media::Player>& player)
+{
+    assign(player);
+    announce();
+}
+
+std::shared_ptr<media::Player> media::HashedKeyedPlayerStore::CurrentPlayer::load() const
+{
+    std::lock_guard<std::mutex> lg{guard};
+    return value;
+}
+
+void media::HashedKeyedPlayerStore::CurrentPlayer::assign(const std::shared_ptr<media::Player>& player)
+{
+    std::lock_guard<std::mutex> lg{guard};
+    value = player;
+}
+
+void media::HashedKeyedPlayerStore::CurrentPlayer::announce()
+{
+    std::lock_guard<std::recursive_mutex> lg{announcing};
+    // The base keeps the last value announced and only signals a change
+    core::Property<std::shared_ptr<media::Player>>::set(load());
+}
+
+std::shared_ptr<const media::HashedKeyedPlayerStore::Map> media::HashedKeyedPlayerStore::load() const
+{
+    return std::atomic_load(&map);
+}
+
 const core::Property<std::shared_ptr<media::Player>>& media::HashedKeyedPlayerStore::current_player() const
 {
     return prop_current_player;
@@ -31,16 +72,15 @@ const core::Property<std::shared_ptr<media::Player>>& media::HashedKeyedPlayerSt
 
 bool media::HashedKeyedPlayerStore::has_player_for_key(const media::Player::PlayerKey& key) const
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-    return map.count(key) > 0;
+    return load()->count(key) > 0;
 }
 
 std::shared_ptr<media::Player> media::HashedKeyedPlayerStore::player_for_key(const media::Player::PlayerKey& key) const
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-    auto it = map.find(key);
+    const auto snapshot = load();
+    auto it = snapshot->find(key);
 
-    if (it == map.end()) throw std::out_of_range
+    if (it == snapshot->end()) throw std::out_of_range
     {
         "HashedKeyedPlayerStore::player_for_key: No player known for " + std::to_string(key)
     };
@@ -50,38 +90,54 @@ std::shared_ptr<media::Player> media::HashedKeyedPlayerStore::player_for_key(con
 
 void media::HashedKeyedPlayerStore::enumerate_players(const media::KeyedPlayerStore::PlayerEnumerator& enumerator) const
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-    for (const auto& pair : map)
+    // The snapshot keeps the players alive for the duration of the enumeration,
+    // even if they get removed from the store in the meantime.
+    const auto snapshot = load();
+    for (const auto& pair : *snapshot)
         enumerator(pair.first, pair.second);
 }
 
 void media::HashedKeyedPlayerStore::add_player_for_key(const media::Player::PlayerKey& key, const std::shared_ptr<media::Player>& player)
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-    map[key] = player;
+    std::lock_guard<std::mutex> lg{guard};
+
+    auto next = std::make_shared<Map>(*load());
+    (*next)[key] = player;
+    std::atomic_store(&map, std::shared_ptr<const Map>{std::move(next)});
 }
 
 void media::HashedKeyedPlayerStore::remove_player_for_key(const media::Player::PlayerKey& key)
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-
-    auto it = map.find(key);
-    if (it != map.end())
     {
-        if (prop_current_player == it->second)
-            prop_current_player = nullptr;
+        std::lock_guard<std::mutex> lg{guard};
 
-        map.erase(it);
+        const auto snapshot = load();
+        auto it = snapshot->find(key);
+        if (it == snapshot->end())
+            return;
+
+        if (prop_current_player.load() == it->second)
+            prop_current_player.assign(nullptr);
+
+        auto next = std::make_shared<Map>(*snapshot);
+        next->erase(key);
+        std::atomic_store(&map, std::shared_ptr<const Map>{std::move(next)});
     }
+
+    prop_current_player.announce();
 }
 
 size_t media::HashedKeyedPlayerStore::number_of_players() const
 {
-    std::lock_guard<std::recursive_mutex> lg{guard};
-    return map.size();
+    return load()->size();
 }
 
 void media::HashedKeyedPlayerStore::set_current_player_for_key(const media::Player::PlayerKey& key)
 {
-    prop_current_player = player_for_key(key);
+    {
+        std::lock_guard<std::mutex> lg{guard};
+        prop_current_player.assign(player_for_key(key));
+    }
+
+    prop_current_player.announce();
 }
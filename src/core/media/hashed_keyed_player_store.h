@@ -21,6 +21,7 @@
 
 #include <core/media/keyed_player_store.h>
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
@@ -30,7 +31,9 @@ namespace ubuntu
 {
 namespace media
 {
-// Implements KeyedPlayerStore using a std::unordered_map.
+// Implements KeyedPlayerStore using a std::unordered_map. Writers copy the map,
+// modify the copy and publish it as a new immutable snapshot, so that readers
+// never take a lock and enumerators run without any lock held.
 class HashedKeyedPlayerStore : public KeyedPlayerStore
 {
 public:
@@ -51,7 +54,8 @@ public:
     std::shared_ptr<Player> player_for_key(const Player::PlayerKey& key) const override;
 
     // Enumerates all known players and invokes the given enumerator for each
-    // (key, player) pair.
+    // (key, player) pair. The enumeration covers the players known when it started
+    // and the enumerator is free to call back into the store.
     void enumerate_players(const PlayerEnumerator& enumerator) const override;
 
     // Adds the given player with the given key.
@@ -68,9 +72,37 @@ public:
     void set_current_player_for_key(const Player::PlayerKey& key) override;
 
 private:
-    core::Property<std::shared_ptr<Player>> prop_current_player;
-    mutable std::recursive_mutex guard;
-    std::unordered_map<Player::PlayerKey, std::shared_ptr<Player>> map;
+    typedef std::unordered_map<Player::PlayerKey, std::shared_ptr<Player>> Map;
+
+    // Can be read from any thread. Writers of the store assign to it with the
+    // store locked and announce the change once the store is unlocked, so that
+    // observers are free to call back into the store from any thread.
+    class CurrentPlayer : public core::Property<std::shared_ptr<Player>>
+    {
+    public:
+        const std::shared_ptr<Player>& get() const override;
+        void set(const std::shared_ptr<Player>& player) override;
+
+        std::shared_ptr<Player> load() const;
+        void assign(const std::shared_ptr<Player>& player);
+        // Tells observers about the player current by now, if it changed
+        // since the last announcement
+        void announce();
+
+    private:
+        mutable std::mutex guard;
+        std::shared_ptr<Player> value;
+        // Keeps announcements in order, a changed handler may announce again
+        std::recursive_mutex announcing;
+    };
+
+    std::shared_ptr<const Map> load() const;
+
+    CurrentPlayer prop_current_player;
+    // Serializes writers, including those of prop_current_player
+    std::mutex guard;
+    // Only ever accessed through std::atomic_load/std::atomic_store
+    std::shared_ptr<const Map> map;
 };
 }
 }
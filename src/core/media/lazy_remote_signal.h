@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CORE_UBUNTU_MEDIA_LAZY_REMOTE_SIGNAL_H_
+#define CORE_UBUNTU_MEDIA_LAZY_REMOTE_SIGNAL_H_
+
+#include <core/dbus/object.h>
+#include <core/dbus/signal.h>
+
+#include <core/signal.h>
+
+#include "core/media/logger/logger.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Forwards a signal of a remote object to a local one. The bus is only asked
+// to deliver the signal once the local one is asked for, so signals nobody
+// connects to cost neither a match rule nor a round trip to set one up.
+template<typename Description, typename Argument = typename Description::ArgumentType>
+class LazyRemoteSignal
+{
+public:
+    typedef typename core::dbus::Signal<Description, Argument>::Ptr Remote;
+    // Sets up the delivery of the remote signal
+    typedef std::function<Remote()> Subscribe;
+
+    explicit LazyRemoteSignal(const core::dbus::Object::Ptr& object)
+        : subscribe([object]() { return object->template get_signal<Description>(); })
+    {
+    }
+
+    explicit LazyRemoteSignal(const Subscribe& subscribe)
+        : subscribe(subscribe)
+    {
+    }
+
+    LazyRemoteSignal(const LazyRemoteSignal&) = delete;
+    LazyRemoteSignal& operator=(const LazyRemoteSignal&) = delete;
+
+    core::Signal<Argument>& get()
+    {
+        std::call_once(subscribed, [this]()
+        {
+            remote = subscribe();
+            remote->connect([this](const Argument& argument)
+            {
+                MH_DEBUG("%s signal arrived via the bus.", Description::name());
+                local(argument);
+            });
+        });
+
+        return local;
+    }
+
+private:
+    Subscribe subscribe;
+    std::once_flag subscribed;
+    core::Signal<Argument> local;
+    // Declared last, so that nothing arrives while the rest is torn down
+    Remote remote;
+};
+
+template<typename Description>
+class LazyRemoteSignal<Description, void>
+{
+public:
+    typedef typename core::dbus::Signal<Description, void>::Ptr Remote;
+    // Sets up the delivery of the remote signal
+    typedef std::function<Remote()> Subscribe;
+
+    explicit LazyRemoteSignal(const core::dbus::Object::Ptr& object)
+        : subscribe([object]() { return object->template get_signal<Description>(); })
+    {
+    }
+
+    explicit LazyRemoteSignal(const Subscribe& subscribe)
+        : subscribe(subscribe)
+    {
+    }
+
+    LazyRemoteSignal(const LazyRemoteSignal&) = delete;
+    LazyRemoteSignal& operator=(const LazyRemoteSignal&) = delete;
+
+    core::Signal<void>& get()
+    {
+        std::call_once(subscribed, [this]()
+        {
+            remote = subscribe();
+            remote->connect([this]()
+            {
+                MH_DEBUG("%s signal arrived via the bus.", Description::name());
+                local();
+            });
+        });
+
+        return local;
+    }
+
+private:
+    Subscribe subscribe;
+    std::once_flag subscribed;
+    core::Signal<void> local;
+    // Declared last, so that nothing arrives while the rest is torn down
+    Remote remote;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_LAZY_REMOTE_SIGNAL_H_
@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MPRIS_CACHED_PROPERTIES_H_
+#define MPRIS_CACHED_PROPERTIES_H_
+
+#include <core/dbus/types/variant.h>
+
+#include <core/property.h>
+#include <core/signal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace mpris
+{
+// Keeps the dictionary that GetAll answers with for one interface, so that
+// properties only get encoded again once any of them changed.
+class CachedProperties
+{
+public:
+    typedef std::map<std::string, core::dbus::types::Variant> Dictionary;
+
+    struct Statistics
+    {
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> misses{0};
+    };
+
+    // Taken over all caches
+    static Statistics& statistics()
+    {
+        static Statistics instance; return instance;
+    }
+
+    explicit CachedProperties(const std::function<Dictionary()>& build)
+        : build(build),
+          valid(false)
+    {
+    }
+
+    CachedProperties(const CachedProperties&) = delete;
+    CachedProperties& operator=(const CachedProperties&) = delete;
+
+    // Any change to property throws the dictionary away. Properties whose
+    // value comes from a getter don't tell about changes and must not be
+    // part of the dictionary.
+    template<typename T>
+    void watch(const core::Property<T>& property)
+    {
+        connections.emplace_back(property.changed().connect([this](const T&)
+        {
+            invalidate();
+        }));
+    }
+
+    Dictionary get()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (valid)
+        {
+            ++statistics().hits;
+            return dict;
+        }
+
+        ++statistics().misses;
+        dict = build();
+        valid = true;
+        return dict;
+    }
+
+    void invalidate()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        valid = false;
+    }
+
+private:
+    std::function<Dictionary()> build;
+
+    std::mutex guard;
+    Dictionary dict;
+    bool valid;
+
+    // Declared last, so that no change comes in while the rest is torn down
+    std::list<core::ScopedConnection> connections;
+};
+}
+
+#endif // MPRIS_CACHED_PROPERTIES_H_
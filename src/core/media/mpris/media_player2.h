@@ -25,6 +25,8 @@
 #include <core/dbus/interfaces/properties.h>
 #include <core/dbus/types/variant.h>
 
+#include "cached_properties.h"
+
 #include <string>
 #include <vector>
 
@@ -139,6 +141,10 @@ struct MediaPlayer2
               signals
               {
                   configuration.object->get_signal<core::dbus::interfaces::Properties::Signals::PropertiesChanged>()
+              },
+              cached_properties
+              {
+                  std::bind(&Skeleton::get_cacheable_properties, this)
               }
         {
             // Initialize property values of the media_player instance.
@@ -150,9 +156,23 @@ struct MediaPlayer2
             properties.desktop_entry->set(configuration.defaults.desktop_entry);
             properties.identity->set(configuration.defaults.identity);
             properties.supported_mime_types->set(configuration.defaults.supported_mime_types);
+
+            cached_properties.watch(*properties.can_quit);
+            cached_properties.watch(*properties.fullscreen);
+            cached_properties.watch(*properties.can_set_fullscreen);
+            cached_properties.watch(*properties.can_raise);
+            cached_properties.watch(*properties.has_track_list);
+            cached_properties.watch(*properties.identity);
+            cached_properties.watch(*properties.desktop_entry);
+            cached_properties.watch(*properties.supported_mime_types);
         }
 
         std::map<std::string, core::dbus::types::Variant> get_all_properties()
+        {
+            return cached_properties.get();
+        }
+
+        std::map<std::string, core::dbus::types::Variant> get_cacheable_properties()
         {
             std::map<std::string, core::dbus::types::Variant> dict;
             dict[Properties::CanQuit::name()]
@@ -202,6 +222,9 @@ struct MediaPlayer2
                 core::dbus::interfaces::Properties::Signals::PropertiesChanged::ArgumentType
             >::Ptr properties_changed;
         } signals;
+
+        // Answers GetAll for the properties above
+        CachedProperties cached_properties;
     };
 };
 }
@@ -32,6 +32,7 @@
 #include <core/dbus/interfaces/properties.h>
 #include <core/dbus/types/any.h>
 #include <core/dbus/types/object_path.h>
+#include <core/dbus/types/unix_fd.h>
 #include <core/dbus/types/variant.h>
 
 #include <core/dbus/types/stl/tuple.h>
@@ -46,6 +47,9 @@
 
 #include "core/media/logger/logger.h"
 
+#include "cached_properties.h"
+#include "properties_changed_batch.h"
+
 namespace dbus = core::dbus;
 
 namespace mpris
@@ -134,6 +138,14 @@ struct Player
                 "mpris.Player.Error.UriNotFound"
             };
         };
+
+        struct StatusPageNotAvailable
+        {
+            static constexpr const char* name
+            {
+                "mpris.Player.Error.StatusPageNotAvailable"
+            };
+        };
     };
 
     typedef std::map<std::string, core::dbus::types::Variant> Dictionary;
@@ -150,6 +162,7 @@ struct Player
     DBUS_CPP_METHOD_DEF(Key, Player)
     DBUS_CPP_METHOD_DEF(OpenUri, Player)
     DBUS_CPP_METHOD_DEF(OpenUriExtended, Player)
+    DBUS_CPP_METHOD_DEF(GetStatusPage, Player)
 
     struct Signals
     {
@@ -274,6 +287,14 @@ struct Player
                   configuration.object->template get_signal<Signals::Error>(),
                   configuration.object->template get_signal<Signals::Buffering>(),
                   configuration.object->template get_signal<core::dbus::interfaces::Properties::Signals::PropertiesChanged>()
+              },
+              property_changes
+              {
+                  PropertiesChangedBatch::create(emitter_for(signals.properties_changed))
+              },
+              cached_properties
+              {
+                  std::bind(&Skeleton::get_cacheable_properties, this)
               }
         {
             properties.can_play->set(configuration.defaults.can_play);
@@ -300,6 +321,25 @@ struct Player
             properties.minimum_playback_rate->set(configuration.defaults.minimum_rate);
             properties.maximum_playback_rate->set(configuration.defaults.maximum_rate);
 
+            cached_properties.watch(*properties.can_play);
+            cached_properties.watch(*properties.can_pause);
+            cached_properties.watch(*properties.can_seek);
+            cached_properties.watch(*properties.can_control);
+            cached_properties.watch(*properties.playback_status);
+            cached_properties.watch(*properties.typed_playback_status);
+            cached_properties.watch(*properties.typed_backend);
+            cached_properties.watch(*properties.loop_status);
+            cached_properties.watch(*properties.typed_loop_status);
+            cached_properties.watch(*properties.audio_stream_role);
+            cached_properties.watch(*properties.orientation);
+            cached_properties.watch(*properties.lifetime);
+            cached_properties.watch(*properties.playback_rate);
+            cached_properties.watch(*properties.shuffle);
+            cached_properties.watch(*properties.meta_data_for_current_track);
+            cached_properties.watch(*properties.volume);
+            cached_properties.watch(*properties.minimum_playback_rate);
+            cached_properties.watch(*properties.maximum_playback_rate);
+
             // Make sure the Orientation Property gets sent over DBus to the client
             properties.orientation->changed().connect([this](const core::ubuntu::media::Player::Orientation& o)
             {
@@ -350,28 +390,72 @@ struct Player
             {
                 on_property_value_changed<Properties::CanGoPrevious>(can_go_previous);
             });
+
+            // Clients keep a copy of all properties that are set, and rely on
+            // being told about every change to them.
+            announce_changes_of<Properties::CanSeek>(properties.can_seek);
+            announce_changes_of<Properties::CanControl>(properties.can_control);
+            announce_changes_of<Properties::TypedPlaybackStatus>(properties.typed_playback_status);
+            announce_changes_of<Properties::TypedBackend>(properties.typed_backend);
+            announce_changes_of<Properties::TypedLoopStatus>(properties.typed_loop_status);
+            announce_changes_of<Properties::AudioStreamRole>(properties.audio_stream_role);
+            announce_changes_of<Properties::Lifetime>(properties.lifetime);
+            announce_changes_of<Properties::PlaybackRate>(properties.playback_rate);
+            announce_changes_of<Properties::Metadata>(properties.meta_data_for_current_track);
+            announce_changes_of<Properties::Volume>(properties.volume);
+            announce_changes_of<Properties::MinimumRate>(properties.minimum_playback_rate);
+            announce_changes_of<Properties::MaximumRate>(properties.maximum_playback_rate);
         }
 
         template<typename Property>
-        void on_property_value_changed(const typename Property::ValueType& value)
+        void announce_changes_of(const std::shared_ptr<core::dbus::Property<Property>>& property)
         {
-            Dictionary dict; dict[Property::name()] = dbus::types::Variant::encode(value);
+            property->changed().connect([this](const typename Property::ValueType& value)
+            {
+                on_property_value_changed<Property>(value);
+            });
+        }
 
-            signals.properties_changed->emit(std::make_tuple(
-                        dbus::traits::Service<Player>::interface_name(),
-                        dict,
-                        the_empty_list_of_invalidated_properties()));
+        template<typename Signal>
+        static PropertiesChangedBatch::Emitter emitter_for(const Signal& signal)
+        {
+            return [signal](const Dictionary& dict)
+            {
+                signal->emit(std::make_tuple(
+                            dbus::traits::Service<Player>::interface_name(),
+                            dict,
+                            the_empty_list_of_invalidated_properties()));
+            };
+        }
+
+        template<typename Property>
+        void on_property_value_changed(const typename Property::ValueType& value)
+        {
+            property_changes->add(Property::name(), dbus::types::Variant::encode(value));
         }
 
         Dictionary get_all_properties()
+        {
+            Dictionary dict = cached_properties.get();
+            // Sessions install getters for these, which don't tell about changes
+            dict[Properties::CanGoNext::name()] = dbus::types::Variant::encode(properties.can_go_next->get());
+            dict[Properties::CanGoPrevious::name()] = dbus::types::Variant::encode(properties.can_go_previous->get());
+            dict[Properties::Duration::name()] = dbus::types::Variant::encode(properties.duration->get());
+            dict[Properties::Position::name()] = dbus::types::Variant::encode(properties.position->get());
+            dict[Properties::IsVideoSource::name()] = dbus::types::Variant::encode(properties.is_video_source->get());
+            dict[Properties::IsAudioSource::name()] = dbus::types::Variant::encode(properties.is_audio_source->get());
+
+            return dict;
+        }
+
+        // All of get_all_properties() that only changes by setting the properties
+        Dictionary get_cacheable_properties()
         {
             Dictionary dict;
             dict[Properties::CanPlay::name()] = dbus::types::Variant::encode(properties.can_play->get());
             dict[Properties::CanPause::name()] = dbus::types::Variant::encode(properties.can_pause->get());
             dict[Properties::CanSeek::name()] = dbus::types::Variant::encode(properties.can_seek->get());
             dict[Properties::CanControl::name()] = dbus::types::Variant::encode(properties.can_control->get());
-            dict[Properties::CanGoNext::name()] = dbus::types::Variant::encode(properties.can_go_next->get());
-            dict[Properties::CanGoPrevious::name()] = dbus::types::Variant::encode(properties.can_go_previous->get());
             dict[Properties::PlaybackStatus::name()] = dbus::types::Variant::encode(properties.playback_status->get());
             dict[Properties::TypedPlaybackStatus::name()] = dbus::types::Variant::encode(properties.typed_playback_status->get());
             dict[Properties::TypedBackend::name()] = dbus::types::Variant::encode(properties.typed_backend->get());
@@ -383,8 +467,7 @@ struct Player
             dict[Properties::PlaybackRate::name()] = dbus::types::Variant::encode(properties.playback_rate->get());
             dict[Properties::Shuffle::name()] = dbus::types::Variant::encode(properties.shuffle->get());
             dict[Properties::Metadata::name()] = dbus::types::Variant::encode(properties.meta_data_for_current_track->get());
-            dict[Properties::Duration::name()] = dbus::types::Variant::encode(properties.duration->get());
-            dict[Properties::Position::name()] = dbus::types::Variant::encode(properties.position->get());
+            dict[Properties::Volume::name()] = dbus::types::Variant::encode(properties.volume->get());
             dict[Properties::MinimumRate::name()] = dbus::types::Variant::encode(properties.minimum_playback_rate->get());
             dict[Properties::MaximumRate::name()] = dbus::types::Variant::encode(properties.maximum_playback_rate->get());
 
@@ -439,6 +522,11 @@ struct Player
                 core::dbus::interfaces::Properties::Signals::PropertiesChanged::ArgumentType
             >::Ptr properties_changed;
         } signals;
+
+        // Sends the changes to the properties above as PropertiesChanged
+        PropertiesChangedBatch::Ptr property_changes;
+        // Answers GetAll for the properties above
+        CachedProperties cached_properties;
     };
 };
 }
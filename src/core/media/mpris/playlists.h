@@ -26,6 +26,8 @@
 #include <core/dbus/types/struct.h>
 #include <core/dbus/types/variant.h>
 
+#include "cached_properties.h"
+
 #include <string>
 #include <vector>
 
@@ -98,6 +100,47 @@ struct Playlists
         >
     > MaybePlaylist;
 
+    struct Errors
+    {
+        Errors() = delete;
+
+        struct UnknownOrdering
+        {
+            static const std::string& name()
+            {
+                static const std::string s
+                {
+                    "org.mpris.MediaPlayer2.Playlists.Error.UnknownOrdering"
+                };
+                return s;
+            }
+        };
+
+        struct UnknownPlaylist
+        {
+            static const std::string& name()
+            {
+                static const std::string s
+                {
+                    "org.mpris.MediaPlayer2.Playlists.Error.UnknownPlaylist"
+                };
+                return s;
+            }
+        };
+
+        struct NoActiveSession
+        {
+            static const std::string& name()
+            {
+                static const std::string s
+                {
+                    "org.mpris.MediaPlayer2.Playlists.Error.NoActiveSession"
+                };
+                return s;
+            }
+        };
+    };
+
     struct Methods
     {
         Methods() = delete;
@@ -178,22 +221,38 @@ struct Playlists
               properties
               {
                   configuration.object->get_property<Properties::PlaylistCount>(),
-                  configuration.object->get_property<Properties::Orderings>()
+                  configuration.object->get_property<Properties::Orderings>(),
+                  configuration.object->get_property<Properties::ActivePlaylist>()
               },
               signals
               {
                   configuration.object->get_signal<Signals::PlaylistsChanged>()
+              },
+              cached_properties
+              {
+                  std::bind(&Skeleton::get_cacheable_properties, this)
               }
         {
             properties.playlist_count->set(configuration.defaults.playlist_count);
             properties.orderings->set(configuration.defaults.orderings);
+            properties.active_playlist->set(configuration.defaults.active_playlist);
+
+            cached_properties.watch(*properties.playlist_count);
+            cached_properties.watch(*properties.orderings);
+            cached_properties.watch(*properties.active_playlist);
         }
 
         std::map<std::string, core::dbus::types::Variant> get_all_properties()
+        {
+            return cached_properties.get();
+        }
+
+        std::map<std::string, core::dbus::types::Variant> get_cacheable_properties()
         {
             std::map<std::string, core::dbus::types::Variant> dict;
             dict[Properties::PlaylistCount::name()] = core::dbus::types::Variant::encode(properties.playlist_count->get());
             dict[Properties::Orderings::name()] = core::dbus::types::Variant::encode(properties.orderings->get());
+            dict[Properties::ActivePlaylist::name()] = core::dbus::types::Variant::encode(properties.active_playlist->get());
 
             return dict;
         }
@@ -204,12 +263,16 @@ struct Playlists
         {
             std::shared_ptr<core::dbus::Property<Properties::PlaylistCount>> playlist_count;
             std::shared_ptr<core::dbus::Property<Properties::Orderings>> orderings;
+            std::shared_ptr<core::dbus::Property<Properties::ActivePlaylist>> active_playlist;
         } properties;
 
         struct
         {
             core::dbus::Signal<Signals::PlaylistsChanged, Signals::PlaylistsChanged::ArgumentType>::Ptr playlist_changed;
         } signals;
+
+        // Answers GetAll for the properties above
+        CachedProperties cached_properties;
     };
 };
 }
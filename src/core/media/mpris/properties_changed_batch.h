@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MPRIS_PROPERTIES_CHANGED_BATCH_H_
+#define MPRIS_PROPERTIES_CHANGED_BATCH_H_
+
+#include <core/dbus/types/variant.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mpris
+{
+// Collects the changes to the properties of one interface of an object, so
+// that all changes of a dispatch cycle go out as a single PropertiesChanged.
+// Without a scheduler every change is sent right away.
+class PropertiesChangedBatch : public std::enable_shared_from_this<PropertiesChangedBatch>
+{
+public:
+    typedef std::shared_ptr<PropertiesChangedBatch> Ptr;
+    typedef std::map<std::string, core::dbus::types::Variant> Dictionary;
+    // Sends the dictionary of changed properties
+    typedef std::function<void(const Dictionary&)> Emitter;
+    // Runs the given flush once the current dispatch cycle is done
+    typedef std::function<void(const std::function<void()>&)> Scheduler;
+
+    struct Statistics
+    {
+        std::atomic<std::uint64_t> changes{0};
+        std::atomic<std::uint64_t> messages{0};
+    };
+
+    // Taken over all batches
+    static Statistics& statistics()
+    {
+        static Statistics instance; return instance;
+    }
+
+    static Ptr create(const Emitter& emitter)
+    {
+        return Ptr{new PropertiesChangedBatch{emitter}};
+    }
+
+    PropertiesChangedBatch(const PropertiesChangedBatch&) = delete;
+    PropertiesChangedBatch& operator=(const PropertiesChangedBatch&) = delete;
+
+    void set_scheduler(const Scheduler& scheduler)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        this->scheduler = scheduler;
+    }
+
+    void add(const std::string& name, const core::dbus::types::Variant& value)
+    {
+        ++statistics().changes;
+
+        Scheduler schedule;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            if (scheduler)
+            {
+                // A later value of the same property replaces the earlier one
+                pending[name] = value;
+                if (flush_scheduled)
+                    return;
+
+                flush_scheduled = true;
+                schedule = scheduler;
+            }
+        }
+
+        if (not schedule)
+        {
+            Dictionary dict; dict[name] = value;
+            emit(dict);
+            return;
+        }
+
+        const std::weak_ptr<PropertiesChangedBatch> weak_batch{shared_from_this()};
+        schedule([weak_batch]()
+        {
+            if (const auto sp = weak_batch.lock())
+                sp->flush();
+        });
+    }
+
+    // Sends all changes collected so far, if any
+    void flush()
+    {
+        Dictionary dict;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            dict.swap(pending);
+            flush_scheduled = false;
+        }
+
+        if (not dict.empty())
+            emit(dict);
+    }
+
+private:
+    explicit PropertiesChangedBatch(const Emitter& emitter)
+        : emitter(emitter),
+          flush_scheduled(false)
+    {
+    }
+
+    void emit(const Dictionary& dict)
+    {
+        ++statistics().messages;
+        emitter(dict);
+    }
+
+    Emitter emitter;
+
+    std::mutex guard;
+    Scheduler scheduler;
+    Dictionary pending;
+    bool flush_scheduled;
+};
+}
+
+#endif // MPRIS_PROPERTIES_CHANGED_BATCH_H_
@@ -119,6 +119,30 @@ struct Service
                 return s;
             }
         };
+
+        struct QuotaExceeded
+        {
+            static const std::string& name()
+            {
+                static const std::string s
+                {
+                    "core.ubuntu.media.Service.Error.QuotaExceeded"
+                };
+                return s;
+            }
+        };
+
+        struct InsufficientAppArmorPermissions
+        {
+            static const std::string& name()
+            {
+                static const std::string s
+                {
+                    "core.ubuntu.media.Service.Error.InsufficientAppArmorPermissions"
+                };
+                return s;
+            }
+        };
     };
 
     DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(CreateSession, Service, 1000)
@@ -128,6 +152,8 @@ struct Service
     DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(CreateFixedSession, Service, 1000)
     DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(ResumeSession, Service, 1000)
     DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(PauseOtherSessions, Service, 1000)
+    DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(GetClientUsage, Service, 1000)
+    DBUS_CPP_METHOD_WITH_TIMEOUT_DEF(BootstrapSession, Service, 1000)
 };
 }
 
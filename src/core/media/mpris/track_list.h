@@ -30,6 +30,7 @@
 
 #include <boost/utility/identity_type.hpp>
 
+#include <cstdint>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -89,12 +90,30 @@ struct TrackList
                 "mpris.TrackList.Error.TrackNotFound"
             };
         };
+
+        struct QuotaExceeded
+        {
+            static constexpr const char* name
+            {
+                "mpris.TrackList.Error.QuotaExceeded"
+            };
+        };
+
+        struct Cancelled
+        {
+            static constexpr const char* name
+            {
+                "mpris.TrackList.Error.Cancelled"
+            };
+        };
     };
 
     DBUS_CPP_METHOD_DEF(GetTracksMetadata, TrackList)
     DBUS_CPP_METHOD_DEF(GetTracksUri, TrackList)
     DBUS_CPP_METHOD_DEF(AddTrack, TrackList)
     DBUS_CPP_METHOD_DEF(AddTracks, TrackList)
+    DBUS_CPP_METHOD_DEF(AddTracksFromPlaylist, TrackList)
+    DBUS_CPP_METHOD_DEF(ReplaceTracks, TrackList)
     DBUS_CPP_METHOD_DEF(MoveTrack, TrackList)
     DBUS_CPP_METHOD_DEF(RemoveTrack, TrackList)
     DBUS_CPP_METHOD_DEF(GoTo, TrackList)
@@ -125,6 +144,13 @@ struct TrackList
             core::ubuntu::media::TrackList::ContainerURI
         )
 
+        DBUS_CPP_SIGNAL_DEF
+        (
+            PlaylistImportProgress,
+            TrackList,
+            BOOST_IDENTITY_TYPE((std::tuple<core::ubuntu::media::Track::UriType, std::uint64_t, bool>))
+        )
+
         DBUS_CPP_SIGNAL_DEF
         (
             TrackMoved,
@@ -201,6 +227,7 @@ struct TrackList
                   configuration.object->template get_signal<Signals::TrackListReplaced>(),
                   configuration.object->template get_signal<Signals::TrackAdded>(),
                   configuration.object->template get_signal<Signals::TracksAdded>(),
+                  configuration.object->template get_signal<Signals::PlaylistImportProgress>(),
                   configuration.object->template get_signal<Signals::TrackMoved>(),
                   configuration.object->template get_signal<Signals::TrackRemoved>(),
                   configuration.object->template get_signal<Signals::TrackChanged>(),
@@ -212,6 +239,21 @@ struct TrackList
             // Set the default value of the properties on the MPRIS TrackList dbus interface
             properties.tracks->set(configuration.defaults.tracks);
             properties.can_edit_tracks->set(configuration.defaults.can_edit_tracks);
+
+            // Clients keep a copy of the properties. The tracks can be plenty,
+            // so changes to them are only announced as invalidating the copy.
+            properties.tracks->changed().connect([this](const Properties::Tracks::ValueType&)
+            {
+                signals.properties_changed->emit(std::make_tuple(
+                                dbus::traits::Service<TrackList>::interface_name(),
+                                Dictionary{},
+                                std::vector<std::string>{Properties::Tracks::name()}));
+            });
+
+            properties.can_edit_tracks->changed().connect([this](bool can_edit_tracks)
+            {
+                on_property_value_changed<Properties::CanEditTracks>(can_edit_tracks);
+            });
         }
 
         template<typename Property>
@@ -248,6 +290,7 @@ struct TrackList
             core::dbus::Signal<Signals::TrackListReplaced, Signals::TrackListReplaced::ArgumentType>::Ptr tracklist_replaced;
             core::dbus::Signal<Signals::TrackAdded, Signals::TrackAdded::ArgumentType>::Ptr track_added;
             core::dbus::Signal<Signals::TracksAdded, Signals::TracksAdded::ArgumentType>::Ptr tracks_added;
+            core::dbus::Signal<Signals::PlaylistImportProgress, Signals::PlaylistImportProgress::ArgumentType>::Ptr playlist_import_progress;
             core::dbus::Signal<Signals::TrackMoved, Signals::TrackMoved::ArgumentType>::Ptr track_moved;
             core::dbus::Signal<Signals::TrackRemoved, Signals::TrackRemoved::ArgumentType>::Ptr track_removed;
             core::dbus::Signal<Signals::TrackChanged, Signals::TrackChanged::ArgumentType>::Ptr track_changed;
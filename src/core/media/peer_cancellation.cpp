@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "peer_cancellation.h"
+
+#include "core/media/logger/logger.h"
+
+#include <algorithm>
+#include <list>
+
+namespace media = core::ubuntu::media;
+
+media::CancellationToken::CancellationToken()
+{
+}
+
+media::CancellationToken::CancellationToken(const std::shared_ptr<std::atomic<bool>>& cancelled)
+    : cancelled(cancelled)
+{
+}
+
+bool media::CancellationToken::is_cancelled() const
+{
+    return cancelled and cancelled->load();
+}
+
+struct media::PeerCancellation::Private
+{
+    void cancel(const std::string& name)
+    {
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+
+            const auto it = tokens.find(name);
+            if (it == tokens.end())
+                return;
+
+            cancelled = it->second.lock();
+            tokens.erase(it);
+        }
+
+        if (cancelled)
+        {
+            MH_DEBUG("Cancelling pending work of %s, which left the bus", name);
+            cancelled->store(true);
+        }
+    }
+
+    // Called with guard held, drops the peers no work holds a token for anymore
+    void sweep()
+    {
+        for (auto it = tokens.begin(); it != tokens.end();)
+        {
+            if (it->second.expired())
+                it = tokens.erase(it);
+            else
+                ++it;
+        }
+
+        sweep_at = std::max(min_sweep_at, 2 * tokens.size());
+    }
+
+    static constexpr std::size_t min_sweep_at{64};
+
+    mutable std::mutex guard;
+    std::unordered_map<std::string, std::weak_ptr<std::atomic<bool>>> tokens;
+    std::size_t sweep_at{min_sweep_at};
+    // Declared last, so that nobody leaves while the rest is torn down
+    std::list<core::ScopedConnection> departures;
+};
+
+constexpr std::size_t media::PeerCancellation::Private::min_sweep_at;
+
+media::PeerCancellation::PeerCancellation()
+    : d(std::make_shared<Private>())
+{
+}
+
+media::PeerCancellation::PeerCancellation(const media::PeerDepartures::Ptr& departures)
+    : d(std::make_shared<Private>())
+{
+    const std::weak_ptr<Private> weak_d{d};
+    d->departures.emplace_back(departures->peer_gone().connect([weak_d](const std::string& name)
+    {
+        if (const auto sp = weak_d.lock())
+            sp->cancel(name);
+    }));
+}
+
+media::PeerCancellation::~PeerCancellation()
+{
+}
+
+media::CancellationToken media::PeerCancellation::token_for(const std::string& name)
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+
+    auto& weak_token = d->tokens[name];
+    auto cancelled = weak_token.lock();
+    if (not cancelled)
+    {
+        cancelled = std::make_shared<std::atomic<bool>>(false);
+        weak_token = cancelled;
+    }
+
+    if (d->tokens.size() >= d->sweep_at)
+        d->sweep();
+
+    return CancellationToken{cancelled};
+}
+
+void media::PeerCancellation::on_peer_gone(const std::string& name)
+{
+    d->cancel(name);
+}
+
+std::size_t media::PeerCancellation::size() const
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+    return std::count_if(d->tokens.begin(), d->tokens.end(),
+                         [](const std::pair<const std::string, std::weak_ptr<std::atomic<bool>>>& token)
+                         {
+                             return not token.second.expired();
+                         });
+}
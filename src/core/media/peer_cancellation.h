@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_PEER_CANCELLATION_H_
+#define CORE_UBUNTU_MEDIA_PEER_CANCELLATION_H_
+
+#include "peer_departures.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Tells work done on behalf of a peer that nobody waits for its result
+// anymore. Copies share their state, a default constructed token never trips.
+class CancellationToken
+{
+public:
+    CancellationToken();
+
+    bool is_cancelled() const;
+
+private:
+    friend class PeerCancellation;
+    explicit CancellationToken(const std::shared_ptr<std::atomic<bool>>& cancelled);
+
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+// Hands out a CancellationToken per unique bus name, which trips once the peer
+// leaves the bus. Tokens are only kept track of while work holds on to them.
+class PeerCancellation
+{
+public:
+    typedef std::shared_ptr<PeerCancellation> Ptr;
+
+    // Cancels through on_peer_gone() only.
+    PeerCancellation();
+    // Also cancels for every peer departures tells about.
+    explicit PeerCancellation(const PeerDepartures::Ptr& departures);
+    ~PeerCancellation();
+
+    PeerCancellation(const PeerCancellation&) = delete;
+    PeerCancellation& operator=(const PeerCancellation&) = delete;
+
+    CancellationToken token_for(const std::string& name);
+
+    // Trips the token of the peer. Tokens are to be taken as soon as a request
+    // arrives, bus messages are handled in order so the peer can't have been
+    // seen leaving yet.
+    void on_peer_gone(const std::string& name);
+
+    // Number of peers that tokens are handed out for.
+    std::size_t size() const;
+
+private:
+    struct Private;
+    std::shared_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PEER_CANCELLATION_H_
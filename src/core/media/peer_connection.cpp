@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "peer_connection.h"
+
+#include "core/media/logger/logger.h"
+
+#include <dbus/dbus.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+const char* the_service_name{"core.ubuntu.media.Service"};
+const char* the_player_interface{"org.mpris.MediaPlayer2.Player"};
+
+struct ScopedError
+{
+    ScopedError()
+    {
+        dbus_error_init(&error);
+    }
+
+    ~ScopedError()
+    {
+        dbus_error_free(&error);
+    }
+
+    std::string print() const
+    {
+        return std::string{error.name ? error.name : ""} + ": " + (error.message ? error.message : "");
+    }
+
+    DBusError error;
+};
+}
+
+std::string media::PeerConnection::default_address()
+{
+    const char* runtime_dir = ::getenv("XDG_RUNTIME_DIR");
+    if (not runtime_dir or runtime_dir[0] == '\0')
+        return std::string{};
+
+    return std::string{"unix:path="} + runtime_dir + "/media-hub-peer";
+}
+
+std::string media::PeerConnection::path_for(media::Player::PlayerKey key)
+{
+    std::stringstream ss;
+    ss << "/core/ubuntu/media/Service/sessions/" << key;
+    return ss.str();
+}
+
+media::PeerConnection::Ptr media::PeerConnection::open(const std::string& address)
+{
+    if (address.empty())
+        return Ptr{};
+
+    dbus_threads_init_default();
+
+    ScopedError error;
+    DBusConnection* connection = dbus_connection_open_private(address.c_str(), &error.error);
+    if (not connection)
+    {
+        MH_DEBUG("No peer endpoint at %s: %s", address, error.print());
+        return Ptr{};
+    }
+
+    dbus_connection_set_exit_on_disconnect(connection, FALSE);
+    return Ptr{new PeerConnection{connection, std::string{}}};
+}
+
+media::PeerConnection::Ptr media::PeerConnection::open_session_bus()
+{
+    dbus_threads_init_default();
+
+    ScopedError error;
+    DBusConnection* connection = dbus_bus_get_private(DBUS_BUS_SESSION, &error.error);
+    if (not connection)
+    {
+        MH_WARNING("Failed to connect to the session bus: %s", error.print());
+        return Ptr{};
+    }
+
+    dbus_connection_set_exit_on_disconnect(connection, FALSE);
+    return Ptr{new PeerConnection{connection, the_service_name}};
+}
+
+media::PeerConnection::PeerConnection(DBusConnection* connection, const std::string& destination)
+    : connection(connection),
+      destination(destination)
+{
+}
+
+media::PeerConnection::~PeerConnection()
+{
+    dbus_connection_close(connection);
+    dbus_connection_unref(connection);
+}
+
+DBusMessage* media::PeerConnection::new_method_call(media::Player::PlayerKey key,
+                                                    const char* interface,
+                                                    const char* member)
+{
+    DBusMessage* message = dbus_message_new_method_call(
+                destination.empty() ? nullptr : destination.c_str(),
+                path_for(key).c_str(),
+                interface,
+                member);
+
+    if (not message)
+        throw std::bad_alloc{};
+
+    return message;
+}
+
+DBusMessage* media::PeerConnection::call(DBusMessage* message)
+{
+    ScopedError error;
+    DBusMessage* reply = dbus_connection_send_with_reply_and_block(
+                connection, message, DBUS_TIMEOUT_USE_DEFAULT, &error.error);
+    dbus_message_unref(message);
+
+    if (not reply)
+        throw std::runtime_error{error.print()};
+
+    return reply;
+}
+
+void media::PeerConnection::invoke(media::Player::PlayerKey key, const char* member)
+{
+    dbus_message_unref(call(new_method_call(key, the_player_interface, member)));
+}
+
+std::int64_t media::PeerConnection::int64_property(media::Player::PlayerKey key, const char* name)
+{
+    DBusMessage* message = new_method_call(key, DBUS_INTERFACE_PROPERTIES, "Get");
+    dbus_message_append_args(message,
+                             DBUS_TYPE_STRING, &the_player_interface,
+                             DBUS_TYPE_STRING, &name,
+                             DBUS_TYPE_INVALID);
+
+    DBusMessage* reply = call(message);
+
+    DBusMessageIter it, variant;
+    dbus_int64_t value = 0;
+    bool valid = false;
+    if (dbus_message_iter_init(reply, &it) and dbus_message_iter_get_arg_type(&it) == DBUS_TYPE_VARIANT)
+    {
+        dbus_message_iter_recurse(&it, &variant);
+        if (dbus_message_iter_get_arg_type(&variant) == DBUS_TYPE_INT64)
+        {
+            dbus_message_iter_get_basic(&variant, &value);
+            valid = true;
+        }
+    }
+
+    dbus_message_unref(reply);
+
+    if (not valid)
+        throw std::runtime_error{std::string{"Unexpected reply when reading "} + name};
+
+    return value;
+}
+
+void media::PeerConnection::play(media::Player::PlayerKey key)
+{
+    invoke(key, "Play");
+}
+
+void media::PeerConnection::pause(media::Player::PlayerKey key)
+{
+    invoke(key, "Pause");
+}
+
+void media::PeerConnection::stop(media::Player::PlayerKey key)
+{
+    invoke(key, "Stop");
+}
+
+void media::PeerConnection::next(media::Player::PlayerKey key)
+{
+    invoke(key, "Next");
+}
+
+void media::PeerConnection::previous(media::Player::PlayerKey key)
+{
+    invoke(key, "Previous");
+}
+
+void media::PeerConnection::seek_to(media::Player::PlayerKey key, const std::chrono::microseconds& offset)
+{
+    DBusMessage* message = new_method_call(key, the_player_interface, "Seek");
+    const dbus_uint64_t ticks = offset.count();
+    dbus_message_append_args(message, DBUS_TYPE_UINT64, &ticks, DBUS_TYPE_INVALID);
+    dbus_message_unref(call(message));
+}
+
+std::int64_t media::PeerConnection::position(media::Player::PlayerKey key)
+{
+    return int64_property(key, "Position");
+}
+
+std::int64_t media::PeerConnection::duration(media::Player::PlayerKey key)
+{
+    return int64_property(key, "Duration");
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CORE_UBUNTU_MEDIA_PEER_CONNECTION_H_
+#define CORE_UBUNTU_MEDIA_PEER_CONNECTION_H_
+
+#include <core/media/player.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct DBusConnection;
+struct DBusMessage;
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// A connection straight to the peer endpoint of media-hub-server, without
+// the bus daemon in between. Sessions are found under the same object paths
+// and interfaces as on the bus. Only the playback controls and the position
+// and duration are served there.
+class PeerConnection
+{
+public:
+    typedef std::shared_ptr<PeerConnection> Ptr;
+
+    // unix:path=$XDG_RUNTIME_DIR/media-hub-peer, empty without a runtime dir.
+    static std::string default_address();
+
+    // Object path of the session with the given key, the same as on the bus.
+    static std::string path_for(Player::PlayerKey key);
+
+    // Returns nullptr if nobody listens on address. Clients the endpoint
+    // doesn't trust are disconnected, their calls fail.
+    static Ptr open(const std::string& address = default_address());
+
+    // Goes through the session bus daemon, the way everybody else does. Lets
+    // callers compare round trips like for like.
+    static Ptr open_session_bus();
+
+    ~PeerConnection();
+
+    PeerConnection(const PeerConnection&) = delete;
+    PeerConnection& operator=(const PeerConnection&) = delete;
+
+    // All of these block until the service replied and throw
+    // std::runtime_error if the call failed.
+    void play(Player::PlayerKey key);
+    void pause(Player::PlayerKey key);
+    void stop(Player::PlayerKey key);
+    void next(Player::PlayerKey key);
+    void previous(Player::PlayerKey key);
+    void seek_to(Player::PlayerKey key, const std::chrono::microseconds& offset);
+
+    std::int64_t position(Player::PlayerKey key);
+    std::int64_t duration(Player::PlayerKey key);
+
+private:
+    PeerConnection(DBusConnection* connection, const std::string& destination);
+
+    DBusMessage* new_method_call(Player::PlayerKey key, const char* interface, const char* member);
+    // Takes over message, returns the reply that the caller has to unref
+    DBusMessage* call(DBusMessage* message);
+    void invoke(Player::PlayerKey key, const char* member);
+    std::int64_t int64_property(Player::PlayerKey key, const char* name);
+
+    DBusConnection* connection;
+    // Empty on peer connections, where there is nobody to route to
+    std::string destination;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PEER_CONNECTION_H_
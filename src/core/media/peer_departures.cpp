@@ -0,0 +1,77 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "peer_departures.h"
+
+#include "apparmor/dbus.h"
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Unique names are never handed out twice, once one loses its owner the peer is gone
+bool is_departure(const std::string& name, const std::string& new_owner)
+{
+    return not name.empty() and name[0] == ':' and new_owner.empty();
+}
+}
+
+struct media::PeerDepartures::Private
+{
+    core::Signal<std::string> peer_gone;
+    std::unique_ptr<org::freedesktop::dbus::DBus::Stub> dbus_daemon;
+};
+
+media::PeerDepartures::PeerDepartures()
+    : d(std::make_shared<Private>())
+{
+}
+
+media::PeerDepartures::PeerDepartures(const core::dbus::Bus::Ptr& bus)
+    : d(std::make_shared<Private>())
+{
+    d->dbus_daemon.reset(new org::freedesktop::dbus::DBus::Stub{bus});
+
+    const std::weak_ptr<Private> weak_d{d};
+    d->dbus_daemon->on_name_owner_changed([weak_d](const std::string& name,
+                                                   const std::string&,
+                                                   const std::string& new_owner)
+    {
+        if (not is_departure(name, new_owner))
+            return;
+
+        if (const auto sp = weak_d.lock())
+            sp->peer_gone(name);
+    });
+}
+
+media::PeerDepartures::~PeerDepartures()
+{
+}
+
+void media::PeerDepartures::on_name_owner_changed(const std::string& name,
+                                                  const std::string&,
+                                                  const std::string& new_owner)
+{
+    if (is_departure(name, new_owner))
+        d->peer_gone(name);
+}
+
+const core::Signal<std::string>& media::PeerDepartures::peer_gone() const
+{
+    return d->peer_gone;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_PEER_DEPARTURES_H_
+#define CORE_UBUNTU_MEDIA_PEER_DEPARTURES_H_
+
+#include <core/dbus/bus.h>
+#include <core/signal.h>
+
+#include <memory>
+#include <string>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Tells about peers leaving the bus. Everything that keeps state per peer,
+// like the apparmor context cache, pending work and the sessions of clients,
+// listens to one instance, so that the bus delivers NameOwnerChanged once.
+class PeerDepartures
+{
+public:
+    typedef std::shared_ptr<PeerDepartures> Ptr;
+
+    // Only tells about what on_name_owner_changed() is handed.
+    PeerDepartures();
+    // Also watches NameOwnerChanged on the given bus.
+    explicit PeerDepartures(const core::dbus::Bus::Ptr& bus);
+    ~PeerDepartures();
+
+    PeerDepartures(const PeerDepartures&) = delete;
+    PeerDepartures& operator=(const PeerDepartures&) = delete;
+
+    // Takes a change of the owner of a name, as NameOwnerChanged reports it.
+    // Only unique names losing their owner mean that a peer left the bus.
+    void on_name_owner_changed(const std::string& name,
+                               const std::string& old_owner,
+                               const std::string& new_owner);
+
+    // Emitted with the unique name of every peer that left the bus.
+    const core::Signal<std::string>& peer_gone() const;
+
+private:
+    struct Private;
+    std::shared_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PEER_DEPARTURES_H_
@@ -0,0 +1,533 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "peer_endpoint.h"
+
+#include "apparmor/ubuntu.h"
+#include "peer_connection.h"
+#include "player_skeleton.h"
+
+#include "core/media/logger/logger.h"
+
+#include <dbus/dbus.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+const char* the_sessions_path{"/core/ubuntu/media/Service/sessions"};
+const char* the_player_interface{"org.mpris.MediaPlayer2.Player"};
+
+// How long the worker threads block before checking whether to stop
+const int poll_timeout_ms{200};
+
+// Each peer gets a thread of its own, connections beyond that are refused
+const std::size_t max_peers{16};
+
+enum class SocketFile
+{
+    none,
+    // Left behind by an instance that didn't get to clean up
+    stale,
+    // Somebody listens on it
+    live
+};
+
+// Anything at path that isn't a socket is none of our business
+SocketFile socket_file_at(const std::string& path)
+{
+    struct stat st;
+    if (::lstat(path.c_str(), &st) < 0 or not S_ISSOCK(st.st_mode))
+        return SocketFile::none;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return SocketFile::none;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return SocketFile::none;
+
+    SocketFile result{SocketFile::live};
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+        result = errno == ECONNREFUSED ? SocketFile::stale : SocketFile::none;
+    ::close(fd);
+
+    return result;
+}
+
+// Runs f the way the bus calls of the session run, waiting for it to finish
+void run_in_session(const std::shared_ptr<media::Player>& player, const std::function<void()>& f)
+{
+    const auto skeleton = std::dynamic_pointer_cast<media::PlayerSkeleton>(player);
+    const auto queue = skeleton ? skeleton->dispatch_queue() : media::SerialQueue::Ptr{};
+    if (not queue)
+    {
+        f();
+        return;
+    }
+
+    auto done = std::make_shared<std::promise<void>>();
+    queue->post([done, f]()
+    {
+        try {
+            f();
+            done->set_value();
+        } catch (...) {
+            done->set_exception(std::current_exception());
+        }
+    }, media::WorkerPool::Priority::high);
+
+    done->get_future().get();
+}
+
+void play_pause(media::Player& player)
+{
+    switch(player.playback_status().get())
+    {
+    case media::Player::PlaybackStatus::ready:
+    case media::Player::PlaybackStatus::paused:
+    case media::Player::PlaybackStatus::stopped:
+        player.play();
+        break;
+    case media::Player::PlaybackStatus::playing:
+        player.pause();
+        break;
+    default:
+        break;
+    }
+}
+
+DBusMessage* int64_variant_reply(DBusMessage* call, std::int64_t value)
+{
+    DBusMessage* reply = dbus_message_new_method_return(call);
+    if (not reply)
+        return nullptr;
+
+    DBusMessageIter it, variant;
+    const dbus_int64_t v = value;
+    dbus_message_iter_init_append(reply, &it);
+    dbus_message_iter_open_container(&it, DBUS_TYPE_VARIANT, DBUS_TYPE_INT64_AS_STRING, &variant);
+    dbus_message_iter_append_basic(&variant, DBUS_TYPE_INT64, &v);
+    dbus_message_iter_close_container(&it, &variant);
+
+    return reply;
+}
+}
+
+media::PeerEndpoint::Configuration media::PeerEndpoint::Configuration::from_environment()
+{
+    Configuration configuration;
+
+    const char* enabled = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_PEER_ENDPOINT");
+    if (enabled and std::string{enabled} == "1")
+        configuration.address = PeerConnection::default_address();
+
+    return configuration;
+}
+
+media::PeerEndpoint::Credentials media::PeerEndpoint::Credentials::of_socket(int fd)
+{
+    Credentials credentials{0, static_cast<uid_t>(-1), std::string{}};
+
+    struct ucred cred;
+    socklen_t size = sizeof(cred);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0)
+    {
+        credentials.pid = cred.pid;
+        credentials.uid = cred.uid;
+    }
+
+    char label[4096];
+    size = sizeof(label);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERSEC, label, &size) == 0)
+    {
+        credentials.label.assign(label, ::strnlen(label, size));
+        // Labels come as "profile (mode)", apart from "unconfined"
+        const auto mode = credentials.label.rfind(" (");
+        if (mode != std::string::npos)
+            credentials.label.erase(mode);
+    }
+    // Otherwise the label stays empty. Without a label there is no
+    // telling a confined app from the shell, so is_trusted turns it down.
+
+    return credentials;
+}
+
+bool media::PeerEndpoint::is_trusted(const Credentials& credentials)
+{
+    if (credentials.uid != ::getuid())
+        return false;
+
+    if (credentials.label.empty())
+        return false;
+
+    try {
+        const media::apparmor::ubuntu::Context context{credentials.label};
+        return context.is_unconfined() or context.is_unity();
+    } catch (const std::exception&) {
+        // Not a profile we know how to tell apart
+        return false;
+    }
+}
+
+struct media::PeerEndpoint::Private
+{
+    struct Peer
+    {
+        std::thread worker;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    Private(const Configuration& configuration, const KeyedPlayerStore::Ptr& players)
+        : players{players},
+          running{true}
+    {
+        dbus_threads_init_default();
+
+        // A socket left behind by a previous instance keeps us from listening.
+        // libdbus would replace one somebody still listens on as well.
+        static const std::string unix_path{"unix:path="};
+        if (configuration.address.compare(0, unix_path.size(), unix_path) == 0)
+        {
+            const auto path = configuration.address.substr(unix_path.size());
+            switch (socket_file_at(path))
+            {
+            case SocketFile::stale:
+                ::unlink(path.c_str());
+                break;
+            case SocketFile::live:
+                throw std::runtime_error{"Failed to listen on " + configuration.address + ": already in use"};
+            case SocketFile::none:
+                break;
+            }
+        }
+
+        DBusError error;
+        dbus_error_init(&error);
+        server = dbus_server_listen(configuration.address.c_str(), &error);
+        if (not server)
+        {
+            const std::string what{std::string{"Failed to listen on "} + configuration.address + ": "
+                                   + (error.message ? error.message : "")};
+            dbus_error_free(&error);
+            throw std::runtime_error{what};
+        }
+
+        dbus_server_set_new_connection_function(server, &Private::on_new_connection, this, nullptr);
+        dbus_server_set_watch_functions(server, &Private::add_watch, &Private::remove_watch,
+                                        &Private::toggle_watch, this, nullptr);
+
+        listener = std::thread{[this]() { listen(); }};
+    }
+
+    ~Private()
+    {
+        running = false;
+        listener.join();
+
+        for (auto& peer : peers)
+            peer.worker.join();
+
+        dbus_server_disconnect(server);
+        dbus_server_unref(server);
+    }
+
+    static dbus_bool_t add_watch(DBusWatch* watch, void* data)
+    {
+        auto self = static_cast<Private*>(data);
+        std::lock_guard<std::mutex> lg(self->guard);
+        self->watches.push_back(watch);
+        return TRUE;
+    }
+
+    static void remove_watch(DBusWatch* watch, void* data)
+    {
+        auto self = static_cast<Private*>(data);
+        std::lock_guard<std::mutex> lg(self->guard);
+        self->watches.remove(watch);
+    }
+
+    static void toggle_watch(DBusWatch*, void*)
+    {
+        // Whether a watch is enabled is checked before every poll
+    }
+
+    bool is_watched(DBusWatch* watch)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        for (auto w : watches)
+            if (w == watch)
+                return true;
+        return false;
+    }
+
+    // Accepts connections on the server socket, until told to stop
+    void listen()
+    {
+        while (running)
+        {
+            std::vector<pollfd> fds;
+            std::vector<DBusWatch*> polled;
+            {
+                std::lock_guard<std::mutex> lg(guard);
+                for (auto watch : watches)
+                {
+                    if (not dbus_watch_get_enabled(watch))
+                        continue;
+
+                    const unsigned int flags = dbus_watch_get_flags(watch);
+                    pollfd fd;
+                    fd.fd = dbus_watch_get_unix_fd(watch);
+                    fd.events = (flags & DBUS_WATCH_READABLE ? POLLIN : 0) | (flags & DBUS_WATCH_WRITABLE ? POLLOUT : 0);
+                    fd.revents = 0;
+                    fds.push_back(fd);
+                    polled.push_back(watch);
+                }
+            }
+
+            if (::poll(fds.data(), fds.size(), poll_timeout_ms) <= 0)
+                continue;
+
+            for (std::size_t i = 0; i < fds.size(); i++)
+            {
+                if (fds[i].revents == 0 or not is_watched(polled[i]))
+                    continue;
+
+                unsigned int flags = 0;
+                if (fds[i].revents & POLLIN) flags |= DBUS_WATCH_READABLE;
+                if (fds[i].revents & POLLOUT) flags |= DBUS_WATCH_WRITABLE;
+                if (fds[i].revents & POLLHUP) flags |= DBUS_WATCH_HANGUP;
+                if (fds[i].revents & POLLERR) flags |= DBUS_WATCH_ERROR;
+                dbus_watch_handle(polled[i], flags);
+            }
+        }
+    }
+
+    // Called on the listener thread
+    static void on_new_connection(DBusServer*, DBusConnection* connection, void* data)
+    {
+        auto self = static_cast<Private*>(data);
+
+        int fd = -1;
+        if (not dbus_connection_get_socket(connection, &fd))
+        {
+            dbus_connection_close(connection);
+            return;
+        }
+
+        const auto credentials = Credentials::of_socket(fd);
+        if (not is_trusted(credentials))
+        {
+            MH_WARNING("Refusing peer connection of pid %d (uid %d, %s)",
+                       credentials.pid, credentials.uid, credentials.label);
+            dbus_connection_close(connection);
+            return;
+        }
+
+        self->reap_peers();
+        if (self->peers.size() >= max_peers)
+        {
+            MH_WARNING("Refusing peer connection of pid %d, already serving %d peers",
+                       credentials.pid, self->peers.size());
+            dbus_connection_close(connection);
+            return;
+        }
+
+        MH_INFO("Accepted peer connection of pid %d (%s)", credentials.pid, credentials.label);
+
+        DBusObjectPathVTable vtable;
+        std::memset(&vtable, 0, sizeof(vtable));
+        vtable.message_function = &Private::on_message;
+        if (not dbus_connection_register_fallback(connection, the_sessions_path, &vtable, self))
+        {
+            dbus_connection_close(connection);
+            return;
+        }
+
+        dbus_connection_ref(connection);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        self->peers.push_back(Peer{std::thread{[self, connection, done]()
+        {
+            // Calls of a peer are answered one after the other, in order
+            while (self->running and dbus_connection_read_write_dispatch(connection, poll_timeout_ms))
+                ;
+
+            dbus_connection_close(connection);
+            dbus_connection_unref(connection);
+            *done = true;
+        }}, done});
+    }
+
+    // Called on the listener thread, joins the workers of peers that left
+    void reap_peers()
+    {
+        for (auto it = peers.begin(); it != peers.end();)
+        {
+            if (not *it->done)
+            {
+                ++it;
+                continue;
+            }
+
+            it->worker.join();
+            it = peers.erase(it);
+        }
+    }
+
+    static DBusHandlerResult on_message(DBusConnection* connection, DBusMessage* message, void* data)
+    {
+        if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+        DBusMessage* reply = static_cast<Private*>(data)->reply_to(message);
+        if (not reply)
+            return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+        dbus_connection_send(connection, reply, nullptr);
+        dbus_message_unref(reply);
+
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    std::shared_ptr<media::Player> player_for(const char* path)
+    {
+        const std::string p{path ? path : ""};
+        const auto slash = p.rfind('/');
+        if (slash == std::string::npos or p.compare(0, slash, the_sessions_path) != 0)
+            return std::shared_ptr<media::Player>{};
+
+        try {
+            const auto key = static_cast<media::Player::PlayerKey>(std::stoul(p.substr(slash + 1)));
+            return players->player_for_key(key);
+        } catch (const std::exception&) {
+            return std::shared_ptr<media::Player>{};
+        }
+    }
+
+    DBusMessage* reply_to(DBusMessage* call)
+    {
+        const auto player = player_for(dbus_message_get_path(call));
+        if (not player)
+            return dbus_message_new_error(call, DBUS_ERROR_UNKNOWN_OBJECT, "No such session");
+
+        try {
+            if (dbus_message_is_method_call(call, DBUS_INTERFACE_PROPERTIES, "Get"))
+                return property(call, *player);
+
+            std::function<void()> f;
+            if (dbus_message_is_method_call(call, the_player_interface, "Play"))
+                f = [player]() { player->play(); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "Pause"))
+                f = [player]() { player->pause(); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "PlayPause"))
+                f = [player]() { play_pause(*player); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "Stop"))
+                f = [player]() { player->stop(); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "Next"))
+                f = [player]() { player->next(); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "Previous"))
+                f = [player]() { player->previous(); };
+            else if (dbus_message_is_method_call(call, the_player_interface, "Seek"))
+            {
+                dbus_uint64_t ticks = 0;
+                if (not dbus_message_get_args(call, nullptr, DBUS_TYPE_UINT64, &ticks, DBUS_TYPE_INVALID))
+                    return dbus_message_new_error(call, DBUS_ERROR_INVALID_ARGS, "Expected an offset in microseconds");
+
+                f = [player, ticks]() { player->seek_to(std::chrono::microseconds(ticks)); };
+            }
+            else
+                return dbus_message_new_error(call, DBUS_ERROR_UNKNOWN_METHOD, "Not served to peers");
+
+            run_in_session(player, f);
+            return dbus_message_new_method_return(call);
+        } catch (const std::exception& e) {
+            return dbus_message_new_error(call, DBUS_ERROR_FAILED, e.what());
+        }
+    }
+
+    DBusMessage* property(DBusMessage* call, media::Player& player)
+    {
+        const char* interface = nullptr;
+        const char* name = nullptr;
+        if (not dbus_message_get_args(call, nullptr,
+                                      DBUS_TYPE_STRING, &interface,
+                                      DBUS_TYPE_STRING, &name,
+                                      DBUS_TYPE_INVALID))
+            return dbus_message_new_error(call, DBUS_ERROR_INVALID_ARGS, "Expected interface and property name");
+
+        if (std::strcmp(interface, the_player_interface) == 0)
+        {
+            if (std::strcmp(name, "Position") == 0)
+                return int64_variant_reply(call, player.position().get());
+            if (std::strcmp(name, "Duration") == 0)
+                return int64_variant_reply(call, player.duration().get());
+        }
+
+        return dbus_message_new_error(call, DBUS_ERROR_UNKNOWN_PROPERTY, "Not served to peers");
+    }
+
+    KeyedPlayerStore::Ptr players;
+    DBusServer* server;
+    std::atomic<bool> running;
+
+    std::mutex guard;
+    std::list<DBusWatch*> watches;
+
+    // Only touched on the listener thread, and once it is gone
+    std::list<Peer> peers;
+    std::thread listener;
+};
+
+media::PeerEndpoint::PeerEndpoint(const Configuration& configuration, const KeyedPlayerStore::Ptr& players)
+    : d{new Private{configuration, players}}
+{
+}
+
+media::PeerEndpoint::~PeerEndpoint()
+{
+}
+
+std::string media::PeerEndpoint::address() const
+{
+    char* address = dbus_server_get_address(d->server);
+    const std::string result{address ? address : ""};
+    dbus_free(address);
+    return result;
+}
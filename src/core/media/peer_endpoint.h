@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CORE_UBUNTU_MEDIA_PEER_ENDPOINT_H_
+#define CORE_UBUNTU_MEDIA_PEER_ENDPOINT_H_
+
+#include "keyed_player_store.h"
+
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Lets trusted local clients talk to the sessions over a private D-Bus
+// server socket, skipping the hop through the bus daemon. Sessions are
+// served under the same object paths and interfaces as on the bus, see
+// PeerConnection for what is served.
+class PeerEndpoint
+{
+public:
+    typedef std::shared_ptr<PeerEndpoint> Ptr;
+
+    struct Configuration
+    {
+        // Where to listen, nothing is served if empty.
+        std::string address;
+
+        // Listens on PeerConnection::default_address() if
+        // CORE_UBUNTU_MEDIA_SERVICE_PEER_ENDPOINT is set to 1.
+        static Configuration from_environment();
+    };
+
+    // What the kernel tells about the process on the other end of a socket
+    struct Credentials
+    {
+        pid_t pid;
+        uid_t uid;
+        // The AppArmor label, without the mode. Empty if the kernel
+        // couldn't tell.
+        std::string label;
+
+        static Credentials of_socket(int fd);
+    };
+
+    // Clients of the same user that are either unconfined or the shell.
+    // Clients without a label are not trusted.
+    static bool is_trusted(const Credentials& credentials);
+
+    // Throws std::runtime_error if the address can't be listened on.
+    PeerEndpoint(const Configuration& configuration, const KeyedPlayerStore::Ptr& players);
+    ~PeerEndpoint();
+
+    PeerEndpoint(const PeerEndpoint&) = delete;
+    PeerEndpoint& operator=(const PeerEndpoint&) = delete;
+
+    // The address clients connect to, as the D-Bus server reports it.
+    std::string address() const;
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PEER_ENDPOINT_H_
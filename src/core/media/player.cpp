@@ -18,6 +18,7 @@
 
 #include <core/media/player.h>
 
+#include "async_call.h"
 #include "player_configuration.h"
 
 namespace media = core::ubuntu::media;
@@ -58,3 +59,45 @@ media::Player::~Player()
 {
 }
 
+
+// Implementations that talk to the service override these, everybody else
+// has nothing to wait for and runs the blocking call right away.
+std::future<bool> media::Player::open_uri_async(const Track::UriType& uri)
+{
+    return media::complete_now<bool>([this, &uri]() { return open_uri(uri); });
+}
+
+std::future<bool> media::Player::open_uri_async(const Track::UriType& uri, const HeadersType& headers)
+{
+    return media::complete_now<bool>([this, &uri, &headers]() { return open_uri(uri, headers); });
+}
+
+std::future<void> media::Player::next_async()
+{
+    return media::complete_now_void([this]() { next(); });
+}
+
+std::future<void> media::Player::previous_async()
+{
+    return media::complete_now_void([this]() { previous(); });
+}
+
+std::future<void> media::Player::play_async()
+{
+    return media::complete_now_void([this]() { play(); });
+}
+
+std::future<void> media::Player::pause_async()
+{
+    return media::complete_now_void([this]() { pause(); });
+}
+
+std::future<void> media::Player::stop_async()
+{
+    return media::complete_now_void([this]() { stop(); });
+}
+
+std::future<void> media::Player::seek_to_async(const std::chrono::microseconds& offset)
+{
+    return media::complete_now_void([this, &offset]() { seek_to(offset); });
+}
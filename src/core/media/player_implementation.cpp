@@ -63,20 +63,24 @@ struct media::PlayerImplementation<Parent>::Private :
           config(config),
           display_state_lock(config.power_state_controller->display_state_lock()),
           system_state_lock(config.power_state_controller->system_state_lock()),
-          engine(std::make_shared<gstreamer::Engine>(config.key)),
+          engine(std::make_shared<gstreamer::Engine>(config.key, config.meta_data_extractor)),
           track_list(std::make_shared<TrackListImplementation>(
               config.parent.bus,
               config.parent.service->add_object_for_path(
                   dbus::types::ObjectPath(config.parent.session->path().as_string() + "/TrackList")),
               engine->meta_data_extractor(),
               config.parent.request_context_resolver,
-              config.parent.request_authenticator)),
+              config.parent.request_authenticator,
+              config.parent.dispatch_queue,
+              config.parent.quotas,
+              config.parent.cancellation)),
           system_wakelock_count(0),
           display_wakelock_count(0),
           previous_state(Engine::State::stopped),
           engine_state_change_connection(engine->state().changed().connect(make_state_change_handler())),
           engine_playback_status_change_connection(engine->playback_status_changed_signal().connect(make_playback_status_change_handler())),
-          doing_abandon(false)
+          doing_abandon(false),
+          resume_position(0)
     {
         // Poor man's logging of release/acquire events.
         display_state_lock->acquired().connect([](media::power::DisplayState state)
@@ -322,7 +326,7 @@ struct media::PlayerImplementation<Parent>::Private :
                             or parent->Parent::loop_status() != Player::LoopStatus::none;
         const bool has_next = track_list->has_next()
                         or parent->Parent::loop_status() != Player::LoopStatus::none;
-        const auto n_tracks = track_list->tracks()->size();
+        const auto n_tracks = track_list->snapshot()->tracks.size();
         const bool has_tracks = (n_tracks > 0) ? true : false;
 
         MH_INFO("Updating MPRIS TrackList properties:");
@@ -469,6 +473,9 @@ struct media::PlayerImplementation<Parent>::Private :
     // Prevent the TrackList from auto advancing to the next track
     std::mutex doing_go_to_track;
     std::atomic<bool> doing_abandon;
+    // Position in microseconds to seek to once playback of a track that was
+    // loaded without playing it gets started, 0 if there is none
+    std::atomic<std::int64_t> resume_position;
 };
 
 template<typename Parent>
@@ -594,11 +601,15 @@ media::PlayerImplementation<Parent>::PlayerImplementation(const media::PlayerImp
 
         Parent::about_to_finish()();
 
-        const media::Track::Id prev_track_id = d->track_list->current();
-        // Make sure that the TrackList keeps advancing. The logic for what gets played next,
-        // if anything at all, occurs in TrackListSkeleton::next()
-        const Track::UriType uri = d->track_list->query_uri_for_track(d->track_list->next());
-        if (prev_track_id != d->track_list->current() && !uri.empty())
+        // This runs on a streaming thread, which must not wait for an edit of the
+        // TrackList to finish. The next track is taken from the latest snapshot and
+        // the TrackList catches up on the dispatch queue of the session.
+        const auto snapshot = d->track_list->snapshot();
+        const media::Track::Id prev_track_id = snapshot->current < snapshot->tracks.size()
+                ? snapshot->tracks[snapshot->current] : media::Track::Id{};
+        const media::Track::Id next_track_id = d->track_list->advance_from(snapshot);
+        const Track::UriType uri = d->track_list->query_uri_for_track(next_track_id);
+        if (prev_track_id != next_track_id && !uri.empty())
         {
             MH_INFO("Advancing to next track on playbin: %s", uri);
             static const bool do_pipeline_reset = false;
@@ -673,6 +684,9 @@ media::PlayerImplementation<Parent>::PlayerImplementation(const media::PlayerImp
         if (!locked)
             return;
 
+        // A different track was picked, so a pending resume position no longer applies
+        d->resume_position = 0;
+
         // Store whether we should restore the current playing state after loading the new uri
         const bool auto_play = Parent::playback_status().get() == media::Player::playing;
 
@@ -694,10 +708,47 @@ media::PlayerImplementation<Parent>::PlayerImplementation(const media::PlayerImp
         d->doing_go_to_track.unlock();
     });
 
+    d->track_list->on_go_to_track_at().connect([this](const media::TrackListSkeleton::TrackIdPositionTuple& t)
+    {
+        // Mutually exclusive with the about_to_finish lambda, like on_go_to_track
+        const bool locked = d->doing_go_to_track.try_lock();
+        if (!locked)
+            return;
+
+        const bool auto_play = Parent::playback_status().get() == media::Player::playing;
+
+        const media::Track::Id id = std::get<0>(t);
+        const std::chrono::microseconds position = std::get<1>(t);
+        const Track::UriType uri = d->track_list->query_uri_for_track(id);
+        if (!uri.empty())
+        {
+            MH_INFO("Setting track on playbin (on_go_to_track_at signal): %s", uri);
+            MH_INFO("\twith a Track::Id: %s", id);
+            static const bool do_pipeline_reset = true;
+            d->engine->open_resource_for_uri(uri, do_pipeline_reset);
+        }
+
+        if (auto_play)
+        {
+            MH_DEBUG("Restoring playing state");
+            d->engine->play();
+            // Seeking needs a prerolled pipeline, so it is only done when playing
+            if (position.count() > 0)
+                d->engine->seek_to(position);
+        }
+        else
+        {
+            // Otherwise play() takes care of it
+            d->resume_position = position.count();
+        }
+
+        d->doing_go_to_track.unlock();
+    });
+
     d->track_list->on_track_added().connect([this](const media::Track::Id& id)
     {
         MH_TRACE("** Track was added, handling in PlayerImplementation");
-        if (d->track_list->tracks()->size() == 1)
+        if (d->track_list->snapshot()->tracks.size() == 1)
             d->open_first_track_from_tracklist(id);
 
         d->update_mpris_properties();
@@ -709,7 +760,7 @@ media::PlayerImplementation<Parent>::PlayerImplementation(const media::PlayerImp
         // If the two sizes are the same, that means the TrackList was previously empty and we need
         // to open the first track in the TrackList so that is_audio_source() and is_video_source()
         // will function correctly.
-        if (tracks.size() >= 1 and d->track_list->tracks()->size() == tracks.size())
+        if (tracks.size() >= 1 and d->track_list->snapshot()->tracks.size() == tracks.size())
             d->open_first_track_from_tracklist(tracks.front());
 
         d->update_mpris_properties();
@@ -890,6 +941,10 @@ void media::PlayerImplementation<Parent>::play()
     }
 
     d->engine->play();
+
+    const std::chrono::microseconds position{d->resume_position.exchange(0)};
+    if (position.count() > 0)
+        d->engine->seek_to(position);
 }
 
 template<typename Parent>
@@ -909,9 +964,17 @@ void media::PlayerImplementation<Parent>::stop()
 template<typename Parent>
 void media::PlayerImplementation<Parent>::seek_to(const std::chrono::microseconds& ms)
 {
+    d->resume_position = 0;
     d->engine->seek_to(ms);
 }
 
+template<typename Parent>
+bool media::PlayerImplementation<Parent>::release_pipeline()
+{
+    MH_TRACE("");
+    return d->engine->release_pipeline();
+}
+
 template<typename Parent>
 const core::Signal<>& media::PlayerImplementation<Parent>::on_client_disconnected() const
 {
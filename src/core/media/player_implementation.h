@@ -23,6 +23,7 @@
 
 #include "apparmor/ubuntu.h"
 #include "client_death_observer.h"
+#include "engine.h"
 #include "power/state_controller.h"
 
 #include <memory>
@@ -50,6 +51,8 @@ public:
         // Functional dependencies
         ClientDeathObserver::Ptr client_death_observer;
         power::StateController::Ptr power_state_controller;
+        // Shared by all sessions of the service
+        std::shared_ptr<Engine::MetaDataExtractor> meta_data_extractor;
     };
 
     PlayerImplementation(const Configuration& configuration);
@@ -73,6 +76,9 @@ public:
     virtual void stop();
     virtual void seek_to(const std::chrono::microseconds& offset);
 
+    // Gives up the resources of the pipeline while the session is idle, see Engine::release_pipeline.
+    bool release_pipeline();
+
     const core::Signal<>& on_client_disconnected() const;
 
 protected:
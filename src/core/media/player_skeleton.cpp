@@ -23,6 +23,7 @@
 #include "player_skeleton.h"
 #include "player_traits.h"
 #include "property_stub.h"
+#include "status_page.h"
 #include "the_session_bus.h"
 #include "xesam.h"
 
@@ -41,6 +42,11 @@
 
 #include <core/dbus/asio/executor.h>
 #include <core/dbus/interfaces/properties.h>
+#include <core/dbus/types/unix_fd.h>
+
+#include <future>
+#include <list>
+#include <mutex>
 
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
@@ -51,13 +57,17 @@ struct media::PlayerSkeleton::Private
             const std::shared_ptr<core::dbus::Bus>& bus,
             const std::shared_ptr<core::dbus::Object>& session,
             const apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-            const apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator)
+            const apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+            const media::SerialQueue::Ptr& dispatch_queue,
+            const media::PeerCancellation::Ptr& cancellation)
         : impl(player),
           bus(bus),
           object(session),
           request_context_resolver{request_context_resolver},
           request_authenticator{request_authenticator},
-          uri_check(std::make_shared<UriCheck>()),
+          dispatch_queue{dispatch_queue},
+          cancellation{cancellation},
+          status_page(media::StatusPageWriter::create("media-hub-status-page")),
           skeleton{mpris::Player::Skeleton::Configuration{bus, session, mpris::Player::Skeleton::Configuration::Defaults{}}},
           signals
           {
@@ -72,6 +82,59 @@ struct media::PlayerSkeleton::Private
     {
     }
 
+    typedef std::function<void(const core::dbus::Message::Ptr&)> Handler;
+    // Gets the token taken on arrival of the call, for whatever it carries on with
+    typedef std::function<void(const core::dbus::Message::Ptr&, const media::CancellationToken&)> CancellableHandler;
+
+    // Moves the handler off the bus thread onto the dispatch queue of the session
+    Handler dispatched(const Handler& handler,
+                       media::WorkerPool::Priority priority = media::WorkerPool::Priority::normal)
+    {
+        return dispatched_with_token([handler](const core::dbus::Message::Ptr& msg, const media::CancellationToken&)
+        {
+            handler(msg);
+        }, priority);
+    }
+
+    Handler dispatched_with_token(const CancellableHandler& handler,
+                                  media::WorkerPool::Priority priority = media::WorkerPool::Priority::normal)
+    {
+        const auto cancellation = this->cancellation;
+        if (not dispatch_queue)
+            return [cancellation, handler](const core::dbus::Message::Ptr& msg)
+            {
+                handler(msg, cancellation ? cancellation->token_for(msg->sender()) : media::CancellationToken{});
+            };
+
+        const auto queue = dispatch_queue;
+        const auto player = impl;
+        return [queue, player, cancellation, handler, priority](const core::dbus::Message::Ptr& msg)
+        {
+            std::weak_ptr<media::Player> weak_player;
+            try {
+                weak_player = player->shared_from_this();
+            } catch (const std::bad_weak_ptr&) {
+                // Being torn down
+                return;
+            }
+
+            // Taken on arrival, so that the caller leaving later on is noticed
+            const auto token = cancellation ? cancellation->token_for(msg->sender()) : media::CancellationToken{};
+            queue->post([weak_player, handler, msg, token]()
+            {
+                if (token.is_cancelled())
+                {
+                    MH_DEBUG("Dropping call of %s, it left the bus", msg->sender());
+                    return;
+                }
+
+                // The session might be gone by the time its turn comes
+                if (const auto sp = weak_player.lock())
+                    handler(msg, token);
+            }, priority);
+        };
+    }
+
     void handle_next(const core::dbus::Message::Ptr& msg)
     {
         impl->next();
@@ -170,6 +233,21 @@ struct media::PlayerSkeleton::Private
         bus->send(reply);
     }
 
+    // Answered right away, the dictionary is cached until a property changes
+    void handle_get_all(const core::dbus::Message::Ptr& msg)
+    {
+        std::string interface;
+        msg->reader() >> interface;
+
+        auto reply = dbus::Message::make_method_return(msg);
+        if (interface == mpris::Player::name())
+            reply->writer() << skeleton.get_all_properties();
+        else
+            reply->writer() << mpris::Player::Dictionary{};
+
+        bus->send(reply);
+    }
+
     void handle_key(const core::dbus::Message::Ptr& in)
     {
         auto reply = dbus::Message::make_method_return(in);
@@ -177,17 +255,172 @@ struct media::PlayerSkeleton::Private
         bus->send(reply);
     }
 
-    void handle_open_uri(const core::dbus::Message::Ptr& in)
+    // Only the app owning the session and unconfined ones get to look at its
+    // status page. Sessions without an owner are shared, unconfined ones only.
+    bool may_read_status_page(const media::apparmor::ubuntu::Context& context)
     {
+        if (context.is_unconfined())
+            return true;
+
+        std::lock_guard<std::mutex> lg{owner_guard};
+        return not owner_context.empty() and context.str() == owner_context;
+    }
+
+    void handle_get_status_page(const core::dbus::Message::Ptr& in)
+    {
+        if (not status_page)
+        {
+            bus->send(dbus::Message::make_error(
+                        in,
+                        mpris::Player::Error::StatusPageNotAvailable::name,
+                        "Status pages are not supported on this system"));
+            return;
+        }
+
         request_context_resolver->resolve_context_for_dbus_name_async(in->sender(), [this, in](const media::apparmor::ubuntu::Context& context)
         {
+            if (not may_read_status_page(context))
+            {
+                const std::string err_str = {"Warning: " + context.str() +
+                    " does not own the session, refusing to hand out its status page"};
+                MH_WARNING("%s", err_str);
+                bus->send(dbus::Message::make_error(
+                            in,
+                            mpris::Player::Error::InsufficientAppArmorPermissions::name,
+                            err_str));
+                return;
+            }
+
+            auto reply = dbus::Message::make_method_return(in);
+            reply->writer() << core::dbus::types::UnixFd{status_page->fd()};
+            bus->send(reply);
+        });
+    }
+
+    // Keeps the status page up to date. The position is only sampled when it
+    // jumps or stops moving along with the clock, readers extrapolate from there.
+    void publish_status_changes()
+    {
+        status_connections.emplace_back(skeleton.properties.typed_playback_status->changed().connect(
+            [this](media::Player::PlaybackStatus status)
+            {
+                const auto position = impl->position().get();
+                const auto anchor = media::StatusPage::now();
+                const auto duration = impl->duration().get();
+                status_page->update([status, position, anchor, duration](media::StatusPage::Snapshot& snapshot)
+                {
+                    snapshot.playback_status = status;
+                    snapshot.position = position;
+                    snapshot.anchor = anchor;
+                    snapshot.duration = duration;
+                });
+            }));
+
+        status_connections.emplace_back(skeleton.properties.playback_rate->changed().connect(
+            [this](media::Player::PlaybackRate rate)
+            {
+                const auto position = impl->position().get();
+                const auto anchor = media::StatusPage::now();
+                status_page->update([rate, position, anchor](media::StatusPage::Snapshot& snapshot)
+                {
+                    snapshot.rate = rate;
+                    snapshot.position = position;
+                    snapshot.anchor = anchor;
+                });
+            }));
+
+        status_connections.emplace_back(skeleton.properties.volume->changed().connect(
+            [this](media::Player::Volume volume)
+            {
+                status_page->update([volume](media::StatusPage::Snapshot& snapshot)
+                {
+                    snapshot.volume = volume;
+                });
+            }));
+
+        status_connections.emplace_back(skeleton.properties.meta_data_for_current_track->changed().connect(
+            [this](const media::Track::MetaData&)
+            {
+                // A new track starts over, readers must not extrapolate the
+                // old track's position against the new duration
+                const auto position = impl->position().get();
+                const auto anchor = media::StatusPage::now();
+                const auto duration = impl->duration().get();
+                status_page->update([position, anchor, duration](media::StatusPage::Snapshot& snapshot)
+                {
+                    snapshot.position = position;
+                    snapshot.anchor = anchor;
+                    snapshot.duration = duration;
+                    ++snapshot.metadata_generation;
+                });
+            }));
+
+        // Seeking and running out of buffered data make the position jump or stall
+        const auto resample = [this]()
+        {
+            const auto position = impl->position().get();
+            const auto anchor = media::StatusPage::now();
+            status_page->update([position, anchor](media::StatusPage::Snapshot& snapshot)
+            {
+                snapshot.position = position;
+                snapshot.anchor = anchor;
+            });
+        };
+
+        status_connections.emplace_back(signals.seeked_to.connect([resample](int64_t) { resample(); }));
+        status_connections.emplace_back(signals.buffering_changed.connect([resample](int) { resample(); }));
+    }
+
+    // Runs then with the apparmor context of the caller. On the dispatch queue
+    // this waits for a context that isn't cached yet, so that the call still
+    // completes on the queue and ahead of the calls after it. Without a queue
+    // it completes wherever the answer comes in, the bus thread must not wait
+    // for the bus.
+    void with_context_of(const core::dbus::Message::Ptr& msg,
+                         const media::apparmor::ubuntu::RequestContextResolver::ResolveCallback& then)
+    {
+        if (not dispatch_queue)
+        {
+            request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(), then);
+            return;
+        }
+
+        typedef std::shared_ptr<const media::apparmor::ubuntu::Context> ContextPtr;
+        const auto resolved = std::make_shared<std::promise<ContextPtr>>();
+        auto future = resolved->get_future();
+        request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
+                [resolved](const media::apparmor::ubuntu::Context& context)
+        {
+            resolved->set_value(std::make_shared<const media::apparmor::ubuntu::Context>(context));
+        });
+
+        ContextPtr context;
+        try {
+            context = future.get();
+        } catch (const std::future_error&) {
+            // The resolver dropped the request without an answer
+            MH_WARNING("Failed to resolve the apparmor context of %s", msg->sender());
+            return;
+        }
+
+        then(*context);
+    }
+
+    void handle_open_uri(const core::dbus::Message::Ptr& in, const media::CancellationToken& token)
+    {
+        with_context_of(in, [this, in, token](const media::apparmor::ubuntu::Context& context)
+        {
+            // Nobody would get to play what got prerolled
+            if (token.is_cancelled())
+                return;
+
             Track::UriType uri;
             in->reader() >> uri;
 
             auto reply = dbus::Message::make_method_return(in);
-            uri_check->set(uri);
-            const bool valid_uri = !uri_check->is_local_file() or
-                    (uri_check->is_local_file() and uri_check->file_exists());
+            const media::UriCheck uri_check{uri};
+            const bool valid_uri = !uri_check.is_local_file() or
+                    (uri_check.is_local_file() and uri_check.file_exists());
             if (!valid_uri)
             {
                 const std::string err_str = {"Warning: Failed to open uri " + uri +
@@ -222,19 +455,22 @@ struct media::PlayerSkeleton::Private
         });
     }
 
-    void handle_open_uri_extended(const core::dbus::Message::Ptr& in)
+    void handle_open_uri_extended(const core::dbus::Message::Ptr& in, const media::CancellationToken& token)
     {
-        request_context_resolver->resolve_context_for_dbus_name_async(in->sender(), [this, in](const media::apparmor::ubuntu::Context& context)
+        with_context_of(in, [this, in, token](const media::apparmor::ubuntu::Context& context)
         {
+            if (token.is_cancelled())
+                return;
+
             Track::UriType uri;
             Player::HeadersType headers;
 
             in->reader() >> uri >> headers;
 
             auto reply = dbus::Message::make_method_return(in);
-            uri_check->set(uri);
-            const bool valid_uri = !uri_check->is_local_file() or
-                    (uri_check->is_local_file() and uri_check->file_exists());
+            const media::UriCheck uri_check{uri};
+            const bool valid_uri = !uri_check.is_local_file() or
+                    (uri_check.is_local_file() and uri_check.file_exists());
             if (!valid_uri)
             {
                 const std::string err_str = {"Warning: Failed to open uri " + uri +
@@ -295,7 +531,13 @@ struct media::PlayerSkeleton::Private
     dbus::Object::Ptr object;
     media::apparmor::ubuntu::RequestContextResolver::Ptr request_context_resolver;
     media::apparmor::ubuntu::RequestAuthenticator::Ptr request_authenticator;
-    media::UriCheck::Ptr uri_check;
+    media::SerialQueue::Ptr dispatch_queue;
+    media::PeerCancellation::Ptr cancellation;
+    // Null if the system doesn't support them
+    media::StatusPageWriter::Ptr status_page;
+    // The apparmor context of the app owning the session, empty if nobody does
+    std::mutex owner_guard;
+    std::string owner_context;
 
     mpris::Player::Skeleton skeleton;
 
@@ -363,54 +605,97 @@ struct media::PlayerSkeleton::Private
         core::Signal<int> buffering_changed;
     } signals;
 
+    // Declared last, so that no change comes in while the rest is torn down
+    std::list<core::ScopedConnection> status_connections;
 };
 
 media::PlayerSkeleton::PlayerSkeleton(const media::PlayerSkeleton::Configuration& config)
-        : d(new Private{this, config.bus, config.session, config.request_context_resolver, config.request_authenticator})
+        : d(new Private{this, config.bus, config.session, config.request_context_resolver, config.request_authenticator,
+                        config.dispatch_queue, config.cancellation})
 {
+    // Controlling playback must not wait for bulk work of other sessions
+    const auto high = media::WorkerPool::Priority::high;
+
     // Setup method handlers for mpris::Player methods.
     auto next = std::bind(&Private::handle_next, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Next>(next);
+    d->object->install_method_handler<mpris::Player::Next>(d->dispatched(next, high));
 
     auto previous = std::bind(&Private::handle_previous, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Previous>(previous);
+    d->object->install_method_handler<mpris::Player::Previous>(d->dispatched(previous, high));
 
     auto pause = std::bind(&Private::handle_pause, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Pause>(pause);
+    d->object->install_method_handler<mpris::Player::Pause>(d->dispatched(pause, high));
 
     auto stop = std::bind(&Private::handle_stop, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Stop>(stop);
+    d->object->install_method_handler<mpris::Player::Stop>(d->dispatched(stop, high));
 
     auto play = std::bind(&Private::handle_play, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Play>(play);
+    d->object->install_method_handler<mpris::Player::Play>(d->dispatched(play, high));
 
     auto play_pause = std::bind(&Private::handle_play_pause, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::PlayPause>(play_pause);
+    d->object->install_method_handler<mpris::Player::PlayPause>(d->dispatched(play_pause, high));
 
     auto seek = std::bind(&Private::handle_seek, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::Seek>(seek);
+    d->object->install_method_handler<mpris::Player::Seek>(d->dispatched(seek, high));
 
     auto set_position = std::bind(&Private::handle_set_position, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::SetPosition>(set_position);
+    d->object->install_method_handler<mpris::Player::SetPosition>(d->dispatched(set_position));
 
-    auto open_uri = std::bind(&Private::handle_open_uri, d, std::placeholders::_1);
-    d->object->install_method_handler<mpris::Player::OpenUri>(open_uri);
+    auto open_uri = std::bind(&Private::handle_open_uri, d, std::placeholders::_1, std::placeholders::_2);
+    d->object->install_method_handler<mpris::Player::OpenUri>(d->dispatched_with_token(open_uri));
 
     // All the method handlers that exceed the mpris spec go here.
     d->object->install_method_handler<mpris::Player::CreateVideoSink>(
-        std::bind(&Private::handle_create_video_sink,
-                  d,
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_create_video_sink,
+                                d,
+                                std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::Player::Key>(
-        std::bind(&Private::handle_key,
-                  d,
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_key,
+                                d,
+                                std::placeholders::_1),
+                      high));
 
     d->object->install_method_handler<mpris::Player::OpenUriExtended>(
-        std::bind(&Private::handle_open_uri_extended,
-                  d,
-                  std::placeholders::_1));
+        d->dispatched_with_token(std::bind(&Private::handle_open_uri_extended,
+                                           d,
+                                           std::placeholders::_1,
+                                           std::placeholders::_2)));
+
+    d->object->install_method_handler<core::dbus::interfaces::Properties::GetAll>(
+        std::bind(&Private::handle_get_all, d, std::placeholders::_1));
+
+    // Handed out right on the bus thread once the caller turned out to own the session
+    d->object->install_method_handler<mpris::Player::GetStatusPage>(
+        std::bind(&Private::handle_get_status_page, d, std::placeholders::_1));
+
+    if (d->status_page)
+        d->publish_status_changes();
+
+    // Changes go out once per main loop iteration. Changes that come in from
+    // the streaming threads don't wait there for a long call of the session.
+    if (config.external_services)
+    {
+        boost::asio::io_service& io_service = config.external_services->io_service;
+        d->skeleton.property_changes->set_scheduler([&io_service](const std::function<void()>& flush)
+        {
+            io_service.post(flush);
+        });
+    }
+
+    // Alarms, alerts and calls are time critical, all requests of such a
+    // session run ahead of the ones of multimedia sessions
+    if (d->dispatch_queue)
+    {
+        const auto queue = d->dispatch_queue;
+
+        d->skeleton.properties.audio_stream_role->changed().connect([queue](media::Player::AudioStreamRole role)
+        {
+            queue->set_minimum_priority(role == media::Player::AudioStreamRole::multimedia ?
+                                            media::WorkerPool::Priority::bulk :
+                                            media::WorkerPool::Priority::high);
+        });
+    }
 }
 
 media::PlayerSkeleton::~PlayerSkeleton()
@@ -429,6 +714,24 @@ media::PlayerSkeleton::~PlayerSkeleton()
    d->object->uninstall_method_handler<mpris::Player::CreateVideoSink>();
    d->object->uninstall_method_handler<mpris::Player::Key>();
    d->object->uninstall_method_handler<mpris::Player::OpenUriExtended>();
+   d->object->uninstall_method_handler<core::dbus::interfaces::Properties::GetAll>();
+   d->object->uninstall_method_handler<mpris::Player::GetStatusPage>();
+}
+
+const media::SerialQueue::Ptr& media::PlayerSkeleton::dispatch_queue() const
+{
+    return d->dispatch_queue;
+}
+
+void media::PlayerSkeleton::set_owner_context(const std::string& context)
+{
+    std::lock_guard<std::mutex> lg{d->owner_guard};
+    d->owner_context = context;
+}
+
+mpris::Player::Dictionary media::PlayerSkeleton::get_all_properties()
+{
+    return d->skeleton.get_all_properties();
 }
 
 const core::Property<bool>& media::PlayerSkeleton::can_play() const
@@ -25,7 +25,10 @@
 #include "player_traits.h"
 
 #include "apparmor/ubuntu.h"
+#include "client_quotas.h"
 #include "mpris/player.h"
+#include "peer_cancellation.h"
+#include "util/worker_pool.h"
 
 #include <core/dbus/skeleton.h>
 #include <core/dbus/types/object_path.h>
@@ -62,11 +65,31 @@ class PlayerSkeleton : public core::ubuntu::media::Player
         // Our functional dependencies.
         apparmor::ubuntu::RequestContextResolver::Ptr request_context_resolver;
         apparmor::ubuntu::RequestAuthenticator::Ptr request_authenticator;
+        // Method calls of the session are handled on this queue, on the bus
+        // thread if there is none. Shared with the TrackList of the session.
+        SerialQueue::Ptr dispatch_queue;
+        // Limits what clients get to put into the TrackList, unlimited if there is none.
+        ClientQuotas::Ptr quotas;
+        // Trips for calls of clients that left the bus, which are then dropped.
+        PeerCancellation::Ptr cancellation;
+        // Changed properties are announced from its main loop, one by one
+        // as they change if there is none.
+        helper::ExternalServices* external_services;
     };
 
     PlayerSkeleton(const Configuration& configuration);
     ~PlayerSkeleton();
 
+    // What GetAll answers with for the Player interface
+    mpris::Player::Dictionary get_all_properties();
+
+    // Where method calls of the session are handled, null if on the bus thread.
+    const SerialQueue::Ptr& dispatch_queue() const;
+
+    // The apparmor context of the app owning the session. Its status page is
+    // handed out to that app and unconfined ones only.
+    void set_owner_context(const std::string& context);
+
     virtual const core::Property<bool>& can_play() const;
     virtual const core::Property<bool>& can_pause() const;
     virtual const core::Property<bool>& can_seek() const;
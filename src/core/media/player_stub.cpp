@@ -21,10 +21,15 @@
 #include <core/media/track_list.h>
 #include <core/media/video/platform_default_sink.h>
 
+#include "async_call.h"
+#include "cached_remote_property.h"
 #include "codec.h"
+#include "lazy_remote_signal.h"
+#include "peer_connection.h"
 #include "player_stub.h"
 #include "player_traits.h"
 #include "property_stub.h"
+#include "status_page.h"
 #include "the_session_bus.h"
 #include "track_list_stub.h"
 
@@ -34,63 +39,174 @@
 
 #include <core/dbus/property.h>
 #include <core/dbus/types/object_path.h>
+#include <core/dbus/types/unix_fd.h>
 
+#include <atomic>
+#include <cstdlib>
 #include <limits>
+#include <list>
+#include <map>
+#include <mutex>
 #include <sstream>
 
+#include <unistd.h>
+
 #define UNUSED __attribute__((unused))
 
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
 
+namespace
+{
+void throw_open_uri_error(const dbus::Error& error)
+{
+    if (error.name() == mpris::Player::Error::InsufficientAppArmorPermissions::name)
+        throw media::Player::Errors::InsufficientAppArmorPermissions{error.print()};
+    else if (error.name() == mpris::Player::Error::UriNotFound::name)
+        throw media::Player::Errors::UriNotFound{error.print()};
+    else
+        throw std::runtime_error{error.print()};
+}
+
+media::ErrorTranslator fails_with(const std::string& what)
+{
+    return [what](const dbus::Error&) { throw std::runtime_error{what}; };
+}
+
+// Opened once per process, and only if CORE_UBUNTU_MEDIA_SERVICE_PEER_ENDPOINT
+// is set to 1 for the client as well. nullptr if the service doesn't listen.
+media::PeerConnection::Ptr the_peer_connection()
+{
+    static const media::PeerConnection::Ptr connection = []()
+    {
+        const char* enabled = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_PEER_ENDPOINT");
+        if (not enabled or std::string{enabled} != "1")
+            return media::PeerConnection::Ptr{};
+
+        return media::PeerConnection::open();
+    }();
+
+    return connection;
+}
+}
+
 struct media::PlayerStub::Private
 {
     Private(const std::shared_ptr<Service>& parent,
             const std::shared_ptr<core::dbus::Service>& service,
             const std::shared_ptr<core::dbus::Object>& object,
-            const std::string& uuid
+            const std::string& uuid,
+            const media::PlayerStub::InitialState* state
             ) : parent(parent),
                 service(service),
                 object(object),
-                key(object->invoke_method_synchronously<mpris::Player::Key, media::Player::PlayerKey>().value()),
+                key(state ? state->key : object->invoke_method_synchronously<mpris::Player::Key, media::Player::PlayerKey>().value()),
                 uuid(uuid),
+                peer(the_peer_connection()),
+                peer_failed{false},
                 properties
                 {
                     // Link the properties from the server side to the client side over the bus
-                    object->get_property<mpris::Player::Properties::CanPlay>(),
-                    object->get_property<mpris::Player::Properties::CanPause>(),
-                    object->get_property<mpris::Player::Properties::CanSeek>(),
-                    object->get_property<mpris::Player::Properties::CanControl>(),
-                    object->get_property<mpris::Player::Properties::CanGoNext>(),
-                    object->get_property<mpris::Player::Properties::CanGoPrevious>(),
-                    object->get_property<mpris::Player::Properties::IsVideoSource>(),
-                    object->get_property<mpris::Player::Properties::IsAudioSource>(),
-                    object->get_property<mpris::Player::Properties::TypedPlaybackStatus>(),
-                    object->get_property<mpris::Player::Properties::TypedBackend>(),
-                    object->get_property<mpris::Player::Properties::TypedLoopStatus>(),
-                    object->get_property<mpris::Player::Properties::PlaybackRate>(),
-                    object->get_property<mpris::Player::Properties::Shuffle>(),
-                    object->get_property<mpris::Player::Properties::Metadata>(),
-                    object->get_property<mpris::Player::Properties::Volume>(),
-                    object->get_property<mpris::Player::Properties::Position>(),
-                    object->get_property<mpris::Player::Properties::Duration>(),
-                    object->get_property<mpris::Player::Properties::AudioStreamRole>(),
-                    object->get_property<mpris::Player::Properties::Orientation>(),
-                    object->get_property<mpris::Player::Properties::Lifetime>(),
-                    object->get_property<mpris::Player::Properties::MinimumRate>(),
-                    object->get_property<mpris::Player::Properties::MaximumRate>()
+                    cached(object->get_property<mpris::Player::Properties::CanPlay>()),
+                    cached(object->get_property<mpris::Player::Properties::CanPause>()),
+                    cached(object->get_property<mpris::Player::Properties::CanSeek>()),
+                    cached(object->get_property<mpris::Player::Properties::CanControl>()),
+                    cached(object->get_property<mpris::Player::Properties::CanGoNext>()),
+                    cached(object->get_property<mpris::Player::Properties::CanGoPrevious>()),
+                    cached(object->get_property<mpris::Player::Properties::IsVideoSource>()),
+                    cached(object->get_property<mpris::Player::Properties::IsAudioSource>()),
+                    cached(object->get_property<mpris::Player::Properties::TypedPlaybackStatus>()),
+                    cached(object->get_property<mpris::Player::Properties::TypedBackend>()),
+                    cached(object->get_property<mpris::Player::Properties::TypedLoopStatus>()),
+                    cached(object->get_property<mpris::Player::Properties::PlaybackRate>()),
+                    cached(object->get_property<mpris::Player::Properties::Shuffle>()),
+                    cached(object->get_property<mpris::Player::Properties::Metadata>()),
+                    cached(object->get_property<mpris::Player::Properties::Volume>()),
+                    extrapolated(object->get_property<mpris::Player::Properties::Position>()),
+                    cached(object->get_property<mpris::Player::Properties::Duration>()),
+                    cached(object->get_property<mpris::Player::Properties::AudioStreamRole>()),
+                    cached(object->get_property<mpris::Player::Properties::Orientation>()),
+                    cached(object->get_property<mpris::Player::Properties::Lifetime>()),
+                    cached(object->get_property<mpris::Player::Properties::MinimumRate>()),
+                    cached(object->get_property<mpris::Player::Properties::MaximumRate>())
                 },
-                signals
+                paged
                 {
-                    object->get_signal<mpris::Player::Signals::Seeked>(),
-                    object->get_signal<mpris::Player::Signals::AboutToFinish>(),
-                    object->get_signal<mpris::Player::Signals::EndOfStream>(),
-                    object->get_signal<mpris::Player::Signals::PlaybackStatusChanged>(),
-                    object->get_signal<mpris::Player::Signals::VideoDimensionChanged>(),
-                    object->get_signal<mpris::Player::Signals::Buffering>(),
-                    object->get_signal<mpris::Player::Signals::Error>()
-                }
+                    std::make_shared<media::StatusPageProperty<std::int64_t>>(
+                        [this]() { return status_page(); },
+                        [](const media::StatusPage::Snapshot& snapshot) { return snapshot.position_at(media::StatusPage::now()); },
+                        properties.position),
+                    std::make_shared<media::StatusPageProperty<std::int64_t>>(
+                        [this]() { return status_page(); },
+                        [](const media::StatusPage::Snapshot& snapshot) { return snapshot.duration; },
+                        properties.duration)
+                },
+                signals{object}
     {
+        if (state)
+        {
+            seed_properties(state->properties);
+            track_list_properties = state->track_list_properties;
+        }
+        else
+        {
+            seed_properties();
+        }
+
+        // The service computes these on every read instead of setting them,
+        // so it never tells about changes. They are asked for again once the
+        // track, the tracklist or the playback status changed.
+        connections.emplace_back(properties.meta_data_for_current_track->changed().connect(
+            [this](const media::Track::MetaData&)
+            {
+                // The new track doesn't carry on from where the last one was
+                properties.position->invalidate();
+                invalidate_computed_properties();
+            }));
+
+        // Whether there is a next or previous track depends on both
+        connections.emplace_back(properties.loop_status->changed().connect(
+            [this](media::Player::LoopStatus)
+            {
+                invalidate_computed_properties();
+            }));
+
+        connections.emplace_back(properties.shuffle->changed().connect(
+            [this](bool)
+            {
+                invalidate_computed_properties();
+            }));
+
+        connections.emplace_back(properties.playback_status->changed().connect(
+            [this](media::Player::PlaybackStatus status)
+            {
+                properties.position->set_playing(status == media::Player::PlaybackStatus::playing);
+                properties.position->invalidate();
+                invalidate_computed_properties();
+            }));
+
+        connections.emplace_back(properties.playback_rate->changed().connect(
+            [this](media::Player::PlaybackRate rate)
+            {
+                properties.position->set_rate(rate);
+            }));
+
+        // Seeks by other clients and the end of the stream move the position
+        // without PropertiesChanged, so these two are always listened to.
+        connections.emplace_back(signals.seeked_to.get().connect([this](int64_t)
+        {
+            properties.position->invalidate();
+        }));
+
+        connections.emplace_back(signals.end_of_stream.get().connect([this]()
+        {
+            properties.position->invalidate();
+            invalidate_computed_properties();
+        }));
+
+        properties.position->set_playing(properties.playback_status->get() == media::Player::PlaybackStatus::playing);
+        properties.position->set_rate(properties.playback_rate->get());
+
         sink_factory = media::video::make_platform_default_sink_factory(key,
                                 properties.backend->get());
     }
@@ -99,138 +215,223 @@ struct media::PlayerStub::Private
     {
     }
 
+    template<typename Property>
+    std::shared_ptr<media::CachedRemoteProperty<typename Property::ValueType>> cached(
+            const std::shared_ptr<core::dbus::Property<Property>>& remote)
+    {
+        typedef typename Property::ValueType ValueType;
+        const auto property = std::make_shared<media::CachedRemoteProperty<ValueType>>(remote);
+
+        std::weak_ptr<media::CachedRemoteProperty<ValueType>> weak{property};
+        seeders[Property::name()] = [weak](const core::dbus::types::Variant& value)
+        {
+            if (const auto sp = weak.lock())
+                sp->refresh(value.template as<ValueType>());
+        };
+
+        return property;
+    }
+
+    media::ExtrapolatedPosition::Ptr extrapolated(
+            const std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Position>>& remote)
+    {
+        const auto position = std::make_shared<media::ExtrapolatedPosition>(remote);
+
+        std::weak_ptr<media::ExtrapolatedPosition> weak{position};
+        seeders[mpris::Player::Properties::Position::name()] = [weak](const core::dbus::types::Variant& value)
+        {
+            if (const auto sp = weak.lock())
+                sp->refresh(value.as<std::int64_t>());
+        };
+
+        return position;
+    }
+
+    // A single GetAll fills the cache. Properties it doesn't have, for services
+    // that don't answer GetAll, are fetched as they are read for the first time.
+    void seed_properties()
+    {
+        const auto op = object->invoke_method_synchronously<
+                core::dbus::interfaces::Properties::GetAll,
+                mpris::Player::Dictionary>(mpris::Player::name());
+
+        if (op.is_error())
+        {
+            MH_WARNING("Failed to get all properties of the player: %s", op.error().print());
+            return;
+        }
+
+        seed_properties(op.value());
+    }
+
+    void seed_properties(const mpris::Player::Dictionary& dict)
+    {
+        for (const auto& pair : dict)
+        {
+            const auto it = seeders.find(pair.first);
+            if (it != seeders.end())
+                it->second(pair.second);
+        }
+    }
+
+    // Asks for the status page of the session the first time it is needed.
+    // Services that don't have one are asked for every read instead.
+    media::StatusPageReader::Ptr status_page()
+    {
+        std::call_once(status_page_once, [this]()
+        {
+            const auto op = object->invoke_method_synchronously<
+                    mpris::Player::GetStatusPage,
+                    core::dbus::types::UnixFd>();
+
+            if (op.is_error())
+            {
+                MH_DEBUG("No status page for the session: %s", op.error().print());
+                return;
+            }
+
+            // The mapping outlives the descriptor, which is ours to close
+            const int fd = op.value().to_raw();
+            status_page_reader = media::StatusPageReader::map(fd);
+            ::close(fd);
+        });
+
+        return status_page_reader;
+    }
+
+    // Sends a playback control over the peer connection, if there is one
+    // that works. Returns false if the call has to go through the bus. Once
+    // a call failed, for example because the endpoint didn't trust us, all
+    // further calls go through the bus.
+    bool via_peer(const std::function<void(media::PeerConnection&)>& call)
+    {
+        if (not peer or peer_failed)
+            return false;
+
+        try
+        {
+            call(*peer);
+            return true;
+        }
+        catch (const std::runtime_error& e)
+        {
+            MH_WARNING("Call over the peer connection failed, using the bus: %s", e.what());
+            peer_failed = true;
+            return false;
+        }
+    }
+
+    void invalidate_computed_properties()
+    {
+        properties.can_go_next->invalidate();
+        properties.can_go_previous->invalidate();
+        properties.is_video_source->invalidate();
+        properties.is_audio_source->invalidate();
+        properties.duration->invalidate();
+    }
+
+    // The service announces what a control changed, but the announcement
+    // may come in after the reply. Until then the values the control touches
+    // are asked for again, so that a read right after the call sees them.
+    std::function<void()> playback_state_invalidator() const
+    {
+        const auto p = properties;
+        return [p]()
+        {
+            p.playback_status->invalidate();
+            p.meta_data_for_current_track->invalidate();
+            p.can_play->invalidate();
+            p.can_pause->invalidate();
+            p.can_seek->invalidate();
+            p.can_go_next->invalidate();
+            p.can_go_previous->invalidate();
+            p.is_video_source->invalidate();
+            p.is_audio_source->invalidate();
+            p.duration->invalidate();
+            p.position->invalidate();
+        };
+    }
+
+    void invalidate_playback_state()
+    {
+        playback_state_invalidator()();
+    }
+
     std::shared_ptr<Service> parent;
     std::shared_ptr<TrackList> track_list;
     dbus::Service::Ptr service;
     dbus::Object::Ptr object;
     media::Player::PlayerKey key;
     std::string uuid;
+    media::PeerConnection::Ptr peer;
+    std::atomic<bool> peer_failed;
     media::video::SinkFactory sink_factory;
+    // Handed to the TrackList once it gets created
+    std::map<std::string, core::dbus::types::Variant> track_list_properties;
+    // Turns the values of a GetAll into the properties below
+    std::map<std::string, std::function<void(const core::dbus::types::Variant&)>> seeders;
     struct
     {
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanPlay>> can_play;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanPause>> can_pause;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanSeek>> can_seek;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanControl>> can_control;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanGoNext>> can_go_next;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::CanGoPrevious>> can_go_previous;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::IsVideoSource>> is_video_source;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::IsAudioSource>> is_audio_source;
-
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::TypedPlaybackStatus>> playback_status;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::TypedBackend>> backend;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::TypedLoopStatus>> loop_status;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::PlaybackRate>> playback_rate;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Shuffle>> shuffle;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Metadata>> meta_data_for_current_track;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Volume>> volume;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Position>> position;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Duration>> duration;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::AudioStreamRole>> audio_role;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Orientation>> orientation;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::Lifetime>> lifetime;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::MinimumRate>> minimum_playback_rate;
-        std::shared_ptr<core::dbus::Property<mpris::Player::Properties::MaximumRate>> maximum_playback_rate;
+        media::CachedRemoteProperty<bool>::Ptr can_play;
+        media::CachedRemoteProperty<bool>::Ptr can_pause;
+        media::CachedRemoteProperty<bool>::Ptr can_seek;
+        media::CachedRemoteProperty<bool>::Ptr can_control;
+        media::CachedRemoteProperty<bool>::Ptr can_go_next;
+        media::CachedRemoteProperty<bool>::Ptr can_go_previous;
+        media::CachedRemoteProperty<bool>::Ptr is_video_source;
+        media::CachedRemoteProperty<bool>::Ptr is_audio_source;
+
+        media::CachedRemoteProperty<media::Player::PlaybackStatus>::Ptr playback_status;
+        media::CachedRemoteProperty<media::AVBackend::Backend>::Ptr backend;
+        media::CachedRemoteProperty<media::Player::LoopStatus>::Ptr loop_status;
+        media::CachedRemoteProperty<media::Player::PlaybackRate>::Ptr playback_rate;
+        media::CachedRemoteProperty<bool>::Ptr shuffle;
+        media::CachedRemoteProperty<media::Track::MetaData>::Ptr meta_data_for_current_track;
+        media::CachedRemoteProperty<media::Player::Volume>::Ptr volume;
+        media::ExtrapolatedPosition::Ptr position;
+        media::CachedRemoteProperty<int64_t>::Ptr duration;
+        media::CachedRemoteProperty<media::Player::AudioStreamRole>::Ptr audio_role;
+        media::CachedRemoteProperty<media::Player::Orientation>::Ptr orientation;
+        media::CachedRemoteProperty<media::Player::Lifetime>::Ptr lifetime;
+        media::CachedRemoteProperty<media::Player::PlaybackRate>::Ptr minimum_playback_rate;
+        media::CachedRemoteProperty<media::Player::PlaybackRate>::Ptr maximum_playback_rate;
     } properties;
 
+    std::once_flag status_page_once;
+    media::StatusPageReader::Ptr status_page_reader;
+    // Read off the status page while there is one
+    struct
+    {
+        media::StatusPageProperty<std::int64_t>::Ptr position;
+        media::StatusPageProperty<std::int64_t>::Ptr duration;
+    } paged;
+
+    // Only subscribed to once a client asks for them, except for Seeked and
+    // EndOfStream which keep the position current
     struct Signals
     {
-        typedef core::dbus::Signal<mpris::Player::Signals::Seeked, mpris::Player::Signals::Seeked::ArgumentType> DBusSeekedToSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::AboutToFinish, mpris::Player::Signals::AboutToFinish::ArgumentType> DBusAboutToFinishSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::EndOfStream, mpris::Player::Signals::EndOfStream::ArgumentType> DBusEndOfStreamSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::PlaybackStatusChanged, mpris::Player::Signals::PlaybackStatusChanged::ArgumentType> DBusPlaybackStatusChangedSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::VideoDimensionChanged, mpris::Player::Signals::VideoDimensionChanged::ArgumentType> DBusVideoDimensionChangedSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::Error, mpris::Player::Signals::Error::ArgumentType> DBusErrorSignal;
-        typedef core::dbus::Signal<mpris::Player::Signals::Buffering, mpris::Player::Signals::Buffering::ArgumentType> DBusBufferingChangedSignal;
-
-        Signals(const std::shared_ptr<DBusSeekedToSignal>& seeked,
-                const std::shared_ptr<DBusAboutToFinishSignal>& atf,
-                const std::shared_ptr<DBusEndOfStreamSignal>& eos,
-                const std::shared_ptr<DBusPlaybackStatusChangedSignal>& status,
-                const std::shared_ptr<DBusVideoDimensionChangedSignal>& d,
-                const std::shared_ptr<DBusBufferingChangedSignal>& bp,
-                const std::shared_ptr<DBusErrorSignal>& e)
-            : seeked_to(),
-              about_to_finish(),
-              end_of_stream(),
-              playback_status_changed(),
-              video_dimension_changed(),
-              error(),
-              buffering_changed(),
-              dbus
-              {
-                  seeked,
-                  atf,
-                  eos,
-                  status,
-                  d,
-                  e,
-                  bp
-              }
+        explicit Signals(const dbus::Object::Ptr& object)
+            : seeked_to{object},
+              about_to_finish{object},
+              end_of_stream{object},
+              playback_status_changed{object},
+              video_dimension_changed{object},
+              error{object},
+              buffering_changed{object}
         {
-            dbus.seeked_to->connect([this](std::uint64_t value)
-            {
-                MH_DEBUG("SeekedTo signal arrived via the bus.");
-                seeked_to(value);
-            });
-
-            dbus.about_to_finish->connect([this]()
-            {
-                MH_DEBUG("AboutToFinish signal arrived via the bus.");
-                about_to_finish();
-            });
-
-            dbus.end_of_stream->connect([this]()
-            {
-                MH_DEBUG("EndOfStream signal arrived via the bus.");
-                end_of_stream();
-            });
-
-            dbus.playback_status_changed->connect([this](const media::Player::PlaybackStatus& status)
-            {
-                MH_DEBUG("PlaybackStatusChanged signal arrived via the bus (status: %s)",
-                        status);
-                playback_status_changed(status);
-            });
-
-            dbus.video_dimension_changed->connect([this](const media::video::Dimensions dimensions)
-            {
-                MH_DEBUG("VideoDimensionChanged signal arrived via the bus.");
-                video_dimension_changed(dimensions);
-            });
-
-            dbus.error->connect([this](const media::Player::Error& e)
-            {
-                MH_DEBUG("Error signal arrived via the bus (error: %s)", e);
-                error(e);
-            });
-
-            dbus.buffering_changed->connect([this](int percent)
-            {
-                MH_DEBUG("BufferingChanged signal arrived via the bus (percent: %d", percent);
-                buffering_changed(percent);
-            });
         }
 
-        core::Signal<int64_t> seeked_to;
-        core::Signal<void> about_to_finish;
-        core::Signal<void> end_of_stream;
-        core::Signal<media::Player::PlaybackStatus> playback_status_changed;
-        core::Signal<media::video::Dimensions> video_dimension_changed;
-        core::Signal<media::Player::Error> error;
-        core::Signal<int> buffering_changed;
-
-        struct DBus
-        {
-            std::shared_ptr<DBusSeekedToSignal> seeked_to;
-            std::shared_ptr<DBusAboutToFinishSignal> about_to_finish;
-            std::shared_ptr<DBusEndOfStreamSignal> end_of_stream;
-            std::shared_ptr<DBusPlaybackStatusChangedSignal> playback_status_changed;
-            std::shared_ptr<DBusVideoDimensionChangedSignal> video_dimension_changed;
-            std::shared_ptr<DBusErrorSignal> error;
-            std::shared_ptr<DBusBufferingChangedSignal> buffering_changed;
-        } dbus;
+        media::LazyRemoteSignal<mpris::Player::Signals::Seeked> seeked_to;
+        media::LazyRemoteSignal<mpris::Player::Signals::AboutToFinish> about_to_finish;
+        media::LazyRemoteSignal<mpris::Player::Signals::EndOfStream> end_of_stream;
+        media::LazyRemoteSignal<mpris::Player::Signals::PlaybackStatusChanged> playback_status_changed;
+        media::LazyRemoteSignal<mpris::Player::Signals::VideoDimensionChanged> video_dimension_changed;
+        media::LazyRemoteSignal<mpris::Player::Signals::Error> error;
+        media::LazyRemoteSignal<mpris::Player::Signals::Buffering> buffering_changed;
     } signals;
+
+    // Declared last, so that no change comes in while the rest is torn down
+    std::list<core::ScopedConnection> connections;
 };
 
 media::PlayerStub::PlayerStub(
@@ -238,7 +439,18 @@ media::PlayerStub::PlayerStub(
     const std::shared_ptr<core::dbus::Service>& service,
     const std::shared_ptr<core::dbus::Object>& object,
     const std::string& uuid)
-        : d(new Private{parent, service, object, uuid})
+        : d(new Private{parent, service, object, uuid, nullptr})
+{
+    MH_TRACE("");
+}
+
+media::PlayerStub::PlayerStub(
+    const std::shared_ptr<Service>& parent,
+    const std::shared_ptr<core::dbus::Service>& service,
+    const std::shared_ptr<core::dbus::Object>& object,
+    const std::string& uuid,
+    const InitialState& state)
+        : d(new Private{parent, service, object, uuid, &state})
 {
     MH_TRACE("");
 }
@@ -246,6 +458,11 @@ media::PlayerStub::PlayerStub(
 media::PlayerStub::~PlayerStub()
 {
     MH_TRACE("");
+
+    const auto& statistics = media::RemotePropertyStatistics::instance();
+    MH_DEBUG("Property reads: %llu answered locally, %llu asked the service",
+             static_cast<unsigned long long>(statistics.answered_locally.load()),
+             static_cast<unsigned long long>(statistics.fetched.load()));
 }
 
 std::string media::PlayerStub::uuid() const
@@ -267,11 +484,20 @@ std::shared_ptr<media::TrackList> media::PlayerStub::track_list()
 {
     if (!d->track_list)
     {
-        d->track_list = std::make_shared<media::TrackListStub>(
+        const auto track_list = std::make_shared<media::TrackListStub>(
                     shared_from_this(),
                     d->service->object_for_path(
                         dbus::types::ObjectPath(
-                            d->object->path().as_string() + "/TrackList")));
+                            d->object->path().as_string() + "/TrackList")),
+                    d->track_list_properties);
+
+        // Whether there is a next or previous track depends on the tracklist
+        d->connections.emplace_back(track_list->on_tracks_invalidated().connect([this]()
+        {
+            d->invalidate_computed_properties();
+        }));
+
+        d->track_list = track_list;
     }
 
     return d->track_list;
@@ -287,15 +513,9 @@ bool media::PlayerStub::open_uri(const media::Track::UriType& uri)
 {
     const auto op = d->object->transact_method<mpris::Player::OpenUri, bool>(uri);
     if (op.is_error())
-    {
-        if (op.error().name() == mpris::Player::Error::InsufficientAppArmorPermissions::name)
-            throw media::Player::Errors::InsufficientAppArmorPermissions{op.error().print()};
-        else if (op.error().name() == mpris::Player::Error::UriNotFound::name)
-            throw media::Player::Errors::UriNotFound{op.error().print()};
-        else
-            throw std::runtime_error{op.error().print()};
-    }
+        throw_open_uri_error(op.error());
 
+    d->invalidate_playback_state();
     return op.value();
 }
 
@@ -311,6 +531,7 @@ bool media::PlayerStub::open_uri(const Track::UriType& uri, const Player::Header
             throw std::runtime_error{op.error().print()};
     }
 
+    d->invalidate_playback_state();
     return op.value();
 }
 
@@ -336,50 +557,154 @@ media::video::Sink::Ptr media::PlayerStub::create_gl_texture_video_sink(std::uin
 
 void media::PlayerStub::next()
 {
-    auto op = d->object->transact_method<mpris::Player::Next, void>();
+    if (not d->via_peer([this](media::PeerConnection& peer) { peer.next(d->key); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Next, void>();
 
-    if (op.is_error())
-        throw std::runtime_error("Problem switching to next track on remote object");
+        if (op.is_error())
+            throw std::runtime_error("Problem switching to next track on remote object");
+    }
+
+    d->invalidate_playback_state();
 }
 
 void media::PlayerStub::previous()
 {
-    auto op = d->object->transact_method<mpris::Player::Previous, void>();
+    if (not d->via_peer([this](media::PeerConnection& peer) { peer.previous(d->key); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Previous, void>();
 
-    if (op.is_error())
-        throw std::runtime_error("Problem switching to previous track on remote object");
+        if (op.is_error())
+            throw std::runtime_error("Problem switching to previous track on remote object");
+    }
+
+    d->invalidate_playback_state();
 }
 
 void media::PlayerStub::play()
 {
-    auto op = d->object->transact_method<mpris::Player::Play, void>();
+    if (not d->via_peer([this](media::PeerConnection& peer) { peer.play(d->key); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Play, void>();
 
-    if (op.is_error())
-        throw std::runtime_error("Problem starting playback on remote object");
+        if (op.is_error())
+            throw std::runtime_error("Problem starting playback on remote object");
+    }
+
+    d->invalidate_playback_state();
 }
 
 void media::PlayerStub::pause()
 {
-    auto op = d->object->transact_method<mpris::Player::Pause, void>();
+    if (not d->via_peer([this](media::PeerConnection& peer) { peer.pause(d->key); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Pause, void>();
 
-    if (op.is_error())
-        throw std::runtime_error("Problem pausing playback on remote object");
+        if (op.is_error())
+            throw std::runtime_error("Problem pausing playback on remote object");
+    }
+
+    d->invalidate_playback_state();
 }
 
 void media::PlayerStub::seek_to(const std::chrono::microseconds& offset)
 {
-    auto op = d->object->transact_method<mpris::Player::Seek, void, uint64_t>(offset.count());
+    if (not d->via_peer([this, offset](media::PeerConnection& peer) { peer.seek_to(d->key, offset); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Seek, void, uint64_t>(offset.count());
 
-    if (op.is_error())
-        throw std::runtime_error("Problem seeking on remote object");
+        if (op.is_error())
+            throw std::runtime_error("Problem seeking on remote object");
+    }
+
+    d->properties.position->invalidate();
 }
 
 void media::PlayerStub::stop()
 {
-    auto op = d->object->transact_method<mpris::Player::Stop, void>();
+    if (not d->via_peer([this](media::PeerConnection& peer) { peer.stop(d->key); }))
+    {
+        auto op = d->object->transact_method<mpris::Player::Stop, void>();
+
+        if (op.is_error())
+            throw std::runtime_error("Problem stopping playback on remote object");
+    }
+
+    d->invalidate_playback_state();
+}
+
+std::future<bool> media::PlayerStub::open_uri_async(const Track::UriType& uri)
+{
+    return media::invoke_async_then<mpris::Player::OpenUri, bool>(
+                d->object, throw_open_uri_error, d->playback_state_invalidator(), uri);
+}
 
-    if (op.is_error())
-        throw std::runtime_error("Problem stopping playback on remote object");
+std::future<bool> media::PlayerStub::open_uri_async(const Track::UriType& uri, const Player::HeadersType& headers)
+{
+    return media::invoke_async_then<mpris::Player::OpenUriExtended, bool>(
+                d->object, throw_open_uri_error, d->playback_state_invalidator(), uri, headers);
+}
+
+std::future<void> media::PlayerStub::next_async()
+{
+    return media::invoke_async_then<mpris::Player::Next, void>(
+                d->object, fails_with("Problem switching to next track on remote object"),
+                d->playback_state_invalidator());
+}
+
+std::future<void> media::PlayerStub::previous_async()
+{
+    return media::invoke_async_then<mpris::Player::Previous, void>(
+                d->object, fails_with("Problem switching to previous track on remote object"),
+                d->playback_state_invalidator());
+}
+
+std::future<void> media::PlayerStub::play_async()
+{
+    return media::invoke_async_then<mpris::Player::Play, void>(
+                d->object, fails_with("Problem starting playback on remote object"),
+                d->playback_state_invalidator());
+}
+
+std::future<void> media::PlayerStub::pause_async()
+{
+    return media::invoke_async_then<mpris::Player::Pause, void>(
+                d->object, fails_with("Problem pausing playback on remote object"),
+                d->playback_state_invalidator());
+}
+
+std::future<void> media::PlayerStub::stop_async()
+{
+    return media::invoke_async_then<mpris::Player::Stop, void>(
+                d->object, fails_with("Problem stopping playback on remote object"),
+                d->playback_state_invalidator());
+}
+
+std::future<void> media::PlayerStub::seek_to_async(const std::chrono::microseconds& offset)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+
+    // Holding on to the position keeps it around if the reply outlives us
+    const auto position = d->properties.position;
+    const auto translate = fails_with("Problem seeking on remote object");
+    try
+    {
+        d->object->invoke_method_asynchronously_with_callback<mpris::Player::Seek, void>(
+                    [promise, position, translate](const dbus::Result<void>& result)
+                    {
+                        if (not result.is_error())
+                            position->invalidate();
+
+                        media::complete(*promise, result, translate);
+                    }, static_cast<uint64_t>(offset.count()));
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    return future;
 }
 
 const core::Property<bool>& media::PlayerStub::can_play() const
@@ -454,12 +779,12 @@ const core::Property<media::Player::Volume>& media::PlayerStub::volume() const
 
 const core::Property<int64_t>& media::PlayerStub::position() const
 {
-    return *d->properties.position;
+    return *d->paged.position;
 }
 
 const core::Property<int64_t>& media::PlayerStub::duration() const
 {
-    return *d->properties.duration;
+    return *d->paged.duration;
 }
 
 const core::Property<media::Player::AudioStreamRole>& media::PlayerStub::audio_stream_role() const
@@ -519,35 +844,35 @@ core::Property<media::Player::Lifetime>& media::PlayerStub::lifetime()
 
 const core::Signal<int64_t>& media::PlayerStub::seeked_to() const
 {
-    return d->signals.seeked_to;
+    return d->signals.seeked_to.get();
 }
 
 const core::Signal<void>& media::PlayerStub::about_to_finish() const
 {
-    return d->signals.about_to_finish;
+    return d->signals.about_to_finish.get();
 }
 
 const core::Signal<void>& media::PlayerStub::end_of_stream() const
 {
-    return d->signals.end_of_stream;
+    return d->signals.end_of_stream.get();
 }
 
 core::Signal<media::Player::PlaybackStatus>& media::PlayerStub::playback_status_changed()
 {
-    return d->signals.playback_status_changed;
+    return d->signals.playback_status_changed.get();
 }
 
 const core::Signal<media::video::Dimensions>& media::PlayerStub::video_dimension_changed() const
 {
-    return d->signals.video_dimension_changed;
+    return d->signals.video_dimension_changed.get();
 }
 
 const core::Signal<media::Player::Error>& media::PlayerStub::error() const
 {
-    return d->signals.error;
+    return d->signals.error.get();
 }
 
 const core::Signal<int>& media::PlayerStub::buffering_changed() const
 {
-    return d->signals.buffering_changed;
+    return d->signals.buffering_changed.get();
 }
@@ -23,8 +23,11 @@
 #include <core/media/player.h>
 
 #include <core/dbus/stub.h>
+#include <core/dbus/types/variant.h>
 
+#include <map>
 #include <memory>
+#include <string>
 
 namespace core
 {
@@ -37,12 +40,30 @@ class Service;
 class PlayerStub : public Player
 {
   public:
+    // What the service tells about a session right as it creates it
+    struct InitialState
+    {
+        PlayerKey key;
+        // Values of the properties of the Player interface
+        std::map<std::string, core::dbus::types::Variant> properties;
+        // Values of the properties of the TrackList interface
+        std::map<std::string, core::dbus::types::Variant> track_list_properties;
+    };
+
     explicit PlayerStub(
         const std::shared_ptr<Service>& parent,
         const std::shared_ptr<core::dbus::Service>& service,
         const std::shared_ptr<core::dbus::Object>& object,
         const std::string& uuid = std::string{});
 
+    // Takes the key and the properties from state instead of asking the service
+    PlayerStub(
+        const std::shared_ptr<Service>& parent,
+        const std::shared_ptr<core::dbus::Service>& service,
+        const std::shared_ptr<core::dbus::Object>& object,
+        const std::string& uuid,
+        const InitialState& state);
+
     ~PlayerStub();
 
     virtual std::string uuid() const;
@@ -63,6 +84,15 @@ class PlayerStub : public Player
     virtual void seek_to(const std::chrono::microseconds& offset);
     virtual void stop();
 
+    virtual std::future<bool> open_uri_async(const Track::UriType& uri);
+    virtual std::future<bool> open_uri_async(const Track::UriType& uri, const Player::HeadersType& headers);
+    virtual std::future<void> next_async();
+    virtual std::future<void> previous_async();
+    virtual std::future<void> play_async();
+    virtual std::future<void> pause_async();
+    virtual std::future<void> stop_async();
+    virtual std::future<void> seek_to_async(const std::chrono::microseconds& offset);
+
     virtual const core::Property<bool>& can_play() const;
     virtual const core::Property<bool>& can_pause() const;
     virtual const core::Property<bool>& can_seek() const;
@@ -22,6 +22,7 @@
 
 #include "core/media/hashed_keyed_player_store.h"
 #include "core/media/logger/logger.h"
+#include "core/media/peer_endpoint.h"
 #include "core/media/service_implementation.h"
 
 #include <hybris/media/media_codec_layer.h>
@@ -152,10 +153,27 @@ int main()
         external_services
     };
 
+    // Shared by the service and all of its sessions, which charge clients for what they use.
+    auto quotas = std::make_shared<media::ClientQuotas>(media::ClientQuotas::Configuration::from_environment());
+
+    // Tells work done on behalf of clients that they left the bus.
+    auto cancellation = std::make_shared<media::PeerCancellation>(external_services.session_departures());
+
+    // Only the decoding service knows about clients that died on hybris, everywhere
+    // else they are noticed leaving the bus.
+    media::DBusClientDeathObserver::Ptr client_death_observer;
+    const media::AVBackend::Backend backend {media::AVBackend::get_backend_type()};
+    if (backend == media::AVBackend::Backend::mir or backend == media::AVBackend::Backend::none)
+        client_death_observer = media::DBusClientDeathObserver::create(external_services.session_departures(),
+                                                                      external_services.io_service);
+
     auto impl = std::make_shared<media::ServiceImplementation>(media::ServiceImplementation::Configuration
     {
         player_store,
-        external_services
+        external_services,
+        quotas,
+        cancellation,
+        client_death_observer
     });
 
     auto skeleton = std::make_shared<media::ServiceSkeleton>(media::ServiceSkeleton::Configuration
@@ -163,9 +181,28 @@ int main()
         impl,
         player_store,
         external_services,
-        nullptr
+        nullptr,
+        quotas,
+        cancellation,
+        client_death_observer
     });
 
+    // Trusted local clients may skip the bus daemon for playback controls.
+    media::PeerEndpoint::Ptr peer_endpoint;
+    const auto peer_config = media::PeerEndpoint::Configuration::from_environment();
+    if (not peer_config.address.empty())
+    {
+        try
+        {
+            peer_endpoint = std::make_shared<media::PeerEndpoint>(peer_config, player_store);
+            MH_INFO("Serving peers on %s", peer_endpoint->address());
+        }
+        catch (const std::exception& e)
+        {
+            MH_WARNING("Not serving peers: %s", e.what());
+        }
+    }
+
     std::thread service_worker
     {
         [&shutdown_requested, skeleton]()
@@ -197,6 +234,7 @@ int main()
     shutdown_requested = true;
 
     // And stop execution of helper and actual service.
+    peer_endpoint.reset();
     skeleton->stop();
 
     if (service_worker.joinable())
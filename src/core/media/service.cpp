@@ -20,6 +20,7 @@
 
 #include "core/media/logger/logger.h"
 
+#include "async_call.h"
 #include "service_stub.h"
 
 namespace media = core::ubuntu::media;
@@ -30,3 +31,9 @@ const std::shared_ptr<media::Service> media::Service::Client::instance()
     static std::shared_ptr<media::Service> instance{new media::ServiceStub()};
     return instance;
 }
+
+// Overridden by the stub, an in-process service has nothing to wait for
+std::future<std::shared_ptr<media::Player>> media::Service::create_session_async(const Player::Configuration& config)
+{
+    return media::complete_now<std::shared_ptr<media::Player>>([this, &config]() { return create_session(config); });
+}
@@ -25,21 +25,31 @@
 #include "apparmor/ubuntu.h"
 #include "audio/output_observer.h"
 #include "client_death_observer.h"
+#include "gstreamer/meta_data_extractor.h"
+#include "mpris/cached_properties.h"
+#include "mpris/properties_changed_batch.h"
 #include "player_configuration.h"
 #include "player_skeleton.h"
 #include "player_implementation.h"
 #include "power/battery_observer.h"
 #include "power/state_controller.h"
 #include "recorder_observer.h"
+#include "session_resource_manager.h"
+#include "session_teardown.h"
 #include "telephony/call_monitor.h"
+#include "track_list_implementation.h"
 
 #include "util/timeout.h"
+#include "util/worker_pool.h"
 #include "core/media/logger/logger.h"
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 
+#include <algorithm>
 #include <string>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <map>
 #include <memory>
@@ -62,14 +72,76 @@ struct media::ServiceImplementation::Private
           battery_observer(media::power::make_platform_default_battery_observer(configuration.external_services)),
           power_state_controller(media::power::make_platform_default_state_controller(configuration.external_services)),
           display_state_lock(power_state_controller->display_state_lock()),
-          client_death_observer(media::platform_default_client_death_observer()),
+          client_death_observer(configuration.client_death_observer
+                                ? configuration.client_death_observer
+                                : media::platform_default_client_death_observer()),
           recorder_observer(media::make_platform_default_recorder_observer()),
           audio_output_observer(media::audio::make_platform_default_output_observer()),
           request_context_resolver(media::apparmor::ubuntu::make_platform_default_request_context_resolver(configuration.external_services)),
           request_authenticator(media::apparmor::ubuntu::make_platform_default_request_authenticator()),
           audio_output_state(media::audio::OutputState::Speaker),
-          call_monitor(media::telephony::make_platform_default_call_monitor())
+          call_monitor(media::telephony::make_platform_default_call_monitor()),
+          meta_data_extractor(std::make_shared<gstreamer::SharedMetaDataExtractor>()),
+          resource_manager(media::SessionResourceManager::Configuration::from_environment()),
+          idle_check(configuration.external_services.io_service),
+          dispatch_pool(dispatch_threads())
     {
+        schedule_idle_check();
+    }
+
+    ~Private()
+    {
+        idle_check.cancel();
+    }
+
+    // Number of threads handling the method calls of all sessions, taken from
+    // CORE_UBUNTU_MEDIA_SERVICE_DISPATCH_THREADS if set
+    static std::size_t dispatch_threads()
+    {
+        if (const char *threads = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_DISPATCH_THREADS"))
+            return std::max(1ul, std::strtoul(threads, nullptr, 10));
+
+        return std::max(4u, std::thread::hardware_concurrency());
+    }
+
+    void schedule_idle_check()
+    {
+        // Check often enough that no session stays loaded much longer than the idle timeout
+        static const std::chrono::milliseconds max_interval{std::chrono::seconds{30}};
+        static const std::chrono::milliseconds min_interval{std::chrono::seconds{1}};
+        const auto interval = std::max(min_interval,
+                std::min(max_interval, resource_manager.configuration().idle_timeout));
+
+        idle_check.expires_from_now(interval);
+        idle_check.async_wait([this](const boost::system::error_code& ec)
+        {
+            if (ec == boost::asio::error::operation_aborted)
+                return;
+
+            resource_manager.enforce();
+            log_dispatch_statistics();
+            schedule_idle_check();
+        });
+    }
+
+    void log_dispatch_statistics()
+    {
+        const auto stats = dispatch_pool.statistics();
+        MH_DEBUG("Dispatch queue depth (max) high: %zu (%zu), normal: %zu (%zu), bulk: %zu (%zu), aged: %llu",
+                 stats.depth[0], stats.max_depth[0],
+                 stats.depth[1], stats.max_depth[1],
+                 stats.depth[2], stats.max_depth[2],
+                 static_cast<unsigned long long>(stats.aged));
+
+        const auto& changes = mpris::PropertiesChangedBatch::statistics();
+        MH_DEBUG("PropertiesChanged: %llu property changes sent in %llu messages",
+                 static_cast<unsigned long long>(changes.changes.load()),
+                 static_cast<unsigned long long>(changes.messages.load()));
+
+        const auto& get_all = mpris::CachedProperties::statistics();
+        MH_DEBUG("GetAll: %llu answered from cache, %llu built",
+                 static_cast<unsigned long long>(get_all.hits.load()),
+                 static_cast<unsigned long long>(get_all.misses.load()));
     }
 
     media::ServiceImplementation::Configuration configuration;
@@ -90,6 +162,15 @@ struct media::ServiceImplementation::Private
     // Holds a pair of a Player key denoting what player to resume playback, and a bool
     // for if it should be resumed after a phone call is hung up
     std::list<std::pair<media::Player::PlayerKey, bool>> paused_sessions;
+    // One extraction pipeline for all sessions instead of one per Engine, it is
+    // only brought up once the first track needs its metadata.
+    std::shared_ptr<media::Engine::MetaDataExtractor> meta_data_extractor;
+    // Takes the pipelines away from sessions that are idle for too long
+    media::SessionResourceManager resource_manager;
+    boost::asio::steady_timer idle_check;
+    // Runs the dispatch queues of all sessions. Declared last so that it
+    // finishes the queued calls while everything else is still around.
+    media::WorkerPool dispatch_pool;
 };
 
 media::ServiceImplementation::ServiceImplementation(const Configuration& configuration)
@@ -195,37 +276,65 @@ std::shared_ptr<media::Player> media::ServiceImplementation::create_session(
             conf.session,
             conf.player_service,
             d->request_context_resolver,
-            d->request_authenticator
+            d->request_authenticator,
+            // Calls of one session are handled in order, those of different sessions in parallel
+            media::SerialQueue::create(d->dispatch_pool),
+            d->configuration.quotas,
+            d->configuration.cancellation,
+            &d->configuration.external_services
         },
         conf.key,
         d->client_death_observer,
-        d->power_state_controller
+        d->power_state_controller,
+        d->meta_data_extractor
     });
 
     auto key = conf.key;
+
+    std::weak_ptr<media::PlayerImplementation<media::PlayerSkeleton>> weak_player{player};
+    d->resource_manager.add_session(key, player, [weak_player]()
+    {
+        const auto sp = weak_player.lock();
+        return sp ? sp->release_pipeline() : false;
+    });
+
+    player->playback_status().changed().connect([this, key](const media::Player::PlaybackStatus& status)
+    {
+        if (status != media::Player::PlaybackStatus::playing)
+        {
+            d->resource_manager.on_session_idle(key);
+            return;
+        }
+
+        // Make room right away instead of waiting for the next periodic check,
+        // but not from within the state change of the session itself
+        if (d->resource_manager.on_session_active(key))
+            d->configuration.external_services.io_service.post([this]()
+            {
+                d->resource_manager.enforce();
+            });
+    });
     // *Note: on_client_disconnected() is called from a Binder thread context
-    player->on_client_disconnected().connect([this, key]()
+    player->on_client_disconnected().connect([this, key, weak_player]()
     {
         // Call remove_player_for_key asynchronously otherwise deadlock can occur
         // if called within this dispatcher context.
         // remove_player_for_key can destroy the player instance which in turn
         // destroys the "on_client_disconnected" signal whose destructor will wait
         // until all dispatches are done
-        d->configuration.external_services.io_service.post([this, key]()
+        d->configuration.external_services.io_service.post([this, key, weak_player]()
         {
-            if (!d->configuration.player_store->has_player_for_key(key))
+            const auto sp = weak_player.lock();
+            if (not media::reclaim_session(*d->configuration.player_store, key))
                 return;
 
-            try {
-                if (d->configuration.player_store->player_for_key(key)->lifetime() == Player::Lifetime::normal)
-                    d->configuration.player_store->remove_player_for_key(key);
-            }
-            catch (const std::out_of_range &e) {
-                MH_WARNING("Failed to look up Player instance for key %d"
-                    ", no valid Player instance for that key value. Removal of Player from Player store"
-                    " might not have completed. This most likely means that media-hub-server has"
-                    " crashed and restarted.", key);
-                return;
+            d->resource_manager.remove_session(key);
+            // Fixed sessions leave a journal behind, which there is no use for anymore
+            if (sp)
+            {
+                const auto track_list = std::dynamic_pointer_cast<media::TrackListImplementation>(sp->track_list());
+                if (track_list)
+                    track_list->discard_journal();
             }
         });
     });
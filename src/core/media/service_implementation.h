@@ -38,6 +38,12 @@ public:
     {
         KeyedPlayerStore::Ptr player_store;
         helper::ExternalServices& external_services;
+        // Limits what clients get to put into the tracklists of their sessions.
+        ClientQuotas::Ptr quotas;
+        // Lets sessions drop the calls of clients that left the bus.
+        PeerCancellation::Ptr cancellation;
+        // Tells sessions that their client died, the platform default if there is none.
+        ClientDeathObserver::Ptr client_death_observer;
     };
 
     ServiceImplementation (const Configuration& configuration);
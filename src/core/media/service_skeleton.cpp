@@ -24,16 +24,27 @@
 #include "mpris/player.h"
 #include "mpris/playlists.h"
 #include "mpris/service.h"
+#include "mpris/track_list.h"
 
+#include "external_services.h"
 #include "player_configuration.h"
+#include "player_skeleton.h"
+#include "session_registry.h"
+#include "session_teardown.h"
 #include "the_session_bus.h"
+#include "track_list_implementation.h"
 #include "xesam.h"
 
+#include "util/playlist_store.h"
+#include "util/track_list_journal.h"
+
 #include "core/media/logger/logger.h"
 
 #include <core/dbus/message.h>
 #include <core/dbus/object.h>
 #include <core/dbus/types/object_path.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
 
 #include <core/posix/this_process.h>
 
@@ -41,9 +52,15 @@
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
+#include <mutex>
 #include <regex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
@@ -100,22 +117,118 @@ struct media::ServiceSkeleton::Private
                         &Private::handle_pause_other_sessions,
                         this,
                         std::placeholders::_1));
+        object->install_method_handler<mpris::Service::GetClientUsage>(
+                    std::bind(
+                        &Private::handle_get_client_usage,
+                        this,
+                        std::placeholders::_1));
+        object->install_method_handler<mpris::Service::BootstrapSession>(
+                    std::bind(
+                        &Private::handle_bootstrap_session,
+                        this,
+                        std::placeholders::_1));
+
+        if (configuration.client_death_observer)
+            configuration.client_death_observer->set_session_lookup(
+                        std::bind(
+                            &Private::sessions_to_tear_down,
+                            this,
+                            std::placeholders::_1));
+    }
+
+    ~Private()
+    {
+        if (configuration.client_death_observer)
+            configuration.client_death_observer->set_session_lookup(
+                        media::DBusClientDeathObserver::SessionLookup{});
+    }
+
+    std::vector<media::Player::PlayerKey> sessions_to_tear_down(const std::string& sender)
+    {
+        return media::sessions_to_tear_down(sessions, *configuration.player_store, sender);
     }
 
     std::tuple<std::string, media::Player::PlayerKey, std::string> create_session_info()
     {
-        static unsigned int session_counter = 0;
+        const media::Player::PlayerKey current_session = sessions.allocate_key();
 
-        const unsigned int current_session = session_counter++;
-        boost::uuids::uuid uuid = gen();
+        boost::uuids::uuid uuid;
+        {
+            // The generator is not thread-safe
+            std::lock_guard<std::mutex> lg(gen_guard);
+            uuid = gen();
+        }
 
         std::stringstream ss;
         ss << "/core/ubuntu/media/Service/sessions/" << current_session;
 
-        return std::make_tuple(ss.str(), media::Player::PlayerKey(current_session), to_string(uuid));
+        return std::make_tuple(ss.str(), current_session, to_string(uuid));
     }
 
     void handle_create_session(const core::dbus::Message::Ptr& msg)
+    {
+        create_session_for_request(msg, false);
+    }
+
+    // Like CreateSession, but also answers with everything a client needs to
+    // know about the new session, which saves it a round trip for each.
+    void handle_bootstrap_session(const core::dbus::Message::Ptr& msg)
+    {
+        create_session_for_request(msg, true);
+    }
+
+    void create_session_for_request(const core::dbus::Message::Ptr& msg, bool with_state)
+    {
+        // The client is known before anything gets built, so that one over its
+        // quota is turned down before it costs a pipeline
+        const auto token = configuration.cancellation
+                ? configuration.cancellation->token_for(msg->sender())
+                : media::CancellationToken{};
+        request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
+                [this, msg, token, with_state](const media::apparmor::ubuntu::Context& context)
+        {
+            if (token.is_cancelled())
+            {
+                MH_DEBUG("Not creating session, %s left the bus", msg->sender());
+                return;
+            }
+
+            const auto client = media::ClientQuotas::client_for(context, msg->sender());
+            std::shared_ptr<void> slot;
+            if (not admit_session(msg, client, slot))
+                return;
+
+            create_session_for(msg, context, client, slot, with_state);
+        });
+    }
+
+    // Takes a session from the quota of client, answering msg with an error
+    // if it has none left. The session stays taken while slot lives.
+    bool admit_session(const core::dbus::Message::Ptr& msg, const std::string& client, std::shared_ptr<void>& slot)
+    {
+        if (not configuration.quotas)
+            return true;
+
+        slot = configuration.quotas->admit_session(client);
+        if (slot)
+            return true;
+
+        std::stringstream err_str;
+        err_str << "Not creating session, client " << client << " already has "
+                << configuration.quotas->configuration().max_sessions << " sessions";
+        MH_WARNING("%s", err_str.str());
+        impl->access_bus()->send(dbus::Message::make_error(
+                    msg,
+                    mpris::Service::Errors::QuotaExceeded::name(),
+                    err_str.str()));
+        return false;
+    }
+
+    void create_session_for(const core::dbus::Message::Ptr& msg,
+                            const media::apparmor::ubuntu::Context& context,
+                            const std::string& client,
+                            const std::shared_ptr<void>& slot,
+                            bool with_state)
     {
         auto session_info = create_session_info();
 
@@ -139,17 +252,22 @@ struct media::ServiceSkeleton::Private
         {
             const std::shared_ptr<media::Player> player {impl->create_session(config)};
             configuration.player_store->add_player_for_key(key, player);
-            uuid_player_map.emplace(std::make_pair(uuid, key));
+            sessions.add(key, uuid);
+            if (configuration.quotas)
+                configuration.quotas->bind_session(client, slot, player);
 
-            request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
-                    [this, key, msg](const media::apparmor::ubuntu::Context& context)
-            {
-                MH_DEBUG(" -- app_name='%s', attached", context.str());
-                player_owner_map.emplace(std::make_pair(key, std::make_tuple(context.str(), true, msg->sender())));
-            });
+            MH_DEBUG(" -- app_name='%s', attached", context.str());
+            sessions.set_owner(key, media::SessionRegistry::Owner{context.str(), true, msg->sender()});
+            if (const auto skeleton = std::dynamic_pointer_cast<media::PlayerSkeleton>(player))
+                skeleton->set_owner_context(context.str());
 
             auto reply = dbus::Message::make_method_return(msg);
-            reply->writer() << std::make_tuple(op, uuid);
+            if (with_state)
+                reply->writer() << std::make_tuple(op, uuid, key,
+                                                   player_properties_of(player),
+                                                   track_list_properties_of(player));
+            else
+                reply->writer() << std::make_tuple(op, uuid);
 
             impl->access_bus()->send(reply);
         } catch(const std::runtime_error& e)
@@ -162,6 +280,72 @@ struct media::ServiceSkeleton::Private
         }
     }
 
+    static mpris::Player::Dictionary player_properties_of(const std::shared_ptr<media::Player>& player)
+    {
+        const auto skeleton = std::dynamic_pointer_cast<media::PlayerSkeleton>(player);
+        return skeleton ? skeleton->get_all_properties() : mpris::Player::Dictionary{};
+    }
+
+    static mpris::TrackList::Dictionary track_list_properties_of(const std::shared_ptr<media::Player>& player)
+    {
+        const auto track_list = player->track_list();
+        const auto skeleton = std::dynamic_pointer_cast<media::TrackListSkeleton>(track_list);
+
+        mpris::TrackList::Dictionary dict;
+        dict[mpris::TrackList::Properties::Tracks::name()] = skeleton ?
+                dbus::types::Variant::encode(skeleton->snapshot()->tracks) :
+                dbus::types::Variant::encode(track_list->tracks().get());
+        dict[mpris::TrackList::Properties::CanEditTracks::name()] =
+                dbus::types::Variant::encode(track_list->can_edit_tracks().get());
+
+        return dict;
+    }
+
+    // Answers with what every client currently uses, followed by the limits that
+    // apply to each of them
+    void handle_get_client_usage(const core::dbus::Message::Ptr& msg)
+    {
+        // Tells which apps are installed and what they play, for the shell only
+        request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
+                [this, msg](const media::apparmor::ubuntu::Context& context)
+        {
+            if (not context.is_unconfined() and not context.is_unity())
+            {
+                MH_WARNING("Not telling %s about the usage of clients", context.str());
+                impl->access_bus()->send(dbus::Message::make_error(
+                            msg,
+                            mpris::Service::Errors::InsufficientAppArmorPermissions::name(),
+                            "Only the shell and unconfined clients may ask for the usage of clients"));
+                return;
+            }
+
+            send_client_usage(msg);
+        });
+    }
+
+    void send_client_usage(const core::dbus::Message::Ptr& msg)
+    {
+        typedef std::tuple<std::string, std::uint64_t, std::uint64_t, std::uint64_t> ClientUsage;
+
+        std::vector<ClientUsage> usages;
+        std::tuple<std::uint64_t, std::uint64_t, std::uint64_t> limits{0, 0, 0};
+        if (configuration.quotas)
+        {
+            for (const auto& usage : configuration.quotas->usage())
+                usages.push_back(ClientUsage{usage.first,
+                                             usage.second.sessions,
+                                             usage.second.tracks,
+                                             usage.second.metadata_requests});
+
+            const auto& config = configuration.quotas->configuration();
+            limits = std::make_tuple(config.max_sessions, config.max_tracks, config.max_metadata_requests);
+        }
+
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << usages << limits;
+        impl->access_bus()->send(reply);
+    }
+
     void handle_detach_session(const core::dbus::Message::Ptr& msg)
     {
         try
@@ -169,22 +353,24 @@ struct media::ServiceSkeleton::Private
             std::string uuid;
             msg->reader() >> uuid;
 
-            // Make sure we don't try to do a lookup if the map is empty
-            if (!uuid_player_map.empty())
+            media::Player::PlayerKey key;
+            if (sessions.key_for_uuid(uuid, key))
             {
-                const auto key = uuid_player_map.at(uuid);
-
-                if (player_owner_map.count(key) != 0) {
-                    auto info = player_owner_map.at(key);
+                bool detached = false;
+                sessions.update_owner(key, [&detached, &msg](media::SessionRegistry::Owner& owner)
+                {
                     // Check if session is attached(1) and that the detachment
                     // request comes from the same peer(2) that created the session.
-                    if (std::get<1>(info) && (std::get<2>(info) == msg->sender())) { // Player is attached
-                        std::get<1>(info) = false; // Detached
-                        std::get<2>(info).clear(); // Clear registered sender/peer
-
-                        auto player = configuration.player_store->player_for_key(key);
-                        player->lifetime().set(media::Player::Lifetime::resumable);
+                    if (owner.attached && (owner.sender == msg->sender())) { // Player is attached
+                        owner.attached = false; // Detached
+                        owner.sender.clear(); // Clear registered sender/peer
+                        detached = true;
                     }
+                });
+
+                if (detached) {
+                    auto player = configuration.player_store->player_for_key(key);
+                    player->lifetime().set(media::Player::Lifetime::resumable);
                 }
             }
 
@@ -208,9 +394,9 @@ struct media::ServiceSkeleton::Private
             std::string uuid;
             msg->reader() >> uuid;
 
-            if (uuid_player_map.count(uuid) != 0)
+            media::Player::PlayerKey key;
+            if (sessions.key_for_uuid(uuid, key))
             {
-                const auto key = uuid_player_map.at(uuid);
                 if (not configuration.player_store->has_player_for_key(key))
                 {
                     auto reply = dbus::Message::make_error(
@@ -227,13 +413,19 @@ struct media::ServiceSkeleton::Private
                 request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
                         [this, msg, key, op](const media::apparmor::ubuntu::Context& context)
                 {
-                    auto info = player_owner_map.at(key);
-                    MH_DEBUG(" -- reattach app_name='%s', info='%s', '%s'",
-                            context.str(), std::get<0>(info), std::get<2>(info));
-                    if (std::get<0>(info) == context.str()) {
-                        std::get<1>(info) = true; // Set to Attached
-                        std::get<2>(info) = msg->sender(); // Register new owner
-
+                    bool reattached = false;
+                    sessions.update_owner(key, [&reattached, &context, &msg](media::SessionRegistry::Owner& owner)
+                    {
+                        MH_DEBUG(" -- reattach app_name='%s', info='%s', '%s'",
+                                context.str(), owner.context, owner.sender);
+                        if (owner.context == context.str()) {
+                            owner.attached = true; // Set to Attached
+                            owner.sender = msg->sender(); // Register new owner
+                            reattached = true;
+                        }
+                    });
+
+                    if (reattached) {
                         // Signal player reconnection
                         auto player = configuration.player_store->player_for_key(key);
                         player->reconnect();
@@ -278,8 +470,8 @@ struct media::ServiceSkeleton::Private
             std::string uuid;
             msg->reader() >> uuid;
 
-            if (uuid_player_map.count(uuid) != 0) {
-                const auto key = uuid_player_map.at(uuid);
+            media::Player::PlayerKey key;
+            if (sessions.key_for_uuid(uuid, key)) {
                 if (not configuration.player_store->has_player_for_key(key)) {
                     auto reply = dbus::Message::make_error(
                                 msg,
@@ -289,18 +481,20 @@ struct media::ServiceSkeleton::Private
                     return;
                 }
 
-                // Remove control entries from the map, at this point
+                // Remove the uuid from the registry, at this point
                 // the session is no longer usable.
-                uuid_player_map.erase(uuid);
+                sessions.remove_uuid(uuid);
 
                 request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
                         [this, msg, key](const media::apparmor::ubuntu::Context& context)
                 {
-                    auto info = player_owner_map.at(key);
+                    media::SessionRegistry::Owner owner;
+                    const bool known = sessions.owner(key, owner);
                     MH_DEBUG(" -- Destroying app_name='%s', info='%s', '%s'",
-                            context.str(), std::get<0>(info), std::get<2>(info));
-                    if (std::get<0>(info) == context.str()) {
-                        player_owner_map.erase(key);
+                            context.str(), owner.context, owner.sender);
+                    if (known && owner.context == context.str()) {
+                        // Forget about the session and its owner at once
+                        sessions.remove(key);
 
                         // Reset lifecycle to non-resumable on the now-abandoned session
                         auto player = configuration.player_store->player_for_key(key);
@@ -341,18 +535,43 @@ struct media::ServiceSkeleton::Private
     }
 
     void handle_create_fixed_session(const core::dbus::Message::Ptr& msg)
+    {
+        // Fixed sessions cost a pipeline and a journal on disk, they are charged
+        // to the quota of the client like all other sessions
+        const auto token = configuration.cancellation
+                ? configuration.cancellation->token_for(msg->sender())
+                : media::CancellationToken{};
+        request_context_resolver->resolve_context_for_dbus_name_async(msg->sender(),
+                [this, msg, token](const media::apparmor::ubuntu::Context& context)
+        {
+            if (token.is_cancelled())
+            {
+                MH_DEBUG("Not creating fixed session, %s left the bus", msg->sender());
+                return;
+            }
+
+            create_fixed_session_for(msg, media::ClientQuotas::client_for(context, msg->sender()));
+        });
+    }
+
+    void create_fixed_session_for(const core::dbus::Message::Ptr& msg, const std::string& client)
     {
         try
         {
             std::string name;
             msg->reader() >> name;
 
-            if (named_player_map.count(name) == 0) {
+            media::Player::PlayerKey key;
+            if (not sessions.key_for_name(name, key)) {
+                std::shared_ptr<void> slot;
+                if (not admit_session(msg, client, slot))
+                    return;
+
                 // Create new session
                 auto session_info = create_session_info();
 
                 dbus::types::ObjectPath op{std::get<0>(session_info)};
-                media::Player::PlayerKey key{std::get<1>(session_info)};
+                key = std::get<1>(session_info);
 
                 media::Player::Configuration config
                 {
@@ -365,10 +584,13 @@ struct media::ServiceSkeleton::Private
 
                 auto session = impl->create_session(config);
                 session->lifetime().set(media::Player::Lifetime::resumable);
+                restore_fixed_session(name, session);
 
                 configuration.player_store->add_player_for_key(key, session);
 
-                named_player_map.insert(std::make_pair(name, key));
+                sessions.add(key, std::string{}, name);
+                if (configuration.quotas)
+                    configuration.quotas->bind_session(client, slot, session);
 
                 auto reply = dbus::Message::make_method_return(msg);
                 reply->writer() << op;
@@ -377,7 +599,6 @@ struct media::ServiceSkeleton::Private
             }
             else {
                 // Resume previous session
-                const auto key = named_player_map.at(name);
                 if (not configuration.player_store->has_player_for_key(key)) {
                     auto reply = dbus::Message::make_error(
                                 msg,
@@ -406,6 +627,37 @@ struct media::ServiceSkeleton::Private
         }
     }
 
+    // Brings back the TrackList the fixed session had before media-hub got restarted,
+    // and keeps journaling every edit of it from now on
+    void restore_fixed_session(const std::string& name, const std::shared_ptr<media::Player>& session)
+    {
+        const auto track_list = std::dynamic_pointer_cast<media::TrackListImplementation>(session->track_list());
+        if (not track_list)
+            return;
+
+        const std::string path = media::TrackListJournal::path_for_session(name);
+
+        media::TrackListJournal::State state;
+        const auto start = std::chrono::steady_clock::now();
+        if (media::TrackListJournal::load(path, state))
+        {
+            // Set the Player properties first, turning on shuffle picks a new shuffle seed
+            session->loop_status().set(state.loop_status);
+            session->shuffle().set(state.shuffle);
+            track_list->restore(state);
+
+            MH_INFO("Restored %d tracks of fixed session %s in %d ms", state.tracks.size(), name,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+        }
+
+        try {
+            track_list->set_journal(std::make_shared<media::TrackListJournal>(path));
+        } catch (const media::TrackListJournal::Errors::FailedToOpenJournal& e) {
+            MH_WARNING("Not journaling fixed session %s: %s", name, e.what());
+        }
+    }
+
     void handle_resume_session(const core::dbus::Message::Ptr& msg)
     {
         try
@@ -502,14 +754,10 @@ struct media::ServiceSkeleton::Private
 
     // We remember all our creation time arguments.
     ServiceSkeleton::Configuration configuration;
-    // We map named/fixed player instances to their respective keys.
-    std::map<std::string, media::Player::PlayerKey> named_player_map;
-    // We map UUIDs to their respective keys.
-    std::map<std::string, media::Player::PlayerKey> uuid_player_map;
-    // We keep a list of keys and their respective owners and states.
-    // value: (owner context, attached state, attached dbus name)
-    std::map<media::Player::PlayerKey, std::tuple<std::string, bool, std::string>> player_owner_map;
+    // We map UUIDs, named/fixed sessions and owners to their respective keys.
+    media::SessionRegistry sessions;
 
+    std::mutex gen_guard;
     boost::uuids::random_generator gen;
 
     // We expose the entire service as an MPRIS player.
@@ -533,6 +781,71 @@ struct media::ServiceSkeleton::Private
             return defaults;
         }
 
+        static mpris::Playlists::Skeleton::Configuration::Defaults playlists_defaults()
+        {
+            mpris::Playlists::Skeleton::Configuration::Defaults defaults;
+            // All of them are answered from an index of the PlaylistStore
+            defaults.orderings =
+            {
+                mpris::Playlists::Orderings::alphabetical,
+                mpris::Playlists::Orderings::creation_date,
+                mpris::Playlists::Orderings::modified_date,
+                mpris::Playlists::Orderings::last_play_date
+            };
+
+            return defaults;
+        }
+
+        static const std::string& playlist_path_prefix()
+        {
+            static const std::string s{"/core/ubuntu/media/Service/playlists/"};
+            return s;
+        }
+
+        static mpris::Playlists::Playlist playlist_for(const media::PlaylistStore::Playlist& playlist)
+        {
+            return mpris::Playlists::Playlist
+            {
+                std::make_tuple(
+                    dbus::types::ObjectPath{playlist_path_prefix() + std::to_string(playlist.id)},
+                    playlist.name,
+                    playlist.icon)
+            };
+        }
+
+        static bool ordering_for(const std::string& name, media::PlaylistStore::Ordering& ordering)
+        {
+            static const std::map<std::string, media::PlaylistStore::Ordering> orderings
+            {
+                {mpris::Playlists::Orderings::alphabetical, media::PlaylistStore::Ordering::alphabetical},
+                {mpris::Playlists::Orderings::creation_date, media::PlaylistStore::Ordering::creation_date},
+                {mpris::Playlists::Orderings::modified_date, media::PlaylistStore::Ordering::modified_date},
+                {mpris::Playlists::Orderings::last_play_date, media::PlaylistStore::Ordering::last_play_date}
+            };
+
+            const auto it = orderings.find(name);
+            if (it == orderings.end())
+                return false;
+
+            ordering = it->second;
+            return true;
+        }
+
+        static bool playlist_id_for(const dbus::types::ObjectPath& path, media::PlaylistStore::Id& id)
+        {
+            const std::string& s = path.as_string();
+            if (s.compare(0, playlist_path_prefix().size(), playlist_path_prefix()) != 0)
+                return false;
+
+            try {
+                id = std::stoull(s.substr(playlist_path_prefix().size()));
+            } catch (const std::logic_error&) {
+                return false;
+            }
+
+            return true;
+        }
+
         explicit Exported(const dbus::Bus::Ptr& bus, const media::CoverArtResolver& cover_art_resolver,
                 media::ServiceSkeleton* impl, const ServiceSkeleton::Configuration& config)
             : bus{bus},
@@ -541,11 +854,19 @@ struct media::ServiceSkeleton::Private
               object{service->add_object_for_path(dbus::types::ObjectPath{"/org/mpris/MediaPlayer2"})},
               media_player{mpris::MediaPlayer2::Skeleton::Configuration{bus, object, media_player_defaults()}},
               player{mpris::Player::Skeleton::Configuration{bus, object, player_defaults()}},
-              playlists{mpris::Playlists::Skeleton::Configuration{bus, object, mpris::Playlists::Skeleton::Configuration::Defaults{}}},
+              playlists{mpris::Playlists::Skeleton::Configuration{bus, object, playlists_defaults()}},
+              playlist_store{media::PlaylistStore::default_path()},
               cover_art_resolver{cover_art_resolver},
               impl{impl},
               service_skel_config(config)
         {
+            // Changes mirrored from the current session go out once per main loop iteration
+            boost::asio::io_service& io_service = config.external_services.io_service;
+            player.property_changes->set_scheduler([&io_service](const std::function<void()>& flush)
+            {
+                io_service.post(flush);
+            });
+
             object->install_method_handler<core::dbus::interfaces::Properties::GetAll>([this](const core::dbus::Message::Ptr& msg)
             {
                 // Extract the interface
@@ -563,6 +884,107 @@ struct media::ServiceSkeleton::Private
                 Exported::bus->send(reply);
             });
 
+            // Setup method handlers for mpris::Playlists methods.
+            object->install_method_handler<mpris::Playlists::GetPlaylists>([this](const core::dbus::Message::Ptr& msg)
+            {
+                std::uint32_t index = 0, max_count = 0;
+                std::string order;
+                bool reverse = false;
+                msg->reader() >> index >> max_count >> order >> reverse;
+
+                media::PlaylistStore::Ordering ordering;
+                if (not ordering_for(order, ordering))
+                {
+                    Exported::bus->send(core::dbus::Message::make_error(
+                            msg, mpris::Playlists::Errors::UnknownOrdering::name(), order));
+                    return;
+                }
+
+                std::vector<mpris::Playlists::Playlist> result;
+                for (const auto& playlist : playlist_store.playlists(index, max_count, ordering, reverse))
+                    result.push_back(playlist_for(playlist));
+
+                auto reply = core::dbus::Message::make_method_return(msg);
+                reply->writer() << result;
+                Exported::bus->send(reply);
+            });
+
+            object->install_method_handler<mpris::Playlists::ActivatePlaylist>([this, impl](const core::dbus::Message::Ptr& msg)
+            {
+                dbus::types::ObjectPath path;
+                msg->reader() >> path;
+
+                media::PlaylistStore::Id id = 0;
+                media::PlaylistStore::Playlist playlist;
+                media::TrackList::ContainerURI uris;
+                if (not playlist_id_for(path, id) or not playlist_store.playlist(id, playlist)
+                        or not playlist_store.uris(id, uris))
+                {
+                    Exported::bus->send(core::dbus::Message::make_error(
+                            msg, mpris::Playlists::Errors::UnknownPlaylist::name(), path.as_string()));
+                    return;
+                }
+
+                const auto sp = service_skel_config.player_store->current_player().get();
+                if (not sp or not is_multimedia_role())
+                {
+                    Exported::bus->send(core::dbus::Message::make_error(
+                            msg, mpris::Playlists::Errors::NoActiveSession::name(),
+                            "There is no multimedia session to activate the playlist in"));
+                    return;
+                }
+
+                const auto track_list = std::dynamic_pointer_cast<media::TrackListSkeleton>(sp->track_list());
+                if (not track_list)
+                {
+                    Exported::bus->send(core::dbus::Message::make_error(
+                            msg, mpris::Playlists::Errors::NoActiveSession::name(),
+                            "The current session can't take playlists"));
+                    return;
+                }
+
+                // The whole playlist goes into the TrackList in one go, instead of one AddTrack per entry.
+                // The caller needs the same permissions for the entries as if it replaced the tracks itself.
+                const auto token = service_skel_config.cancellation
+                        ? service_skel_config.cancellation->token_for(msg->sender())
+                        : media::CancellationToken{};
+                const auto bus = Exported::bus;
+                track_list->replace_tracks_for(msg->sender(), token, uris, 0, std::chrono::microseconds{0},
+                        [this, bus, impl, msg, sp, id, playlist, uris](const std::string& error_name,
+                                                                       const std::string& error)
+                {
+                    if (not error_name.empty())
+                    {
+                        bus->send(core::dbus::Message::make_error(msg, error_name, error));
+                        return;
+                    }
+
+                    if (not uris.empty())
+                    {
+                        if (impl)
+                            impl->pause_other_sessions(sp->key());
+                        sp->play();
+                    }
+
+                    playlist_store.mark_played(id);
+                    playlists.properties.active_playlist->set(mpris::Playlists::MaybePlaylist
+                    {
+                        std::make_tuple(true, playlist_for(playlist))
+                    });
+
+                    bus->send(core::dbus::Message::make_method_return(msg));
+                });
+            });
+
+            playlists.properties.playlist_count->set(playlist_store.size());
+            // Parsing playlist files must not hold up the startup of the service
+            playlist_import = std::thread([this]()
+            {
+                const auto cancelled = [this]() { return playlist_import_cancelled.load(); };
+                if (playlist_store.import_directory(media::PlaylistStore::default_import_directory(), cancelled))
+                    playlists.properties.playlist_count->set(playlist_store.size());
+            });
+
             // Setup method handlers for mpris::Player methods.
             auto next = [this](const core::dbus::Message::Ptr& msg)
             {
@@ -652,6 +1074,14 @@ struct media::ServiceSkeleton::Private
             object->install_method_handler<mpris::Player::PlayPause>(play_pause);
         }
 
+        ~Exported()
+        {
+            // A large music directory must not hold up shutting down
+            playlist_import_cancelled = true;
+            if (playlist_import.joinable())
+                playlist_import.join();
+        }
+
         inline bool is_multimedia_role()
         {
             MH_TRACE("");
@@ -739,12 +1169,8 @@ struct media::ServiceSkeleton::Private
                     [this](const media::Track::MetaData& metadata)
             {
                 player.properties.meta_data_for_current_track->set(metadata);
-                mpris::Player::Dictionary dict; dict[mpris::Player::Properties::Metadata::name()]
-                        = dbus::types::Variant::encode(metadata);
-                player.signals.properties_changed->emit(std::make_tuple(
-                                dbus::traits::Service<mpris::Player>::interface_name(),
-                                dict,
-                                mpris::Player::Skeleton::the_empty_list_of_invalidated_properties()));
+                player.property_changes->add(mpris::Player::Properties::Metadata::name(),
+                                             dbus::types::Variant::encode(metadata));
             });
 
             // Sync property values between session and player mpris::Player instances
@@ -806,6 +1232,9 @@ struct media::ServiceSkeleton::Private
         mpris::MediaPlayer2::Skeleton media_player;
         mpris::Player::Skeleton player;
         mpris::Playlists::Skeleton playlists;
+        media::PlaylistStore playlist_store;
+        std::atomic<bool> playlist_import_cancelled{false};
+        std::thread playlist_import;
 
         // The CoverArtResolver used by the exported player.
         media::CoverArtResolver cover_art_resolver;
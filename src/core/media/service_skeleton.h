@@ -23,8 +23,11 @@
 
 #include <core/media/service.h>
 
+#include "client_quotas.h"
 #include "cover_art_resolver.h"
+#include "dbus_client_death_observer.h"
 #include "keyed_player_store.h"
+#include "peer_cancellation.h"
 #include "service_traits.h"
 
 #include <core/dbus/skeleton.h>
@@ -47,6 +50,12 @@ public:
         KeyedPlayerStore::Ptr player_store;
         helper::ExternalServices& external_services;
         CoverArtResolver cover_art_resolver;
+        // Limits the sessions a client may create, unlimited if there is none.
+        ClientQuotas::Ptr quotas;
+        // Lets session creation for clients that left the bus be skipped.
+        PeerCancellation::Ptr cancellation;
+        // Learns from the sessions registry which sessions a client that left owned.
+        DBusClientDeathObserver::Ptr client_death_observer;
     };
 
     ServiceSkeleton(const Configuration& configuration);
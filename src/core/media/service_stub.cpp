@@ -20,15 +20,52 @@
 #include "service_traits.h"
 
 #include "player_stub.h"
+#include "session_bootstrap.h"
 #include "the_session_bus.h"
 
 #include "mpris/service.h"
 
 #include "core/media/logger/logger.h"
 
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/variant.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
 
+namespace
+{
+std::shared_ptr<media::Player> player_for(const std::shared_ptr<media::Service>& parent,
+                                          const std::shared_ptr<dbus::Service>& service,
+                                          const media::BootstrappedSession& session)
+{
+    // Stubs of services that predate BootstrapSession ask for the rest themselves
+    if (not session.state)
+        return std::shared_ptr<media::Player>(new media::PlayerStub
+        {
+            parent,
+            service,
+            service->object_for_path(session.path),
+            session.uuid
+        });
+
+    return std::shared_ptr<media::Player>(new media::PlayerStub
+    {
+        parent,
+        service,
+        service->object_for_path(session.path),
+        session.uuid,
+        *session.state
+    });
+}
+}
+
 media::ServiceStub::ServiceStub()
     : core::dbus::Stub<media::Service>(the_session_bus()),
       object(
@@ -77,19 +114,56 @@ media::ServiceStub::~ServiceStub()
 
 std::shared_ptr<media::Player> media::ServiceStub::create_session(const media::Player::Configuration&)
 {
-    const auto op = object->invoke_method_synchronously<mpris::Service::CreateSession,
-         std::tuple<dbus::types::ObjectPath, std::string>>();
+    // A single round trip gets the session along with its key and properties
+    return player_for(shared_from_this(), access_service(), media::bootstrap_session(object));
+}
 
-    if (op.is_error())
-        throw std::runtime_error("Problem creating session: " + op.error());
+std::future<std::shared_ptr<media::Player>> media::ServiceStub::create_session_async(const media::Player::Configuration&)
+{
+    auto promise = std::make_shared<std::promise<std::shared_ptr<media::Player>>>();
+    auto future = promise->get_future();
 
-    return std::shared_ptr<media::Player>(new media::PlayerStub
+    const std::shared_ptr<media::Service> self{shared_from_this()};
+    const auto service = access_service();
+    const auto make = [promise, self, service](const media::BootstrappedSession& session)
     {
-        shared_from_this(),
-        access_service(),
-        access_service()->object_for_path(std::get<0>(op.value())),
-        std::get<1>(op.value())
-    });
+        try
+        {
+            promise->set_value(player_for(self, service, session));
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    };
+
+    try
+    {
+        media::bootstrap_session_async(object, [promise, make](std::exception_ptr error, const media::BootstrappedSession& session)
+        {
+            if (error)
+            {
+                promise->set_exception(error);
+                return;
+            }
+
+            // The stub of an older service asks for its key and properties
+            // over the bus, which must not wait for itself
+            if (not session.state)
+            {
+                std::thread([make, session]() { make(session); }).detach();
+                return;
+            }
+
+            make(session);
+        });
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    return future;
 }
 
 void media::ServiceStub::detach_session(const std::string& uuid,
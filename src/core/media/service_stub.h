@@ -43,6 +43,8 @@ class ServiceStub : public core::dbus::Stub<core::ubuntu::media::Service>
     ~ServiceStub();
 
     std::shared_ptr<Player> create_session(const Player::Configuration&);
+    // Only asks services that know about BootstrapSession
+    std::future<std::shared_ptr<Player>> create_session_async(const Player::Configuration&);
     void detach_session(const std::string& uuid, const Player::Configuration&);
     std::shared_ptr<Player> reattach_session(const std::string& uuid, const Player::Configuration&);
     void destroy_session(const std::string& uuid, const Player::Configuration&);
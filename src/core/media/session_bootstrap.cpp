@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "session_bootstrap.h"
+
+#include "mpris/service.h"
+
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/variant.h>
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+namespace dbus = core::dbus;
+namespace media = core::ubuntu::media;
+
+namespace
+{
+typedef std::map<std::string, dbus::types::Variant> Dictionary;
+typedef std::tuple<dbus::types::ObjectPath, std::string, media::Player::PlayerKey, Dictionary, Dictionary> BootstrapReply;
+typedef std::tuple<dbus::types::ObjectPath, std::string> CreateReply;
+
+bool predates_bootstrap(const dbus::Error& error)
+{
+    return error.name() == "org.freedesktop.DBus.Error.UnknownMethod";
+}
+
+media::BootstrappedSession from(const BootstrapReply& reply)
+{
+    return media::BootstrappedSession
+    {
+        std::get<0>(reply),
+        std::get<1>(reply),
+        std::make_shared<media::PlayerStub::InitialState>(media::PlayerStub::InitialState
+        {
+            std::get<2>(reply),
+            std::get<3>(reply),
+            std::get<4>(reply)
+        })
+    };
+}
+
+media::BootstrappedSession from(const CreateReply& reply)
+{
+    return media::BootstrappedSession{std::get<0>(reply), std::get<1>(reply), nullptr};
+}
+
+template<typename Reply>
+media::BootstrappedSession from_result(const dbus::Result<Reply>& result)
+{
+    if (result.is_error())
+        throw std::runtime_error("Problem creating session: " + result.error().print());
+
+    return from(result.value());
+}
+}
+
+media::BootstrappedSession media::bootstrap_session(const dbus::Object::Ptr& service)
+{
+    const auto bootstrap = service->invoke_method_synchronously<mpris::Service::BootstrapSession,
+         BootstrapReply>();
+
+    if (not bootstrap.is_error() or not predates_bootstrap(bootstrap.error()))
+        return from_result(bootstrap);
+
+    // Services that predate BootstrapSession are asked piece by piece
+    return from_result(service->invoke_method_synchronously<mpris::Service::CreateSession,
+         CreateReply>());
+}
+
+void media::bootstrap_session_async(const dbus::Object::Ptr& service, const BootstrapCallback& done)
+{
+    // Hands done what make returns, or what it throws
+    const auto settle = [done](const std::function<media::BootstrappedSession()>& make)
+    {
+        media::BootstrappedSession session;
+        try
+        {
+            session = make();
+        }
+        catch (...)
+        {
+            done(std::current_exception(), session);
+            return;
+        }
+
+        done(nullptr, session);
+    };
+
+    service->invoke_method_asynchronously_with_callback<mpris::Service::BootstrapSession, BootstrapReply>(
+                [service, settle](const dbus::Result<BootstrapReply>& bootstrap)
+                {
+                    if (not bootstrap.is_error() or not predates_bootstrap(bootstrap.error()))
+                    {
+                        settle([&bootstrap]() { return from_result(bootstrap); });
+                        return;
+                    }
+
+                    // Services that predate BootstrapSession are asked piece by piece
+                    try
+                    {
+                        service->invoke_method_asynchronously_with_callback<mpris::Service::CreateSession, CreateReply>(
+                                    [settle](const dbus::Result<CreateReply>& op)
+                                    {
+                                        settle([&op]() { return from_result(op); });
+                                    });
+                    }
+                    catch (const std::exception& e)
+                    {
+                        const std::string what{e.what()};
+                        settle([what]() -> media::BootstrappedSession { throw std::runtime_error(what); });
+                    }
+                });
+}
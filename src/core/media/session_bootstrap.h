@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_SESSION_BOOTSTRAP_H_
+#define CORE_UBUNTU_MEDIA_SESSION_BOOTSTRAP_H_
+
+#include "player_stub.h"
+
+#include <core/dbus/object.h>
+#include <core/dbus/types/object_path.h>
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// What the service tells about a session it created for a client
+struct BootstrappedSession
+{
+    core::dbus::types::ObjectPath path;
+    std::string uuid;
+    // Only services that know BootstrapSession send the key and the
+    // properties along. Stubs of older ones ask for them on their own.
+    std::shared_ptr<PlayerStub::InitialState> state;
+};
+
+// Creates a session on the service object in a single round trip. Services
+// that predate BootstrapSession are asked with CreateSession instead.
+BootstrappedSession bootstrap_session(const core::dbus::Object::Ptr& service);
+
+// Told about the session, or about the exception bootstrap_session would
+// have thrown, in which case the session is empty
+typedef std::function<void(std::exception_ptr, const BootstrappedSession&)> BootstrapCallback;
+
+// As above, without blocking. Calls done on the bus thread. Throws if the
+// call can't be sent.
+void bootstrap_session_async(const core::dbus::Object::Ptr& service, const BootstrapCallback& done);
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_SESSION_BOOTSTRAP_H_
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "session_registry.h"
+
+namespace media = core::ubuntu::media;
+
+media::SessionRegistry::SessionRegistry()
+    : next_key{0}
+{
+}
+
+media::Player::PlayerKey media::SessionRegistry::allocate_key()
+{
+    return next_key.fetch_add(1);
+}
+
+void media::SessionRegistry::add(media::Player::PlayerKey key, const std::string& uuid, const std::string& name)
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    auto& session = sessions[key];
+    session.uuid = uuid;
+    session.name = name;
+    session.has_owner = false;
+
+    if (not uuid.empty())
+        by_uuid[uuid] = key;
+    if (not name.empty())
+        by_name[name] = key;
+}
+
+void media::SessionRegistry::remove(media::Player::PlayerKey key)
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end())
+        return;
+
+    const auto uuid = by_uuid.find(it->second.uuid);
+    if (uuid != by_uuid.end() and uuid->second == key)
+        by_uuid.erase(uuid);
+
+    const auto name = by_name.find(it->second.name);
+    if (name != by_name.end() and name->second == key)
+        by_name.erase(name);
+
+    unlink_sender(key, it->second);
+    sessions.erase(it);
+}
+
+bool media::SessionRegistry::remove_uuid(const std::string& uuid)
+{
+    std::lock_guard<std::mutex> lg{guard};
+    return by_uuid.erase(uuid) > 0;
+}
+
+bool media::SessionRegistry::key_for_uuid(const std::string& uuid, media::Player::PlayerKey& key) const
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = by_uuid.find(uuid);
+    if (it == by_uuid.end())
+        return false;
+
+    key = it->second;
+    return true;
+}
+
+bool media::SessionRegistry::key_for_name(const std::string& name, media::Player::PlayerKey& key) const
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = by_name.find(name);
+    if (it == by_name.end())
+        return false;
+
+    key = it->second;
+    return true;
+}
+
+void media::SessionRegistry::set_owner(media::Player::PlayerKey key, const Owner& owner)
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end())
+        return;
+
+    unlink_sender(key, it->second);
+    it->second.has_owner = true;
+    it->second.owner = owner;
+    link_sender(key, it->second);
+}
+
+bool media::SessionRegistry::owner(media::Player::PlayerKey key, Owner& owner) const
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end() or not it->second.has_owner)
+        return false;
+
+    owner = it->second.owner;
+    return true;
+}
+
+bool media::SessionRegistry::update_owner(media::Player::PlayerKey key, const std::function<void(Owner&)>& f)
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end() or not it->second.has_owner)
+        return false;
+
+    unlink_sender(key, it->second);
+    f(it->second.owner);
+    link_sender(key, it->second);
+    return true;
+}
+
+bool media::SessionRegistry::remove_owner(media::Player::PlayerKey key)
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end() or not it->second.has_owner)
+        return false;
+
+    unlink_sender(key, it->second);
+    it->second.has_owner = false;
+    it->second.owner = Owner{};
+    return true;
+}
+
+std::vector<media::Player::PlayerKey> media::SessionRegistry::sessions_owned_by(const std::string& sender) const
+{
+    std::lock_guard<std::mutex> lg{guard};
+
+    const auto it = by_sender.find(sender);
+    if (it == by_sender.end())
+        return std::vector<Player::PlayerKey>{};
+
+    return std::vector<Player::PlayerKey>(it->second.begin(), it->second.end());
+}
+
+std::size_t media::SessionRegistry::size() const
+{
+    std::lock_guard<std::mutex> lg{guard};
+    return sessions.size();
+}
+
+void media::SessionRegistry::unlink_sender(media::Player::PlayerKey key, const Session& session)
+{
+    if (not session.has_owner or session.owner.sender.empty())
+        return;
+
+    const auto it = by_sender.find(session.owner.sender);
+    if (it == by_sender.end())
+        return;
+
+    it->second.erase(key);
+    if (it->second.empty())
+        by_sender.erase(it);
+}
+
+void media::SessionRegistry::link_sender(media::Player::PlayerKey key, const Session& session)
+{
+    if (session.has_owner and session.owner.attached and not session.owner.sender.empty())
+        by_sender[session.owner.sender].insert(key);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_SESSION_REGISTRY_H_
+#define CORE_UBUNTU_MEDIA_SESSION_REGISTRY_H_
+
+#include <core/media/player.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Keeps track of the sessions handed out over the bus, indexed by key, uuid,
+// name (for fixed sessions) and the bus name of their owner. All lookups are
+// O(1) and all functions are thread-safe; callbacks passed in are invoked with
+// the registry locked and must not call back into it.
+class SessionRegistry
+{
+public:
+    struct Owner
+    {
+        // The apparmor context of the app that created the session.
+        std::string context;
+        // Whether the session is attached to a client.
+        bool attached;
+        // The unique bus name of the attached client, empty if detached.
+        std::string sender;
+    };
+
+    SessionRegistry();
+
+    SessionRegistry(const SessionRegistry&) = delete;
+    SessionRegistry& operator=(const SessionRegistry&) = delete;
+
+    // Hands out a key that was never handed out before.
+    Player::PlayerKey allocate_key();
+
+    // Registers the session known by uuid, or by name if it is a fixed one.
+    // Either of them may be empty.
+    void add(Player::PlayerKey key, const std::string& uuid, const std::string& name = std::string{});
+    // Forgets the session and everything known about it, including its owner.
+    void remove(Player::PlayerKey key);
+    // Stops resolving uuid to the session, leaving the rest in place.
+    bool remove_uuid(const std::string& uuid);
+
+    bool key_for_uuid(const std::string& uuid, Player::PlayerKey& key) const;
+    bool key_for_name(const std::string& name, Player::PlayerKey& key) const;
+
+    void set_owner(Player::PlayerKey key, const Owner& owner);
+    bool owner(Player::PlayerKey key, Owner& owner) const;
+    // Lets f modify the owner of the session in place, returns false if the
+    // session has no owner.
+    bool update_owner(Player::PlayerKey key, const std::function<void(Owner&)>& f);
+    // Drops the owner of the session, returns false if it had none.
+    bool remove_owner(Player::PlayerKey key);
+    // All sessions currently attached to the given bus name.
+    std::vector<Player::PlayerKey> sessions_owned_by(const std::string& sender) const;
+
+    std::size_t size() const;
+
+private:
+    struct Session
+    {
+        std::string uuid;
+        std::string name;
+        bool has_owner;
+        Owner owner;
+    };
+
+    void unlink_sender(Player::PlayerKey key, const Session& session);
+    void link_sender(Player::PlayerKey key, const Session& session);
+
+    std::atomic<Player::PlayerKey> next_key;
+
+    mutable std::mutex guard;
+    std::unordered_map<Player::PlayerKey, Session> sessions;
+    std::unordered_map<std::string, Player::PlayerKey> by_uuid;
+    std::unordered_map<std::string, Player::PlayerKey> by_name;
+    std::unordered_map<std::string, std::unordered_set<Player::PlayerKey>> by_sender;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_SESSION_REGISTRY_H_
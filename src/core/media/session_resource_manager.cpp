@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "session_resource_manager.h"
+
+#include "core/media/logger/logger.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+media::SessionResourceManager::Configuration media::SessionResourceManager::Configuration::from_environment()
+{
+    Configuration configuration;
+
+    if (const char *timeout = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_PIPELINE_IDLE_TIMEOUT"))
+        configuration.idle_timeout = std::chrono::seconds{std::strtoul(timeout, nullptr, 10)};
+
+    if (const char *max_pipelines = ::getenv("CORE_UBUNTU_MEDIA_SERVICE_MAX_PIPELINES"))
+        configuration.max_pipelines = std::strtoul(max_pipelines, nullptr, 10);
+
+    return configuration;
+}
+
+media::SessionResourceManager::SessionResourceManager(const Configuration& configuration)
+    : config(configuration)
+{
+}
+
+const media::SessionResourceManager::Configuration& media::SessionResourceManager::configuration() const
+{
+    return config;
+}
+
+void media::SessionResourceManager::add_session(Player::PlayerKey key,
+                                                const std::weak_ptr<void>& owner,
+                                                const ReleaseFunction& release)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    // Keys of sessions that are gone get reused
+    const auto it = sessions.find(key);
+    if (it != sessions.end() and it->second.loaded)
+        lru.erase(it->second.lru_position);
+
+    Session session;
+    session.owner = owner;
+    session.release = release;
+    // A new session has no pipeline loaded before it plays for the first time
+    session.loaded = false;
+    session.active = false;
+    session.lru_position = lru.end();
+    sessions[key] = session;
+}
+
+void media::SessionResourceManager::remove_session(Player::PlayerKey key)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end())
+        return;
+
+    if (it->second.loaded)
+        lru.erase(it->second.lru_position);
+    sessions.erase(it);
+}
+
+void media::SessionResourceManager::touch(Session& session,
+                                          Player::PlayerKey key,
+                                          const Clock::time_point& now)
+{
+    if (session.loaded)
+        lru.erase(session.lru_position);
+
+    session.loaded = true;
+    session.last_used = now;
+    session.lru_position = lru.insert(lru.end(), key);
+}
+
+bool media::SessionResourceManager::on_session_active(Player::PlayerKey key, const Clock::time_point& now)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end())
+        return false;
+
+    it->second.active = true;
+    touch(it->second, key, now);
+
+    return lru.size() > config.max_pipelines;
+}
+
+void media::SessionResourceManager::on_session_idle(Player::PlayerKey key, const Clock::time_point& now)
+{
+    std::lock_guard<std::mutex> lg(guard);
+
+    const auto it = sessions.find(key);
+    if (it == sessions.end())
+        return;
+
+    it->second.active = false;
+    touch(it->second, key, now);
+}
+
+std::size_t media::SessionResourceManager::enforce(const Clock::time_point& now)
+{
+    std::vector<std::pair<Player::PlayerKey, ReleaseFunction>> victims;
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        // Least recently used sessions come first
+        for (auto it = lru.begin(); it != lru.end();)
+        {
+            const Player::PlayerKey key = *it;
+            Session& session = sessions.at(key);
+
+            if (session.owner.expired())
+            {
+                it = lru.erase(it);
+                sessions.erase(key);
+                continue;
+            }
+
+            const bool idle_for_too_long = now - session.last_used >= config.idle_timeout;
+            if (session.active or not (idle_for_too_long or lru.size() > config.max_pipelines))
+            {
+                ++it;
+                continue;
+            }
+
+            // Should the release fail because the session just started playing again,
+            // on_session_active has marked it as loaded in the meantime
+            victims.push_back(std::make_pair(key, session.release));
+            session.loaded = false;
+            it = lru.erase(it);
+        }
+    }
+
+    // Releasing tears down a pipeline, which must not happen with the lock held
+    std::size_t released = 0;
+    for (const auto& victim : victims)
+    {
+        if (victim.second())
+        {
+            MH_DEBUG("Released the pipeline of idle session %d", victim.first);
+            ++released;
+        }
+    }
+
+    return released;
+}
+
+std::size_t media::SessionResourceManager::loaded_pipelines() const
+{
+    std::lock_guard<std::mutex> lg(guard);
+    return lru.size();
+}
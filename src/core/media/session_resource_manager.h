@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_SESSION_RESOURCE_MANAGER_H_
+#define CORE_UBUNTU_MEDIA_SESSION_RESOURCE_MANAGER_H_
+
+#include <core/media/player.h>
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Decides which sessions get to keep their pipeline. A session that has not
+// been playing for longer than the idle timeout loses it, and so does the
+// least recently used idle session once more pipelines than the budget
+// allows are loaded. Releasing is left to the session, which is expected to
+// bring its pipeline back by itself the next time it plays.
+class SessionResourceManager
+{
+public:
+    typedef std::shared_ptr<SessionResourceManager> Ptr;
+    typedef std::chrono::steady_clock Clock;
+    // Returns true if the pipeline of the session was actually released.
+    typedef std::function<bool()> ReleaseFunction;
+
+    struct Configuration
+    {
+        // Idle sessions keep their pipeline for at most this long.
+        std::chrono::milliseconds idle_timeout{std::chrono::minutes{5}};
+        // Number of loaded pipelines above which idle ones are released right away.
+        std::size_t max_pipelines{8};
+
+        // Reads CORE_UBUNTU_MEDIA_SERVICE_PIPELINE_IDLE_TIMEOUT (seconds) and
+        // CORE_UBUNTU_MEDIA_SERVICE_MAX_PIPELINES, falling back to the defaults.
+        static Configuration from_environment();
+    };
+
+    explicit SessionResourceManager(const Configuration& configuration);
+
+    SessionResourceManager(const SessionResourceManager&) = delete;
+    SessionResourceManager& operator=(const SessionResourceManager&) = delete;
+
+    const Configuration& configuration() const;
+
+    // The session is forgotten about once owner is gone.
+    void add_session(Player::PlayerKey key, const std::weak_ptr<void>& owner, const ReleaseFunction& release);
+    void remove_session(Player::PlayerKey key);
+
+    // The session started playing and holds a pipeline that must not be released.
+    // Returns true if that puts the loaded pipelines over budget, in which case
+    // enforce() should be called soon. It is not called right away as the caller
+    // is usually still busy bringing up the pipeline of the session.
+    bool on_session_active(Player::PlayerKey key, const Clock::time_point& now = Clock::now());
+    // The session stopped playing but still holds a pipeline, idle from now on.
+    void on_session_idle(Player::PlayerKey key, const Clock::time_point& now = Clock::now());
+
+    // Releases the pipelines of idle sessions as mandated by idle timeout and
+    // budget. Returns the number of pipelines released.
+    std::size_t enforce(const Clock::time_point& now = Clock::now());
+
+    // Number of sessions currently holding a pipeline.
+    std::size_t loaded_pipelines() const;
+
+private:
+    struct Session
+    {
+        std::weak_ptr<void> owner;
+        ReleaseFunction release;
+        bool loaded;
+        bool active;
+        Clock::time_point last_used;
+        // Position in lru if loaded, most recently used at the back
+        std::list<Player::PlayerKey>::iterator lru_position;
+    };
+
+    void touch(Session& session, Player::PlayerKey key, const Clock::time_point& now);
+
+    Configuration config;
+    mutable std::mutex guard;
+    std::unordered_map<Player::PlayerKey, Session> sessions;
+    std::list<Player::PlayerKey> lru;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_SESSION_RESOURCE_MANAGER_H_
@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "session_teardown.h"
+
+#include "core/media/logger/logger.h"
+
+#include <stdexcept>
+
+namespace media = core::ubuntu::media;
+
+std::vector<media::Player::PlayerKey> media::sessions_to_tear_down(media::SessionRegistry& sessions,
+                                                                   const media::KeyedPlayerStore& players,
+                                                                   const std::string& sender)
+{
+    std::vector<media::Player::PlayerKey> keys;
+    for (const auto key : sessions.sessions_owned_by(sender))
+    {
+        std::shared_ptr<media::Player> player;
+        try {
+            player = players.player_for_key(key);
+        }
+        catch (const std::out_of_range&) {
+            // Already gone
+            sessions.remove(key);
+            continue;
+        }
+
+        if (player->lifetime() == media::Player::Lifetime::resumable)
+        {
+            MH_DEBUG("Detaching resumable session %d of %s, which left the bus", key, sender);
+            sessions.update_owner(key, [](media::SessionRegistry::Owner& owner)
+            {
+                owner.attached = false;
+                owner.sender.clear();
+            });
+            continue;
+        }
+
+        sessions.remove(key);
+        keys.push_back(key);
+    }
+
+    return keys;
+}
+
+bool media::reclaim_session(media::KeyedPlayerStore& players, const media::Player::PlayerKey& key)
+{
+    if (!players.has_player_for_key(key))
+        return true;
+
+    try {
+        if (players.player_for_key(key)->lifetime() != media::Player::Lifetime::normal)
+            return false;
+
+        players.remove_player_for_key(key);
+    }
+    catch (const std::out_of_range &e) {
+        MH_WARNING("Failed to look up Player instance for key %d"
+            ", no valid Player instance for that key value. Removal of Player from Player store"
+            " might not have completed. This most likely means that media-hub-server has"
+            " crashed and restarted.", key);
+    }
+
+    return true;
+}
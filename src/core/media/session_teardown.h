@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_SESSION_TEARDOWN_H_
+#define CORE_UBUNTU_MEDIA_SESSION_TEARDOWN_H_
+
+#include <core/media/player.h>
+
+#include "keyed_player_store.h"
+#include "session_registry.h"
+
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Forgets about the sessions the client with the given bus name was attached
+// to, returning the ones to tear down. Resumable sessions are detached
+// instead, waiting for their owner to come back.
+std::vector<Player::PlayerKey> sessions_to_tear_down(SessionRegistry& sessions,
+                                                     const KeyedPlayerStore& players,
+                                                     const std::string& sender);
+
+// Drops the player of a session whose client is gone from the store, which
+// releases its pipeline. Resumable sessions are kept. Returns true if the
+// session is gone for good.
+bool reclaim_session(KeyedPlayerStore& players, const Player::PlayerKey& key);
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_SESSION_TEARDOWN_H_
@@ -0,0 +1,283 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "status_page.h"
+
+#include "core/media/logger/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+// Linux 5.1 and later, older kernels refuse it
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+namespace media = core::ubuntu::media;
+
+// What is actually in the page. Only ever grows at the end, readers check
+// the version before looking at anything else.
+struct media::StatusPage::Layout
+{
+    static constexpr std::uint32_t the_magic = 0x4d485350; // "MHSP"
+    static constexpr std::uint32_t the_version = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    // Odd while a write is under way
+    std::atomic<std::uint32_t> sequence;
+
+    std::atomic<std::int32_t> playback_status;
+    std::atomic<std::int64_t> position;
+    std::atomic<std::int64_t> anchor;
+    std::atomic<double> rate;
+    std::atomic<std::int64_t> duration;
+    std::atomic<double> volume;
+    std::atomic<std::uint64_t> metadata_generation;
+};
+
+// A field that needs a lock can't be shared with other processes, the lock
+// would only exist in the one that took it. C++11 has no is_always_lock_free,
+// so ask the compiler directly.
+static_assert(__atomic_always_lock_free(sizeof(std::uint32_t), 0), "32 bit atomics have to be lock free");
+static_assert(__atomic_always_lock_free(sizeof(std::int64_t), 0), "64 bit atomics have to be lock free");
+static_assert(__atomic_always_lock_free(sizeof(double), 0), "atomic doubles have to be lock free");
+
+namespace
+{
+// Enough to outlast any write, which only takes a handful of stores
+constexpr int max_read_attempts = 1000;
+
+std::size_t page_size()
+{
+    return std::max<std::size_t>(::sysconf(_SC_PAGESIZE), sizeof(media::StatusPage::Layout));
+}
+
+int create_memfd(const std::string& name)
+{
+#ifdef SYS_memfd_create
+    return ::syscall(SYS_memfd_create, name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    (void) name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+}
+
+std::int64_t media::StatusPage::Snapshot::position_at(std::int64_t now) const
+{
+    if (playback_status != Player::PlaybackStatus::playing or now <= anchor)
+        return position;
+
+    const std::int64_t extrapolated = position + static_cast<std::int64_t>((now - anchor) * rate);
+    return duration > 0 ? std::min(extrapolated, duration) : extrapolated;
+}
+
+std::int64_t media::StatusPage::now()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+media::StatusPageWriter::Ptr media::StatusPageWriter::create(const std::string& name)
+{
+    const int fd = create_memfd(name);
+    if (fd < 0)
+        return Ptr{};
+
+    if (::ftruncate(fd, page_size()) < 0)
+    {
+        ::close(fd);
+        return Ptr{};
+    }
+
+    // The only writable mapping there will ever be, it has to exist before
+    // the page gets sealed against writes
+    void* mapping = ::mmap(nullptr, page_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        ::close(fd);
+        return Ptr{};
+    }
+
+    // Nobody gets to pull the page out from under a mapping, nor to write to
+    // it, not even through a descriptor reopened from /proc.
+    if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) < 0)
+    {
+        // Kernels before 5.1 don't know about F_SEAL_FUTURE_WRITE. Clients
+        // still only get a read only descriptor, but one that reopens it from
+        // /proc could write to the page and mislead other readers of it.
+        if (errno != EINVAL or ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+        {
+            ::munmap(mapping, page_size());
+            ::close(fd);
+            return Ptr{};
+        }
+
+        MH_WARNING("Status page %s can't be sealed against writes, this needs Linux 5.1 or later", name);
+    }
+
+    // Handing out a read only descriptor on top keeps clients from even trying
+    const std::string path{"/proc/self/fd/" + std::to_string(fd)};
+    const int read_only_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (read_only_fd < 0)
+    {
+        ::munmap(mapping, page_size());
+        ::close(fd);
+        return Ptr{};
+    }
+
+    auto layout = new (mapping) StatusPage::Layout;
+    layout->magic = StatusPage::Layout::the_magic;
+    layout->version = StatusPage::Layout::the_version;
+    layout->sequence.store(0, std::memory_order_relaxed);
+
+    Ptr writer{new StatusPageWriter{fd, read_only_fd, layout}};
+    writer->update([](StatusPage::Snapshot& snapshot) { snapshot.anchor = StatusPage::now(); });
+    return writer;
+}
+
+media::StatusPageWriter::StatusPageWriter(int fd, int read_only_fd, StatusPage::Layout* layout)
+    : rw_fd(fd),
+      ro_fd(read_only_fd),
+      layout(layout)
+{
+}
+
+media::StatusPageWriter::~StatusPageWriter()
+{
+    layout->~Layout();
+    ::munmap(layout, page_size());
+    ::close(ro_fd);
+    ::close(rw_fd);
+}
+
+int media::StatusPageWriter::fd() const
+{
+    return ro_fd;
+}
+
+void media::StatusPageWriter::update(const std::function<void(StatusPage::Snapshot&)>& change)
+{
+    std::lock_guard<std::mutex> lg(guard);
+    change(current);
+
+    const auto sequence = layout->sequence.load(std::memory_order_relaxed);
+    layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    layout->playback_status.store(current.playback_status, std::memory_order_relaxed);
+    layout->position.store(current.position, std::memory_order_relaxed);
+    layout->anchor.store(current.anchor, std::memory_order_relaxed);
+    layout->rate.store(current.rate, std::memory_order_relaxed);
+    layout->duration.store(current.duration, std::memory_order_relaxed);
+    layout->volume.store(current.volume, std::memory_order_relaxed);
+    layout->metadata_generation.store(current.metadata_generation, std::memory_order_relaxed);
+
+    layout->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+media::StatusPage::Snapshot media::StatusPageWriter::snapshot() const
+{
+    std::lock_guard<std::mutex> lg(guard);
+    return current;
+}
+
+media::StatusPageReader::Ptr media::StatusPageReader::map(int fd)
+{
+    struct stat st;
+    if (::fstat(fd, &st) < 0 or static_cast<std::size_t>(st.st_size) < sizeof(StatusPage::Layout))
+        return Ptr{};
+
+    void* mapping = ::mmap(nullptr, page_size(), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+        return Ptr{};
+
+    const auto layout = static_cast<const StatusPage::Layout*>(mapping);
+    if (layout->magic != StatusPage::Layout::the_magic or layout->version != StatusPage::Layout::the_version)
+    {
+        ::munmap(mapping, page_size());
+        return Ptr{};
+    }
+
+    return Ptr{new StatusPageReader{layout}};
+}
+
+media::StatusPageReader::StatusPageReader(const StatusPage::Layout* layout)
+    : layout(layout)
+{
+}
+
+media::StatusPageReader::~StatusPageReader()
+{
+    ::munmap(const_cast<StatusPage::Layout*>(layout), page_size());
+}
+
+bool media::StatusPageReader::read(StatusPage::Snapshot& snapshot) const
+{
+    for (int attempt = 0; attempt < max_read_attempts; attempt++)
+    {
+        const auto before = layout->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        StatusPage::Snapshot copy;
+        copy.playback_status = static_cast<Player::PlaybackStatus>(layout->playback_status.load(std::memory_order_relaxed));
+        copy.position = layout->position.load(std::memory_order_relaxed);
+        copy.anchor = layout->anchor.load(std::memory_order_relaxed);
+        copy.rate = layout->rate.load(std::memory_order_relaxed);
+        copy.duration = layout->duration.load(std::memory_order_relaxed);
+        copy.volume = layout->volume.load(std::memory_order_relaxed);
+        copy.metadata_generation = layout->metadata_generation.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (layout->sequence.load(std::memory_order_relaxed) == before)
+        {
+            snapshot = copy;
+            return true;
+        }
+    }
+
+    return false;
+}
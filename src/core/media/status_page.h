@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef CORE_UBUNTU_MEDIA_STATUS_PAGE_H_
+#define CORE_UBUNTU_MEDIA_STATUS_PAGE_H_
+
+#include <core/media/player.h>
+
+#include "cached_remote_property.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// A page of shared memory a session publishes its playback state on. The
+// service writes it under a seqlock, clients map it read-only and answer
+// reads of the position and friends without going to the service.
+struct StatusPage
+{
+    struct Snapshot
+    {
+        Player::PlaybackStatus playback_status{Player::PlaybackStatus::null};
+        // In nanoseconds, as of anchor
+        std::int64_t position{0};
+        // Monotonic time in nanoseconds the position was sampled at
+        std::int64_t anchor{0};
+        Player::PlaybackRate rate{1.};
+        std::int64_t duration{0};
+        Player::Volume volume{0.};
+        // Bumped whenever the metadata of the current track changes
+        std::uint64_t metadata_generation{0};
+
+        // The position moved along with the clock while playing, never past
+        // the end of the track.
+        std::int64_t position_at(std::int64_t now) const;
+    };
+
+    StatusPage() = delete;
+
+    // The monotonic clock anchors are taken with, shared by all processes.
+    static std::int64_t now();
+
+    struct Layout;
+};
+
+class StatusPageWriter
+{
+public:
+    typedef std::shared_ptr<StatusPageWriter> Ptr;
+
+    // Returns nullptr if the page can't be set up, e.g. for lack of memfd
+    // support in the kernel.
+    static Ptr create(const std::string& name);
+    ~StatusPageWriter();
+
+    StatusPageWriter(const StatusPageWriter&) = delete;
+    StatusPageWriter& operator=(const StatusPageWriter&) = delete;
+
+    // A read-only descriptor of the page, to be handed out to clients. The
+    // page is only sealed against writes from Linux 5.1 on, before that a
+    // client reopening the descriptor from /proc can write to it.
+    int fd() const;
+
+    // Changes what is published, readers either see all of the changes or none.
+    void update(const std::function<void(StatusPage::Snapshot&)>& change);
+    StatusPage::Snapshot snapshot() const;
+
+private:
+    StatusPageWriter(int fd, int read_only_fd, StatusPage::Layout* layout);
+
+    int rw_fd;
+    int ro_fd;
+    StatusPage::Layout* layout;
+
+    mutable std::mutex guard;
+    StatusPage::Snapshot current;
+};
+
+class StatusPageReader
+{
+public:
+    typedef std::shared_ptr<StatusPageReader> Ptr;
+
+    // Returns nullptr if fd doesn't hold a page we understand. The
+    // descriptor may be closed right after.
+    static Ptr map(int fd);
+    ~StatusPageReader();
+
+    StatusPageReader(const StatusPageReader&) = delete;
+    StatusPageReader& operator=(const StatusPageReader&) = delete;
+
+    // Retries while a write is under way, returns false if the writer keeps
+    // the page busy for too long.
+    bool read(StatusPage::Snapshot& snapshot) const;
+
+private:
+    explicit StatusPageReader(const StatusPage::Layout* layout);
+
+    const StatusPage::Layout* layout;
+};
+
+// Answers reads from the status page of a session once there is one, and
+// from fallback until then or if the page can't be read. Changes of fallback
+// are announced as changes of this property.
+template<typename T>
+class StatusPageProperty : public core::Property<T>
+{
+public:
+    typedef std::shared_ptr<StatusPageProperty<T>> Ptr;
+    typedef std::function<StatusPageReader::Ptr()> PageAccess;
+    typedef std::function<T(const StatusPage::Snapshot&)> Extract;
+
+    StatusPageProperty(const PageAccess& page,
+                       const Extract& extract,
+                       const std::shared_ptr<core::Property<T>>& fallback)
+        : page(page),
+          extract(extract),
+          fallback(fallback),
+          value(),
+          connection(fallback->changed().connect([this](const T& t)
+          {
+              // Reads don't touch the value kept by the base, so it holds
+              // the last value announced and a change is never swallowed
+              core::Property<T>::set(t);
+          }))
+    {
+    }
+
+    StatusPageProperty(const StatusPageProperty&) = delete;
+    StatusPageProperty& operator=(const StatusPageProperty&) = delete;
+
+    const T& get() const override
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        StatusPage::Snapshot snapshot;
+        const auto reader = page();
+        if (reader and reader->read(snapshot))
+        {
+            ++RemotePropertyStatistics::instance().answered_locally;
+            value = extract(snapshot);
+        }
+        else
+        {
+            value = fallback->get();
+        }
+
+        return value;
+    }
+
+    void set(const T& t) override
+    {
+        fallback->set(t);
+    }
+
+private:
+    PageAccess page;
+    Extract extract;
+    std::shared_ptr<core::Property<T>> fallback;
+
+    mutable std::mutex guard;
+    mutable T value;
+
+    // Declared last, so that no change comes in while the rest is torn down
+    core::ScopedConnection connection;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_STATUS_PAGE_H_
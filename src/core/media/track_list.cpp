@@ -18,6 +18,8 @@
 
 #include <core/media/track_list.h>
 
+#include "async_call.h"
+
 namespace media = core::ubuntu::media;
 
 media::TrackList::Errors::InsufficientPermissionsToAddTrack::InsufficientPermissionsToAddTrack()
@@ -47,6 +49,11 @@ media::TrackList::Errors::TrackNotFound::TrackNotFound()
 {
 }
 
+media::TrackList::Errors::QuotaExceeded::QuotaExceeded(const std::string& e)
+    : std::runtime_error{e}
+{
+}
+
 const media::Track::Id& media::TrackList::after_empty_track()
 {
     static const media::Track::Id id{"/org/mpris/MediaPlayer2/TrackList/NoTrack"};
@@ -70,3 +77,49 @@ bool media::TrackList::has_previous() const
 {
     return false;
 }
+
+// See Player::open_uri_async() for why these complete right away
+std::future<media::Track::MetaData> media::TrackList::query_meta_data_for_track_async(const Track::Id& id)
+{
+    return media::complete_now<media::Track::MetaData>([this, &id]() { return query_meta_data_for_track(id); });
+}
+
+std::future<media::Track::UriType> media::TrackList::query_uri_for_track_async(const Track::Id& id)
+{
+    return media::complete_now<media::Track::UriType>([this, &id]() { return query_uri_for_track(id); });
+}
+
+std::future<void> media::TrackList::add_track_with_uri_at_async(const Track::UriType& uri,
+                                                                const Track::Id& position,
+                                                                bool make_current)
+{
+    return media::complete_now_void([this, &uri, &position, make_current]()
+    {
+        add_track_with_uri_at(uri, position, make_current);
+    });
+}
+
+std::future<void> media::TrackList::add_tracks_with_uri_at_async(const ContainerURI& uris, const Track::Id& position)
+{
+    return media::complete_now_void([this, &uris, &position]() { add_tracks_with_uri_at(uris, position); });
+}
+
+std::future<bool> media::TrackList::move_track_async(const Track::Id& id, const Track::Id& to)
+{
+    return media::complete_now<bool>([this, &id, &to]() { return move_track(id, to); });
+}
+
+std::future<void> media::TrackList::remove_track_async(const Track::Id& id)
+{
+    return media::complete_now_void([this, &id]() { remove_track(id); });
+}
+
+std::future<void> media::TrackList::go_to_async(const Track::Id& track)
+{
+    return media::complete_now_void([this, &track]() { go_to(track); });
+}
+
+std::future<void> media::TrackList::reset_async()
+{
+    return media::complete_now_void([this]() { reset(); });
+}
@@ -17,6 +17,10 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
 #include <random>
 #include <sstream>
 #include <stdio.h>
@@ -37,19 +41,46 @@ namespace media = core::ubuntu::media;
 
 struct media::TrackListImplementation::Private
 {
-    typedef std::map<Track::Id, std::tuple<Track::UriType, Track::MetaData>> MetaDataCache;
+    typedef media::TrackListJournal::MetaDataCache MetaDataCache;
+
+    Private(const dbus::Object::Ptr& object,
+            const std::shared_ptr<media::Engine::MetaDataExtractor>& extractor)
+        : object(object),
+          track_counter(0),
+          extractor(extractor),
+          shuffle(false),
+          position(0)
+    {
+    }
+
+    Track::Id next_track_id()
+    {
+        std::stringstream ss;
+        ss << object->path().as_string() << "/" << track_counter++;
+        return Track::Id{ss.str()};
+    }
 
     dbus::Object::Ptr object;
+    // Only modified with the writer lane held
     size_t track_counter;
+    // Lookups don't take the writer lane, so that the about-to-finish path never
+    // waits for an edit of the TrackList to finish
+    std::mutex meta_data_guard;
     MetaDataCache meta_data_cache;
     std::shared_ptr<media::Engine::MetaDataExtractor> extractor;
-    // Used for caching the original tracklist order to be used to restore the order
-    // to the live TrackList after shuffle is turned off
-    media::TrackList::Container shuffled_tracks;
-    bool shuffle;
+    // The shuffled playback order, computed on the fly from a seed so that no
+    // copy of the TrackList is needed and the order can be restored later on
+    media::ShufflePermutation shuffle_order;
+    std::atomic<bool> shuffle;
+    // Journaling happens with the writer lane held, so that records are in the same
+    // order as the edits they describe
+    media::TrackListJournal::Ptr journal;
+    media::Track::Id journaled_current;
+    std::chrono::microseconds position;
 
     void updateCachedTrackMetadata(const media::Track::Id& id, const media::Track::UriType& uri)
     {
+        std::lock_guard<std::mutex> lg(meta_data_guard);
         if (meta_data_cache.count(id) == 0)
         {
             // FIXME: This code seems to conflict badly when called multiple times in a row: causes segfaults
@@ -71,19 +102,6 @@ struct media::TrackListImplementation::Private
             std::get<0>(meta_data_cache[id]) = uri;
         }
     }
-
-    media::TrackList::Container::iterator get_shuffled_insert_it()
-    {
-        media::TrackList::Container::iterator random_it = shuffled_tracks.begin();
-        if (random_it == shuffled_tracks.end())
-            return random_it;
-
-        // This is slightly biased, but not much, as RAND_MAX >= 32767, which is
-        // much more than the average number of tracks.
-        // Note that for N tracks we have N + 1 possible insertion positions.
-        std::advance(random_it, rand() % (shuffled_tracks.size() + 1));
-        return random_it;
-    }
 };
 
 media::TrackListImplementation::TrackListImplementation(
@@ -91,10 +109,13 @@ media::TrackListImplementation::TrackListImplementation(
         const dbus::Object::Ptr& object,
         const std::shared_ptr<media::Engine::MetaDataExtractor>& extractor,
         const media::apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-        const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator)
-    : media::TrackListSkeleton(bus, object, request_context_resolver, request_authenticator),
-      d(new Private{object, 0, Private::MetaDataCache{},
-                    extractor, media::TrackList::Container{}, false})
+        const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+        const media::SerialQueue::Ptr& dispatch_queue,
+        const media::ClientQuotas::Ptr& quotas,
+        const media::PeerCancellation::Ptr& cancellation)
+    : media::TrackListSkeleton(bus, object, request_context_resolver, request_authenticator, dispatch_queue, quotas,
+                               cancellation),
+      d(new Private(object, extractor))
 {
     can_edit_tracks().set(true);
 }
@@ -105,6 +126,7 @@ media::TrackListImplementation::~TrackListImplementation()
 
 media::Track::UriType media::TrackListImplementation::query_uri_for_track(const media::Track::Id& id)
 {
+    std::lock_guard<std::mutex> lg(d->meta_data_guard);
     const auto it = d->meta_data_cache.find(id);
 
     if (it == d->meta_data_cache.end())
@@ -115,6 +137,7 @@ media::Track::UriType media::TrackListImplementation::query_uri_for_track(const
 
 media::Track::MetaData media::TrackListImplementation::query_meta_data_for_track(const media::Track::Id& id)
 {
+    std::lock_guard<std::mutex> lg(d->meta_data_guard);
     const auto it = d->meta_data_cache.find(id);
 
     if (it == d->meta_data_cache.end())
@@ -130,37 +153,42 @@ void media::TrackListImplementation::add_track_with_uri_at(
 {
     MH_TRACE("");
 
-    std::stringstream ss;
-    ss << d->object->path().as_string() << "/" << d->track_counter++;
-    Track::Id id{ss.str()};
+    Track::Id id;
+    bool result = false;
+    bool first_track = false;
+    {
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
 
-    MH_DEBUG("Adding Track::Id: %s", id);
-    MH_DEBUG("\tURI: %s", uri);
+        id = d->next_track_id();
 
-    const auto current = get_current_track();
+        MH_DEBUG("Adding Track::Id: %s", id);
+        MH_DEBUG("\tURI: %s", uri);
 
-    auto result = tracks().update([this, id, position, make_current](TrackList::Container& container)
-    {
-        auto it = std::find(container.begin(), container.end(), position);
-        container.insert(it, id);
+        const auto current = get_current_track();
 
-        return true;
-    });
+        result = tracks().update([id, position](TrackList::Container& container)
+        {
+            auto it = std::find(container.begin(), container.end(), position);
+            container.insert(it, id);
 
-    if (result)
-    {
-        d->updateCachedTrackMetadata(id, uri);
+            return true;
+        });
 
-        if (d->shuffle)
-            d->shuffled_tracks.insert(d->get_shuffled_insert_it(), id);
+        if (result)
+        {
+            d->updateCachedTrackMetadata(id, uri);
+            if (d->journal)
+                d->journal->tracks_inserted(position, TrackList::Container{id}, ContainerURI{uri});
+            set_current_track(make_current ? id : current);
+            first_track = tracks().get().size() == 1;
+            publish_snapshot();
+        }
+    }
 
+    if (result)
+    {
         if (make_current)
-        {
-            set_current_track(id);
             go_to(id);
-        } else {
-            set_current_track(current);
-        }
 
         MH_DEBUG("Signaling that we just added track id: %s", id);
         // Signal to the client that a track was added to the TrackList
@@ -168,7 +196,7 @@ void media::TrackListImplementation::add_track_with_uri_at(
 
         // Signal to the client that the current track has changed for the first
         // track added to the TrackList
-        if (tracks().get().size() == 1)
+        if (first_track)
             on_track_changed()(id);
     }
 }
@@ -177,49 +205,44 @@ void media::TrackListImplementation::add_tracks_with_uri_at(const ContainerURI&
 {
     MH_TRACE("");
 
-    const auto current = get_current_track();
-
     Track::Id current_id;
     ContainerURI tmp;
-    for (const auto uri : uris)
     {
-        // TODO: Refactor this code to use a smaller common function shared with add_track_with_uri_at()
-        std::stringstream ss;
-        ss << d->object->path().as_string() << "/" << d->track_counter++;
-        Track::Id id{ss.str()};
-        MH_DEBUG("Adding Track::Id: %s", id);
-        MH_DEBUG("\tURI: %s", uri);
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
 
-        tmp.push_back(id);
+        const auto current = get_current_track();
 
-        Track::Id insert_position = position;
+        for (const auto& uri : uris)
+        {
+            const Track::Id id = d->next_track_id();
+            MH_DEBUG("Adding Track::Id: %s", id);
+            MH_DEBUG("\tURI: %s", uri);
+
+            tmp.push_back(id);
+            d->updateCachedTrackMetadata(id, uri);
+        }
 
-        auto it = std::find(tracks().get().begin(), tracks().get().end(), insert_position);
-        const auto result = tracks().update([this, id, position, it, &insert_position](TrackList::Container& container)
+        // All tracks go in with a single update, in the order they were passed in
+        const bool was_empty = tracks().get().empty();
+        const auto result = tracks().update([&tmp, position](TrackList::Container& container)
         {
-            container.insert(it, id);
-            // Make sure the next insert position is after the current insert position
-            // Update the Track::Id after which to insert the next one from uris
-            insert_position = id;
+            auto it = std::find(container.begin(), container.end(), position);
+            container.insert(it, tmp.begin(), tmp.end());
 
             return true;
         });
 
-        if (result)
-        {
-            d->updateCachedTrackMetadata(id, uri);
+        // Signal to the client that the current track has changed for the first track added to the TrackList
+        if (result and was_empty and not tmp.empty())
+            current_id = tmp.front();
 
-            if (d->shuffle)
-                d->shuffled_tracks.insert(d->get_shuffled_insert_it(), id);
+        if (result and d->journal)
+            d->journal->tracks_inserted(position, tmp, uris);
 
-            // Signal to the client that the current track has changed for the first track added to the TrackList
-            if (tracks().get().size() == 1)
-                current_id = id;
-        }
+        set_current_track(current);
+        publish_snapshot();
     }
 
-    set_current_track(current);
-
     MH_DEBUG("Signaling that we just added %d tracks to the TrackList", tmp.size());
     on_tracks_added()(tmp);
 
@@ -227,6 +250,71 @@ void media::TrackListImplementation::add_tracks_with_uri_at(const ContainerURI&
         on_track_changed()(current_id);
 }
 
+void media::TrackListImplementation::replace_tracks(const ContainerURI& uris,
+                                                    std::size_t current,
+                                                    const std::chrono::microseconds& position)
+{
+    MH_TRACE("");
+
+    Track::UriType previous_uri;
+    Track::Id current_id;
+    TrackList::Container ids;
+    {
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+        previous_uri = query_uri_for_track(get_current_track());
+
+        ids.reserve(uris.size());
+        Private::MetaDataCache meta_data_cache;
+        for (const auto& uri : uris)
+        {
+            const Track::Id id = d->next_track_id();
+            ids.push_back(id);
+            meta_data_cache[id] = std::make_tuple(uri, core::ubuntu::media::Track::MetaData{});
+        }
+
+        current_id = (current < ids.size()) ? ids[current] : Track::Id{};
+        MH_DEBUG("Replacing TrackList with %d tracks, current track: %s", ids.size(), current_id);
+
+        // Make sure no index into the old list survives the swap
+        media::TrackListSkeleton::reset();
+        {
+            std::lock_guard<std::mutex> lg(d->meta_data_guard);
+            d->meta_data_cache.swap(meta_data_cache);
+        }
+
+        tracks().update([&ids](TrackList::Container& container)
+        {
+            container = ids;
+            return true;
+        });
+
+        if (d->journal)
+        {
+            d->journal->tracks_cleared();
+            d->journal->tracks_inserted(Track::Id{}, ids, uris);
+        }
+
+        set_current_track(current_id);
+        publish_snapshot();
+    }
+
+    // This is the only notification sent to clients for the whole replacement
+    on_track_list_replaced()(std::make_tuple(ids, current_id));
+
+    if (current_id.empty())
+    {
+        // Make sure playback stops if the new TrackList is empty
+        on_end_of_tracklist()();
+    }
+    else if (previous_uri != uris[current])
+    {
+        // Only reload the pipeline if the current track actually changed, otherwise
+        // playback just carries on with the new TrackList
+        on_go_to_track_at()(std::make_tuple(current_id, position));
+    }
+}
+
 bool media::TrackListImplementation::move_track(const media::Track::Id& id,
                                                 const media::Track::Id& to)
 {
@@ -245,20 +333,27 @@ bool media::TrackListImplementation::move_track(const media::Track::Id& id,
         return false;
     }
 
-    if (tracks().get().size() == 1)
-    {
-        MH_ERROR("Can't move track since TrackList contains only one track");
-        return false;
-    }
-
     bool ret = false;
-    const media::Track::Id current_id = *current_iterator();
-    MH_DEBUG("current_track id: %s", current_id);
-    // Get an iterator that points to the track that is the insertion point
-    auto insert_point_it = std::find(tracks().get().begin(), tracks().get().end(), to);
-    if (insert_point_it != tracks().get().end())
     {
-        const auto result = tracks().update([this, id, to, current_id, &insert_point_it]
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+        if (tracks().get().size() == 1)
+        {
+            MH_ERROR("Can't move track since TrackList contains only one track");
+            return false;
+        }
+
+        const media::Track::Id current_id = *current_iterator();
+        MH_DEBUG("current_track id: %s", current_id);
+        // Get an iterator that points to the track that is the insertion point
+        auto insert_point_it = std::find(tracks().get().begin(), tracks().get().end(), to);
+        if (insert_point_it == tracks().get().end())
+        {
+            throw media::TrackList::Errors::FailedToFindMoveTrackSource
+                    ("Failed to find source track " + id);
+        }
+
+        ret = tracks().update([this, id, to, current_id, &insert_point_it]
                 (TrackList::Container& container)
         {
             // Get an iterator that points to the track to move within the TrackList
@@ -295,23 +390,24 @@ bool media::TrackListImplementation::move_track(const media::Track::Id& id,
             return true;
         });
 
-        if (result)
+        if (ret)
         {
             MH_DEBUG("TrackList after move");
             for(const auto track : tracks().get())
             {
                 MH_DEBUG("%s", track);
             }
-            const media::TrackList::TrackIdTuple ids = std::make_tuple(id, to);
-            // Signal to the client that track 'id' was moved within the TrackList
-            on_track_moved()(ids);
-            ret = true;
+            if (d->journal)
+                d->journal->track_moved(id, to);
+            publish_snapshot();
         }
     }
-    else
+
+    if (ret)
     {
-        throw media::TrackList::Errors::FailedToFindMoveTrackSource
-                ("Failed to find source track " + id);
+        const media::TrackList::TrackIdTuple ids = std::make_tuple(id, to);
+        // Signal to the client that track 'id' was moved within the TrackList
+        on_track_moved()(ids);
     }
 
     MH_DEBUG("-----------------------------------------------------");
@@ -321,28 +417,49 @@ bool media::TrackListImplementation::move_track(const media::Track::Id& id,
 
 void media::TrackListImplementation::remove_track(const media::Track::Id& id)
 {
-    const auto result = tracks().update([id](TrackList::Container& container)
+    bool result = false;
+    bool removing_current = false;
+    bool now_empty = false;
+    Track::Id next;
     {
-        container.erase(std::find(container.begin(), container.end(), id));
-        return true;
-    });
-
-    reset_current_iterator_if_needed();
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
 
-    if (result)
-    {
-        d->meta_data_cache.erase(id);
+        next = current_after_removing(id, removing_current);
 
-        if (d->shuffle)
-            d->shuffled_tracks.erase(find(d->shuffled_tracks.begin(),
-                                          d->shuffled_tracks.end(), id));
+        result = tracks().update([id](TrackList::Container& container)
+        {
+            const auto it = std::find(container.begin(), container.end(), id);
+            if (it == container.end())
+                return false;
 
-        on_track_removed()(id);
+            container.erase(it);
+            return true;
+        });
 
-        // Make sure playback stops if all tracks were removed
-        if (tracks().get().empty())
-            on_end_of_tracklist()();
+        if (result)
+        {
+            set_current_track(next);
+            {
+                std::lock_guard<std::mutex> lg(d->meta_data_guard);
+                d->meta_data_cache.erase(id);
+            }
+            if (d->journal)
+                d->journal->track_removed(id);
+            now_empty = tracks().get().empty();
+            publish_snapshot();
+        }
     }
+
+    if (not result)
+        return;
+
+    on_track_removed()(id);
+
+    // Make sure playback stops if all tracks were removed or nothing is left to play
+    if (now_empty or (removing_current and next.empty()))
+        on_end_of_tracklist()();
+    else if (removing_current)
+        go_to(next);
 }
 
 void media::TrackListImplementation::go_to(const media::Track::Id& track)
@@ -355,11 +472,18 @@ void media::TrackListImplementation::go_to(const media::Track::Id& track)
 
 void media::TrackListImplementation::set_shuffle(bool shuffle)
 {
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
     d->shuffle = shuffle;
 
+    // Pick a new order every time shuffle gets turned on
     if (shuffle) {
-        d->shuffled_tracks = tracks().get();
-        random_shuffle(d->shuffled_tracks.begin(), d->shuffled_tracks.end());
+        std::random_device rd;
+        set_shuffle_seed((static_cast<std::uint64_t>(rd()) << 32) | rd());
+    } else {
+        if (d->journal)
+            d->journal->shuffle_changed(false, d->shuffle_order.seed());
+        publish_snapshot();
     }
 }
 
@@ -368,9 +492,26 @@ bool media::TrackListImplementation::shuffle()
     return d->shuffle;
 }
 
-const media::TrackList::Container& media::TrackListImplementation::shuffled_tracks()
+const media::ShufflePermutation& media::TrackListImplementation::shuffle_order()
 {
-    return d->shuffled_tracks;
+    return d->shuffle_order;
+}
+
+std::uint64_t media::TrackListImplementation::shuffle_seed() const
+{
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+    return d->shuffle_order.seed();
+}
+
+void media::TrackListImplementation::set_shuffle_seed(std::uint64_t seed)
+{
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+    d->shuffle_order = media::ShufflePermutation{seed};
+
+    if (d->journal)
+        d->journal->shuffle_changed(d->shuffle, seed);
+    // The track to go to next depends on the order
+    publish_snapshot();
 }
 
 void media::TrackListImplementation::reset()
@@ -379,17 +520,163 @@ void media::TrackListImplementation::reset()
 
     // Make sure playback stops
     on_end_of_tracklist()();
-    // And make sure there is no "current" track
-    media::TrackListSkeleton::reset();
 
-    tracks().update([this](TrackList::Container& container)
     {
-        container.clear();
-        on_track_list_reset()();
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+        // And make sure there is no "current" track
+        media::TrackListSkeleton::reset();
+
+        tracks().update([](TrackList::Container& container)
+        {
+            container.clear();
+            return true;
+        });
+
+        // The counter keeps going, so that ids of tracks from before the
+        // reset that are still held somewhere never name a new track
+        {
+            std::lock_guard<std::mutex> lg(d->meta_data_guard);
+            d->meta_data_cache.clear();
+        }
+        if (d->journal)
+            d->journal->tracks_cleared();
+        publish_snapshot();
+    }
+
+    on_track_list_reset()();
+}
+
+void media::TrackListImplementation::on_loop_status_changed(const media::Player::LoopStatus& loop_status)
+{
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+    media::TrackListSkeleton::on_loop_status_changed(loop_status);
+
+    if (d->journal)
+        d->journal->loop_status_changed(loop_status);
+}
+
+void media::TrackListImplementation::on_position_changed(uint64_t position)
+{
+    media::TrackListSkeleton::on_position_changed(position);
+
+    // The Engine reports the position in nanoseconds
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+    d->position = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds{position});
+
+    if (d->journal)
+        d->journal->position_changed(d->position);
+}
+
+void media::TrackListImplementation::set_journal(const media::TrackListJournal::Ptr& journal)
+{
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+    d->journal = journal;
+    if (not d->journal)
+        return;
+
+    // Whatever the journal contained before is superseded by the current state
+    media::TrackListJournal::State state;
+    state.tracks = tracks().get();
+    {
+        std::lock_guard<std::mutex> lg(d->meta_data_guard);
+        state.meta_data = d->meta_data_cache;
+    }
+    state.current = get_current_track();
+    state.shuffle = d->shuffle;
+    state.shuffle_seed = d->shuffle_order.seed();
+    state.loop_status = loop_status();
+    state.position = d->position;
+
+    d->journal->compact(state);
+    d->journaled_current = state.current;
+}
+
+void media::TrackListImplementation::discard_journal()
+{
+    std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+    if (d->journal)
+        d->journal->discard();
+    d->journal.reset();
+}
+
+void media::TrackListImplementation::restore(const media::TrackListJournal::State& state)
+{
+    MH_TRACE("");
+
+    Track::Id current_id;
+    TrackList::Container ids;
+    {
+        std::lock_guard<std::recursive_mutex> lg(writer_lane());
+
+        // The journaled ids belong to an object path that is gone, so hand out new ones
+        ids.reserve(state.tracks.size());
+        Private::MetaDataCache meta_data_cache;
+        for (const auto& journaled_id : state.tracks)
+        {
+            const Track::Id id = d->next_track_id();
+            ids.push_back(id);
+
+            const auto it = state.meta_data.find(journaled_id);
+            if (it != state.meta_data.end())
+                meta_data_cache[id] = it->second;
+            if (journaled_id == state.current)
+                current_id = id;
+        }
 
-        d->track_counter = 0;
-        d->shuffled_tracks.clear();
+        MH_DEBUG("Restoring TrackList with %d tracks, current track: %s", ids.size(), current_id);
 
-        return true;
-    });
+        media::TrackListSkeleton::reset();
+        {
+            std::lock_guard<std::mutex> lg(d->meta_data_guard);
+            d->meta_data_cache.swap(meta_data_cache);
+        }
+
+        tracks().update([&ids](TrackList::Container& container)
+        {
+            container = ids;
+            return true;
+        });
+
+        d->shuffle = state.shuffle;
+        d->shuffle_order = media::ShufflePermutation{state.shuffle_seed};
+        media::TrackListSkeleton::on_loop_status_changed(state.loop_status);
+        d->position = state.position;
+
+        set_current_track(current_id);
+        // Rewrites the journal in terms of the new ids
+        set_journal(d->journal);
+        publish_snapshot();
+    }
+
+    on_track_list_replaced()(std::make_tuple(ids, current_id));
+
+    if (not current_id.empty())
+        on_go_to_track_at()(std::make_tuple(current_id, state.position));
+}
+
+void media::TrackListImplementation::publish_snapshot()
+{
+    media::TrackListSkeleton::publish_snapshot();
+
+    if (not d->journal)
+        return;
+
+    // Every change of the current track ends up here, no matter which edit caused it
+    const auto snapshot = media::TrackListSkeleton::snapshot();
+    const Track::Id current = snapshot->current < snapshot->tracks.size()
+            ? snapshot->tracks[snapshot->current] : Track::Id{};
+    if (current != d->journaled_current)
+    {
+        d->journal->current_changed(current);
+        d->journaled_current = current;
+    }
+
+    if (d->journal->needs_compaction(snapshot->tracks.size()))
+    {
+        MH_DEBUG("Compacting TrackList journal %s", d->journal->path());
+        set_journal(d->journal);
+    }
 }
@@ -22,6 +22,8 @@
 #include "engine.h"
 #include "track_list_skeleton.h"
 
+#include "util/track_list_journal.h"
+
 namespace core
 {
 namespace ubuntu
@@ -36,7 +38,10 @@ public:
             const core::dbus::Object::Ptr& object,
             const std::shared_ptr<Engine::MetaDataExtractor>& extractor,
             const core::ubuntu::media::apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-            const core::ubuntu::media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator);
+            const core::ubuntu::media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+            const SerialQueue::Ptr& dispatch_queue = SerialQueue::Ptr{},
+            const ClientQuotas::Ptr& quotas = ClientQuotas::Ptr{},
+            const PeerCancellation::Ptr& cancellation = PeerCancellation::Ptr{});
     ~TrackListImplementation();
 
     Track::UriType query_uri_for_track(const Track::Id& id);
@@ -44,15 +49,37 @@ public:
 
     void add_track_with_uri_at(const Track::UriType& uri, const Track::Id& position, bool make_current);
     void add_tracks_with_uri_at(const ContainerURI& uris, const Track::Id& position);
+    void replace_tracks(const ContainerURI& uris, std::size_t current, const std::chrono::microseconds& position);
     bool move_track(const Track::Id& id, const Track::Id& to);
     void remove_track(const Track::Id& id);
 
     void go_to(const Track::Id& track);
     void set_shuffle(bool shuffle);
     bool shuffle();
-    const media::TrackList::Container& shuffled_tracks();
+    /** The order tracks are played in while shuffling. It only depends on the shuffle
+     *  seed and the number of tracks, so adding or removing tracks reshuffles the
+     *  tracks that have not been played yet. */
+    const media::ShufflePermutation& shuffle_order();
+    /** The seed the current shuffle order is derived from, e.g. to restore it later on. */
+    std::uint64_t shuffle_seed() const;
+    void set_shuffle_seed(std::uint64_t seed);
     void reset();
 
+    void on_loop_status_changed(const Player::LoopStatus& loop_status) override;
+    void on_position_changed(uint64_t position) override;
+
+    /** Records every edit of the TrackList in journal from now on, starting out
+     *  with a checkpoint of the current state. Pass nullptr to stop journaling. */
+    void set_journal(const TrackListJournal::Ptr& journal);
+    /** Stops journaling and removes the journal, once the session is gone for good. */
+    void discard_journal();
+    /** Replaces the TrackList with a journaled one. The current track is loaded but
+     *  not played, playback starts from the journaled position once it is started. */
+    void restore(const TrackListJournal::State& state);
+
+protected:
+    void publish_snapshot() override;
+
 private:
     struct Private;
     std::unique_ptr<Private> d;
@@ -30,9 +30,12 @@
 #include "mpris/player.h"
 #include "mpris/track_list.h"
 
+#include "util/playlist_parser.h"
 #include "util/uri_check.h"
+#include "util/worker_pool.h"
 #include "core/media/logger/logger.h"
 
+#include <core/dbus/interfaces/properties.h>
 #include <core/dbus/object.h>
 #include <core/dbus/property.h>
 #include <core/dbus/types/object_path.h>
@@ -40,36 +43,86 @@
 #include <core/dbus/types/stl/map.h>
 #include <core/dbus/types/stl/vector.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <limits>
 #include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
 
 using namespace std;
 
+namespace
+{
+// Shared by all TrackList instances, which bounds the number of threads doing
+// URI validation no matter how many sessions are adding tracks at the same time.
+media::WorkerPool& uri_validation_pool()
+{
+    static media::WorkerPool pool{std::max(2u, std::thread::hardware_concurrency())};
+    return pool;
+}
+
+// Runs task on the dispatch queue of the session, where all other edits of its
+// TrackList are made, or right away if there is none. Work that completes on
+// other threads hands its edits over through here.
+void run_in_session(const media::SerialQueue::Ptr& queue, const media::WorkerPool::Task& task)
+{
+    if (queue)
+        queue->post(task, media::WorkerPool::Priority::bulk);
+    else
+        task();
+}
+
+// Playlists are imported a batch at a time on these threads, so that clients
+// can't have more threads parsing playlists than there are workers.
+media::WorkerPool& playlist_import_pool()
+{
+    static media::WorkerPool pool{2};
+    return pool;
+}
+}
+
 struct media::TrackListSkeleton::Private
 {
+    // The first batch of a playlist import is kept small so that playback can
+    // start as soon as possible, the remaining entries are added in bigger batches.
+    static constexpr std::size_t first_import_batch_size{8};
+    static constexpr std::size_t import_batch_size{512};
+    static constexpr std::size_t no_current_track{std::numeric_limits<std::size_t>::max()};
+
     Private(media::TrackListSkeleton* impl, const dbus::Bus::Ptr& bus, const dbus::Object::Ptr& object,
             const apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-            const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator)
+            const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+            const media::SerialQueue::Ptr& dispatch_queue,
+            const media::ClientQuotas::Ptr& quotas,
+            const media::PeerCancellation::Ptr& cancellation)
         : impl(impl),
           bus(bus),
           object(object),
           request_context_resolver(request_context_resolver),
           request_authenticator(request_authenticator),
+          dispatch_queue(dispatch_queue),
+          quotas(quotas),
+          cancellation(cancellation),
+          charged_tracks(0),
+          reserved_tracks(0),
           uri_check(std::make_shared<UriCheck>()),
           skeleton(mpris::TrackList::Skeleton::Configuration{object, mpris::TrackList::Skeleton::Configuration::Defaults{}}),
-          current_track(skeleton.properties.tracks->get().begin()),
-          empty_iterator(skeleton.properties.tracks->get().begin()),
+          current_index(no_current_track),
+          snapshot(std::make_shared<const Snapshot>(Snapshot{Container{}, 0, Track::Id{}})),
           loop_status(media::Player::LoopStatus::none),
           current_position(0),
-          id_after_remove(),
+          import_generation(0),
           signals
           {
               skeleton.signals.track_added,
               skeleton.signals.tracks_added,
+              skeleton.signals.playlist_import_progress,
               skeleton.signals.track_moved,
               skeleton.signals.track_removed,
               skeleton.signals.track_changed,
@@ -79,6 +132,185 @@ struct media::TrackListSkeleton::Private
     {
     }
 
+    ~Private()
+    {
+        if (quotas and charged_tracks > 0)
+            quotas->release_tracks(quota_client, charged_tracks);
+    }
+
+    typedef std::function<void(const core::dbus::Message::Ptr&)> Handler;
+    // Gets the token taken on arrival of the call, for whatever it carries on with
+    typedef std::function<void(const core::dbus::Message::Ptr&, const media::CancellationToken&)> CancellableHandler;
+
+    // Moves the handler off the bus thread onto the dispatch queue of the session
+    Handler dispatched(const Handler& handler,
+                       media::WorkerPool::Priority priority = media::WorkerPool::Priority::normal)
+    {
+        return dispatched_with_token([handler](const core::dbus::Message::Ptr& msg, const media::CancellationToken&)
+        {
+            handler(msg);
+        }, priority);
+    }
+
+    Handler dispatched_with_token(const CancellableHandler& handler,
+                                  media::WorkerPool::Priority priority = media::WorkerPool::Priority::normal)
+    {
+        const auto cancellation = this->cancellation;
+        const auto queued = on_queue(handler, priority);
+        return [cancellation, queued](const core::dbus::Message::Ptr& msg)
+        {
+            // Taken right away, the client can't have been seen leaving the bus yet
+            queued(msg, cancellation ? cancellation->token_for(msg->sender()) : media::CancellationToken{});
+        };
+    }
+
+    // Runs the handler on the dispatch queue, unless the caller left the bus by then
+    CancellableHandler on_queue(const CancellableHandler& handler, media::WorkerPool::Priority priority)
+    {
+        if (not dispatch_queue)
+            return handler;
+
+        const auto queue = dispatch_queue;
+        const auto track_list = impl;
+        return [queue, track_list, handler, priority](const core::dbus::Message::Ptr& msg,
+                                                      const media::CancellationToken& token)
+        {
+            std::weak_ptr<media::TrackList> weak_track_list;
+            try {
+                weak_track_list = track_list->shared_from_this();
+            } catch (const std::bad_weak_ptr&) {
+                // Being torn down
+                return;
+            }
+
+            queue->post([weak_track_list, handler, msg, token]()
+            {
+                // Nobody is waiting for the answer anymore
+                if (token.is_cancelled())
+                {
+                    MH_DEBUG("Dropping call of %s, which left the bus", msg->sender());
+                    return;
+                }
+
+                // The session might be gone by the time its turn comes
+                if (const auto sp = weak_track_list.lock())
+                    handler(msg, token);
+            }, priority);
+        };
+    }
+
+    // Charges metadata requests to the client from the moment they arrive until they
+    // are answered, so that a client can't pile up an unbounded number of them
+    Handler metered(const Handler& handler)
+    {
+        if (not quotas)
+            return dispatched(handler, media::WorkerPool::Priority::bulk);
+
+        return [this, handler](const core::dbus::Message::Ptr& msg)
+        {
+            // The charge is taken on the bus thread, right as the call arrives
+            const auto token = token_for(msg);
+            request_context_resolver->resolve_context_for_dbus_name_async
+                (msg->sender(), [this, handler, msg, token](const media::apparmor::ubuntu::Context& context)
+            {
+                if (token.is_cancelled())
+                    return;
+
+                const auto client = media::ClientQuotas::client_for(context, msg->sender());
+                if (not quotas->acquire_metadata_request(client))
+                {
+                    std::stringstream err_str;
+                    err_str << "Error: Not querying metadata, client " << client << " already waits for "
+                            << quotas->configuration().max_metadata_requests << " metadata requests";
+                    MH_WARNING("%s", err_str.str());
+                    bus->send(dbus::Message::make_error(
+                                msg,
+                                mpris::TrackList::Error::QuotaExceeded::name,
+                                err_str.str()));
+                    return;
+                }
+
+                // Released once the request got answered or dropped with its session
+                const auto client_quotas = quotas;
+                const std::shared_ptr<void> charge{nullptr, [client_quotas, client](void*)
+                {
+                    client_quotas->release_metadata_request(client);
+                }};
+
+                on_queue([handler, charge](const core::dbus::Message::Ptr& msg, const media::CancellationToken&)
+                {
+                    handler(msg);
+                }, media::WorkerPool::Priority::bulk)(msg, token);
+            });
+        };
+    }
+
+    // The entries of the TrackList count against the quota of the client that first added to
+    // it, the owner of the session in practice. Room for tracks is reserved before the edit and
+    // whatever was not used up is given back once it is done.
+    // Local callers go by an empty client and are not charged
+    bool reserve_tracks(const std::string& client, std::size_t n, std::string& error)
+    {
+        if (not quotas or client.empty())
+            return true;
+
+        std::lock_guard<std::mutex> lg(quota_guard);
+        if (quota_client.empty())
+            quota_client = client;
+
+        settle_tracks();
+        if (not quotas->acquire_tracks(quota_client, n))
+        {
+            std::stringstream err_str;
+            err_str << "Error: Not adding " << n << " tracks, client " << quota_client
+                    << " would exceed its quota of " << quotas->configuration().max_tracks << " tracks";
+            error = err_str.str();
+            MH_WARNING("%s", error);
+            return false;
+        }
+
+        charged_tracks += n;
+        reserved_tracks += n;
+        return true;
+    }
+
+    void complete_tracks(std::size_t n)
+    {
+        if (not quotas)
+            return;
+
+        std::lock_guard<std::mutex> lg(quota_guard);
+        reserved_tracks -= n;
+        settle_tracks();
+    }
+
+    // Gives back what got removed from the TrackList
+    void release_removed_tracks()
+    {
+        if (not quotas)
+            return;
+
+        std::lock_guard<std::mutex> lg(quota_guard);
+        settle_tracks();
+    }
+
+    // Called with quota_guard held
+    void settle_tracks()
+    {
+        const std::size_t target = impl->snapshot()->tracks.size() + reserved_tracks;
+        if (charged_tracks <= target)
+            return;
+
+        quotas->release_tracks(quota_client, charged_tracks - target);
+        charged_tracks = target;
+    }
+
+    // Trips once the sender of msg leaves the bus
+    media::CancellationToken token_for(const core::dbus::Message::Ptr& msg)
+    {
+        return cancellation ? cancellation->token_for(msg->sender()) : media::CancellationToken{};
+    }
+
     void handle_get_tracks_metadata(const core::dbus::Message::Ptr& msg)
     {
         media::Track::Id track;
@@ -103,6 +335,52 @@ struct media::TrackListSkeleton::Private
         bus->send(reply);
     }
 
+    // Property reads are answered right on the bus thread. tracks() may only be
+    // read with the writer lane held, so they are served from the latest snapshot.
+    mpris::TrackList::Dictionary properties_of_snapshot()
+    {
+        mpris::TrackList::Dictionary dict;
+        dict[mpris::TrackList::Properties::Tracks::name()] =
+                dbus::types::Variant::encode(impl->snapshot()->tracks);
+        dict[mpris::TrackList::Properties::CanEditTracks::name()] =
+                dbus::types::Variant::encode(skeleton.properties.can_edit_tracks->get());
+
+        return dict;
+    }
+
+    void handle_get_property(const core::dbus::Message::Ptr& msg)
+    {
+        std::string interface, name;
+        msg->reader() >> interface >> name;
+
+        const auto dict = properties_of_snapshot();
+        const auto it = dict.find(name);
+        if (interface != mpris::TrackList::name() or it == dict.end())
+        {
+            bus->send(dbus::Message::make_error(
+                          msg, "org.freedesktop.DBus.Error.UnknownProperty", name));
+            return;
+        }
+
+        const auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << it->second;
+        bus->send(reply);
+    }
+
+    void handle_get_all(const core::dbus::Message::Ptr& msg)
+    {
+        std::string interface;
+        msg->reader() >> interface;
+
+        const auto reply = dbus::Message::make_method_return(msg);
+        if (interface == mpris::TrackList::name())
+            reply->writer() << properties_of_snapshot();
+        else
+            reply->writer() << mpris::TrackList::Dictionary{};
+
+        bus->send(reply);
+    }
+
     void handle_add_track_with_uri_at(const core::dbus::Message::Ptr& msg)
     {
         MH_TRACE("");
@@ -133,10 +411,32 @@ struct media::TrackListSkeleton::Private
             }
             else
             {
+                std::string quota_error;
                 // Only add the track to the TrackList if it passes the apparmor permissions check
-                if (std::get<0>(result))
+                if (std::get<0>(result) and
+                        reserve_tracks(media::ClientQuotas::client_for(context, msg->sender()), 1, quota_error))
                 {
-                    impl->add_track_with_uri_at(uri, after, make_current);
+                    // The context might have been resolved on another thread
+                    const std::weak_ptr<media::TrackList> weak_impl{impl->shared_from_this()};
+                    const auto bus = this->bus;
+                    run_in_session(dispatch_queue, [this, weak_impl, bus, reply, uri, after, make_current]()
+                    {
+                        const auto sp = weak_impl.lock();
+                        if (not sp)
+                            return;
+
+                        impl->add_track_with_uri_at(uri, after, make_current);
+                        complete_tracks(1);
+                        bus->send(reply);
+                    });
+                    return;
+                }
+                else if (std::get<0>(result))
+                {
+                    reply = dbus::Message::make_error(
+                                msg,
+                                mpris::TrackList::Error::QuotaExceeded::name,
+                                quota_error);
                 }
                 else
                 {
@@ -154,62 +454,421 @@ struct media::TrackListSkeleton::Private
         });
     }
 
-    void handle_add_tracks_with_uri_at(const core::dbus::Message::Ptr& msg)
+    void handle_add_tracks_with_uri_at(const core::dbus::Message::Ptr& msg, const media::CancellationToken& token)
     {
         MH_TRACE("");
         request_context_resolver->resolve_context_for_dbus_name_async
-            (msg->sender(), [this, msg](const media::apparmor::ubuntu::Context& context)
+            (msg->sender(), [this, msg, token](const media::apparmor::ubuntu::Context& context)
         {
+            if (token.is_cancelled())
+                return;
+
             ContainerURI uris;
             media::Track::Id after;
             msg->reader() >> uris >> after;
 
-            bool valid_uri = false;
-            media::apparmor::ubuntu::RequestAuthenticator::Result result;
-            std::string uri_err_str, err_str;
-            core::dbus::Message::Ptr reply;
-            for (const auto uri : uris)
+            // Refused right away, before checking a single URI
+            std::string quota_error;
+            if (not reserve_tracks(media::ClientQuotas::client_for(context, msg->sender()), uris.size(), quota_error))
+            {
+                bus->send(dbus::Message::make_error(
+                            msg,
+                            mpris::TrackList::Error::QuotaExceeded::name,
+                            quota_error));
+                return;
+            }
+
+            const std::weak_ptr<media::TrackList> weak_impl{impl->shared_from_this()};
+            const auto bus = this->bus;
+            const auto queue = dispatch_queue;
+            validate_uris_async(context, uris, token,
+                [this, weak_impl, bus, queue, msg, uris, after](const std::string& error_name, const std::string& error)
+            {
+                // Called on the validation pool
+                run_in_session(queue, [this, weak_impl, bus, msg, uris, after, error_name, error]()
+                {
+                    const auto sp = weak_impl.lock();
+                    core::dbus::Message::Ptr reply;
+                    // Only add the tracks to the TrackList if all of them passed the checks
+                    if (error_name.empty())
+                    {
+                        if (not sp)
+                            return;
+
+                        impl->add_tracks_with_uri_at(uris, after);
+                        reply = dbus::Message::make_method_return(msg);
+                    }
+                    else
+                    {
+                        reply = dbus::Message::make_error(msg, error_name, error);
+                    }
+                    if (sp)
+                        complete_tracks(uris.size());
+
+                    bus->send(reply);
+                });
+            });
+        });
+    }
+
+    // Checks that every URI can be found and that the client is allowed to open it. The
+    // checks are spread over the shared validation pool so that neither the dbus dispatch
+    // thread nor the apparmor resolver thread block on g_file_query_info(). on_done gets
+    // called exactly once, from the worker that finishes last, with an empty error name if
+    // all URIs passed. The first failure stops all remaining checks.
+    void validate_uris_async(const media::apparmor::ubuntu::Context& context,
+                             const ContainerURI& uris,
+                             const media::CancellationToken& token,
+                             const std::function<void(const std::string&, const std::string&)>& on_done)
+    {
+        struct Validation
+        {
+            ContainerURI uris;
+            std::shared_ptr<media::apparmor::ubuntu::Context> context;
+            media::CancellationToken token;
+            std::function<void(const std::string&, const std::string&)> on_done;
+            std::atomic<std::size_t> next;
+            std::atomic<std::size_t> pending;
+            std::atomic<bool> failed;
+            std::mutex guard;
+            std::string error_name;
+            std::string error;
+        };
+
+        if (uris.empty())
+        {
+            on_done(std::string{}, std::string{});
+            return;
+        }
+
+        auto& pool = uri_validation_pool();
+        const std::size_t n_workers = std::min(uris.size(), pool.size());
+
+        auto validation = std::make_shared<Validation>();
+        validation->uris = uris;
+        // The resolver only guarantees the context to be valid within its callback
+        validation->context = std::make_shared<media::apparmor::ubuntu::Context>(context.str());
+        validation->token = token;
+        validation->on_done = on_done;
+        validation->next = 0;
+        validation->pending = n_workers;
+        validation->failed = false;
+
+        const auto authenticator = request_authenticator;
+        for (std::size_t i = 0; i < n_workers; i++)
+        {
+            pool.post([validation, authenticator]()
             {
-                uri_check->set(uri);
-                valid_uri = !uri_check->is_local_file() or
-                        (uri_check->is_local_file() and uri_check->file_exists());
-                if (!valid_uri)
+                auto fail = [&validation](const std::string& error_name, const std::string& error)
+                {
+                    std::lock_guard<std::mutex> lg(validation->guard);
+                    if (validation->failed.exchange(true))
+                        return;
+
+                    MH_WARNING("%s", error.c_str());
+                    validation->error_name = error_name;
+                    validation->error = error;
+                };
+
+                media::UriCheck uri_check;
+                while (not validation->failed)
                 {
-                    uri_err_str = {"Warning: Not adding track " + uri +
-                         " to TrackList because it can't be found."};
-                    MH_WARNING("%s", uri_err_str.c_str());
+                    const std::size_t index = validation->next++;
+                    if (index >= validation->uris.size())
+                        break;
+
+                    if (validation->token.is_cancelled())
+                    {
+                        fail(mpris::TrackList::Error::Cancelled::name,
+                             "Not validating the remaining tracks, the client left the bus.");
+                        break;
+                    }
+
+                    const auto& uri = validation->uris[index];
+                    uri_check.set(uri);
+                    if (uri_check.is_local_file() and not uri_check.file_exists())
+                    {
+                        fail(mpris::Player::Error::UriNotFound::name,
+                             "Warning: Not adding track " + uri + " to TrackList because it can't be found.");
+                        break;
+                    }
+
+                    // Make sure the client has adequate apparmor permissions to open the URI
+                    const auto result = authenticator->authenticate_open_uri_request(*validation->context, uri);
+                    if (not std::get<0>(result))
+                    {
+                        fail(mpris::TrackList::Error::InsufficientPermissionsToAddTrack::name,
+                             "Warning: Not adding track " + uri +
+                             " to TrackList because of inadequate client apparmor permissions.");
+                        break;
+                    }
+                }
+
+                // The decrement orders this against the error written by any other worker
+                if (--validation->pending == 0)
+                    validation->on_done(validation->error_name, validation->error);
+            }, media::WorkerPool::Priority::bulk);
+        }
+    }
+
+    void handle_add_tracks_from_playlist(const core::dbus::Message::Ptr& msg, const media::CancellationToken& token)
+    {
+        MH_TRACE("");
+        request_context_resolver->resolve_context_for_dbus_name_async
+            (msg->sender(), [this, msg, token](const media::apparmor::ubuntu::Context& context)
+        {
+            if (token.is_cancelled())
+                return;
+
+            Track::UriType playlist;
+            media::Track::Id after;
+            msg->reader() >> playlist >> after;
+
+            media::PlaylistParser::Ptr parser;
+            core::dbus::Message::Ptr reply;
+            // Make sure the client has adequate apparmor permissions to open the playlist itself
+            const auto result = request_authenticator->authenticate_open_uri_request(context, playlist);
+            if (not std::get<0>(result))
+            {
+                const std::string err_str = {"Warning: Not adding tracks from playlist " + playlist +
+                    " to TrackList because of inadequate client apparmor permissions."};
+                MH_WARNING("%s", err_str.c_str());
+                reply = dbus::Message::make_error(
+                            msg,
+                            mpris::TrackList::Error::InsufficientPermissionsToAddTrack::name,
+                            err_str);
+            }
+            else
+            {
+                try {
+                    parser = std::make_shared<media::PlaylistParser>(playlist);
+                    reply = dbus::Message::make_method_return(msg);
+                } catch (const media::PlaylistParser::Errors::FailedToOpenPlaylist& e) {
+                    MH_WARNING("%s", e.what());
                     reply = dbus::Message::make_error(
                                 msg,
                                 mpris::Player::Error::UriNotFound::name,
-                                err_str);
+                                e.what());
                 }
+            }
 
-                // Make sure the client has adequate apparmor permissions to open the URI
-                result = request_authenticator->authenticate_open_uri_request(context, uri);
-                if (not std::get<0>(result))
+            bus->send(reply);
+
+            if (not parser)
+                return;
+
+            // Every entry of the playlist is checked against the client's apparmor profile,
+            // the context is recreated from its name since it is only valid in this callback
+            const auto authenticator = request_authenticator;
+            const std::string context_name = context.str();
+            std::shared_ptr<media::apparmor::ubuntu::Context> entry_context;
+            start_playlist_import(parser, playlist, after, media::ClientQuotas::client_for(context, msg->sender()), token,
+                [authenticator, context_name, entry_context](const Track::UriType& uri) mutable
+            {
+                if (not entry_context)
+                    entry_context = std::make_shared<media::apparmor::ubuntu::Context>(context_name);
+
+                return std::get<0>(authenticator->authenticate_open_uri_request(*entry_context, uri));
+            });
+        });
+    }
+
+    // State of a playlist import, handed from one batch to the next
+    struct PlaylistImport
+    {
+        media::PlaylistParser::Ptr parser;
+        Track::UriType playlist;
+        media::Track::Id after;
+        std::string client;
+        media::CancellationToken token;
+        std::function<bool(const Track::UriType&)> is_allowed;
+        std::size_t generation;
+        std::size_t batch_size;
+        std::uint64_t added;
+        media::UriCheck entry_check;
+    };
+
+    // Reads the playlist on the import pool and adds its entries in batches. The
+    // import is abandoned as soon as the TrackList is reset, replaced or destroyed.
+    void start_playlist_import(const media::PlaylistParser::Ptr& parser,
+                               const Track::UriType& playlist,
+                               const media::Track::Id& after,
+                               const std::string& client,
+                               const media::CancellationToken& token,
+                               const std::function<bool(const Track::UriType&)>& is_allowed)
+    {
+        auto import = std::make_shared<PlaylistImport>();
+        import->parser = parser;
+        import->playlist = playlist;
+        import->after = after;
+        import->client = client;
+        import->token = token;
+        import->is_allowed = is_allowed;
+        import->generation = import_generation;
+        import->batch_size = first_import_batch_size;
+        import->added = 0;
+
+        import_next_batch(std::static_pointer_cast<media::TrackListSkeleton>(impl->shared_from_this()), import);
+    }
+
+    // Only ever touches the skeleton through the weak reference, queued batches
+    // must not keep a TrackList alive that its session is done with
+    static void import_next_batch(const std::weak_ptr<media::TrackListSkeleton>& weak_skeleton,
+                                  const std::shared_ptr<PlaylistImport>& import)
+    {
+        playlist_import_pool().post([weak_skeleton, import]()
+        {
+            // Checked before parsing, which is where the time goes
+            if (import->token.is_cancelled())
+            {
+                MH_INFO("Client left the bus, abandoning import of playlist %s", import->playlist);
+                if (const auto sp = weak_skeleton.lock())
+                    sp->d->signals.on_playlist_import_progress(std::make_tuple(import->playlist, import->added, true));
+                return;
+            }
+
+            ContainerURI entries;
+            const bool more = import->parser->read_entries(import->batch_size, entries);
+            import->batch_size = import_batch_size;
+
+            ContainerURI uris;
+            uris.reserve(entries.size());
+            for (const auto& uri : entries)
+            {
+                import->entry_check.set(uri);
+                if (import->entry_check.is_local_file() and not import->entry_check.file_exists())
                 {
-                    err_str = {"Warning: Not adding track " + uri +
-                        " to TrackList because of inadequate client apparmor permissions."};
-                    break;
+                    MH_WARNING("Not adding track %s from playlist because it can't be found.", uri);
+                    continue;
                 }
+
+                if (not import->is_allowed(uri))
+                {
+                    MH_WARNING("Not adding track %s from playlist because of inadequate "
+                               "client apparmor permissions.", uri);
+                    continue;
+                }
+
+                uris.push_back(uri);
             }
 
-            // Only add the track to the TrackList if it passes the apparmor permissions check
-            if (std::get<0>(result))
+            const auto sp = weak_skeleton.lock();
+            if (not sp)
+                return;
+
+            run_in_session(sp->d->dispatch_queue, [weak_skeleton, import, uris, more]()
             {
-                reply = dbus::Message::make_method_return(msg);
-                impl->add_tracks_with_uri_at(uris, after);
+                const auto sp = weak_skeleton.lock();
+                if (sp and sp->d->add_imported_tracks(*import, uris, more) and more)
+                    import_next_batch(weak_skeleton, import);
+            });
+        }, media::WorkerPool::Priority::bulk);
+    }
+
+    // Returns false if the import got abandoned
+    bool add_imported_tracks(PlaylistImport& import, const ContainerURI& uris, bool more)
+    {
+        if (import.generation != import_generation)
+        {
+            MH_INFO("TrackList changed, abandoning import of playlist %s", import.playlist);
+            signals.on_playlist_import_progress(std::make_tuple(import.playlist, import.added, true));
+            return false;
+        }
+
+        if (not uris.empty())
+        {
+            std::string quota_error;
+            if (not reserve_tracks(import.client, uris.size(), quota_error))
+            {
+                MH_WARNING("Abandoning import of playlist %s: %s", import.playlist, quota_error);
+                signals.on_playlist_import_progress(std::make_tuple(import.playlist, import.added, true));
+                return false;
             }
-            else
+
+            impl->add_tracks_with_uri_at(uris, import.after);
+            if (not import.client.empty())
+                complete_tracks(uris.size());
+            import.added += uris.size();
+        }
+
+        MH_DEBUG("Added %d tracks from playlist %s so far", import.added, import.playlist);
+        signals.on_playlist_import_progress(std::make_tuple(import.playlist, import.added, not more));
+        return true;
+    }
+
+    void handle_replace_tracks(const core::dbus::Message::Ptr& msg, const media::CancellationToken& token)
+    {
+        MH_TRACE("");
+        ContainerURI uris;
+        std::uint64_t current;
+        std::int64_t position;
+        msg->reader() >> uris >> current >> position;
+
+        const auto bus = this->bus;
+        replace_tracks_for(msg->sender(), token, uris, current, std::chrono::microseconds{position},
+                           [bus, msg](const std::string& error_name, const std::string& error)
+        {
+            bus->send(error_name.empty() ?
+                          dbus::Message::make_method_return(msg) :
+                          dbus::Message::make_error(msg, error_name, error));
+        });
+    }
+
+    void replace_tracks_for(const std::string& sender, const media::CancellationToken& token,
+                            const ContainerURI& uris, std::size_t current,
+                            const std::chrono::microseconds& position, const Completion& done)
+    {
+        request_context_resolver->resolve_context_for_dbus_name_async
+            (sender, [this, sender, token, uris, current, position, done](const media::apparmor::ubuntu::Context& context)
+        {
+            if (token.is_cancelled())
+                return;
+
+            if (not uris.empty() and current >= uris.size())
             {
-                MH_WARNING("%s", err_str.c_str());
-                reply = dbus::Message::make_error(
-                            msg,
-                            mpris::TrackList::Error::InsufficientPermissionsToAddTrack::name,
-                            err_str);
+                std::stringstream err_str;
+                err_str << "Error: Not replacing TrackList because current track index "
+                        << current << " is out of range";
+                MH_WARNING("%s", err_str.str());
+                done(mpris::TrackList::Error::TrackNotFound::name, err_str.str());
+                return;
             }
 
-            bus->send(reply);
+            // Only the tracks beyond the ones getting replaced need room
+            const std::size_t size = impl->snapshot()->tracks.size();
+            const std::size_t growth = uris.size() > size ? uris.size() - size : 0;
+            std::string quota_error;
+            if (not reserve_tracks(media::ClientQuotas::client_for(context, sender), growth, quota_error))
+            {
+                done(mpris::TrackList::Error::QuotaExceeded::name, quota_error);
+                return;
+            }
+
+            // All URIs are validated before touching the TrackList, so that it is
+            // either replaced as a whole or left as it is
+            const std::weak_ptr<media::TrackList> weak_impl{impl->shared_from_this()};
+            const auto queue = dispatch_queue;
+            validate_uris_async(context, uris, token,
+                [this, weak_impl, queue, uris, current, position, growth, done](const std::string& error_name,
+                                                                                 const std::string& error)
+            {
+                // Called on the validation pool
+                run_in_session(queue, [this, weak_impl, uris, current, position, growth, done, error_name, error]()
+                {
+                    const auto sp = weak_impl.lock();
+                    if (error_name.empty())
+                    {
+                        if (not sp)
+                            return;
+
+                        impl->replace_tracks(uris, current, position);
+                    }
+                    if (sp)
+                        complete_tracks(growth);
+
+                    done(error_name, error);
+                });
+            });
         });
     }
 
@@ -261,8 +920,8 @@ struct media::TrackListSkeleton::Private
         media::Track::Id track;
         msg->reader() >> track;
 
-        auto id_it = find(impl->tracks().get().begin(), impl->tracks().get().end(), track);
-        if (id_it == impl->tracks().get().end()) {
+        const auto snapshot = impl->snapshot();
+        if (std::find(snapshot->tracks.begin(), snapshot->tracks.end(), track) == snapshot->tracks.end()) {
             stringstream err_str;
             err_str << "Track " << track << " not found in track list";
             MH_WARNING("%s", err_str.str());
@@ -274,49 +933,9 @@ struct media::TrackListSkeleton::Private
             return;
         }
 
-        media::Track::Id next;
-        bool deleting_current = false;
-
-        if (id_it == impl->current_iterator())
-        {
-            MH_DEBUG("Removing current track");
-            deleting_current = true;
-
-            if (current_track != empty_iterator)
-            {
-                ++current_track;
-
-                if (current_track == impl->tracks().get().end()
-                            && loop_status == media::Player::LoopStatus::playlist)
-                {
-                    // Removed the last track, current is the first track and make sure that
-                    // the player starts playing it
-                    current_track = impl->tracks().get().begin();
-                }
-
-                if (current_track == impl->tracks().get().end())
-                {
-                    current_track = empty_iterator;
-                    // Nothing else to play, stop playback
-                    impl->emit_on_end_of_tracklist();
-                }
-                else
-                {
-                    next = *current_track;
-                }
-            }
-        }
-        else if (current_track != empty_iterator)
-        {
-            next = *current_track;
-        }
-        id_after_remove = next;
-
-        // Calls reset_current_iterator_if_needed(), which updates the iterator
+        // Takes care of moving on to the next track if the current one gets removed
         impl->remove_track(track);
-
-        if ((not next.empty()) and deleting_current)
-            impl->go_to(next);
+        release_removed_tracks();
 
         auto reply = dbus::Message::make_method_return(msg);
         bus->send(reply);
@@ -327,7 +946,11 @@ struct media::TrackListSkeleton::Private
         media::Track::Id track;
         msg->reader() >> track;
 
-        current_track = std::find(skeleton.properties.tracks->get().begin(), skeleton.properties.tracks->get().end(), track);
+        {
+            std::lock_guard<std::recursive_mutex> lg(writer_lane);
+            impl->set_current_track(track);
+            impl->publish_snapshot();
+        }
         impl->go_to(track);
 
         auto reply = dbus::Message::make_method_return(msg);
@@ -337,6 +960,7 @@ struct media::TrackListSkeleton::Private
     void handle_reset(const core::dbus::Message::Ptr& msg)
     {
         impl->reset();
+        release_removed_tracks();
 
         auto reply = dbus::Message::make_method_return(msg);
         bus->send(reply);
@@ -347,19 +971,33 @@ struct media::TrackListSkeleton::Private
     dbus::Object::Ptr object;
     media::apparmor::ubuntu::RequestContextResolver::Ptr request_context_resolver;
     media::apparmor::ubuntu::RequestAuthenticator::Ptr request_authenticator;
+    media::SerialQueue::Ptr dispatch_queue;
+    media::ClientQuotas::Ptr quotas;
+    media::PeerCancellation::Ptr cancellation;
+    std::mutex quota_guard;
+    std::string quota_client;
+    // Tracks charged to quota_client, the size of the TrackList plus reserved_tracks
+    std::size_t charged_tracks;
+    std::size_t reserved_tracks;
     media::UriCheck::Ptr uri_check;
 
     mpris::TrackList::Skeleton skeleton;
-    TrackList::ConstIterator current_track;
-    TrackList::ConstIterator empty_iterator;
-    media::Player::LoopStatus loop_status;
-    uint64_t current_position;
-    media::Track::Id id_after_remove;
+    // Guards the tracks property and current_index, see TrackListSkeleton::writer_lane()
+    std::recursive_mutex writer_lane;
+    // Index of the current track within the tracks property, no_current_track if there is none
+    std::size_t current_index;
+    // Only ever accessed through std::atomic_load/std::atomic_store
+    Snapshot::Ptr snapshot;
+    std::atomic<media::Player::LoopStatus> loop_status;
+    std::atomic<uint64_t> current_position;
+    // Bumped whenever the TrackList is reset, so that pending playlist imports stop
+    std::atomic<std::size_t> import_generation;
 
     struct Signals
     {
         typedef core::dbus::Signal<mpris::TrackList::Signals::TrackAdded, mpris::TrackList::Signals::TrackAdded::ArgumentType> DBusTrackAddedSignal;
         typedef core::dbus::Signal<mpris::TrackList::Signals::TracksAdded, mpris::TrackList::Signals::TracksAdded::ArgumentType> DBusTracksAddedSignal;
+        typedef core::dbus::Signal<mpris::TrackList::Signals::PlaylistImportProgress, mpris::TrackList::Signals::PlaylistImportProgress::ArgumentType> DBusPlaylistImportProgressSignal;
         typedef core::dbus::Signal<mpris::TrackList::Signals::TrackMoved, mpris::TrackList::Signals::TrackMoved::ArgumentType> DBusTrackMovedSignal;
         typedef core::dbus::Signal<mpris::TrackList::Signals::TrackRemoved, mpris::TrackList::Signals::TrackRemoved::ArgumentType> DBusTrackRemovedSignal;
         typedef core::dbus::Signal<mpris::TrackList::Signals::TrackChanged, mpris::TrackList::Signals::TrackChanged::ArgumentType> DBusTrackChangedSignal;
@@ -371,6 +1009,7 @@ struct media::TrackListSkeleton::Private
 
         Signals(const std::shared_ptr<DBusTrackAddedSignal>& remote_track_added,
                 const std::shared_ptr<DBusTracksAddedSignal>& remote_tracks_added,
+                const std::shared_ptr<DBusPlaylistImportProgressSignal>& remote_playlist_import_progress,
                 const std::shared_ptr<DBusTrackMovedSignal>& remote_track_moved,
                 const std::shared_ptr<DBusTrackRemovedSignal>& remote_track_removed,
                 const std::shared_ptr<DBusTrackChangedSignal>& remote_track_changed,
@@ -388,6 +1027,11 @@ struct media::TrackListSkeleton::Private
                 remote_tracks_added->emit(tracks);
             });
 
+            on_playlist_import_progress.connect([remote_playlist_import_progress](const media::TrackList::PlaylistImportProgressTuple &progress)
+            {
+                remote_playlist_import_progress->emit(progress);
+            });
+
             on_track_moved.connect([remote_track_moved](const media::TrackList::TrackIdTuple &ids)
             {
                 remote_track_moved->emit(ids);
@@ -416,64 +1060,99 @@ struct media::TrackListSkeleton::Private
 
         core::Signal<Track::Id> on_track_added;
         core::Signal<TrackList::ContainerURI> on_tracks_added;
+        core::Signal<TrackList::PlaylistImportProgressTuple> on_playlist_import_progress;
         core::Signal<TrackList::TrackIdTuple> on_track_moved;
         core::Signal<Track::Id> on_track_removed;
         core::Signal<void> on_track_list_reset;
         core::Signal<Track::Id> on_track_changed;
         core::Signal<TrackList::ContainerTrackIdTuple> on_track_list_replaced;
         core::Signal<Track::Id> on_go_to_track;
+        core::Signal<TrackIdPositionTuple> on_go_to_track_at;
         core::Signal<void> on_end_of_tracklist;
     } signals;
 };
 
 media::TrackListSkeleton::TrackListSkeleton(const core::dbus::Bus::Ptr& bus, const core::dbus::Object::Ptr& object,
         const media::apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-        const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator)
-    : d(new Private(this, bus, object, request_context_resolver, request_authenticator))
+        const media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+        const media::SerialQueue::Ptr& dispatch_queue,
+        const media::ClientQuotas::Ptr& quotas,
+        const media::PeerCancellation::Ptr& cancellation)
+    : d(new Private(this, bus, object, request_context_resolver, request_authenticator, dispatch_queue, quotas,
+                    cancellation))
 {
+    // Batches of tracks and their metadata make way for playback control
+    const auto bulk = media::WorkerPool::Priority::bulk;
+
     d->object->install_method_handler<mpris::TrackList::GetTracksMetadata>(
-        std::bind(&Private::handle_get_tracks_metadata,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->metered(std::bind(&Private::handle_get_tracks_metadata,
+                             std::ref(d),
+                             std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::TrackList::GetTracksUri>(
-        std::bind(&Private::handle_get_tracks_uri,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_get_tracks_uri,
+                                std::ref(d),
+                                std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::TrackList::AddTrack>(
-        std::bind(&Private::handle_add_track_with_uri_at,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_add_track_with_uri_at,
+                                std::ref(d),
+                                std::placeholders::_1),
+                      bulk));
 
     d->object->install_method_handler<mpris::TrackList::AddTracks>(
-        std::bind(&Private::handle_add_tracks_with_uri_at,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched_with_token(std::bind(&Private::handle_add_tracks_with_uri_at,
+                                           std::ref(d),
+                                           std::placeholders::_1,
+                                           std::placeholders::_2),
+                                 bulk));
+
+    d->object->install_method_handler<mpris::TrackList::AddTracksFromPlaylist>(
+        d->dispatched_with_token(std::bind(&Private::handle_add_tracks_from_playlist,
+                                           std::ref(d),
+                                           std::placeholders::_1,
+                                           std::placeholders::_2),
+                                 bulk));
+
+    d->object->install_method_handler<mpris::TrackList::ReplaceTracks>(
+        d->dispatched_with_token(std::bind(&Private::handle_replace_tracks,
+                                           std::ref(d),
+                                           std::placeholders::_1,
+                                           std::placeholders::_2),
+                                 bulk));
 
     d->object->install_method_handler<mpris::TrackList::MoveTrack>(
-        std::bind(&Private::handle_move_track,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_move_track,
+                                std::ref(d),
+                                std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::TrackList::RemoveTrack>(
-        std::bind(&Private::handle_remove_track,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_remove_track,
+                                std::ref(d),
+                                std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::TrackList::GoTo>(
-        std::bind(&Private::handle_go_to,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_go_to,
+                                std::ref(d),
+                                std::placeholders::_1)));
 
     d->object->install_method_handler<mpris::TrackList::Reset>(
-        std::bind(&Private::handle_reset,
-                  std::ref(d),
-                  std::placeholders::_1));
+        d->dispatched(std::bind(&Private::handle_reset,
+                                std::ref(d),
+                                std::placeholders::_1)));
+
+    d->object->install_method_handler<core::dbus::interfaces::Properties::Get>(
+        std::bind(&Private::handle_get_property, std::ref(d), std::placeholders::_1));
+
+    d->object->install_method_handler<core::dbus::interfaces::Properties::GetAll>(
+        std::bind(&Private::handle_get_all, std::ref(d), std::placeholders::_1));
 }
 
 media::TrackListSkeleton::~TrackListSkeleton()
 {
+    // The object may outlive the skeleton, see ~PlayerSkeleton
+    d->object->uninstall_method_handler<core::dbus::interfaces::Properties::Get>();
+    d->object->uninstall_method_handler<core::dbus::interfaces::Properties::GetAll>();
 }
 
 /*
@@ -483,30 +1162,20 @@ media::TrackListSkeleton::~TrackListSkeleton()
  */
 bool media::TrackListSkeleton::has_next()
 {
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
     const auto n_tracks = tracks().get().size();
 
     if (n_tracks == 0)
         return false;
 
-    // TODO Using current_iterator() makes media-hub crash later. Logic for
-    // handling the iterators must be reviewed. As a minimum updates to the
-    // track list should update current_track instead of the list being sneakly
-    // changed in player_implementation.cpp.
-    // To avoid the crash we consider that current_track will be eventually
-    // initialized to the first track when current_iterator() gets called.
-    if (d->current_track == d->empty_iterator)
-    {
-        if (n_tracks < 2)
-            return false;
-        else
-            return true;
-    }
+    // If there is no current track yet it will be initialized to the first
+    // track when current_iterator() gets called.
+    if (d->current_index == Private::no_current_track)
+        return n_tracks >= 2;
 
     if (shuffle())
-    {
-        auto it = get_current_shuffled();
-        return ++it != shuffled_tracks().end();
-    }
+        return current_shuffled_position() + 1 < n_tracks;
     else
     {
         const auto next_track = std::next(current_iterator());
@@ -521,83 +1190,62 @@ bool media::TrackListSkeleton::has_next()
  */
 bool media::TrackListSkeleton::has_previous()
 {
-    if (tracks().get().empty() || d->current_track == d->empty_iterator)
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+    if (tracks().get().empty() || d->current_index == Private::no_current_track)
         return false;
 
     if (shuffle())
-        return get_current_shuffled() != shuffled_tracks().begin();
+        return current_shuffled_position() != 0;
     else
-        return d->current_track != std::begin(tracks().get());
+        return not is_first_track(current_iterator());
 }
 
-media::TrackList::ConstIterator media::TrackListSkeleton::get_current_shuffled()
+std::size_t media::TrackListSkeleton::current_shuffled_position()
 {
-    auto current_id = *current_iterator();
-    return find(shuffled_tracks().begin(), shuffled_tracks().end(), current_id);
+    const std::size_t index = std::distance(tracks().get().begin(), current_iterator());
+    return shuffle_order().position_of(index, tracks().get().size());
+}
+
+void media::TrackListSkeleton::set_current_shuffled_position(std::size_t position)
+{
+    const auto& container = tracks().get();
+    update_current_iterator(container.begin() + shuffle_order().at(position, container.size()));
 }
 
 media::Track::Id media::TrackListSkeleton::next()
 {
     MH_TRACE("");
-    if (tracks().get().empty()) {
-        // TODO Change ServiceSkeleton to return with error from DBus call
-        MH_ERROR("No tracks, cannot go to next");
-        return media::Track::Id{};
-    }
 
     bool go_to_track = false;
-
-    // End of the track reached so loop around to the beginning of the track
-    if (d->loop_status == media::Player::LoopStatus::track)
+    media::Track::Id id;
     {
-        MH_INFO("Looping on the current track since LoopStatus is set to track");
-        go_to_track = true;
-    }
-    // End of the tracklist reached so loop around to the beginning of the tracklist
-    else if (d->loop_status == media::Player::LoopStatus::playlist && not has_next())
-    {
-        MH_INFO("Looping on the tracklist since LoopStatus is set to playlist");
+        std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
 
-        if (shuffle())
-        {
-            const auto id = *shuffled_tracks().begin();
-            set_current_track(id);
-        }
-        else
-        {
-            d->current_track = tracks().get().begin();
-        }
-        go_to_track = true;
-    }
-    else
-    {
-        if (shuffle())
-        {
-            auto it = get_current_shuffled();
-            if (++it != shuffled_tracks().end()) {
-                MH_INFO("Advancing to next track: %s", *it);
-                set_current_track(*it);
-                go_to_track = true;
-            }
+        if (tracks().get().empty()) {
+            // TODO Change ServiceSkeleton to return with error from DBus call
+            MH_ERROR("No tracks, cannot go to next");
+            return media::Track::Id{};
         }
-        else
+
+        const auto& container = tracks().get();
+        const std::size_t index = index_after(std::distance(container.begin(), current_iterator()),
+                                              container.size());
+        if (index < container.size())
         {
-            const auto it = std::next(current_iterator());
-            if (not is_last_track(it))
-            {
-                MH_INFO("Advancing to next track: %s", *it);
-                d->current_track = it;
-                go_to_track = true;
-            }
+            update_current_iterator(container.begin() + index);
+            MH_INFO("Advancing to next track: %s", container[index]);
+            go_to_track = true;
         }
 
+        id = *(current_iterator());
+        publish_snapshot();
     }
 
     if (go_to_track)
     {
-        MH_DEBUG("next track id is %s", *(current_iterator()));
-        on_track_changed()(*(current_iterator()));
-        const media::Track::Id id = *(current_iterator());
+        MH_DEBUG("next track id is %s", id);
+        on_track_changed()(id);
         // Signal the PlayerImplementation to play the next track
         on_go_to_track()(id);
     }
@@ -608,74 +1256,77 @@ media::Track::Id media::TrackListSkeleton::next()
         on_end_of_tracklist()();
     }
 
-    return *(current_iterator());
+    return id;
 }
 
 media::Track::Id media::TrackListSkeleton::previous()
 {
     MH_TRACE("");
-    if (tracks().get().empty()) {
-        // TODO Change ServiceSkeleton to return with error from DBus call
-        MH_ERROR("No tracks, cannot go to previous");
-        return media::Track::Id{};
-    }
 
     bool go_to_track = false;
-    // Position is measured in nanoseconds
-    const uint64_t max_position = 5 * UINT64_C(1000000000);
-
-    // If we're playing the current track for > max_position time then
-    // repeat it from the beginning
-    if (d->current_position > max_position)
-    {
-        MH_INFO("Repeating current track...");
-        go_to_track = true;
-    }
-    // Loop on the current track forever
-    else if (d->loop_status == media::Player::LoopStatus::track)
+    media::Track::Id id;
     {
-        MH_INFO("Looping on the current track...");
-        go_to_track = true;
-    }
-    // Loop over the whole playlist and repeat
-    else if (d->loop_status == media::Player::LoopStatus::playlist && not has_previous())
-    {
-        MH_INFO("Looping on the entire TrackList...");
+        std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+        if (tracks().get().empty()) {
+            // TODO Change ServiceSkeleton to return with error from DBus call
+            MH_ERROR("No tracks, cannot go to previous");
+            return media::Track::Id{};
+        }
+
+        // Position is measured in nanoseconds
+        const uint64_t max_position = 5 * UINT64_C(1000000000);
 
-        if (shuffle())
+        // If we're playing the current track for > max_position time then
+        // repeat it from the beginning
+        if (d->current_position > max_position)
         {
-            const auto id = *std::prev(shuffled_tracks().end());
-            set_current_track(id);
+            MH_INFO("Repeating current track...");
+            go_to_track = true;
         }
-        else
+        // Loop on the current track forever
+        else if (d->loop_status == media::Player::LoopStatus::track)
         {
-            d->current_track = std::prev(tracks().get().end());
+            MH_INFO("Looping on the current track...");
+            go_to_track = true;
         }
+        // Loop over the whole playlist and repeat
+        else if (d->loop_status == media::Player::LoopStatus::playlist && not has_previous())
+        {
+            MH_INFO("Looping on the entire TrackList...");
 
-        go_to_track = true;
-    }
-    else
-    {
-        if (shuffle())
+            if (shuffle())
+                set_current_shuffled_position(tracks().get().size() - 1);
+            else
+                update_current_iterator(std::prev(tracks().get().end()));
+
+            go_to_track = true;
+        }
+        else
         {
-            auto it = get_current_shuffled();
-            if (it != shuffled_tracks().begin()) {
-                set_current_track(*(--it));
+            if (shuffle())
+            {
+                const std::size_t position = current_shuffled_position();
+                if (position != 0) {
+                    set_current_shuffled_position(position - 1);
+                    go_to_track = true;
+                }
+            }
+            else if (not is_first_track(current_iterator()))
+            {
+                // Keep returning the previous track until the first track is reached
+                update_current_iterator(std::prev(current_iterator()));
                 go_to_track = true;
             }
         }
-        else if (not is_first_track(current_iterator()))
-        {
-            // Keep returning the previous track until the first track is reached
-            d->current_track = std::prev(current_iterator());
-            go_to_track = true;
-        }
+
+        id = *(current_iterator());
+        publish_snapshot();
     }
 
     if (go_to_track)
     {
-        on_track_changed()(*(current_iterator()));
-        const media::Track::Id id = *(current_iterator());
+        on_track_changed()(id);
         on_go_to_track()(id);
     }
     else
@@ -685,29 +1336,151 @@ media::Track::Id media::TrackListSkeleton::previous()
         on_end_of_tracklist()();
     }
 
-    return *(current_iterator());
+    return id;
 }
 
-const media::Track::Id& media::TrackListSkeleton::current()
+media::Track::Id media::TrackListSkeleton::current()
 {
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+    if (tracks().get().empty())
+        return media::Track::Id{};
+
     return *(current_iterator());
 }
 
-const media::TrackList::ConstIterator& media::TrackListSkeleton::current_iterator()
+void media::TrackListSkeleton::replace_tracks_for(const std::string& sender,
+                                                 const media::CancellationToken& token,
+                                                 const ContainerURI& uris,
+                                                 std::size_t current,
+                                                 const std::chrono::microseconds& position,
+                                                 const Completion& done)
+{
+    d->replace_tracks_for(sender, token, uris, current, position, done);
+}
+
+media::TrackListSkeleton::Snapshot::Ptr media::TrackListSkeleton::snapshot() const
+{
+    return std::atomic_load(&d->snapshot);
+}
+
+std::recursive_mutex& media::TrackListSkeleton::writer_lane() const
+{
+    return d->writer_lane;
+}
+
+void media::TrackListSkeleton::publish_snapshot()
+{
+    const auto& container = tracks().get();
+    const std::size_t current = std::min(d->current_index, container.size());
+    const std::size_t next = index_after(d->current_index, container.size());
+    const Track::Id next_id = next < container.size() ? container[next] : Track::Id{};
+    std::atomic_store(&d->snapshot, std::make_shared<const Snapshot>(Snapshot{container, current, next_id}));
+}
+
+media::Track::Id media::TrackListSkeleton::advance_from(const Snapshot::Ptr& snapshot)
 {
+    const Track::Id previous = snapshot->current < snapshot->tracks.size()
+            ? snapshot->tracks[snapshot->current] : Track::Id{};
+    const Track::Id next = snapshot->next;
+
+    std::weak_ptr<media::TrackList> weak_track_list;
+    try {
+        weak_track_list = shared_from_this();
+    } catch (const std::bad_weak_ptr&) {
+        // Being torn down
+        return next;
+    }
+
+    const auto advance = [weak_track_list, previous, next]()
+    {
+        const auto sp = std::static_pointer_cast<media::TrackListSkeleton>(weak_track_list.lock());
+        if (not sp)
+            return;
+
+        {
+            std::lock_guard<std::recursive_mutex> lg(sp->d->writer_lane);
+            // Edited in the meantime, whoever did it picked the current track
+            if (sp->get_current_track() != previous)
+                return;
+
+            if (not next.empty())
+            {
+                sp->set_current_track(next);
+                sp->publish_snapshot();
+            }
+        }
+
+        if (next.empty())
+        {
+            MH_INFO("End of tracklist reached");
+            sp->on_end_of_tracklist()();
+        }
+        else
+        {
+            sp->on_track_changed()(next);
+        }
+    };
+
+    // Ahead of everything else of the session, the pipeline already moved on
+    if (d->dispatch_queue)
+        d->dispatch_queue->post(advance, media::WorkerPool::Priority::high);
+    else
+        advance();
+
+    return next;
+}
+
+std::size_t media::TrackListSkeleton::index_after(std::size_t current, std::size_t size)
+{
+    if (size == 0)
+        return size;
+
+    // Like current_iterator(), without a current track the first one is taken
+    if (current >= size)
+        current = 0;
+
+    // End of the track reached so loop around to the beginning of the track
+    if (d->loop_status == media::Player::LoopStatus::track)
+        return current;
+
+    // End of the tracklist reached so loop around to its beginning if set to
+    const bool wrap = d->loop_status == media::Player::LoopStatus::playlist;
+
+    if (shuffle())
+    {
+        const std::size_t position = shuffle_order().position_of(current, size) + 1;
+        if (position < size)
+            return shuffle_order().at(position, size);
+
+        return wrap ? shuffle_order().at(0, size) : size;
+    }
+
+    if (current + 1 < size)
+        return current + 1;
+
+    return wrap ? 0 : size;
+}
+
+media::TrackList::ConstIterator media::TrackListSkeleton::current_iterator()
+{
+    const auto& container = tracks().get();
+
     // Prevent the TrackList from sitting at the end which will cause
-    // a segfault when calling current()
-    if (tracks().get().size() && (d->current_track == d->empty_iterator))
+    // a segfault when dereferencing the iterator
+    if (not container.empty() and d->current_index >= container.size())
     {
-        MH_DEBUG("Wrapping d->current_track back to begin()");
-        d->current_track = d->skeleton.properties.tracks->get().begin();
+        MH_DEBUG("Wrapping current track back to begin()");
+        d->current_index = 0;
+        publish_snapshot();
     }
-    else if (tracks().get().empty())
+    else if (container.empty())
     {
         MH_ERROR("TrackList is empty therefore there is no valid current track");
+        return container.end();
     }
 
-    return d->current_track;
+    return container.begin() + d->current_index;
 }
 
 bool media::TrackListSkeleton::update_current_iterator(const TrackList::ConstIterator &it)
@@ -716,21 +1489,16 @@ bool media::TrackListSkeleton::update_current_iterator(const TrackList::ConstIte
     if (it == tracks().get().end())
         return false;
 
-    d->current_track = it;
+    d->current_index = std::distance(tracks().get().begin(), it);
 
     return true;
 }
 
-void media::TrackListSkeleton::reset_current_iterator_if_needed()
-{
-    d->current_track = find(tracks().get().begin(), tracks().get().end(), d->id_after_remove);
-    if (d->current_track == tracks().get().end())
-        d->current_track = d->empty_iterator;
-}
-
 media::Track::Id media::TrackListSkeleton::get_current_track(void)
 {
-    if (d->current_track == d->empty_iterator || tracks().get().empty())
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+    if (d->current_index == Private::no_current_track || tracks().get().empty())
         return media::Track::Id{};
 
     return *(current_iterator());
@@ -738,9 +1506,46 @@ media::Track::Id media::TrackListSkeleton::get_current_track(void)
 
 void media::TrackListSkeleton::set_current_track(const media::Track::Id& id)
 {
-    const auto id_it = find(tracks().get().begin(), tracks().get().end(), id);
-    if (id_it != tracks().get().end())
-        d->current_track = id_it;
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+    const auto& container = tracks().get();
+    const auto id_it = std::find(container.begin(), container.end(), id);
+    if (id_it != container.end())
+        d->current_index = std::distance(container.begin(), id_it);
+    else
+        d->current_index = Private::no_current_track;
+}
+
+media::Track::Id media::TrackListSkeleton::current_after_removing(const media::Track::Id& id, bool& removing_current)
+{
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+
+    removing_current = false;
+
+    const auto& container = tracks().get();
+    if (d->current_index == Private::no_current_track || container.empty())
+        return media::Track::Id{};
+
+    const auto current_it = current_iterator();
+    if (*current_it != id)
+        return *current_it;
+
+    MH_DEBUG("Removing current track");
+    removing_current = true;
+
+    auto next_it = std::next(current_it);
+    if (next_it == container.end() && d->loop_status == media::Player::LoopStatus::playlist)
+    {
+        // Removing the last track, the first one becomes current and the player
+        // starts playing it
+        next_it = container.begin();
+    }
+
+    // Nothing else to play if the removed track is the only one left
+    if (next_it == container.end() || next_it == current_it)
+        return media::Track::Id{};
+
+    return *next_it;
 }
 
 void media::TrackListSkeleton::emit_on_end_of_tracklist()
@@ -770,7 +1575,10 @@ void media::TrackListSkeleton::on_position_changed(uint64_t position)
 
 void media::TrackListSkeleton::on_loop_status_changed(const media::Player::LoopStatus& loop_status)
 {
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
     d->loop_status = loop_status;
+    // The track to go to next depends on it
+    publish_snapshot();
 }
 
 media::Player::LoopStatus media::TrackListSkeleton::loop_status() const
@@ -806,6 +1614,11 @@ const core::Signal<media::TrackList::ContainerURI>& media::TrackListSkeleton::on
     return d->signals.on_tracks_added;
 }
 
+const core::Signal<media::TrackList::PlaylistImportProgressTuple>& media::TrackListSkeleton::on_playlist_import_progress() const
+{
+    return d->signals.on_playlist_import_progress;
+}
+
 const core::Signal<media::TrackList::TrackIdTuple>& media::TrackListSkeleton::on_track_moved() const
 {
     return d->signals.on_track_moved;
@@ -831,6 +1644,11 @@ const core::Signal<media::Track::Id>& media::TrackListSkeleton::on_go_to_track()
     return d->signals.on_go_to_track;
 }
 
+const core::Signal<media::TrackListSkeleton::TrackIdPositionTuple>& media::TrackListSkeleton::on_go_to_track_at() const
+{
+    return d->signals.on_go_to_track_at;
+}
+
 const core::Signal<void>& media::TrackListSkeleton::on_end_of_tracklist() const
 {
     return d->signals.on_end_of_tracklist;
@@ -876,14 +1694,28 @@ core::Signal<media::Track::Id>& media::TrackListSkeleton::on_go_to_track()
     return d->signals.on_go_to_track;
 }
 
+core::Signal<media::TrackListSkeleton::TrackIdPositionTuple>& media::TrackListSkeleton::on_go_to_track_at()
+{
+    return d->signals.on_go_to_track_at;
+}
+
 core::Signal<void>& media::TrackListSkeleton::on_end_of_tracklist()
 {
     return d->signals.on_end_of_tracklist;
 }
 
+void media::TrackListSkeleton::add_tracks_from_playlist(const Track::UriType& playlist, const Track::Id& position)
+{
+    // Local callers are trusted, so the entries are not checked against any apparmor profile
+    d->start_playlist_import(std::make_shared<media::PlaylistParser>(playlist), playlist, position,
+            std::string{}, media::CancellationToken{}, [](const Track::UriType&) { return true; });
+}
+
 void media::TrackListSkeleton::reset()
 {
-    d->current_track = d->empty_iterator;
+    std::lock_guard<std::recursive_mutex> lg(d->writer_lane);
+    d->current_index = Private::no_current_track;
+    ++d->import_generation;
 }
 
 // operator<< pretty prints the given TrackList to the given output stream.
@@ -19,6 +19,10 @@
 #define CORE_UBUNTU_MEDIA_TRACK_LIST_SKELETON_H_
 
 #include "apparmor/ubuntu.h"
+#include "client_quotas.h"
+#include "peer_cancellation.h"
+#include "util/shuffle_permutation.h"
+#include "util/worker_pool.h"
 
 #include <core/media/track_list.h>
 
@@ -27,6 +31,11 @@
 #include <core/dbus/object.h>
 #include <core/dbus/skeleton.h>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
 namespace core
 {
 namespace ubuntu
@@ -36,16 +45,46 @@ namespace media
 class TrackListSkeleton : public core::ubuntu::media::TrackList
 {
 public:
+    typedef std::tuple<Track::Id, std::chrono::microseconds> TrackIdPositionTuple;
+
+    /** An immutable copy of the TrackList. Readers that must not wait for edits, like
+     *  the about-to-finish path, take one of these instead of reading tracks(). */
+    struct Snapshot
+    {
+        typedef std::shared_ptr<const Snapshot> Ptr;
+
+        Container tracks;
+        /** Index of the current track, tracks.size() if there is none. */
+        std::size_t current;
+        /** The track next() advances to, empty if it ends playback instead. */
+        Track::Id next;
+    };
+
+    /** Method calls are handled on dispatch_queue if given, on the bus thread otherwise.
+     *  Tracks and metadata requests are charged to the quotas of the calling client, if given.
+     *  Pending work of clients that left the bus is abandoned if cancellation is given. */
     TrackListSkeleton(const core::dbus::Bus::Ptr& bus, const core::dbus::Object::Ptr& object,
         const core::ubuntu::media::apparmor::ubuntu::RequestContextResolver::Ptr& request_context_resolver,
-        const core::ubuntu::media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator);
+        const core::ubuntu::media::apparmor::ubuntu::RequestAuthenticator::Ptr& request_authenticator,
+        const SerialQueue::Ptr& dispatch_queue = SerialQueue::Ptr{},
+        const ClientQuotas::Ptr& quotas = ClientQuotas::Ptr{},
+        const PeerCancellation::Ptr& cancellation = PeerCancellation::Ptr{});
     ~TrackListSkeleton();
 
     bool has_next();
     bool has_previous();
     Track::Id next();
     Track::Id previous();
-    const Track::Id& current();
+    Track::Id current();
+
+    /** Returns the most recently published snapshot, never blocks. */
+    Snapshot::Ptr snapshot() const;
+
+    /** For the about-to-finish path, which must not wait for edits of the TrackList:
+     *  returns snapshot->next right away and advances the TrackList to it on the
+     *  dispatch queue, like next() does apart from on_go_to_track. Nothing is moved
+     *  if the current track changed since the snapshot was taken. */
+    Track::Id advance_from(const Snapshot::Ptr& snapshot);
 
     const core::Property<bool>& can_edit_tracks() const;
     const core::Property<Container>& tracks() const;
@@ -56,6 +95,7 @@ public:
     core::Signal<Track::Id>& on_track_added();
     const core::Signal<ContainerURI>& on_tracks_added() const;
     core::Signal<ContainerURI>& on_tracks_added();
+    const core::Signal<PlaylistImportProgressTuple>& on_playlist_import_progress() const;
     const core::Signal<TrackIdTuple>& on_track_moved() const;
     core::Signal<TrackIdTuple>& on_track_moved();
     const core::Signal<Track::Id>& on_track_removed() const;
@@ -64,16 +104,34 @@ public:
     core::Signal<Track::Id>& on_track_changed();
     const core::Signal<Track::Id>& on_go_to_track() const;
     core::Signal<Track::Id>& on_go_to_track();
+    /** Like on_go_to_track, but playback starts from the given position. Not exported over D-Bus. */
+    const core::Signal<TrackIdPositionTuple>& on_go_to_track_at() const;
+    core::Signal<TrackIdPositionTuple>& on_go_to_track_at();
     const core::Signal<void>& on_end_of_tracklist() const;
     core::Signal<void>& on_end_of_tracklist();
     core::Signal<Track::Id>& on_track_removed();
     core::Signal<void>& on_track_list_reset();
 
     core::Property<Container>& tracks();
-    void on_loop_status_changed(const core::ubuntu::media::Player::LoopStatus& loop_status);
+
+    /** Throws PlaylistParser::Errors::FailedToOpenPlaylist if the playlist can't be read. */
+    void add_tracks_from_playlist(const Track::UriType& playlist, const Track::Id& position);
+
+    /** Gets an empty error_name on success, otherwise the D-Bus error to answer with. */
+    typedef std::function<void(const std::string& error_name, const std::string& error)> Completion;
+
+    /** Replaces the tracks with the same checks as a ReplaceTracks call of sender: every
+     *  URI has to exist and be allowed by the apparmor profile of sender, and the tracks
+     *  are charged to its quota. done runs on the dispatch queue, or not at all if the
+     *  token trips first. */
+    void replace_tracks_for(const std::string& sender, const CancellationToken& token,
+                            const ContainerURI& uris, std::size_t current,
+                            const std::chrono::microseconds& position, const Completion& done);
+
+    virtual void on_loop_status_changed(const core::ubuntu::media::Player::LoopStatus& loop_status);
     core::ubuntu::media::Player::LoopStatus loop_status() const;
 
-    void on_position_changed(uint64_t position);
+    virtual void on_position_changed(uint64_t position);
 
     /** Gets called when the shuffle property on the Player interface is changed
      * by the client */
@@ -81,19 +139,32 @@ public:
 
     virtual void set_shuffle(bool shuffle) = 0;
     virtual bool shuffle() = 0;
-    virtual const media::TrackList::Container& shuffled_tracks() = 0;
+    virtual const media::ShufflePermutation& shuffle_order() = 0;
 
 protected:
     inline bool is_first_track(const ConstIterator &it)
     { return it == std::begin(tracks().get()); }
     inline bool is_last_track(const ConstIterator &it)
     { return it == std::end(tracks().get()); }
-    const TrackList::ConstIterator& current_iterator();
+    // All edits of the TrackList and of its current track are serialized through
+    // the writer lane. Signals should be emitted after releasing it.
+    std::recursive_mutex& writer_lane() const;
+    // Makes the current state visible to snapshot(), call with the writer lane held
+    virtual void publish_snapshot();
+    // The iterator is only valid as long as the writer lane is held
+    TrackList::ConstIterator current_iterator();
     bool update_current_iterator(const TrackList::ConstIterator &it);
-    void reset_current_iterator_if_needed();
     media::Track::Id get_current_track(void);
+    // Clears the current track if id is not part of the TrackList
     void set_current_track(const media::Track::Id& id);
-    TrackList::ConstIterator get_current_shuffled();
+    // The track that becomes the current one once id is removed, empty if there is none
+    media::Track::Id current_after_removing(const media::Track::Id& id, bool& removing_current);
+    // Index of the track that next() moves to from current, size if it ends
+    // playback instead. Call with the writer lane held.
+    std::size_t index_after(std::size_t current, std::size_t size);
+    // Position of the current track within the shuffled order
+    std::size_t current_shuffled_position();
+    void set_current_shuffled_position(std::size_t position);
 
     core::Property<bool>& can_edit_tracks();
 
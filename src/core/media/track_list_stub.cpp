@@ -21,6 +21,9 @@
 #include <core/media/player.h>
 #include <core/media/track_list.h>
 
+#include "async_call.h"
+#include "cached_remote_property.h"
+#include "lazy_remote_signal.h"
 #include "property_stub.h"
 #include "track_list_traits.h"
 #include "the_session_bus.h"
@@ -36,151 +39,182 @@
 #include <core/dbus/types/stl/map.h>
 #include <core/dbus/types/stl/vector.h>
 
+#include <algorithm>
 #include <limits>
 
 namespace dbus = core::dbus;
 namespace media = core::ubuntu::media;
 
-struct media::TrackListStub::Private
+namespace
+{
+void throw_add_track_error(const dbus::Error& error)
+{
+    if (error.name() == mpris::TrackList::Error::InsufficientPermissionsToAddTrack::name)
+        throw media::TrackList::Errors::InsufficientPermissionsToAddTrack{};
+    else if (error.name() == mpris::Player::Error::UriNotFound::name)
+        throw media::Player::Errors::UriNotFound{error.print()};
+    else if (error.name() == mpris::TrackList::Error::QuotaExceeded::name)
+        throw media::TrackList::Errors::QuotaExceeded{error.print()};
+    else
+        throw std::runtime_error{error.print()};
+}
+
+void throw_move_track_error(const dbus::Error& error)
+{
+    if (error.name() == mpris::TrackList::Error::FailedToMoveTrack::name)
+        throw media::TrackList::Errors::FailedToMoveTrack{};
+    else if (error.name() == mpris::TrackList::Error::FailedToFindMoveTrackSource::name)
+        throw media::TrackList::Errors::FailedToFindMoveTrackSource{error.print()};
+    else if (error.name() == mpris::TrackList::Error::FailedToFindMoveTrackDest::name)
+        throw media::TrackList::Errors::FailedToFindMoveTrackDest{error.print()};
+    else
+        throw std::runtime_error{error.print()};
+}
+
+void throw_remove_track_error(const dbus::Error& error)
+{
+    if (error.name() == mpris::TrackList::Error::TrackNotFound::name)
+        throw media::TrackList::Errors::TrackNotFound{};
+    else
+        throw std::runtime_error{"Problem removing track: " + error.print()};
+}
+
+media::ErrorTranslator fails_with(const std::string& what)
+{
+    return [what](const dbus::Error& error) { throw std::runtime_error{what + error.print()}; };
+}
+}
+
+struct media::TrackListStub::Private : public std::enable_shared_from_this<media::TrackListStub::Private>
 {
     Private(
             TrackListStub* impl,
             const std::shared_ptr<media::Player>& parent,
-            const dbus::Object::Ptr& object)
+            const dbus::Object::Ptr& object,
+            const mpris::TrackList::Dictionary& properties)
         : impl(impl),
           parent(parent),
           object(object),
-          can_edit_tracks(object->get_property<mpris::TrackList::Properties::CanEditTracks>()),
-          tracks(object->get_property<mpris::TrackList::Properties::Tracks>()),
-          signals
-          {
-              object->get_signal<mpris::TrackList::Signals::TrackAdded>(),
-              object->get_signal<mpris::TrackList::Signals::TracksAdded>(),
-              object->get_signal<mpris::TrackList::Signals::TrackMoved>(),
-              object->get_signal<mpris::TrackList::Signals::TrackRemoved>(),
-              object->get_signal<mpris::TrackList::Signals::TrackListReset>(),
-              object->get_signal<mpris::TrackList::Signals::TrackListReplaced>(),
-              object->get_signal<mpris::TrackList::Signals::TrackChanged>()
-          }
+          can_edit_tracks(std::make_shared<media::CachedRemoteProperty<bool>>(
+                              object->get_property<mpris::TrackList::Properties::CanEditTracks>())),
+          tracks(std::make_shared<media::CachedRemoteProperty<media::TrackList::Container>>(
+                     object->get_property<mpris::TrackList::Properties::Tracks>())),
+          tracks_invalidated(),
+          properties_changed(object->get_signal<core::dbus::interfaces::Properties::Signals::PropertiesChanged>()),
+          signals{object}
     {
-    }
+        auto it = properties.find(mpris::TrackList::Properties::CanEditTracks::name());
+        if (it != properties.end())
+            can_edit_tracks->refresh(it->second.as<bool>());
 
-    TrackListStub* impl;
-    std::shared_ptr<media::Player> parent;
-    dbus::Object::Ptr object;
+        it = properties.find(mpris::TrackList::Properties::Tracks::name());
+        if (it != properties.end())
+            tracks->refresh(it->second.as<media::TrackList::Container>());
 
-    std::shared_ptr<core::dbus::Property<mpris::TrackList::Properties::CanEditTracks>> can_edit_tracks;
-    std::shared_ptr<core::dbus::Property<mpris::TrackList::Properties::Tracks>> tracks;
+        // Changes to the tracks are only announced, without the new value
+        properties_changed->connect([this](const core::dbus::interfaces::Properties::Signals::PropertiesChanged::ArgumentType& args)
+        {
+            const auto& invalidated = std::get<2>(args);
+            if (std::find(invalidated.begin(), invalidated.end(),
+                          mpris::TrackList::Properties::Tracks::name()) == invalidated.end())
+                return;
 
+            invalidate_tracks();
+        });
+    }
 
-    struct Signals
+    void invalidate_tracks()
     {
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TrackAdded, mpris::TrackList::Signals::TrackAdded::ArgumentType> DBusTrackAddedSignal;
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TracksAdded, mpris::TrackList::Signals::TracksAdded::ArgumentType> DBusTracksAddedSignal;
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TrackMoved, mpris::TrackList::Signals::TrackMoved::ArgumentType> DBusTrackMovedSignal;
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TrackRemoved, mpris::TrackList::Signals::TrackRemoved::ArgumentType> DBusTrackRemovedSignal;
-        typedef core::dbus::Signal<
-            mpris::TrackList::Signals::TrackListReset,
-            mpris::TrackList::Signals::TrackListReset::ArgumentType>
-                DBusTrackListResetSignal;
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TrackListReplaced, mpris::TrackList::Signals::TrackListReplaced::ArgumentType> DBusTrackListReplacedSignal;
-        typedef core::dbus::Signal<mpris::TrackList::Signals::TrackChanged, mpris::TrackList::Signals::TrackChanged::ArgumentType> DBusTrackChangedSignal;
-
-        Signals(const std::shared_ptr<DBusTrackAddedSignal>& track_added,
-                const std::shared_ptr<DBusTracksAddedSignal>& tracks_added,
-                const std::shared_ptr<DBusTrackMovedSignal>& track_moved,
-                const std::shared_ptr<DBusTrackRemovedSignal>& track_removed,
-                const std::shared_ptr<DBusTrackListResetSignal>& track_list_reset,
-                const std::shared_ptr<DBusTrackListReplacedSignal>& track_list_replaced,
-                const std::shared_ptr<DBusTrackChangedSignal>& track_changed)
-            : on_track_added(),
-              on_tracks_added(),
-              on_track_moved(),
-              on_track_removed(),
-              on_track_list_reset(),
-              on_track_list_replaced(),
-              on_track_changed(),
-              dbus
-              {
-                  track_added,
-                  tracks_added,
-                  track_moved,
-                  track_removed,
-                  track_list_reset,
-                  track_list_replaced,
-                  track_changed,
-              }
-        {
-            dbus.on_track_added->connect([this](const Track::Id& id)
-            {
-                MH_DEBUG("OnTrackAdded signal arrived via the bus.");
-                on_track_added(id);
-            });
+        tracks->invalidate();
+        tracks_invalidated();
+    }
 
-            dbus.on_tracks_added->connect([this](const media::TrackList::ContainerURI& tracks)
-            {
-                MH_DEBUG("OnTracksAdded signal arrived via the bus.");
-                on_tracks_added(tracks);
-            });
+    // Sends Method without waiting for the reply. Once the call went through,
+    // the tracks are invalidated before done learns about the result.
+    template<typename Method, typename... Args>
+    void invoke_then_invalidate(const std::function<void(const dbus::Result<void>&)>& done, const Args&... args)
+    {
+        std::weak_ptr<Private> wp{shared_from_this()};
+        object->invoke_method_asynchronously_with_callback<Method, void>(
+                    [wp, done](const dbus::Result<void>& result)
+                    {
+                        if (not result.is_error())
+                        {
+                            if (auto sp = wp.lock())
+                                sp->invalidate_tracks();
+                        }
+
+                        done(result);
+                    }, args...);
+    }
 
-            dbus.on_track_moved->connect([this](const media::TrackList::TrackIdTuple& ids)
-            {
-                MH_DEBUG("OnTrackMoved signal arrived via the bus.");
-                on_track_moved(ids);
-            });
+    template<typename Method, typename... Args>
+    std::future<void> edit_async(const media::ErrorTranslator& translate, const Args&... args)
+    {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto future = promise->get_future();
 
-            dbus.on_track_removed->connect([this](const Track::Id& id)
+        try
+        {
+            invoke_then_invalidate<Method>([promise, translate](const dbus::Result<void>& result)
             {
-                MH_DEBUG("OnTrackRemoved signal arrived via the bus.");
-                on_track_removed(id);
-            });
+                media::complete(*promise, result, translate);
+            }, args...);
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
 
-            dbus.on_track_list_reset->connect([this](void)
-            {
-                MH_DEBUG("OnTrackListReset signal arrived via the bus.");
-                on_track_list_reset();
-            });
+        return future;
+    }
 
-            dbus.on_track_list_replaced->connect([this](const media::TrackList::ContainerTrackIdTuple& list)
-            {
-                MH_DEBUG("OnTrackListReplaced signal arrived via the bus.");
-                on_track_list_replaced(list);
-            });
+    TrackListStub* impl;
+    std::shared_ptr<media::Player> parent;
+    dbus::Object::Ptr object;
 
-            dbus.on_track_changed->connect([this](const Track::Id& id)
-            {
-                MH_DEBUG("OnTrackChanged signal arrived via the bus.");
-                on_track_changed(id);
-            });
+    media::CachedRemoteProperty<bool>::Ptr can_edit_tracks;
+    media::CachedRemoteProperty<media::TrackList::Container>::Ptr tracks;
+
+    core::Signal<void> tracks_invalidated;
+    core::dbus::Signal<
+        core::dbus::interfaces::Properties::Signals::PropertiesChanged,
+        core::dbus::interfaces::Properties::Signals::PropertiesChanged::ArgumentType
+    >::Ptr properties_changed;
+
+    // Only subscribed to once a client asks for them
+    struct Signals
+    {
+        explicit Signals(const dbus::Object::Ptr& object)
+            : on_track_added{object},
+              on_tracks_added{object},
+              on_playlist_import_progress{object},
+              on_track_moved{object},
+              on_track_removed{object},
+              on_track_list_reset{object},
+              on_track_list_replaced{object},
+              on_track_changed{object}
+        {
         }
 
-        core::Signal<Track::Id> on_track_added;
-        core::Signal<media::TrackList::ContainerURI> on_tracks_added;
-        core::Signal<media::TrackList::TrackIdTuple> on_track_moved;
-        core::Signal<Track::Id> on_track_removed;
-        core::Signal<void> on_track_list_reset;
-        core::Signal<media::TrackList::ContainerTrackIdTuple> on_track_list_replaced;
-        core::Signal<Track::Id> on_track_changed;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackAdded> on_track_added;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TracksAdded> on_tracks_added;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::PlaylistImportProgress> on_playlist_import_progress;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackMoved> on_track_moved;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackRemoved> on_track_removed;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackListReset> on_track_list_reset;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackListReplaced> on_track_list_replaced;
+        media::LazyRemoteSignal<mpris::TrackList::Signals::TrackChanged> on_track_changed;
         core::Signal<Track::Id> on_go_to_track;
         core::Signal<void> on_end_of_tracklist;
-
-        struct DBus
-        {
-            std::shared_ptr<DBusTrackAddedSignal> on_track_added;
-            std::shared_ptr<DBusTracksAddedSignal> on_tracks_added;
-            std::shared_ptr<DBusTrackMovedSignal> on_track_moved;
-            std::shared_ptr<DBusTrackRemovedSignal> on_track_removed;
-            std::shared_ptr<DBusTrackListResetSignal> on_track_list_reset;
-            std::shared_ptr<DBusTrackListReplacedSignal> on_track_list_replaced;
-            std::shared_ptr<DBusTrackChangedSignal> on_track_changed;
-        } dbus;
     } signals;
 };
 
 media::TrackListStub::TrackListStub(
         const std::shared_ptr<media::Player>& parent,
-        const core::dbus::Object::Ptr& object)
-    : d(new Private(this, parent, object))
+        const core::dbus::Object::Ptr& object,
+        const std::map<std::string, core::dbus::types::Variant>& properties)
+    : d(new Private(this, parent, object, properties))
 {
 }
 
@@ -238,15 +272,9 @@ void media::TrackListStub::add_track_with_uri_at(
                 make_current);
 
     if (op.is_error())
-    {
-        if (op.error().name() ==
-                mpris::TrackList::Error::InsufficientPermissionsToAddTrack::name)
-            throw media::TrackList::Errors::InsufficientPermissionsToAddTrack{};
-        else if (op.error().name() == mpris::Player::Error::UriNotFound::name)
-            throw media::Player::Errors::UriNotFound{op.error().print()};
-        else
-            throw std::runtime_error{op.error().print()};
-    }
+        throw_add_track_error(op.error());
+
+    d->invalidate_tracks();
 }
 
 void media::TrackListStub::add_tracks_with_uri_at(const ContainerURI& uris, const Track::Id& position)
@@ -255,6 +283,33 @@ void media::TrackListStub::add_tracks_with_uri_at(const ContainerURI& uris, cons
                 uris,
                 position);
 
+    if (op.is_error())
+        throw_add_track_error(op.error());
+
+    d->invalidate_tracks();
+}
+
+void media::TrackListStub::add_tracks_from_playlist(const Track::UriType& playlist, const Track::Id& position)
+{
+    auto op = d->object->invoke_method_synchronously<mpris::TrackList::AddTracksFromPlaylist, void>(
+                playlist,
+                position);
+
+    if (op.is_error())
+        throw_add_track_error(op.error());
+
+    d->invalidate_tracks();
+}
+
+void media::TrackListStub::replace_tracks(const ContainerURI& uris,
+                                         std::size_t current,
+                                         const std::chrono::microseconds& position)
+{
+    auto op = d->object->invoke_method_synchronously<mpris::TrackList::ReplaceTracks, void>(
+                uris,
+                static_cast<std::uint64_t>(current),
+                static_cast<std::int64_t>(position.count()));
+
     if (op.is_error())
     {
         if (op.error().name() ==
@@ -262,9 +317,15 @@ void media::TrackListStub::add_tracks_with_uri_at(const ContainerURI& uris, cons
             throw media::TrackList::Errors::InsufficientPermissionsToAddTrack{};
         else if (op.error().name() == mpris::Player::Error::UriNotFound::name)
             throw media::Player::Errors::UriNotFound{op.error().print()};
+        else if (op.error().name() == mpris::TrackList::Error::QuotaExceeded::name)
+            throw media::TrackList::Errors::QuotaExceeded{op.error().print()};
+        else if (op.error().name() == mpris::TrackList::Error::TrackNotFound::name)
+            throw media::TrackList::Errors::TrackNotFound{};
         else
             throw std::runtime_error{op.error().print()};
     }
+
+    d->invalidate_tracks();
 }
 
 bool media::TrackListStub::move_track(const media::Track::Id& id, const media::Track::Id& to)
@@ -272,22 +333,9 @@ bool media::TrackListStub::move_track(const media::Track::Id& id, const media::T
     auto op = d->object->invoke_method_synchronously<mpris::TrackList::MoveTrack, void>(id, to);
 
     if (op.is_error())
-    {
-        if (op.error().name() ==
-                mpris::TrackList::Error::FailedToMoveTrack::name)
-            throw media::TrackList::Errors::FailedToMoveTrack{};
-        else if (op.error().name() ==
-                mpris::TrackList::Error::FailedToFindMoveTrackSource::name)
-            throw media::TrackList::Errors::FailedToFindMoveTrackSource{op.error().print()};
-        else if (op.error().name() ==
-                mpris::TrackList::Error::FailedToFindMoveTrackDest::name)
-            throw media::TrackList::Errors::FailedToFindMoveTrackDest{op.error().print()};
-        else
-            throw std::runtime_error{op.error().print()};
-
-        return false;
-    }
+        throw_move_track_error(op.error());
 
+    d->invalidate_tracks();
     return true;
 }
 
@@ -297,13 +345,9 @@ void media::TrackListStub::remove_track(const media::Track::Id& track)
                 track);
 
     if (op.is_error())
-    {
-        if (op.error().name() ==
-                mpris::TrackList::Error::TrackNotFound::name)
-            throw media::TrackList::Errors::TrackNotFound{};
-        else
-            throw std::runtime_error{"Problem removing track: " + op.error().print()};
-    }
+        throw_remove_track_error(op.error());
+
+    d->invalidate_tracks();
 }
 
 void media::TrackListStub::go_to(const media::Track::Id& track)
@@ -332,41 +376,151 @@ void media::TrackListStub::reset()
 
     if (op.is_error())
         throw std::runtime_error("Problem resetting tracklist: " + op.error());
+
+    d->invalidate_tracks();
+}
+
+std::future<media::Track::MetaData> media::TrackListStub::query_meta_data_for_track_async(const media::Track::Id& id)
+{
+    auto promise = std::make_shared<std::promise<media::Track::MetaData>>();
+    auto future = promise->get_future();
+
+    const auto translate = fails_with("Problem querying meta data for track: ");
+    try
+    {
+        d->object->invoke_method_asynchronously_with_callback<
+                mpris::TrackList::GetTracksMetadata,
+                std::map<std::string, std::string>>(
+                    [promise, translate](const dbus::Result<std::map<std::string, std::string>>& result)
+                    {
+                        try
+                        {
+                            if (result.is_error())
+                                translate(result.error());
+
+                            media::Track::MetaData md;
+                            for (const auto& pair : result.value())
+                                md.set(pair.first, pair.second);
+
+                            promise->set_value(md);
+                        }
+                        catch (...)
+                        {
+                            promise->set_exception(std::current_exception());
+                        }
+                    }, id);
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    return future;
+}
+
+std::future<media::Track::UriType> media::TrackListStub::query_uri_for_track_async(const media::Track::Id& id)
+{
+    return media::invoke_async<mpris::TrackList::GetTracksUri, std::string>(
+                d->object, fails_with("Problem querying track for uri: "), id);
+}
+
+std::future<void> media::TrackListStub::add_track_with_uri_at_async(
+        const media::Track::UriType& uri,
+        const media::Track::Id& position,
+        bool make_current)
+{
+    return d->edit_async<mpris::TrackList::AddTrack>(throw_add_track_error, uri, position, make_current);
+}
+
+std::future<void> media::TrackListStub::add_tracks_with_uri_at_async(const ContainerURI& uris, const Track::Id& position)
+{
+    return d->edit_async<mpris::TrackList::AddTracks>(throw_add_track_error, uris, position);
+}
+
+std::future<bool> media::TrackListStub::move_track_async(const media::Track::Id& id, const media::Track::Id& to)
+{
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+
+    try
+    {
+        d->invoke_then_invalidate<mpris::TrackList::MoveTrack>([promise](const dbus::Result<void>& result)
+        {
+            try
+            {
+                if (result.is_error())
+                    throw_move_track_error(result.error());
+
+                promise->set_value(true);
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        }, id, to);
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    return future;
+}
+
+std::future<void> media::TrackListStub::remove_track_async(const media::Track::Id& track)
+{
+    return d->edit_async<mpris::TrackList::RemoveTrack>(throw_remove_track_error, track);
+}
+
+std::future<void> media::TrackListStub::go_to_async(const media::Track::Id& track)
+{
+    return media::invoke_async<mpris::TrackList::GoTo, void>(
+                d->object, fails_with("Problem adding track: "), track);
+}
+
+std::future<void> media::TrackListStub::reset_async()
+{
+    return d->edit_async<mpris::TrackList::Reset>(fails_with("Problem resetting tracklist: "));
 }
 
 const core::Signal<media::TrackList::ContainerTrackIdTuple>& media::TrackListStub::on_track_list_replaced() const
 {
-    return d->signals.on_track_list_replaced;
+    return d->signals.on_track_list_replaced.get();
 }
 
 const core::Signal<media::Track::Id>& media::TrackListStub::on_track_added() const
 {
-    return d->signals.on_track_added;
+    return d->signals.on_track_added.get();
 }
 
 const core::Signal<media::TrackList::ContainerURI>& media::TrackListStub::on_tracks_added() const
 {
-    return d->signals.on_tracks_added;
+    return d->signals.on_tracks_added.get();
+}
+
+const core::Signal<media::TrackList::PlaylistImportProgressTuple>& media::TrackListStub::on_playlist_import_progress() const
+{
+    return d->signals.on_playlist_import_progress.get();
 }
 
 const core::Signal<media::TrackList::TrackIdTuple>& media::TrackListStub::on_track_moved() const
 {
-    return d->signals.on_track_moved;
+    return d->signals.on_track_moved.get();
 }
 
 const core::Signal<media::Track::Id>& media::TrackListStub::on_track_removed() const
 {
-    return d->signals.on_track_removed;
+    return d->signals.on_track_removed.get();
 }
 
 const core::Signal<void>& media::TrackListStub::on_track_list_reset() const
 {
-    return d->signals.on_track_list_reset;
+    return d->signals.on_track_list_reset.get();
 }
 
 const core::Signal<media::Track::Id>& media::TrackListStub::on_track_changed() const
 {
-    return d->signals.on_track_changed;
+    return d->signals.on_track_changed.get();
 }
 
 const core::Signal<media::Track::Id>& media::TrackListStub::on_go_to_track() const
@@ -378,3 +532,8 @@ const core::Signal<void>& media::TrackListStub::on_end_of_tracklist() const
 {
     return d->signals.on_end_of_tracklist;
 }
+
+const core::Signal<void>& media::TrackListStub::on_tracks_invalidated() const
+{
+    return d->tracks_invalidated;
+}
@@ -24,8 +24,11 @@
 #include "track_list_traits.h"
 
 #include <core/dbus/stub.h>
+#include <core/dbus/types/variant.h>
 
+#include <map>
 #include <memory>
+#include <string>
 
 namespace core
 {
@@ -36,9 +39,13 @@ namespace media
 class TrackListStub : public core::ubuntu::media::TrackList
 {
 public:
+    // Reads of the properties are answered from properties until the service
+    // tells about changes to them.
     TrackListStub(
             const std::shared_ptr<Player>& parent,
-            const core::dbus::Object::Ptr& object);
+            const core::dbus::Object::Ptr& object,
+            const std::map<std::string, core::dbus::types::Variant>& properties =
+                std::map<std::string, core::dbus::types::Variant>{});
     ~TrackListStub();
 
     const core::Property<bool>& can_edit_tracks() const;
@@ -49,6 +56,8 @@ public:
 
     void add_track_with_uri_at(const Track::UriType& uri, const Track::Id& position, bool make_current);
     void add_tracks_with_uri_at(const ContainerURI& uris, const Track::Id& position);
+    void add_tracks_from_playlist(const Track::UriType& playlist, const Track::Id& position);
+    void replace_tracks(const ContainerURI& uris, std::size_t current, const std::chrono::microseconds& position);
     bool move_track(const Track::Id& id, const Track::Id& to);
     void remove_track(const Track::Id& id);
 
@@ -59,9 +68,19 @@ public:
 
     void reset();
 
+    std::future<Track::MetaData> query_meta_data_for_track_async(const Track::Id& id);
+    std::future<Track::UriType> query_uri_for_track_async(const Track::Id& id);
+    std::future<void> add_track_with_uri_at_async(const Track::UriType& uri, const Track::Id& position, bool make_current);
+    std::future<void> add_tracks_with_uri_at_async(const ContainerURI& uris, const Track::Id& position);
+    std::future<bool> move_track_async(const Track::Id& id, const Track::Id& to);
+    std::future<void> remove_track_async(const Track::Id& id);
+    std::future<void> go_to_async(const Track::Id& track);
+    std::future<void> reset_async();
+
     const core::Signal<ContainerTrackIdTuple>& on_track_list_replaced() const;
     const core::Signal<Track::Id>& on_track_added() const;
     const core::Signal<ContainerURI>& on_tracks_added() const;
+    const core::Signal<PlaylistImportProgressTuple>& on_playlist_import_progress() const;
     const core::Signal<TrackIdTuple>& on_track_moved() const;
     const core::Signal<Track::Id>& on_track_removed() const;
     const core::Signal<void>& on_track_list_reset() const;
@@ -69,9 +88,13 @@ public:
     const core::Signal<Track::Id>& on_go_to_track() const;
     const core::Signal<void>& on_end_of_tracklist() const;
 
+    // Emitted when the service says the tracks changed, without telling how
+    const core::Signal<void>& on_tracks_invalidated() const;
+
 private:
     struct Private;
-    std::unique_ptr<Private> d;
+    // Shared with replies to asynchronous calls that are still on their way
+    std::shared_ptr<Private> d;
 };
 }
 }
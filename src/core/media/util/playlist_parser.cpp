@@ -0,0 +1,327 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "playlist_parser.h"
+
+#include "core/media/logger/logger.h"
+
+#include <gio/gio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+bool ends_with(const std::string& s, const std::string& suffix)
+{
+    if (s.size() < suffix.size())
+        return false;
+
+    return std::equal(suffix.rbegin(), suffix.rend(), s.rbegin(), [](char a, char b)
+    {
+        return ::tolower(a) == ::tolower(b);
+    });
+}
+
+std::string strip(const std::string& s)
+{
+    static const char* whitespace = " \t\r\n";
+    const auto begin = s.find_first_not_of(whitespace);
+    if (begin == std::string::npos)
+        return std::string{};
+
+    const auto end = s.find_last_not_of(whitespace);
+    return s.substr(begin, end - begin + 1);
+}
+
+bool format_from_uri(const std::string& uri, media::PlaylistParser::Format& format)
+{
+    // Ignore any query or fragment when looking at the extension
+    const std::string path = uri.substr(0, uri.find_first_of("?#"));
+
+    if (ends_with(path, ".m3u") or ends_with(path, ".m3u8"))
+        format = media::PlaylistParser::Format::m3u;
+    else if (ends_with(path, ".pls"))
+        format = media::PlaylistParser::Format::pls;
+    else if (ends_with(path, ".xspf"))
+        format = media::PlaylistParser::Format::xspf;
+    else
+        return false;
+
+    return true;
+}
+}
+
+struct media::PlaylistParser::Private
+{
+    Private(const Track::UriType& uri)
+        : file(g_file_new_for_commandline_arg(uri.c_str())),
+          parent(g_file_get_parent(file)),
+          stream(nullptr),
+          markup(nullptr),
+          format(Format::m3u),
+          at_end(false),
+          has_pending_line(false),
+          in_track(false),
+          in_location(false)
+    {
+        GError *error = nullptr;
+        GFileInputStream *file_stream = g_file_read(file, nullptr, &error);
+        if (not file_stream)
+        {
+            const std::string err_str{error ? error->message : "unknown error"};
+            g_clear_error(&error);
+            g_object_unref(file);
+            if (parent)
+                g_object_unref(parent);
+            throw Errors::FailedToOpenPlaylist{"Failed to open playlist " + uri + ": " + err_str};
+        }
+
+        stream = g_data_input_stream_new(G_INPUT_STREAM(file_stream));
+        g_data_input_stream_set_newline_type(stream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+        g_object_unref(file_stream);
+
+        if (not format_from_uri(uri, format))
+            sniff_format();
+
+        if (format == Format::xspf)
+        {
+            static GMarkupParser parser
+            {
+                &Private::on_start_element,
+                &Private::on_end_element,
+                &Private::on_text,
+                nullptr,
+                nullptr
+            };
+            markup = g_markup_parse_context_new(&parser, static_cast<GMarkupParseFlags>(0), this, nullptr);
+        }
+    }
+
+    ~Private()
+    {
+        if (markup)
+            g_markup_parse_context_free(markup);
+        g_object_unref(stream);
+        if (parent)
+            g_object_unref(parent);
+        g_object_unref(file);
+    }
+
+    // Looks at the first line of a playlist without a known extension. The
+    // line is kept around so that it's parsed like any other one.
+    void sniff_format()
+    {
+        std::string line;
+        if (not read_line(line))
+            return;
+
+        const std::string s = strip(line);
+        if (s.compare(0, 10, "[playlist]") == 0)
+            format = Format::pls;
+        else if (s.compare(0, 5, "<?xml") == 0 or s.compare(0, 9, "<playlist") == 0)
+            format = Format::xspf;
+        else
+            format = Format::m3u;
+
+        pending_line = line;
+        has_pending_line = true;
+    }
+
+    bool read_line(std::string& line)
+    {
+        if (has_pending_line)
+        {
+            line.swap(pending_line);
+            has_pending_line = false;
+            return true;
+        }
+
+        if (at_end)
+            return false;
+
+        GError *error = nullptr;
+        gsize length = 0;
+        gchar *tmp = g_data_input_stream_read_line(stream, &length, nullptr, &error);
+        if (not tmp)
+        {
+            if (error)
+            {
+                MH_WARNING("Failed to read playlist line: %s", error->message);
+                g_clear_error(&error);
+            }
+            at_end = true;
+            return false;
+        }
+
+        line.assign(tmp, length);
+        g_free(tmp);
+        return true;
+    }
+
+    // Turns a playlist entry into an absolute URI.
+    Track::UriType resolve(const std::string& entry) const
+    {
+        gchar *scheme = g_uri_parse_scheme(entry.c_str());
+        if (scheme)
+        {
+            g_free(scheme);
+            return entry;
+        }
+
+        GFile *resolved = nullptr;
+        if (g_path_is_absolute(entry.c_str()))
+            resolved = g_file_new_for_path(entry.c_str());
+        else if (parent)
+            resolved = g_file_resolve_relative_path(parent, entry.c_str());
+        else
+            return entry;
+
+        gchar *uri = g_file_get_uri(resolved);
+        const Track::UriType result{uri};
+        g_free(uri);
+        g_object_unref(resolved);
+
+        return result;
+    }
+
+    void parse_line(const std::string& line)
+    {
+        const std::string s = strip(line);
+        if (s.empty())
+            return;
+
+        switch (format)
+        {
+        case Format::m3u:
+            // Everything starting with '#' is either a comment or an extended M3U directive
+            if (s[0] != '#')
+                entries.push_back(resolve(s));
+            break;
+        case Format::pls:
+            // Only FileN=... entries are of interest, titles and lengths are ignored
+            if (s.compare(0, 4, "File") == 0)
+            {
+                const auto eq = s.find('=');
+                if (eq != std::string::npos and eq + 1 < s.size())
+                    entries.push_back(resolve(strip(s.substr(eq + 1))));
+            }
+            break;
+        case Format::xspf:
+        {
+            const std::string chunk{line + "\n"};
+            GError *error = nullptr;
+            if (not g_markup_parse_context_parse(markup, chunk.c_str(), chunk.size(), &error))
+            {
+                MH_WARNING("Failed to parse XSPF playlist: %s", error->message);
+                g_clear_error(&error);
+                at_end = true;
+            }
+            break;
+        }
+        }
+    }
+
+    static void on_start_element(GMarkupParseContext*, const gchar *element_name,
+            const gchar**, const gchar**, gpointer user_data, GError**)
+    {
+        auto p = static_cast<Private*>(user_data);
+        if (std::strcmp(element_name, "track") == 0)
+            p->in_track = true;
+        else if (p->in_track and std::strcmp(element_name, "location") == 0)
+        {
+            p->in_location = true;
+            p->location.clear();
+        }
+    }
+
+    static void on_end_element(GMarkupParseContext*, const gchar *element_name,
+            gpointer user_data, GError**)
+    {
+        auto p = static_cast<Private*>(user_data);
+        if (std::strcmp(element_name, "track") == 0)
+            p->in_track = false;
+        else if (p->in_location and std::strcmp(element_name, "location") == 0)
+        {
+            p->in_location = false;
+            const std::string location = strip(p->location);
+            if (not location.empty())
+                p->entries.push_back(p->resolve(location));
+        }
+    }
+
+    static void on_text(GMarkupParseContext*, const gchar *text, gsize text_len,
+            gpointer user_data, GError**)
+    {
+        auto p = static_cast<Private*>(user_data);
+        // Text may be delivered in several pieces, so accumulate until </location>
+        if (p->in_location)
+            p->location.append(text, text_len);
+    }
+
+    GFile *file;
+    GFile *parent;
+    GDataInputStream *stream;
+    GMarkupParseContext *markup;
+    Format format;
+    bool at_end;
+    std::string pending_line;
+    bool has_pending_line;
+    // Entries that were parsed but not yet handed out
+    std::deque<Track::UriType> entries;
+    // XSPF parser state
+    bool in_track;
+    bool in_location;
+    std::string location;
+};
+
+bool media::PlaylistParser::is_playlist(const Track::UriType& uri)
+{
+    Format format;
+    return format_from_uri(uri, format);
+}
+
+media::PlaylistParser::PlaylistParser(const Track::UriType& uri)
+    : d(new Private(uri))
+{
+}
+
+media::PlaylistParser::~PlaylistParser()
+{
+}
+
+media::PlaylistParser::Format media::PlaylistParser::format() const
+{
+    return d->format;
+}
+
+bool media::PlaylistParser::read_entries(std::size_t max_count, TrackList::ContainerURI& uris)
+{
+    std::string line;
+    while (d->entries.size() < max_count and d->read_line(line))
+        d->parse_line(line);
+
+    const std::size_t n = std::min(max_count, d->entries.size());
+    uris.insert(uris.end(), d->entries.begin(), d->entries.begin() + n);
+    d->entries.erase(d->entries.begin(), d->entries.begin() + n);
+
+    return not (d->entries.empty() and d->at_end and not d->has_pending_line);
+}
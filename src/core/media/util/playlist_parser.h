@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_PLAYLIST_PARSER_H_
+#define CORE_UBUNTU_MEDIA_PLAYLIST_PARSER_H_
+
+#include <core/media/track_list.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Reads the entries of a M3U, PLS or XSPF playlist incrementally, so that
+// a huge playlist never has to be held in memory as a whole. Relative
+// entries are resolved against the location of the playlist itself.
+class PlaylistParser
+{
+public:
+    typedef std::shared_ptr<PlaylistParser> Ptr;
+
+    enum class Format
+    {
+        m3u,
+        pls,
+        xspf
+    };
+
+    struct Errors
+    {
+        Errors() = delete;
+
+        struct FailedToOpenPlaylist : public std::runtime_error
+        {
+            FailedToOpenPlaylist(const std::string& err)
+                : std::runtime_error{err}
+            {
+            }
+        };
+    };
+
+    // Returns true if uri looks like a playlist file we know how to parse.
+    static bool is_playlist(const Track::UriType& uri);
+
+    // Throws Errors::FailedToOpenPlaylist if uri can't be read.
+    PlaylistParser(const Track::UriType& uri);
+    ~PlaylistParser();
+
+    PlaylistParser(const PlaylistParser&) = delete;
+    PlaylistParser& operator=(const PlaylistParser&) = delete;
+
+    Format format() const;
+
+    // Appends up to max_count entries to uris. Returns false once the end
+    // of the playlist has been reached and no more entries will follow.
+    bool read_entries(std::size_t max_count, TrackList::ContainerURI& uris);
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PLAYLIST_PARSER_H_
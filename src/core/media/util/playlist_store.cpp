@@ -0,0 +1,723 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "playlist_store.h"
+#include "playlist_parser.h"
+#include "record_file.h"
+
+#include "core/media/logger/logger.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+// The store is a record_file of the following records.
+namespace
+{
+const char magic[4] = {'M', 'H', 'P', 'L'};
+const std::uint32_t version{1};
+
+const std::size_t n_orderings{4};
+// Entries are read from playlist files in chunks of this size.
+const std::size_t import_batch_size{1024};
+
+enum class Record : std::uint8_t
+{
+    // A complete playlist, replacing an earlier one with the same id.
+    put = 1,
+    remove,
+    played,
+    // Written when compacting, so that ids of removed playlists aren't handed out again.
+    next_id
+};
+
+using media::record_file::Reader;
+using media::record_file::write_all;
+
+struct Writer : public media::record_file::Writer
+{
+    explicit Writer(Record type)
+        : media::record_file::Writer{static_cast<std::uint8_t>(type)}
+    {
+    }
+};
+
+std::int64_t to_us(const media::PlaylistStore::TimePoint& tp)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+}
+
+media::PlaylistStore::TimePoint from_us(std::int64_t us)
+{
+    return media::PlaylistStore::TimePoint{std::chrono::duration_cast<media::PlaylistStore::TimePoint::duration>(
+            std::chrono::microseconds{us})};
+}
+
+// Case insensitive key that sorts names the way the user's locale expects.
+std::string collate_key_for(const std::string& name)
+{
+    if (not g_utf8_validate(name.c_str(), name.size(), nullptr))
+        return name;
+
+    gchar *folded = g_utf8_casefold(name.c_str(), name.size());
+    gchar *key = g_utf8_collate_key(folded, -1);
+    const std::string result{key};
+    g_free(key);
+    g_free(folded);
+
+    return result;
+}
+
+std::string name_from_path(const std::string& path)
+{
+    const auto slash = path.find_last_of('/');
+    std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    const auto dot = name.find_last_of('.');
+    if (dot != std::string::npos and dot > 0)
+        name.erase(dot);
+
+    return name;
+}
+}
+
+struct media::PlaylistStore::Private
+{
+    struct Entry
+    {
+        Playlist playlist;
+        std::string collate_key;
+        TrackList::ContainerURI uris;
+    };
+
+    // Strict weak ordering of the index for ordering, ties are broken by id.
+    struct Less
+    {
+        bool operator()(const Entry* lhs, const Entry* rhs) const
+        {
+            switch (ordering)
+            {
+            case Ordering::alphabetical:
+                if (lhs->collate_key != rhs->collate_key)
+                    return lhs->collate_key < rhs->collate_key;
+                break;
+            case Ordering::creation_date:
+                if (lhs->playlist.created != rhs->playlist.created)
+                    return lhs->playlist.created < rhs->playlist.created;
+                break;
+            case Ordering::modified_date:
+                if (lhs->playlist.modified != rhs->playlist.modified)
+                    return lhs->playlist.modified < rhs->playlist.modified;
+                break;
+            case Ordering::last_play_date:
+                if (lhs->playlist.last_played != rhs->playlist.last_played)
+                    return lhs->playlist.last_played < rhs->playlist.last_played;
+                break;
+            }
+
+            return lhs->playlist.id < rhs->playlist.id;
+        }
+
+        Ordering ordering;
+    };
+
+    typedef std::vector<const Entry*> Index;
+
+    Private(const std::string& path)
+        : path(path),
+          fd(-1),
+          n_records(0),
+          next_id(1)
+    {
+    }
+
+    ~Private()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    static Ordering ordering_at(std::size_t i)
+    {
+        return static_cast<Ordering>(i);
+    }
+
+    void index_insert(const Entry* entry)
+    {
+        for (std::size_t i = 0; i < n_orderings; i++)
+        {
+            const Less less{ordering_at(i)};
+            Index& index = indexes[i];
+            // New and just touched playlists go to the end of all but the alphabetical index
+            if (index.empty() or less(index.back(), entry))
+                index.push_back(entry);
+            else
+                index.insert(std::upper_bound(index.begin(), index.end(), entry, less), entry);
+        }
+    }
+
+    // Needs to be called before any of the sort keys of entry change
+    void index_erase(const Entry* entry)
+    {
+        for (std::size_t i = 0; i < n_orderings; i++)
+        {
+            Index& index = indexes[i];
+            const auto it = std::lower_bound(index.begin(), index.end(), entry, Less{ordering_at(i)});
+            if (it != index.end() and *it == entry)
+                index.erase(it);
+        }
+    }
+
+    void rebuild_indexes()
+    {
+        for (std::size_t i = 0; i < n_orderings; i++)
+        {
+            Index& index = indexes[i];
+            index.clear();
+            index.reserve(entries.size());
+            for (const auto& pair : entries)
+                index.push_back(&pair.second);
+            std::sort(index.begin(), index.end(), Less{ordering_at(i)});
+        }
+    }
+
+    // Inserts or replaces a playlist, without touching the indexes
+    Entry& put(const Playlist& playlist, const TrackList::ContainerURI& uris)
+    {
+        Entry& entry = entries[playlist.id];
+        if (not entry.playlist.source.empty())
+            by_source.erase(entry.playlist.source);
+
+        entry.playlist = playlist;
+        entry.collate_key = collate_key_for(playlist.name);
+        entry.uris = uris;
+        if (not playlist.source.empty())
+            by_source[playlist.source] = playlist.id;
+        next_id = std::max(next_id, playlist.id + 1);
+
+        return entry;
+    }
+
+    void erase(Id id)
+    {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+
+        if (not it->second.playlist.source.empty())
+            by_source.erase(it->second.playlist.source);
+        entries.erase(it);
+    }
+
+    static Writer put_record(const Entry& entry)
+    {
+        const Playlist& p = entry.playlist;
+        Writer writer{Record::put};
+        writer << p.id << p.source << p.name << p.icon
+               << to_us(p.created) << to_us(p.modified) << to_us(p.last_played)
+               << static_cast<std::uint32_t>(entry.uris.size());
+        for (const auto& uri : entry.uris)
+            writer << uri;
+        return writer;
+    }
+
+    void append(Writer&& writer)
+    {
+        ++n_records;
+        if (fd < 0)
+            return;
+
+        if (not write_all(fd, writer.finish()))
+            MH_WARNING("Failed to write to playlist store %s: %s", path, std::strerror(errno));
+    }
+
+    // Applies a single record, returns false if the record is malformed.
+    bool replay(Record type, Reader& payload)
+    {
+        switch (type)
+        {
+        case Record::put:
+        {
+            Playlist playlist;
+            std::int64_t created = 0, modified = 0, last_played = 0;
+            std::uint32_t n = 0;
+            if (not payload.read(playlist.id) or not payload.read(playlist.source)
+                    or not payload.read(playlist.name) or not payload.read(playlist.icon)
+                    or not payload.read(created) or not payload.read(modified)
+                    or not payload.read(last_played) or not payload.read(n))
+                return false;
+
+            TrackList::ContainerURI uris;
+            uris.reserve(n);
+            for (std::uint32_t i = 0; i < n; i++)
+            {
+                Track::UriType uri;
+                if (not payload.read(uri))
+                    return false;
+                uris.push_back(uri);
+            }
+
+            playlist.created = from_us(created);
+            playlist.modified = from_us(modified);
+            playlist.last_played = from_us(last_played);
+            put(playlist, uris);
+            break;
+        }
+        case Record::remove:
+        {
+            Id id = 0;
+            if (not payload.read(id))
+                return false;
+            erase(id);
+            next_id = std::max(next_id, id + 1);
+            break;
+        }
+        case Record::played:
+        {
+            Id id = 0;
+            std::int64_t when = 0;
+            if (not payload.read(id) or not payload.read(when))
+                return false;
+
+            const auto it = entries.find(id);
+            if (it != entries.end())
+                it->second.playlist.last_played = from_us(when);
+            break;
+        }
+        case Record::next_id:
+        {
+            Id id = 0;
+            if (not payload.read(id))
+                return false;
+            next_id = std::max(next_id, id);
+            break;
+        }
+        default:
+            // Written by a newer version, skip it
+            MH_WARNING("Skipping unknown playlist store record type %d", static_cast<int>(type));
+            break;
+        }
+
+        return true;
+    }
+
+    void load()
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0 or static_cast<std::size_t>(st.st_size) < record_file::header_size)
+        {
+            ::close(fd);
+            return;
+        }
+
+        const std::size_t size = st.st_size;
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            MH_WARNING("Failed to map playlist store %s: %s", path, std::strerror(errno));
+            return;
+        }
+        ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+        const char *begin = static_cast<const char*>(mapping);
+        if (not record_file::has_header(begin, size, magic, version))
+        {
+            MH_WARNING("Ignoring playlist store %s with unknown format", path);
+            ::munmap(mapping, size);
+            return;
+        }
+
+        Reader reader{begin + record_file::header_size, begin + size};
+        while (not reader.at_end())
+        {
+            std::uint8_t type = 0;
+            Reader payload{nullptr, nullptr};
+            if (not reader.next_record(type, payload) or not replay(static_cast<Record>(type), payload))
+            {
+                MH_WARNING("Playlist store %s is truncated after %d records", path, n_records);
+                break;
+            }
+            ++n_records;
+        }
+
+        ::munmap(mapping, size);
+    }
+
+    // Rewrites the log as one put record per playlist and keeps appending to it
+    void compact()
+    {
+        const std::string tmp_path = path + ".tmp";
+        const int tmp_fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (tmp_fd < 0)
+        {
+            MH_WARNING("Failed to compact playlist store %s: %s", path, std::strerror(errno));
+            return;
+        }
+
+        std::string data = record_file::header(magic, version);
+        Writer writer{Record::next_id};
+        writer << next_id;
+        data += writer.finish();
+        // Written in creation order, so that loading appends to the indexes
+        for (const Entry* entry : indexes[static_cast<std::size_t>(Ordering::creation_date)])
+            data += put_record(*entry).finish();
+
+        const bool written = write_all(tmp_fd, data);
+        ::close(tmp_fd);
+        if (not written or std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            MH_WARNING("Failed to compact playlist store %s: %s", path, std::strerror(errno));
+            std::remove(tmp_path.c_str());
+            return;
+        }
+
+        n_records = entries.size() + 1;
+    }
+
+    void open_for_appending()
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            // Playlists still work, they just don't survive a restart
+            MH_WARNING("Failed to open playlist store %s: %s", path, std::strerror(errno));
+            return;
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 and st.st_size == 0)
+            write_all(fd, record_file::header(magic, version));
+    }
+
+    bool set(Id id, const std::string& name, const std::string& icon,
+             const TrackList::ContainerURI& uris, const TimePoint& modified)
+    {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return false;
+
+        Playlist playlist = it->second.playlist;
+        playlist.name = name;
+        playlist.icon = icon;
+        playlist.modified = modified;
+
+        index_erase(&it->second);
+        const Entry& entry = put(playlist, uris);
+        index_insert(&entry);
+        append(put_record(entry));
+
+        return true;
+    }
+
+    Id add(const std::string& name, const std::string& icon, const TrackList::ContainerURI& uris,
+           const Track::UriType& source, const TimePoint& created)
+    {
+        Playlist playlist;
+        playlist.id = next_id;
+        playlist.name = name;
+        playlist.icon = icon;
+        playlist.source = source;
+        playlist.created = created;
+        playlist.modified = created;
+
+        const Entry& entry = put(playlist, uris);
+        index_insert(&entry);
+        append(put_record(entry));
+
+        return playlist.id;
+    }
+
+    bool remove(Id id)
+    {
+        const auto it = entries.find(id);
+        if (it == entries.end())
+            return false;
+
+        index_erase(&it->second);
+        erase(id);
+        Writer writer{Record::remove};
+        writer << id;
+        append(std::move(writer));
+
+        return true;
+    }
+
+    std::string path;
+    int fd;
+    std::size_t n_records;
+
+    mutable std::mutex guard;
+    Id next_id;
+    // Nodes of an unordered_map stay put, so the indexes point right into it
+    std::unordered_map<Id, Entry> entries;
+    std::map<Track::UriType, Id> by_source;
+    Index indexes[n_orderings];
+};
+
+std::string media::PlaylistStore::default_path()
+{
+    gchar *dir = g_build_filename(g_get_user_data_dir(), "media-hub", nullptr);
+    g_mkdir_with_parents(dir, 0700);
+
+    const std::string path = std::string{dir} + "/playlists.store";
+    g_free(dir);
+
+    return path;
+}
+
+std::string media::PlaylistStore::default_import_directory()
+{
+    const gchar *dir = g_get_user_special_dir(G_USER_DIRECTORY_MUSIC);
+    return dir ? std::string{dir} : std::string{};
+}
+
+media::PlaylistStore::PlaylistStore(const std::string& path)
+    : d(new Private(path))
+{
+    d->load();
+    d->rebuild_indexes();
+
+    // Edits of the same playlists pile up over time
+    if (d->n_records > 2 * d->entries.size() + 64)
+        d->compact();
+
+    d->open_for_appending();
+}
+
+media::PlaylistStore::~PlaylistStore()
+{
+}
+
+std::size_t media::PlaylistStore::size() const
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+    return d->entries.size();
+}
+
+media::PlaylistStore::Id media::PlaylistStore::add(const std::string& name,
+                                                   const std::string& icon,
+                                                   const TrackList::ContainerURI& uris,
+                                                   const Track::UriType& source)
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+    return d->add(name, icon, uris, source, std::chrono::system_clock::now());
+}
+
+bool media::PlaylistStore::update(Id id,
+                                  const std::string& name,
+                                  const std::string& icon,
+                                  const TrackList::ContainerURI& uris)
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+    return d->set(id, name, icon, uris, std::chrono::system_clock::now());
+}
+
+bool media::PlaylistStore::remove(Id id)
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+    return d->remove(id);
+}
+
+bool media::PlaylistStore::mark_played(Id id)
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+
+    const auto it = d->entries.find(id);
+    if (it == d->entries.end())
+        return false;
+
+    const TimePoint now = std::chrono::system_clock::now();
+    d->index_erase(&it->second);
+    it->second.playlist.last_played = now;
+    d->index_insert(&it->second);
+
+    Writer writer{Record::played};
+    writer << id << to_us(now);
+    d->append(std::move(writer));
+
+    return true;
+}
+
+bool media::PlaylistStore::playlist(Id id, Playlist& playlist) const
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+
+    const auto it = d->entries.find(id);
+    if (it == d->entries.end())
+        return false;
+
+    playlist = it->second.playlist;
+    return true;
+}
+
+bool media::PlaylistStore::uris(Id id, TrackList::ContainerURI& uris) const
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+
+    const auto it = d->entries.find(id);
+    if (it == d->entries.end())
+        return false;
+
+    uris = it->second.uris;
+    return true;
+}
+
+std::vector<media::PlaylistStore::Playlist> media::PlaylistStore::playlists(std::size_t index,
+                                                                            std::size_t max_count,
+                                                                            Ordering ordering,
+                                                                            bool reverse) const
+{
+    std::lock_guard<std::mutex> lg(d->guard);
+
+    const Private::Index& sorted = d->indexes[static_cast<std::size_t>(ordering)];
+    std::vector<Playlist> result;
+    if (index >= sorted.size())
+        return result;
+
+    const std::size_t n = std::min(max_count, sorted.size() - index);
+    result.reserve(n);
+    for (std::size_t i = index; i < index + n; i++)
+        result.push_back(sorted[reverse ? sorted.size() - 1 - i : i]->playlist);
+
+    return result;
+}
+
+bool media::PlaylistStore::import_directory(const std::string& dir, const std::function<bool()>& cancelled)
+{
+    GError *error = nullptr;
+    GDir *gdir = g_dir_open(dir.c_str(), 0, &error);
+    if (not gdir)
+    {
+        MH_DEBUG("Not importing playlists from %s: %s", dir, error->message);
+        g_error_free(error);
+        return false;
+    }
+
+    // Only look at files on disk once, the parsing happens without holding the lock
+    std::map<Track::UriType, TimePoint> files;
+    while (const gchar *name = g_dir_read_name(gdir))
+    {
+        if (cancelled())
+            break;
+
+        const std::string path = dir + "/" + name;
+        gchar *uri = g_filename_to_uri(path.c_str(), nullptr, nullptr);
+        if (not uri)
+            continue;
+
+        const Track::UriType file_uri{uri};
+        g_free(uri);
+
+        struct stat st;
+        if (not PlaylistParser::is_playlist(file_uri) or ::stat(path.c_str(), &st) < 0
+                or not S_ISREG(st.st_mode))
+            continue;
+
+        files[file_uri] = TimePoint{std::chrono::duration_cast<TimePoint::duration>(
+                std::chrono::seconds{st.st_mtime})};
+    }
+    g_dir_close(gdir);
+
+    // Files not listed yet would be taken for deleted ones
+    if (cancelled())
+        return false;
+
+    std::vector<std::pair<Track::UriType, TimePoint>> changed;
+    std::vector<Id> deleted;
+    {
+        std::lock_guard<std::mutex> lg(d->guard);
+
+        for (const auto& file : files)
+        {
+            const auto it = d->by_source.find(file.first);
+            if (it == d->by_source.end() or d->entries.at(it->second).playlist.modified < file.second)
+                changed.push_back(file);
+        }
+
+        gchar *dir_uri = g_filename_to_uri(dir.c_str(), nullptr, nullptr);
+        const std::string prefix = std::string{dir_uri ? dir_uri : ""} + "/";
+        g_free(dir_uri);
+
+        for (auto it = d->by_source.lower_bound(prefix);
+             it != d->by_source.end() and it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            if (files.count(it->first) == 0)
+                deleted.push_back(it->second);
+        }
+    }
+
+    std::size_t imported = 0;
+    for (const auto& file : changed)
+    {
+        if (cancelled())
+        {
+            MH_DEBUG("Import of playlists from %s cancelled", dir);
+            return imported > 0;
+        }
+
+        TrackList::ContainerURI uris;
+        try {
+            PlaylistParser parser{file.first};
+            while (parser.read_entries(import_batch_size, uris))
+            {
+                if (cancelled())
+                {
+                    MH_DEBUG("Import of playlists from %s cancelled", dir);
+                    return imported > 0;
+                }
+            }
+        } catch (const PlaylistParser::Errors::FailedToOpenPlaylist& e) {
+            MH_WARNING("Not importing playlist: %s", e.what());
+            continue;
+        }
+
+        const std::string name = name_from_path(file.first);
+
+        std::lock_guard<std::mutex> lg(d->guard);
+        const auto it = d->by_source.find(file.first);
+        if (it == d->by_source.end())
+            d->add(name, std::string{}, uris, file.first, file.second);
+        else
+            d->set(it->second, name, d->entries.at(it->second).playlist.icon, uris, file.second);
+        imported++;
+    }
+
+    std::lock_guard<std::mutex> lg(d->guard);
+    for (const Id id : deleted)
+        d->remove(id);
+
+    MH_DEBUG("Imported %d playlists from %s, %d are gone", changed.size(), dir, deleted.size());
+
+    return not changed.empty() or not deleted.empty();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_PLAYLIST_STORE_H_
+#define CORE_UBUNTU_MEDIA_PLAYLIST_STORE_H_
+
+#include <core/media/track.h>
+#include <core/media/track_list.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// The playlists offered through org.mpris.MediaPlayer2.Playlists. Every
+// ordering of the MPRIS spec is kept as a sorted index that is updated along
+// with each edit, so a page of GetPlaylists is a slice of an index instead of
+// a sort of all playlists. The store itself is persisted as an append-only
+// log of edits, which is compacted when loading. The indexes only live in
+// memory, they are rebuilt from the log on load.
+class PlaylistStore
+{
+public:
+    typedef std::shared_ptr<PlaylistStore> Ptr;
+    typedef std::uint64_t Id;
+    typedef std::chrono::system_clock::time_point TimePoint;
+
+    enum class Ordering
+    {
+        alphabetical,
+        creation_date,
+        modified_date,
+        last_play_date
+    };
+
+    struct Playlist
+    {
+        Id id = 0;
+        std::string name;
+        std::string icon;
+        // The playlist file this playlist was imported from, if any.
+        Track::UriType source;
+        TimePoint created;
+        TimePoint modified;
+        // Playlists that have never been played sort before all others.
+        TimePoint last_played;
+    };
+
+    // Location of the store of the current user.
+    static std::string default_path();
+    // Directory the playlist files of the current user are imported from.
+    static std::string default_import_directory();
+
+    // Loads the store at path, or starts an empty one if there is none yet.
+    explicit PlaylistStore(const std::string& path);
+    ~PlaylistStore();
+
+    PlaylistStore(const PlaylistStore&) = delete;
+    PlaylistStore& operator=(const PlaylistStore&) = delete;
+
+    std::size_t size() const;
+
+    Id add(const std::string& name, const std::string& icon, const TrackList::ContainerURI& uris,
+           const Track::UriType& source = Track::UriType{});
+    // Replaces name, icon and entries of a playlist and bumps its modification date.
+    bool update(Id id, const std::string& name, const std::string& icon, const TrackList::ContainerURI& uris);
+    bool remove(Id id);
+    bool mark_played(Id id);
+
+    bool playlist(Id id, Playlist& playlist) const;
+    bool uris(Id id, TrackList::ContainerURI& uris) const;
+
+    // Returns at most max_count playlists starting at index in the given
+    // ordering. Ties are broken by the order the playlists were added in.
+    std::vector<Playlist> playlists(std::size_t index, std::size_t max_count,
+                                    Ordering ordering, bool reverse) const;
+
+    // Adds the playlist files in dir that are not known yet, refreshes the ones
+    // that changed on disk and drops the ones that were deleted. Returns true if
+    // the store changed. Stops between playlist files and between batches of
+    // their entries once cancelled returns true, keeping what got imported.
+    bool import_directory(const std::string& dir,
+                          const std::function<bool()>& cancelled = []() { return false; });
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_PLAYLIST_STORE_H_
@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef RECORD_FILE_H_
+#define RECORD_FILE_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// Helpers for the small append-only files media-hub keeps its state in. Such
+// a file starts with a 4 byte magic and a uint32 version, followed by records
+// of the form
+//
+//   uint32 payload size | uint8 record type | payload
+//
+// where strings are stored as a uint32 length followed by the bytes. The files
+// never leave the machine, so all integers are stored in host byte order.
+namespace record_file
+{
+const std::size_t header_size{4 + sizeof(std::uint32_t)};
+const std::size_t record_header_size{sizeof(std::uint32_t) + sizeof(std::uint8_t)};
+
+inline std::string header(const char (&magic)[4], std::uint32_t version)
+{
+    std::string header{magic, sizeof(magic)};
+    header.append(reinterpret_cast<const char*>(&version), sizeof(version));
+    return header;
+}
+
+inline bool has_header(const char* begin, std::size_t size, const char (&magic)[4], std::uint32_t version)
+{
+    if (size < header_size)
+        return false;
+
+    std::uint32_t file_version = 0;
+    std::memcpy(&file_version, begin + sizeof(magic), sizeof(file_version));
+    return std::memcmp(begin, magic, sizeof(magic)) == 0 and file_version == version;
+}
+
+class Writer
+{
+public:
+    explicit Writer(std::uint8_t type)
+    {
+        buffer.resize(record_header_size);
+        buffer[sizeof(std::uint32_t)] = static_cast<char>(type);
+    }
+
+    template<typename T>
+    Writer& operator<<(T value)
+    {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        return *this;
+    }
+
+    Writer& operator<<(const std::string& s)
+    {
+        *this << static_cast<std::uint32_t>(s.size());
+        buffer.append(s);
+        return *this;
+    }
+
+    const std::string& finish()
+    {
+        const std::uint32_t size = buffer.size() - record_header_size;
+        std::memcpy(&buffer[0], &size, sizeof(size));
+        return buffer;
+    }
+
+private:
+    std::string buffer;
+};
+
+// Reads from a mapped file, every read fails instead of running past the end.
+class Reader
+{
+public:
+    Reader(const char* begin, const char* end)
+        : pos(begin),
+          end(end)
+    {
+    }
+
+    bool at_end() const
+    {
+        return pos == end;
+    }
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (static_cast<std::size_t>(end - pos) < sizeof(value))
+            return false;
+
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    bool read(std::string& s)
+    {
+        std::uint32_t size = 0;
+        if (not read(size) or static_cast<std::size_t>(end - pos) < size)
+            return false;
+
+        s.assign(pos, size);
+        pos += size;
+        return true;
+    }
+
+    // Splits off the payload of the next record
+    bool next_record(std::uint8_t& type, Reader& payload)
+    {
+        std::uint32_t size = 0;
+        if (not read(size) or not read(type) or static_cast<std::size_t>(end - pos) < size)
+            return false;
+
+        payload = Reader{pos, pos + size};
+        pos += size;
+        return true;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+inline bool write_all(int fd, const std::string& data)
+{
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        written += n;
+    }
+
+    return true;
+}
+}
+}
+}
+}
+
+#endif // RECORD_FILE_H_
@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHUFFLE_PERMUTATION_H_
+#define SHUFFLE_PERMUTATION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// A pseudo random permutation of the indices [0, n) that is computed on the
+// fly instead of being stored. It is a small Feistel network over the next
+// even power of two >= n, restricted to [0, n) by cycle walking, so that both
+// directions are O(1) (expected) and the order only depends on the seed and n.
+// A different n yields an unrelated order, there is no state to carry the old
+// one over with.
+class ShufflePermutation
+{
+public:
+    explicit ShufflePermutation(std::uint64_t seed = 0)
+        : seed_(seed)
+    {
+    }
+
+    std::uint64_t seed() const
+    {
+        return seed_;
+    }
+
+    // Returns the index that is played at the given position of the shuffled order.
+    std::size_t at(std::size_t position, std::size_t n) const
+    {
+        if (n < 2)
+            return position;
+
+        const unsigned half_bits = half_bits_for(n);
+        std::uint64_t x = position;
+        do
+        {
+            x = encrypt(x, half_bits);
+        } while (x >= n);
+
+        return static_cast<std::size_t>(x);
+    }
+
+    // Returns the position within the shuffled order at which the given index is played.
+    std::size_t position_of(std::size_t index, std::size_t n) const
+    {
+        if (n < 2)
+            return index;
+
+        const unsigned half_bits = half_bits_for(n);
+        std::uint64_t x = index;
+        do
+        {
+            x = decrypt(x, half_bits);
+        } while (x >= n);
+
+        return static_cast<std::size_t>(x);
+    }
+
+private:
+    static constexpr unsigned rounds{4};
+
+    // Both halves need to be of equal size for the network to be a bijection.
+    static unsigned half_bits_for(std::size_t n)
+    {
+        unsigned bits = 1;
+        while ((std::uint64_t{1} << (2 * bits)) < n)
+            ++bits;
+        return bits;
+    }
+
+    // splitmix64 finalizer, mixing the round key into the half block.
+    std::uint64_t round_function(std::uint64_t half, unsigned round) const
+    {
+        std::uint64_t z = half + seed_ + (std::uint64_t{round} + 1) * UINT64_C(0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t encrypt(std::uint64_t x, unsigned half_bits) const
+    {
+        const std::uint64_t mask = (std::uint64_t{1} << half_bits) - 1;
+        std::uint64_t left = x >> half_bits, right = x & mask;
+        for (unsigned round = 0; round < rounds; round++)
+        {
+            const std::uint64_t tmp = right;
+            right = left ^ (round_function(right, round) & mask);
+            left = tmp;
+        }
+        return (left << half_bits) | right;
+    }
+
+    std::uint64_t decrypt(std::uint64_t x, unsigned half_bits) const
+    {
+        const std::uint64_t mask = (std::uint64_t{1} << half_bits) - 1;
+        std::uint64_t left = x >> half_bits, right = x & mask;
+        for (unsigned round = rounds; round-- > 0;)
+        {
+            const std::uint64_t tmp = left;
+            left = right ^ (round_function(left, round) & mask);
+            right = tmp;
+        }
+        return (left << half_bits) | right;
+    }
+
+    std::uint64_t seed_;
+};
+
+}
+}
+}
+
+#endif // SHUFFLE_PERMUTATION_H_
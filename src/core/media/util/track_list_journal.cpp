@@ -0,0 +1,504 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "track_list_journal.h"
+#include "record_file.h"
+
+#include "core/media/logger/logger.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+// The journal is a record_file of the following records.
+namespace
+{
+const char magic[4] = {'M', 'H', 'T', 'L'};
+const std::uint32_t version{1};
+
+// Positions closer than this to the last recorded one are not written out.
+const std::chrono::microseconds position_granularity{std::chrono::seconds{1}};
+
+enum class Record : std::uint8_t
+{
+    insert = 1,
+    meta_data,
+    remove,
+    move,
+    clear,
+    current,
+    shuffle,
+    loop_status,
+    position
+};
+
+using media::record_file::Reader;
+using media::record_file::write_all;
+
+struct Writer : public media::record_file::Writer
+{
+    explicit Writer(Record type)
+        : media::record_file::Writer{static_cast<std::uint8_t>(type)}
+    {
+    }
+};
+
+void insert_tracks(media::TrackListJournal::State& state, const media::Track::Id& before,
+                   const media::TrackList::Container& ids)
+{
+    // Appending is by far the most common case, so avoid searching for it
+    auto it = state.tracks.end();
+    if (not before.empty())
+        it = std::find(state.tracks.begin(), state.tracks.end(), before);
+
+    state.tracks.insert(it, ids.begin(), ids.end());
+}
+
+// Applies a single record to state, returns false if the record is malformed.
+bool replay(Record type, Reader& payload, media::TrackListJournal::State& state)
+{
+    switch (type)
+    {
+    case Record::insert:
+    {
+        media::Track::Id before;
+        std::uint32_t n = 0;
+        if (not payload.read(before) or not payload.read(n))
+            return false;
+
+        media::TrackList::Container ids;
+        ids.reserve(n);
+        for (std::uint32_t i = 0; i < n; i++)
+        {
+            media::Track::Id id;
+            media::Track::UriType uri;
+            if (not payload.read(id) or not payload.read(uri))
+                return false;
+
+            ids.push_back(id);
+            state.meta_data[id] = std::make_tuple(uri, media::Track::MetaData{});
+        }
+        insert_tracks(state, before, ids);
+        break;
+    }
+    case Record::meta_data:
+    {
+        media::Track::Id id;
+        std::uint32_t n = 0;
+        if (not payload.read(id) or not payload.read(n))
+            return false;
+
+        media::Track::MetaData meta_data;
+        for (std::uint32_t i = 0; i < n; i++)
+        {
+            std::string key, value;
+            if (not payload.read(key) or not payload.read(value))
+                return false;
+            meta_data.set(key, value);
+        }
+
+        const auto it = state.meta_data.find(id);
+        if (it != state.meta_data.end())
+            std::get<1>(it->second) = meta_data;
+        break;
+    }
+    case Record::remove:
+    {
+        media::Track::Id id;
+        if (not payload.read(id))
+            return false;
+
+        const auto it = std::find(state.tracks.begin(), state.tracks.end(), id);
+        if (it != state.tracks.end())
+            state.tracks.erase(it);
+        state.meta_data.erase(id);
+        if (state.current == id)
+            state.current.clear();
+        break;
+    }
+    case Record::move:
+    {
+        media::Track::Id id, to;
+        if (not payload.read(id) or not payload.read(to))
+            return false;
+
+        const auto it = std::find(state.tracks.begin(), state.tracks.end(), id);
+        if (it == state.tracks.end())
+            break;
+        state.tracks.erase(it);
+        insert_tracks(state, to, media::TrackList::Container{id});
+        break;
+    }
+    case Record::clear:
+        state.tracks.clear();
+        state.meta_data.clear();
+        state.current.clear();
+        break;
+    case Record::current:
+        if (not payload.read(state.current))
+            return false;
+        break;
+    case Record::shuffle:
+    {
+        std::uint8_t shuffle = 0;
+        if (not payload.read(shuffle) or not payload.read(state.shuffle_seed))
+            return false;
+        state.shuffle = shuffle != 0;
+        break;
+    }
+    case Record::loop_status:
+    {
+        std::uint8_t loop_status = 0;
+        if (not payload.read(loop_status))
+            return false;
+        state.loop_status = static_cast<media::Player::LoopStatus>(loop_status);
+        break;
+    }
+    case Record::position:
+    {
+        std::int64_t position = 0;
+        if (not payload.read(position))
+            return false;
+        state.position = std::chrono::microseconds{position};
+        break;
+    }
+    default:
+        // Written by a newer version, skip it
+        MH_WARNING("Skipping unknown TrackList journal record type %d", static_cast<int>(type));
+        break;
+    }
+
+    return true;
+}
+
+int open_journal(const std::string& path, int flags)
+{
+    const int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0600);
+    if (fd < 0)
+        throw media::TrackListJournal::Errors::FailedToOpenJournal
+        {
+            "Failed to open TrackList journal " + path + ": " + std::strerror(errno)
+        };
+
+    return fd;
+}
+}
+
+struct media::TrackListJournal::Private
+{
+    Private(const std::string& path)
+        : path(path),
+          fd(-1),
+          n_records(0),
+          last_position(-position_granularity),
+          discarded(false)
+    {
+    }
+
+    ~Private()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    void append(Writer& writer)
+    {
+        if (fd < 0)
+            return;
+
+        if (not write_all(fd, writer.finish()))
+            MH_WARNING("Failed to write to TrackList journal %s: %s", path, std::strerror(errno));
+        ++n_records;
+    }
+
+    std::string path;
+    int fd;
+    std::size_t n_records;
+    std::chrono::microseconds last_position;
+    // Keeps compaction from bringing back a discarded journal
+    bool discarded;
+};
+
+std::string media::TrackListJournal::path_for_session(const std::string& name)
+{
+    // Session names are chosen by clients, so they are not used as file names directly
+    gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, name.c_str(), -1);
+    gchar *dir = g_build_filename(g_get_user_cache_dir(), "media-hub", "sessions", nullptr);
+    g_mkdir_with_parents(dir, 0700);
+
+    const std::string path = std::string{dir} + "/" + checksum + ".journal";
+    g_free(dir);
+    g_free(checksum);
+
+    return path;
+}
+
+bool media::TrackListJournal::load(const std::string& path, State& state)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 or static_cast<std::size_t>(st.st_size) < record_file::header_size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    const std::size_t size = st.st_size;
+    void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        MH_WARNING("Failed to map TrackList journal %s: %s", path, std::strerror(errno));
+        return false;
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char *begin = static_cast<const char*>(mapping);
+    if (not record_file::has_header(begin, size, magic, version))
+    {
+        MH_WARNING("Ignoring TrackList journal %s with unknown format", path);
+        ::munmap(mapping, size);
+        return false;
+    }
+
+    state = State{};
+    Reader reader{begin + record_file::header_size, begin + size};
+    std::size_t n_records = 0;
+    while (not reader.at_end())
+    {
+        std::uint8_t type = 0;
+        Reader payload{nullptr, nullptr};
+        if (not reader.next_record(type, payload) or not replay(static_cast<Record>(type), payload, state))
+        {
+            MH_WARNING("TrackList journal %s is truncated after %d records", path, n_records);
+            break;
+        }
+        ++n_records;
+    }
+
+    ::munmap(mapping, size);
+
+    // A current track that has been removed in the meantime is no current track at all
+    if (not state.current.empty() and state.meta_data.count(state.current) == 0)
+        state.current.clear();
+
+    return true;
+}
+
+media::TrackListJournal::TrackListJournal(const std::string& path)
+    : d(new Private(path))
+{
+    d->fd = open_journal(path, O_WRONLY | O_APPEND | O_CREAT);
+
+    struct stat st;
+    if (::fstat(d->fd, &st) == 0 and st.st_size == 0)
+    {
+        write_all(d->fd, record_file::header(magic, version));
+    }
+}
+
+media::TrackListJournal::~TrackListJournal()
+{
+}
+
+const std::string& media::TrackListJournal::path() const
+{
+    return d->path;
+}
+
+void media::TrackListJournal::tracks_inserted(const Track::Id& before,
+                                              const TrackList::Container& ids,
+                                              const TrackList::ContainerURI& uris)
+{
+    Writer writer{Record::insert};
+    writer << before << static_cast<std::uint32_t>(ids.size());
+    for (std::size_t i = 0; i < ids.size(); i++)
+        writer << ids[i] << uris[i];
+    d->append(writer);
+}
+
+void media::TrackListJournal::meta_data_changed(const Track::Id& id, const Track::MetaData& meta_data)
+{
+    Writer writer{Record::meta_data};
+    writer << id << static_cast<std::uint32_t>((*meta_data).size());
+    for (const auto& pair : *meta_data)
+        writer << pair.first << pair.second;
+    d->append(writer);
+}
+
+void media::TrackListJournal::track_removed(const Track::Id& id)
+{
+    Writer writer{Record::remove};
+    writer << id;
+    d->append(writer);
+}
+
+void media::TrackListJournal::track_moved(const Track::Id& id, const Track::Id& to)
+{
+    Writer writer{Record::move};
+    writer << id << to;
+    d->append(writer);
+}
+
+void media::TrackListJournal::tracks_cleared()
+{
+    Writer writer{Record::clear};
+    d->append(writer);
+}
+
+void media::TrackListJournal::current_changed(const Track::Id& id)
+{
+    Writer writer{Record::current};
+    writer << id;
+    d->append(writer);
+}
+
+void media::TrackListJournal::shuffle_changed(bool shuffle, std::uint64_t seed)
+{
+    Writer writer{Record::shuffle};
+    writer << static_cast<std::uint8_t>(shuffle) << seed;
+    d->append(writer);
+}
+
+void media::TrackListJournal::loop_status_changed(Player::LoopStatus loop_status)
+{
+    Writer writer{Record::loop_status};
+    writer << static_cast<std::uint8_t>(loop_status);
+    d->append(writer);
+}
+
+void media::TrackListJournal::position_changed(const std::chrono::microseconds& position)
+{
+    const auto delta = position - d->last_position;
+    if (delta < position_granularity and delta > -position_granularity)
+        return;
+
+    d->last_position = position;
+    Writer writer{Record::position};
+    writer << static_cast<std::int64_t>(position.count());
+    d->append(writer);
+}
+
+bool media::TrackListJournal::needs_compaction(std::size_t n_tracks) const
+{
+    // A checkpoint takes a couple of records plus one per track with metadata
+    return d->n_records > 4 * n_tracks + 1024;
+}
+
+void media::TrackListJournal::compact(const State& state)
+{
+    if (d->discarded)
+        return;
+
+    const std::string tmp_path = d->path + ".tmp";
+    int fd = -1;
+    try {
+        fd = open_journal(tmp_path, O_WRONLY | O_CREAT | O_TRUNC);
+    } catch (const Errors::FailedToOpenJournal& e) {
+        MH_WARNING("%s", e.what());
+        return;
+    }
+
+    std::string data = record_file::header(magic, version);
+    std::size_t n_records = 0;
+    auto add = [&data, &n_records](Writer& writer)
+    {
+        data += writer.finish();
+        ++n_records;
+    };
+
+    Writer insert{Record::insert};
+    insert << Track::Id{} << static_cast<std::uint32_t>(state.tracks.size());
+    for (const auto& id : state.tracks)
+    {
+        const auto it = state.meta_data.find(id);
+        insert << id << (it != state.meta_data.end() ? std::get<0>(it->second) : Track::UriType{});
+    }
+    add(insert);
+
+    for (const auto& pair : state.meta_data)
+    {
+        const auto& meta_data = std::get<1>(pair.second);
+        if ((*meta_data).empty())
+            continue;
+
+        Writer writer{Record::meta_data};
+        writer << pair.first << static_cast<std::uint32_t>((*meta_data).size());
+        for (const auto& kv : *meta_data)
+            writer << kv.first << kv.second;
+        add(writer);
+    }
+
+    Writer current{Record::current};
+    current << state.current;
+    add(current);
+
+    Writer shuffle{Record::shuffle};
+    shuffle << static_cast<std::uint8_t>(state.shuffle) << state.shuffle_seed;
+    add(shuffle);
+
+    Writer loop_status{Record::loop_status};
+    loop_status << static_cast<std::uint8_t>(state.loop_status);
+    add(loop_status);
+
+    Writer position{Record::position};
+    position << static_cast<std::int64_t>(state.position.count());
+    add(position);
+
+    const bool written = write_all(fd, data);
+    ::close(fd);
+    if (not written or std::rename(tmp_path.c_str(), d->path.c_str()) != 0)
+    {
+        MH_WARNING("Failed to compact TrackList journal %s: %s", d->path, std::strerror(errno));
+        std::remove(tmp_path.c_str());
+        return;
+    }
+
+    // Keep appending to the new file from now on
+    ::close(d->fd);
+    d->fd = ::open(d->path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (d->fd < 0)
+        MH_WARNING("Failed to reopen TrackList journal %s: %s", d->path, std::strerror(errno));
+    d->n_records = n_records;
+    d->last_position = state.position;
+}
+
+void media::TrackListJournal::discard()
+{
+    d->discarded = true;
+    if (d->fd >= 0)
+    {
+        ::close(d->fd);
+        d->fd = -1;
+    }
+
+    if (std::remove(d->path.c_str()) != 0 and errno != ENOENT)
+        MH_WARNING("Failed to remove TrackList journal %s: %s", d->path, std::strerror(errno));
+}
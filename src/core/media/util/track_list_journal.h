@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CORE_UBUNTU_MEDIA_TRACK_LIST_JOURNAL_H_
+#define CORE_UBUNTU_MEDIA_TRACK_LIST_JOURNAL_H_
+
+#include <core/media/player.h>
+#include <core/media/track.h>
+#include <core/media/track_list.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// An append-only binary log of the edits done to a TrackList, so that the
+// TrackList of a resumable session survives a restart of media-hub. Every
+// edit appends one small record, loading maps the file and replays it. Once
+// the log grows well beyond the TrackList it describes, it is rewritten as a
+// single checkpoint of the current state.
+class TrackListJournal
+{
+public:
+    typedef std::shared_ptr<TrackListJournal> Ptr;
+    typedef std::map<Track::Id, std::tuple<Track::UriType, Track::MetaData>> MetaDataCache;
+
+    struct Errors
+    {
+        Errors() = delete;
+
+        struct FailedToOpenJournal : public std::runtime_error
+        {
+            FailedToOpenJournal(const std::string& err)
+                : std::runtime_error{err}
+            {
+            }
+        };
+    };
+
+    // Everything needed to bring back a TrackList as it was.
+    struct State
+    {
+        TrackList::Container tracks;
+        MetaDataCache meta_data;
+        Track::Id current;
+        bool shuffle = false;
+        std::uint64_t shuffle_seed = 0;
+        Player::LoopStatus loop_status = Player::LoopStatus::none;
+        std::chrono::microseconds position{0};
+    };
+
+    // Location of the journal for the fixed session with the given name.
+    static std::string path_for_session(const std::string& name);
+
+    // Replays the journal at path into state. Returns false if there is no
+    // journal. A truncated last record, e.g. after a crash, is ignored.
+    static bool load(const std::string& path, State& state);
+
+    // Opens the journal at path for appending, creating it if needed. Throws
+    // Errors::FailedToOpenJournal if that is not possible.
+    explicit TrackListJournal(const std::string& path);
+    ~TrackListJournal();
+
+    TrackListJournal(const TrackListJournal&) = delete;
+    TrackListJournal& operator=(const TrackListJournal&) = delete;
+
+    const std::string& path() const;
+
+    // ids are inserted in front of 'before', or appended if it is not part of the TrackList.
+    void tracks_inserted(const Track::Id& before, const TrackList::Container& ids, const TrackList::ContainerURI& uris);
+    void meta_data_changed(const Track::Id& id, const Track::MetaData& meta_data);
+    void track_removed(const Track::Id& id);
+    void track_moved(const Track::Id& id, const Track::Id& to);
+    void tracks_cleared();
+    void current_changed(const Track::Id& id);
+    void shuffle_changed(bool shuffle, std::uint64_t seed);
+    void loop_status_changed(Player::LoopStatus loop_status);
+    // Only recorded once it differs noticeably from the last recorded position.
+    void position_changed(const std::chrono::microseconds& position);
+
+    // True once the log is considerably bigger than a checkpoint of n_tracks would be.
+    bool needs_compaction(std::size_t n_tracks) const;
+    // Atomically replaces the log with a single checkpoint of state.
+    void compact(const State& state);
+
+    // Removes the journal from disk, for sessions that are gone for good.
+    // Nothing gets recorded from then on.
+    void discard();
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+}
+}
+}
+
+#endif // CORE_UBUNTU_MEDIA_TRACK_LIST_JOURNAL_H_
@@ -0,0 +1,365 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include "core/media/logger/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace core
+{
+namespace ubuntu
+{
+namespace media
+{
+// A fixed number of threads running posted tasks by priority, and in FIFO
+// order within a priority. Used to keep slow, blocking work (file system
+// queries, apparmor checks) off the threads that dispatch dbus messages.
+// Tasks age while waiting: for every aging interval spent in the queue a task
+// is treated as one priority higher, which keeps bulk work from starving.
+class WorkerPool
+{
+public:
+    typedef std::function<void()> Task;
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Priority
+    {
+        // Control of the playback, sessions playing alarms, alerts or calls
+        high,
+        normal,
+        // Tracklist edits in bulk, metadata batches, uri validation
+        bulk
+    };
+    static constexpr std::size_t priority_count{3};
+
+    struct Statistics
+    {
+        // Tasks waiting per priority right now
+        std::size_t depth[priority_count];
+        // The most tasks that ever waited per priority
+        std::size_t max_depth[priority_count];
+        // Tasks run per priority
+        std::uint64_t executed[priority_count];
+        // Tasks that got to run ahead of higher priority ones because of their age
+        std::uint64_t aged;
+    };
+
+    explicit WorkerPool(std::size_t n_workers,
+                        const std::chrono::milliseconds& aging_interval = std::chrono::milliseconds{100})
+        : aging_interval(aging_interval),
+          statistics_{{0}, {0}, {0}, 0},
+          stopped(false)
+    {
+        for (std::size_t i = 0; i < n_workers; i++)
+            workers.push_back(std::thread(&WorkerPool::run, this));
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            stopped = true;
+        }
+        wakeup.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    std::size_t size() const
+    {
+        return workers.size();
+    }
+
+    void post(const Task& task, Priority priority = Priority::normal)
+    {
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            const auto level = static_cast<std::size_t>(priority);
+            tasks[level].push_back(Queued{task, Clock::now()});
+            statistics_.max_depth[level] = std::max(statistics_.max_depth[level], tasks[level].size());
+        }
+        wakeup.notify_one();
+    }
+
+    Statistics statistics() const
+    {
+        std::lock_guard<std::mutex> lg(guard);
+
+        Statistics statistics = statistics_;
+        for (std::size_t level = 0; level < priority_count; level++)
+            statistics.depth[level] = tasks[level].size();
+        return statistics;
+    }
+
+private:
+    struct Queued
+    {
+        Task task;
+        Clock::time_point posted;
+    };
+
+    bool empty() const
+    {
+        for (const auto& queue : tasks)
+            if (not queue.empty())
+                return false;
+        return true;
+    }
+
+    // Only the oldest task of each priority needs to be looked at, called with guard held
+    std::size_t next_level() const
+    {
+        const auto now = Clock::now();
+        std::size_t next = priority_count;
+        double best = 0;
+        for (std::size_t level = 0; level < priority_count; level++)
+        {
+            if (tasks[level].empty())
+                continue;
+
+            const double effective = level - std::chrono::duration<double>(now - tasks[level].front().posted).count() /
+                    std::chrono::duration<double>(aging_interval).count();
+            if (next == priority_count or effective < best)
+            {
+                next = level;
+                best = effective;
+            }
+        }
+        return next;
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> ul(guard);
+                wakeup.wait(ul, [this]() { return stopped or not empty(); });
+                if (stopped and empty())
+                    return;
+
+                const auto level = next_level();
+                for (std::size_t higher = 0; higher < level; higher++)
+                {
+                    if (not tasks[higher].empty())
+                    {
+                        ++statistics_.aged;
+                        break;
+                    }
+                }
+
+                task = std::move(tasks[level].front().task);
+                tasks[level].pop_front();
+                ++statistics_.executed[level];
+            }
+
+            // A failing task must not take the worker, and with it the service, down
+            try
+            {
+                task();
+            }
+            catch (const std::exception& e)
+            {
+                MH_ERROR("Recoverable error while running a pooled task: %s", e.what());
+            }
+            catch (...)
+            {
+                MH_ERROR("Recoverable error while running a pooled task.");
+            }
+        }
+    }
+
+    const std::chrono::milliseconds aging_interval;
+    mutable std::mutex guard;
+    std::condition_variable wakeup;
+    std::deque<Queued> tasks[priority_count];
+    Statistics statistics_;
+    bool stopped;
+    std::vector<std::thread> workers;
+};
+
+// Runs the tasks posted to it one after the other, in the order they were
+// posted, on the threads of a WorkerPool. Tasks of different queues run in
+// parallel, so a queue per session keeps the requests of a session in order
+// without one slow session holding up all others. A queue waits in the pool
+// with the highest priority of the tasks it holds, as tasks of higher priority
+// cannot pass the ones posted before them.
+class SerialQueue : public std::enable_shared_from_this<SerialQueue>
+{
+public:
+    typedef std::shared_ptr<SerialQueue> Ptr;
+    typedef WorkerPool::Task Task;
+    typedef WorkerPool::Priority Priority;
+
+    // The pool has to outlive the queue.
+    static Ptr create(WorkerPool& pool)
+    {
+        return Ptr{new SerialQueue{pool}};
+    }
+
+    SerialQueue(const SerialQueue&) = delete;
+    SerialQueue& operator=(const SerialQueue&) = delete;
+
+    void post(const Task& task, Priority priority = Priority::normal)
+    {
+        Priority scheduled_with;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            tasks.push_back(std::make_pair(task, priority));
+            ++counts[static_cast<std::size_t>(priority)];
+
+            // A running queue schedules itself again once done. One waiting in
+            // the pool only needs to jump ahead if it now holds more urgent work.
+            if (running or waits_in_pool())
+                return;
+
+            scheduled_with = enter_pool();
+        }
+
+        schedule(scheduled_with);
+    }
+
+    // Tasks of the queue are run with at least the given priority from now on,
+    // e.g. while the session plays an alarm.
+    void set_minimum_priority(Priority priority)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        minimum_priority = priority;
+    }
+
+private:
+    explicit SerialQueue(WorkerPool& pool)
+        : pool(pool),
+          counts{0},
+          minimum_priority(Priority::bulk),
+          running(false),
+          entries{0}
+    {
+    }
+
+    // Called with guard held
+    Priority top_priority() const
+    {
+        for (std::size_t level = 0; level < WorkerPool::priority_count; level++)
+            if (counts[level] > 0)
+                return std::min(minimum_priority, static_cast<Priority>(level));
+        return minimum_priority;
+    }
+
+    // Called with guard held, true if the queue waits in the pool with at
+    // least the priority of its most urgent task
+    bool waits_in_pool() const
+    {
+        for (std::size_t level = 0; level <= static_cast<std::size_t>(top_priority()); level++)
+            if (entries[level] > 0)
+                return true;
+        return false;
+    }
+
+    // Called with guard held
+    Priority enter_pool()
+    {
+        const auto priority = top_priority();
+        ++entries[static_cast<std::size_t>(priority)];
+        return priority;
+    }
+
+    // Runs one task at a time and goes back into the pool after each, which
+    // keeps busy queues from starving the others.
+    void schedule(Priority priority)
+    {
+        const auto self = shared_from_this();
+        pool.post([self, priority]() { self->run_next(priority); }, priority);
+    }
+
+    void run_next(Priority entered_with)
+    {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            --entries[static_cast<std::size_t>(entered_with)];
+            // Another entry of the queue in the pool got to it first
+            if (running or tasks.empty())
+                return;
+
+            running = true;
+            task = std::move(tasks.front().first);
+            --counts[static_cast<std::size_t>(tasks.front().second)];
+            tasks.pop_front();
+        }
+
+        try
+        {
+            task();
+        }
+        catch (const std::exception& e)
+        {
+            MH_ERROR("Recoverable error while running a queued task: %s", e.what());
+        }
+        catch (...)
+        {
+            MH_ERROR("Recoverable error while running a queued task.");
+        }
+
+        Priority scheduled_with;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            running = false;
+            if (tasks.empty() or waits_in_pool())
+                return;
+
+            scheduled_with = enter_pool();
+        }
+
+        schedule(scheduled_with);
+    }
+
+    WorkerPool& pool;
+    std::mutex guard;
+    std::deque<std::pair<Task, Priority>> tasks;
+    // Number of tasks per priority
+    std::size_t counts[WorkerPool::priority_count];
+    Priority minimum_priority;
+    bool running;
+    // Number of times the queue waits in the pool per priority
+    std::size_t entries[WorkerPool::priority_count];
+};
+
+}
+}
+}
+
+#endif // WORKER_POOL_H_
@@ -0,0 +1,260 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times the work the service spreads over its worker pools:
+//
+//   uris: checking local URIs serially, as AddTracks used to do, and
+//         spread over a WorkerPool. The page cache is warm here, the
+//         gain on a cold cache is bigger since every check hits the disk.
+//
+//   stalled: the p99 latency of calls of 20 unrelated sessions while one
+//            session stalls for a second, with all calls handled on a
+//            single thread the way the service used to, and with a queue
+//            per session on a pool.
+//
+//   alarm: the p99 latency of the calls of an alarm session while 32
+//          multimedia sessions flood the pool with tracklist edits, with
+//          every call scheduled first come first served and with
+//          priorities.
+//
+// Usage: benchmark_dispatch [<uris>]
+
+#include "core/media/util/uri_check.h"
+#include "core/media/util/worker_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+long long us_since(const Clock::time_point& start)
+{
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+}
+
+void validate_uris(size_t n_uris)
+{
+    char tmpl[] = "/tmp/media-hub-uris-XXXXXX";
+    if (::mkdtemp(tmpl) == nullptr)
+    {
+        cerr << "uris: failed to create a temporary directory" << endl;
+        return;
+    }
+    const string dir{tmpl};
+
+    vector<string> uris;
+    for (size_t i = 0; i < n_uris; i++)
+    {
+        const string path = dir + "/track-" + to_string(i) + ".ogg";
+        ofstream{path} << i;
+        uris.push_back("file://" + path);
+    }
+
+    auto start = Clock::now();
+    media::UriCheck uri_check;
+    for (const auto& uri : uris)
+    {
+        uri_check.set(uri);
+        uri_check.file_exists();
+    }
+    const auto serial_us = us_since(start);
+
+    media::WorkerPool pool{4};
+    atomic<size_t> next{0};
+    size_t pending = pool.size();
+    mutex guard;
+    condition_variable done;
+
+    start = Clock::now();
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        pool.post([&]()
+        {
+            media::UriCheck uri_check;
+            for (size_t index = next++; index < uris.size(); index = next++)
+            {
+                uri_check.set(uris[index]);
+                uri_check.file_exists();
+            }
+
+            lock_guard<mutex> lg(guard);
+            if (--pending == 0)
+                done.notify_one();
+        });
+    }
+    {
+        unique_lock<mutex> ul(guard);
+        done.wait(ul, [&pending]() { return pending == 0; });
+    }
+    const auto parallel_us = us_since(start);
+
+    cout << "uris:" << endl
+         << "  checking " << n_uris << " uris serially: " << serial_us << " us" << endl
+         << "  with " << pool.size() << " workers:      " << parallel_us << " us" << endl;
+
+    for (size_t i = 0; i < n_uris; i++)
+        remove((dir + "/track-" + to_string(i) + ".ogg").c_str());
+    ::rmdir(dir.c_str());
+}
+
+// Posts calls of 20 unrelated sessions while one session stalls for a second,
+// returning the 99th percentile of the time calls waited to be handled.
+chrono::microseconds p99_latency_next_to_a_stalled_session(const function<media::SerialQueue::Ptr()>& queue_for_session)
+{
+    static constexpr size_t n_sessions{20};
+    static constexpr size_t n_calls{50};
+
+    // Like a Play that waits for a slow network stream to preroll
+    const auto stalled = queue_for_session();
+    for (int i = 0; i < 4; i++)
+        stalled->post([]() { this_thread::sleep_for(chrono::milliseconds{250}); });
+
+    vector<media::SerialQueue::Ptr> sessions;
+    for (size_t i = 0; i < n_sessions; i++)
+        sessions.push_back(queue_for_session());
+
+    mutex guard;
+    condition_variable done;
+    vector<chrono::microseconds> latencies;
+
+    for (size_t call = 0; call < n_calls; call++)
+    {
+        for (const auto& session : sessions)
+        {
+            const auto posted = Clock::now();
+            session->post([&, posted]()
+            {
+                const auto latency = chrono::duration_cast<chrono::microseconds>(Clock::now() - posted);
+                // Handling the call itself takes a bit as well
+                this_thread::sleep_for(chrono::microseconds{200});
+
+                lock_guard<mutex> lg(guard);
+                latencies.push_back(latency);
+                if (latencies.size() == n_sessions * n_calls)
+                    done.notify_one();
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds{20});
+    }
+
+    unique_lock<mutex> ul(guard);
+    done.wait(ul, [&latencies]() { return latencies.size() == n_sessions * n_calls; });
+
+    sort(latencies.begin(), latencies.end());
+    return latencies[latencies.size() * 99 / 100];
+}
+
+void stall_a_session()
+{
+    chrono::microseconds single_thread, per_session;
+    {
+        media::WorkerPool pool{1};
+        const auto queue = media::SerialQueue::create(pool);
+        single_thread = p99_latency_next_to_a_stalled_session([queue]() { return queue; });
+    }
+    {
+        media::WorkerPool pool{4};
+        per_session = p99_latency_next_to_a_stalled_session([&pool]() { return media::SerialQueue::create(pool); });
+    }
+
+    cout << "stalled:" << endl
+         << "  p99 latency, single dispatch thread:       " << single_thread.count() << " us" << endl
+         << "  p99 latency, queue per session, 4 workers: " << per_session.count() << " us" << endl;
+}
+
+chrono::microseconds p99_alarm_latency(bool prioritized)
+{
+    static constexpr size_t n_sessions{32};
+    static constexpr size_t n_edits{20};
+    static constexpr size_t n_alarm_calls{20};
+
+    // Declared before the pool, whose destructor still runs the edits left
+    mutex guard;
+    condition_variable done;
+    vector<chrono::microseconds> latencies;
+
+    media::WorkerPool pool{2};
+    vector<media::SerialQueue::Ptr> sessions;
+    for (size_t i = 0; i < n_sessions; i++)
+        sessions.push_back(media::SerialQueue::create(pool));
+    const auto alarm = media::SerialQueue::create(pool);
+    if (prioritized)
+        alarm->set_minimum_priority(media::WorkerPool::Priority::high);
+
+    const auto bulk = prioritized ? media::WorkerPool::Priority::bulk : media::WorkerPool::Priority::normal;
+    for (size_t edit = 0; edit < n_edits; edit++)
+        for (const auto& session : sessions)
+            session->post([]() { this_thread::sleep_for(chrono::microseconds{500}); }, bulk);
+
+    for (size_t call = 0; call < n_alarm_calls; call++)
+    {
+        const auto posted = Clock::now();
+        alarm->post([&, posted]()
+        {
+            lock_guard<mutex> lg(guard);
+            latencies.push_back(chrono::duration_cast<chrono::microseconds>(Clock::now() - posted));
+            done.notify_one();
+        });
+        this_thread::sleep_for(chrono::milliseconds{5});
+    }
+
+    unique_lock<mutex> ul(guard);
+    done.wait(ul, [&latencies]() { return latencies.size() == n_alarm_calls; });
+    sort(latencies.begin(), latencies.end());
+    return latencies[latencies.size() * 99 / 100];
+}
+
+void flood_with_bulk_work()
+{
+    const auto fifo = p99_alarm_latency(false);
+    const auto prioritized = p99_alarm_latency(true);
+
+    cout << "alarm:" << endl
+         << "  p99 latency, first come first served: " << fifo.count() << " us" << endl
+         << "  p99 latency, prioritized:             " << prioritized.count() << " us" << endl;
+}
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n_uris = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000;
+
+    validate_uris(n_uris);
+    stall_a_session();
+    flood_with_bulk_work();
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Reports the resident memory of sessions extracting metadata, first with
+// all of them sharing a small pool of pipelines, then with an extractor
+// pipeline each. Then reports the resident memory of prerolled audio sessions,
+// before and after the pipelines of the idle ones got released, and checks
+// that all of them still play afterwards. Audio goes to a fakesink.
+//
+// Usage: benchmark_engine_memory <audio_uri> [<sessions>] [<busy sessions>]
+
+#include "core/media/gstreamer/engine.h"
+#include "core/media/gstreamer/meta_data_extractor.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+size_t resident_set_size()
+{
+    size_t size = 0, resident = 0;
+    ifstream statm{"/proc/self/statm"};
+    statm >> size >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+// Every session asks for the metadata of uri at the same time
+void extract_meta_data(const string& uri, const vector<shared_ptr<media::Engine::MetaDataExtractor>>& extractors)
+{
+    vector<thread> sessions;
+    for (const auto& extractor : extractors)
+        sessions.emplace_back([&uri, extractor]()
+        {
+            try
+            {
+                extractor->meta_data_for_track_with_uri(uri);
+            }
+            catch (const exception& e)
+            {
+                cerr << "could not extract metadata: " << e.what() << endl;
+            }
+        });
+    for (auto& session : sessions)
+        session.join();
+}
+
+void share_meta_data_extractors(const string& uri, size_t n_sessions)
+{
+    // Shared first, memory freed later on is not necessarily handed back
+    auto start = resident_set_size();
+    const auto shared = make_shared<gstreamer::SharedMetaDataExtractor>();
+    extract_meta_data(uri, vector<shared_ptr<media::Engine::MetaDataExtractor>>(n_sessions, shared));
+
+    cout << "resident memory of " << n_sessions << " sessions sharing " << shared->pipelines() << " extractors: "
+         << (resident_set_size() - start) / 1024 << " KiB" << endl;
+
+    start = resident_set_size();
+    vector<shared_ptr<media::Engine::MetaDataExtractor>> own;
+    for (size_t i = 0; i < n_sessions; i++)
+        own.push_back(make_shared<gstreamer::MetaDataExtractor>());
+    extract_meta_data(uri, own);
+
+    cout << "resident memory of " << n_sessions << " sessions with an extractor each: "
+         << (resident_set_size() - start) / 1024 << " KiB" << endl;
+}
+
+int release_idle_pipelines(const string& uri, size_t n_sessions, size_t n_busy)
+{
+    const auto start = resident_set_size();
+    vector<unique_ptr<gstreamer::Engine>> engines;
+    for (size_t i = 0; i < n_sessions; i++)
+    {
+        engines.emplace_back(new gstreamer::Engine(i));
+        engines.back()->open_resource_for_uri(uri, false);
+        if (not engines.back()->pause())
+        {
+            cerr << "could not preroll " << uri << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    const auto loaded = resident_set_size();
+
+    size_t n_released = 0;
+    for (size_t i = n_busy; i < n_sessions; i++)
+        if (engines[i]->release_pipeline())
+            n_released++;
+    const auto released = resident_set_size();
+
+    cout << "resident memory of " << n_sessions << " sessions with all pipelines loaded: "
+         << (loaded - start) / 1024 << " KiB, with " << n_released << " idle ones released: "
+         << (released - start) / 1024 << " KiB" << endl;
+
+    size_t n_failed = 0;
+    for (const auto& engine : engines)
+    {
+        if (not engine->play() or not engine->stop())
+            n_failed++;
+    }
+    if (n_failed > 0)
+    {
+        cerr << n_failed << " sessions failed to play again" << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <audio_uri> [<sessions>] [<busy sessions>]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    ::setenv("CORE_UBUNTU_MEDIA_SERVICE_AUDIO_SINK_NAME", "fakesink", 1);
+
+    const string uri{argv[1]};
+    const size_t n_sessions = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50;
+    const size_t n_busy = argc > 3 ? strtoul(argv[3], nullptr, 10) : 5;
+
+    share_meta_data_extractors(uri, n_sessions);
+    return release_idle_pipelines(uri, n_sessions, n_busy);
+}
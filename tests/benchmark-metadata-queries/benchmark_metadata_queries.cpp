@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Compares the blocking and the asynchronous client API by asking a running
+// media-hub-server for the metadata of a track over and over again. The
+// blocking calls pay a full round trip each, the asynchronous ones keep up
+// to <window> queries in flight. The window has to stay below the number of
+// metadata requests the service lets a client have waiting at a time.
+//
+// Usage: benchmark_metadata_queries <track_uri> [<queries>] [<window>]
+
+#include <core/media/service.h>
+#include <core/media/track_list.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <iostream>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+void report(const string& name, size_t queries, const Clock::duration& elapsed)
+{
+    const auto us = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+    cout << name << ": " << queries << " queries in " << us / 1000.0 << " ms, "
+         << static_cast<double>(us) / queries << " us per query" << endl;
+}
+
+Clock::duration run_blocking(const shared_ptr<media::TrackList>& track_list,
+                             const media::Track::Id& id,
+                             size_t queries)
+{
+    const auto start = Clock::now();
+    for (size_t i = 0; i < queries; i++)
+        track_list->query_meta_data_for_track(id);
+
+    return Clock::now() - start;
+}
+
+Clock::duration run_async(const shared_ptr<media::TrackList>& track_list,
+                          const media::Track::Id& id,
+                          size_t queries,
+                          size_t window)
+{
+    deque<future<media::Track::MetaData>> in_flight;
+
+    const auto start = Clock::now();
+    for (size_t i = 0; i < queries; i++)
+    {
+        if (in_flight.size() == window)
+        {
+            in_flight.front().get();
+            in_flight.pop_front();
+        }
+
+        in_flight.push_back(track_list->query_meta_data_for_track_async(id));
+    }
+
+    for (auto& reply : in_flight)
+        reply.get();
+
+    return Clock::now() - start;
+}
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <track_uri> [<queries>] [<window>]" << endl;
+        return 1;
+    }
+
+    const size_t queries = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000;
+    const size_t window = argc > 3 ? max<size_t>(1, strtoul(argv[3], nullptr, 10)) : 32;
+
+    try
+    {
+        auto service = media::Service::Client::instance();
+        auto player = service->create_session(media::Player::Client::default_configuration());
+        auto track_list = player->track_list();
+
+        track_list->add_track_with_uri_at(argv[1], media::TrackList::after_empty_track(), false);
+        const auto tracks = track_list->tracks().get();
+        if (tracks.empty())
+        {
+            cerr << "FATAL: The track didn't make it into the TrackList" << endl;
+            return 1;
+        }
+
+        // Once each way first, so that neither run pays for warming up the service
+        track_list->query_meta_data_for_track(tracks.front());
+        track_list->query_meta_data_for_track_async(tracks.front()).get();
+
+        const auto blocking = run_blocking(track_list, tracks.front(), queries);
+        const auto async = run_async(track_list, tracks.front(), queries, window);
+
+        report("blocking", queries, blocking);
+        report("async", queries, async);
+        cout << "speedup: " << static_cast<double>(blocking.count()) / async.count() << "x" << endl;
+
+        service->destroy_session(player->uuid(), media::Player::Client::default_configuration());
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "FATAL: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
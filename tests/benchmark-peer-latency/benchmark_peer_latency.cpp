@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Compares round trips to a running media-hub-server through the session bus
+// daemon with the ones over its peer endpoint, which the service only offers
+// if started with CORE_UBUNTU_MEDIA_SERVICE_PEER_ENDPOINT=1. Times Play, Pause
+// and reading the Position of a session that has the given track loaded.
+//
+// Usage: benchmark_peer_latency <track_uri> [<calls>]
+
+#include <core/media/service.h>
+
+#include "core/media/peer_connection.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+double us_per_call(size_t calls, const function<void()>& call)
+{
+    // Once first, so that the first call doesn't pay for warming up
+    call();
+
+    const auto start = Clock::now();
+    for (size_t i = 0; i < calls; i++)
+        call();
+
+    const auto elapsed = chrono::duration_cast<chrono::microseconds>(Clock::now() - start);
+    return static_cast<double>(elapsed.count()) / calls;
+}
+
+void run(const string& name,
+         const media::PeerConnection::Ptr& connection,
+         media::Player::PlayerKey key,
+         size_t calls)
+{
+    cout << name << ":" << endl
+         << "  Play:     " << us_per_call(calls, [&]() { connection->play(key); }) << " us" << endl
+         << "  Pause:    " << us_per_call(calls, [&]() { connection->pause(key); }) << " us" << endl
+         << "  Position: " << us_per_call(calls, [&]() { connection->position(key); }) << " us" << endl;
+}
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <track_uri> [<calls>]" << endl;
+        return 1;
+    }
+
+    const size_t calls = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000;
+
+    try
+    {
+        auto service = media::Service::Client::instance();
+        auto player = service->create_session(media::Player::Client::default_configuration());
+        if (not player->open_uri(argv[1]))
+        {
+            cerr << "FATAL: Failed to open " << argv[1] << endl;
+            return 1;
+        }
+
+        const auto bus = media::PeerConnection::open_session_bus();
+        const auto peer = media::PeerConnection::open();
+        if (not bus)
+        {
+            cerr << "FATAL: No session bus" << endl;
+            return 1;
+        }
+
+        run("session bus", bus, player->key(), calls);
+
+        if (peer)
+            run("peer to peer", peer, player->key(), calls);
+        else
+            cout << "peer to peer: nobody listens on " << media::PeerConnection::default_address() << endl;
+
+        player->stop();
+        service->destroy_session(player->uuid(), media::Player::Client::default_configuration());
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "FATAL: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times writers adding players to the player store while readers keep
+// enumerating them and looking them up, and reports how many players the
+// readers got through meanwhile.
+//
+// Usage: benchmark_player_store [<writers>] [<readers>] [<players per writer>]
+
+#include "core/media/hashed_keyed_player_store.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    const size_t n_writers = argc > 1 ? strtoul(argv[1], nullptr, 10) : 3;
+    const size_t n_readers = argc > 2 ? strtoul(argv[2], nullptr, 10) : 3;
+    const size_t players_per_writer = argc > 3 ? strtoul(argv[3], nullptr, 10) : 300;
+
+    media::HashedKeyedPlayerStore store;
+    atomic<bool> done{false};
+    atomic<size_t> lookups{0};
+
+    const auto start = chrono::steady_clock::now();
+
+    vector<thread> readers;
+    for (size_t i = 0; i < n_readers; i++)
+    {
+        readers.push_back(thread([&store, &done, &lookups]()
+        {
+            while (not done)
+            {
+                size_t n = 0;
+                store.enumerate_players([&n](const media::Player::PlayerKey&, const shared_ptr<media::Player>&)
+                {
+                    ++n;
+                });
+                store.has_player_for_key(n);
+                lookups += n + 1;
+            }
+        }));
+    }
+
+    vector<thread> writers;
+    for (size_t i = 0; i < n_writers; i++)
+    {
+        writers.push_back(thread([&store, i, players_per_writer]()
+        {
+            const shared_ptr<media::Player> player;
+            for (size_t j = 0; j < players_per_writer; j++)
+                store.add_player_for_key(i * players_per_writer + j, player);
+        }));
+    }
+
+    for (auto& writer : writers)
+        writer.join();
+
+    const auto write_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    cout << n_writers << " writers adding " << n_writers * players_per_writer << " players next to "
+         << n_readers << " readers: " << write_us << " us, " << lookups << " players read" << endl;
+
+    return 0;
+}
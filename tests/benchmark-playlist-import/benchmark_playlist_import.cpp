@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times how long the playlist parser takes to hand out the first batch of a
+// huge M3U, which is what AddTracksFromPlaylist appends before anything else,
+// and how long it takes to get through all of it. This covers parsing only,
+// not the time until the first track starts playing.
+//
+// Usage: benchmark_playlist_import [<entries>]
+
+#include "core/media/util/playlist_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+const size_t first_batch{8};
+const size_t batch{512};
+
+long long us_since(const Clock::time_point& start)
+{
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n_entries = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+
+    char tmpl[] = "/tmp/media-hub-playlist-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    if (fd < 0)
+    {
+        cerr << "FATAL: Failed to create a temporary file" << endl;
+        return 1;
+    }
+    ::close(fd);
+    const string path = string{tmpl} + ".m3u";
+    rename(tmpl, path.c_str());
+
+    {
+        ofstream out{path};
+        out << "#EXTM3U\n";
+        for (size_t i = 0; i < n_entries; i++)
+            out << "#EXTINF:180,Artist - Track " << i << "\n"
+                << "/media/music/track-" << i << ".ogg\n";
+    }
+
+    try
+    {
+        const auto start = Clock::now();
+
+        media::PlaylistParser parser{path};
+        media::TrackList::ContainerURI uris;
+        parser.read_entries(first_batch, uris);
+        const auto first_us = us_since(start);
+
+        while (parser.read_entries(batch, uris));
+        const auto all_us = us_since(start);
+
+        cout << "time to first batch of " << first_batch << " entries: " << first_us << " us" << endl
+             << "time to parse all " << uris.size() << " entries: " << all_us << " us" << endl;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "FATAL: " << e.what() << endl;
+        remove(path.c_str());
+        return 1;
+    }
+
+    remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times filling and loading the store behind MPRIS Playlists, and paging
+// through all of its playlists in every ordering the way an MPRIS client
+// populating a list view would.
+//
+// Usage: benchmark_playlist_store [<playlists>] [<page size>]
+
+#include "core/media/util/playlist_store.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+long long us_since(const Clock::time_point& start)
+{
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+}
+
+const char* name_of(media::PlaylistStore::Ordering ordering)
+{
+    switch (ordering)
+    {
+    case media::PlaylistStore::Ordering::alphabetical:
+        return "alphabetical";
+    case media::PlaylistStore::Ordering::creation_date:
+        return "creation date";
+    case media::PlaylistStore::Ordering::modified_date:
+        return "modified date";
+    case media::PlaylistStore::Ordering::last_play_date:
+        return "last play date";
+    }
+
+    return "unknown";
+}
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n_playlists = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+    const size_t page_size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50;
+
+    char tmpl[] = "/tmp/media-hub-playlists-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    if (fd < 0)
+    {
+        cerr << "FATAL: Failed to create a temporary file" << endl;
+        return 1;
+    }
+    ::close(fd);
+    remove(tmpl);
+    const string path{tmpl};
+
+    auto start = Clock::now();
+    {
+        media::PlaylistStore store{path};
+        for (size_t i = 0; i < n_playlists; i++)
+        {
+            // Names deliberately don't sort like the creation order does
+            const size_t k = (i * 7919) % n_playlists;
+            store.add("Playlist " + to_string(k), "", {"file:///music/" + to_string(k) + ".ogg"});
+        }
+    }
+    const auto fill_us = us_since(start);
+
+    start = Clock::now();
+    media::PlaylistStore store{path};
+    const auto load_us = us_since(start);
+
+    cout << "adding " << n_playlists << " playlists: " << fill_us << " us" << endl
+         << "loading them: " << load_us << " us" << endl
+         << "enumerating them in pages of " << page_size << ":" << endl;
+
+    const media::PlaylistStore::Ordering orderings[] =
+    {
+        media::PlaylistStore::Ordering::alphabetical,
+        media::PlaylistStore::Ordering::creation_date,
+        media::PlaylistStore::Ordering::modified_date,
+        media::PlaylistStore::Ordering::last_play_date
+    };
+
+    for (const auto ordering : orderings)
+    {
+        start = Clock::now();
+        for (size_t index = 0; index < n_playlists; index += page_size)
+            store.playlists(index, page_size, ordering, index % 2 == 0);
+
+        cout << "  by " << name_of(ordering) << ": " << us_since(start) << " us" << endl;
+    }
+
+    remove(path.c_str());
+    return 0;
+}
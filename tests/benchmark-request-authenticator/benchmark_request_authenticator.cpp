@@ -0,0 +1,111 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times a music app adding an album collection to its TrackList, every uri
+// of which gets authorized, with the rule table of the authenticator and
+// with the regex based checks it used to run.
+//
+// Usage: benchmark_request_authenticator [<uris>]
+
+#include "core/media/apparmor/ubuntu.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace apparmor = core::ubuntu::media::apparmor;
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+// The regex based checks the authenticator used to run, as reference
+bool reference_authenticate(const std::string& context_name, const std::string& uri)
+{
+    static const std::regex uri_re{R"delim(^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))?)delim"};
+    static const std::regex short_re{"(.*)_(.*)"};
+    static const std::regex full_re{"(.*)_(.*)_(.*)"};
+
+    if (context_name == apparmor::ubuntu::unconfined)
+        return true;
+
+    std::smatch uri_match;
+    std::regex_match(uri, uri_match, uri_re);
+    const std::string scheme = uri_match.str(2);
+    const std::string path = uri_match.str(5);
+
+    std::smatch match;
+    if (not std::regex_match(context_name, match, full_re))
+        std::regex_match(context_name, match, short_re);
+    const std::string package = match[1];
+    const std::string profile = std::string{match[1]} + "-" + std::string{match[2]};
+
+    const auto contains = [&path](const std::string& s) { return path.find(s) != std::string::npos; };
+
+    return contains(".local/share/" + package + "/") || contains(".cache/" + package + "/") ||
+           (contains("opt/click.ubuntu.com/") && contains(package)) ||
+           (package == "com.ubuntu.camera" && contains("/system/media/audio/ui/")) ||
+           ((package == "com.ubuntu.music" || package == "com.ubuntu.gallery") &&
+            (contains("Music/") || contains("Videos/") || contains("/media"))) ||
+           contains("/usr/share/sounds") ||
+           scheme == "http" || scheme == "https" || scheme == "rtsp";
+}
+
+long long us_since(const Clock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t n_uris = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+    const std::string context_name{"com.ubuntu.music_music_1.0"};
+
+    std::vector<std::string> uris;
+    for (std::size_t i = 0; i < n_uris; i++)
+        uris.push_back("file:///home/phablet/Music/Album " + std::to_string(i % 50) + "/" + std::to_string(i) + ".ogg");
+
+    std::size_t n_reference = 0;
+    auto start = Clock::now();
+    for (const auto& uri : uris)
+    {
+        const apparmor::ubuntu::Context context{context_name};
+        if (reference_authenticate(context_name, uri))
+            ++n_reference;
+    }
+    const auto reference_us = us_since(start);
+
+    std::size_t n_authorized = 0;
+    apparmor::ubuntu::ExistingAuthenticator authenticator;
+    const apparmor::ubuntu::Context context{context_name};
+    start = Clock::now();
+    for (const auto& uri : uris)
+        if (std::get<0>(authenticator.authenticate_open_uri_request(context, uri)))
+            ++n_authorized;
+    const auto authenticate_us = us_since(start);
+
+    std::cout << "authorizing " << uris.size() << " uris" << std::endl
+              << "  regex based: " << reference_us << " us, " << n_reference << " authorized" << std::endl
+              << "  rule table:  " << authenticate_us << " us, " << n_authorized << " authorized" << std::endl;
+
+    return 0;
+}
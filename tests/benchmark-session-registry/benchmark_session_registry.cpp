@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times clients creating, looking up and destroying sessions in the session
+// registry in parallel, the way they hit the bus. Every client keeps every
+// other session it created.
+//
+// Usage: benchmark_session_registry [<clients>] [<sessions per client>]
+
+#include "core/media/session_registry.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    const size_t n_clients = argc > 1 ? strtoul(argv[1], nullptr, 10) : 8;
+    const size_t sessions_per_client = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000;
+
+    media::SessionRegistry registry;
+    vector<thread> clients;
+
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n_clients; i++)
+    {
+        clients.push_back(thread([&registry, i, sessions_per_client]()
+        {
+            const string sender = ":1." + to_string(i);
+            for (size_t j = 0; j < sessions_per_client; j++)
+            {
+                const auto key = registry.allocate_key();
+                const string uuid = sender + "/" + to_string(j);
+                registry.add(key, uuid);
+                registry.set_owner(key, media::SessionRegistry::Owner{"app", true, sender});
+
+                media::Player::PlayerKey found;
+                registry.key_for_uuid(uuid, found);
+
+                if (j % 2 == 1)
+                    registry.remove(key);
+            }
+        }));
+    }
+
+    for (auto& client : clients)
+        client.join();
+
+    const auto elapsed_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+    cout << n_clients << " clients creating " << n_clients * sessions_per_client
+         << " sessions and destroying half of them: " << elapsed_us << " us" << endl;
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Times restoring the TrackList of a fixed session from its journal, for a
+// queue that was built one AddTrack at a time and for the same queue after
+// compaction.
+//
+// Usage: benchmark_track_list_journal [<tracks>]
+
+#include "core/media/util/track_list_journal.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+using namespace std;
+
+namespace
+{
+typedef chrono::steady_clock Clock;
+
+string id(size_t i)
+{
+    return "/core/ubuntu/media/Service/sessions/0/TrackList/" + to_string(i);
+}
+
+string uri(size_t i)
+{
+    return "file:///media/music/track-" + to_string(i) + ".ogg";
+}
+
+long long us_to_load(const string& path, media::TrackListJournal::State& state)
+{
+    const auto start = Clock::now();
+    media::TrackListJournal::load(path, state);
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+}
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n_tracks = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+
+    char tmpl[] = "/tmp/media-hub-journal-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    if (fd < 0)
+    {
+        cerr << "FATAL: Failed to create a temporary file" << endl;
+        return 1;
+    }
+    ::close(fd);
+    remove(tmpl);
+    const string path{tmpl};
+
+    {
+        media::TrackListJournal journal{path};
+        for (size_t i = 0; i < n_tracks; i++)
+            journal.tracks_inserted(media::Track::Id{}, {id(i)}, {uri(i)});
+        journal.current_changed(id(n_tracks / 2));
+
+        media::TrackListJournal::State state;
+        const auto journal_us = us_to_load(path, state);
+
+        journal.compact(state);
+        const auto checkpoint_us = us_to_load(path, state);
+
+        cout << "restoring " << state.tracks.size() << " tracks" << endl
+             << "  from the journal:   " << journal_us << " us" << endl
+             << "  from a checkpoint:  " << checkpoint_us << " us" << endl;
+    }
+
+    remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TESTING_FAKE_PLAYER_H_
+#define TESTING_FAKE_PLAYER_H_
+
+#include <core/media/player.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace testing
+{
+// Only knows its lifetime, which is all the bookkeeping of the service around
+// sessions looks at
+class FakePlayer : public core::ubuntu::media::Player
+{
+public:
+    explicit FakePlayer(Lifetime lifetime = Lifetime::normal)
+        : lifetime_{lifetime}
+    {
+    }
+
+    std::string uuid() const override { return std::string{}; }
+    void reconnect() override {}
+    void abandon() override {}
+
+    std::shared_ptr<core::ubuntu::media::TrackList> track_list() override { return nullptr; }
+    PlayerKey key() const override { return 0; }
+
+    core::ubuntu::media::video::Sink::Ptr create_gl_texture_video_sink(std::uint32_t) override { return nullptr; }
+
+    bool open_uri(const core::ubuntu::media::Track::UriType&) override { return false; }
+    bool open_uri(const core::ubuntu::media::Track::UriType&, const HeadersType&) override { return false; }
+    void next() override {}
+    void previous() override {}
+    void play() override {}
+    void pause() override {}
+    void stop() override {}
+    void seek_to(const std::chrono::microseconds&) override {}
+
+    const core::Property<bool>& can_play() const override { return flag; }
+    const core::Property<bool>& can_pause() const override { return flag; }
+    const core::Property<bool>& can_seek() const override { return flag; }
+    const core::Property<bool>& can_go_previous() const override { return flag; }
+    const core::Property<bool>& can_go_next() const override { return flag; }
+    const core::Property<bool>& is_video_source() const override { return flag; }
+    const core::Property<bool>& is_audio_source() const override { return flag; }
+    const core::Property<PlaybackStatus>& playback_status() const override { return playback_status_; }
+    const core::Property<core::ubuntu::media::AVBackend::Backend>& backend() const override { return backend_; }
+    const core::Property<LoopStatus>& loop_status() const override { return loop_status_; }
+    const core::Property<PlaybackRate>& playback_rate() const override { return rate; }
+    const core::Property<bool>& shuffle() const override { return flag; }
+    const core::Property<core::ubuntu::media::Track::MetaData>& meta_data_for_current_track() const override { return meta_data; }
+    const core::Property<Volume>& volume() const override { return volume_; }
+    const core::Property<PlaybackRate>& minimum_playback_rate() const override { return rate; }
+    const core::Property<PlaybackRate>& maximum_playback_rate() const override { return rate; }
+    const core::Property<int64_t>& position() const override { return time; }
+    const core::Property<int64_t>& duration() const override { return time; }
+    const core::Property<AudioStreamRole>& audio_stream_role() const override { return role; }
+    const core::Property<Orientation>& orientation() const override { return orientation_; }
+    const core::Property<Lifetime>& lifetime() const override { return lifetime_; }
+
+    core::Property<LoopStatus>& loop_status() override { return loop_status_; }
+    core::Property<PlaybackRate>& playback_rate() override { return rate; }
+    core::Property<bool>& shuffle() override { return flag; }
+    core::Property<Volume>& volume() override { return volume_; }
+    core::Property<AudioStreamRole>& audio_stream_role() override { return role; }
+    core::Property<Lifetime>& lifetime() override { return lifetime_; }
+
+    const core::Signal<int64_t>& seeked_to() const override { return seeked_to_; }
+    const core::Signal<void>& about_to_finish() const override { return nothing; }
+    const core::Signal<void>& end_of_stream() const override { return nothing; }
+    core::Signal<PlaybackStatus>& playback_status_changed() override { return playback_status_changed_; }
+    const core::Signal<core::ubuntu::media::video::Dimensions>& video_dimension_changed() const override { return dimensions; }
+    const core::Signal<Error>& error() const override { return error_; }
+    const core::Signal<int>& buffering_changed() const override { return buffering; }
+
+private:
+    core::Property<Lifetime> lifetime_;
+
+    mutable core::Property<bool> flag;
+    core::Property<PlaybackStatus> playback_status_;
+    core::Property<core::ubuntu::media::AVBackend::Backend> backend_;
+    core::Property<LoopStatus> loop_status_;
+    core::Property<PlaybackRate> rate;
+    core::Property<core::ubuntu::media::Track::MetaData> meta_data;
+    core::Property<Volume> volume_;
+    core::Property<int64_t> time;
+    core::Property<AudioStreamRole> role;
+    core::Property<Orientation> orientation_;
+
+    core::Signal<int64_t> seeked_to_;
+    core::Signal<void> nothing;
+    core::Signal<PlaybackStatus> playback_status_changed_;
+    core::Signal<core::ubuntu::media::video::Dimensions> dimensions;
+    core::Signal<Error> error_;
+    core::Signal<int> buffering;
+};
+}
+
+#endif // TESTING_FAKE_PLAYER_H_
@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/mpris/cached_properties.h"
+
+#include <core/property.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+TEST(CachedProperties, properties_are_only_encoded_again_after_a_change)
+{
+    core::Property<bool> can_play{false};
+    core::Property<std::string> playback_status{"Stopped"};
+
+    int builds = 0;
+    mpris::CachedProperties cache{[&]()
+    {
+        ++builds;
+        mpris::CachedProperties::Dictionary dict;
+        dict["CanPlay"] = core::dbus::types::Variant::encode(can_play.get());
+        dict["PlaybackStatus"] = core::dbus::types::Variant::encode(playback_status.get());
+        return dict;
+    }};
+    cache.watch(can_play);
+    cache.watch(playback_status);
+
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(2u, cache.get().size());
+    EXPECT_EQ(1, builds);
+
+    can_play.set(true);
+    playback_status.set("Playing");
+    cache.get();
+    cache.get();
+    EXPECT_EQ(2, builds);
+}
+
+TEST(CachedProperties, properties_outliving_the_cache_can_still_change)
+{
+    core::Property<bool> can_play{false};
+    {
+        mpris::CachedProperties cache{[]() { return mpris::CachedProperties::Dictionary{}; }};
+        cache.watch(can_play);
+        cache.get();
+    }
+
+    can_play.set(true);
+    EXPECT_TRUE(can_play.get());
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "core/media/cached_remote_property.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Stands in for a property of a remote object, counting the reads that would
+// have gone over the bus
+template<typename T>
+struct RemoteProperty : public core::Property<T>
+{
+    const T& get() const override
+    {
+        ++gets;
+        return core::Property<T>::get();
+    }
+
+    // The service computed a new value without telling anyone
+    void change_silently(const T& value)
+    {
+        core::Property<T>::mutable_get() = value;
+    }
+
+    mutable int gets = 0;
+};
+
+struct Clock
+{
+    media::ExtrapolatedPosition::Clock::time_point now()
+    {
+        return t;
+    }
+
+    media::ExtrapolatedPosition::Clock::time_point t;
+};
+}
+
+TEST(CachedRemoteProperty, reads_are_answered_locally_once_a_value_is_known)
+{
+    auto remote = std::make_shared<RemoteProperty<int>>();
+    remote->change_silently(42);
+    media::CachedRemoteProperty<int> property{remote};
+
+    const auto answered_locally = media::RemotePropertyStatistics::instance().answered_locally.load();
+
+    EXPECT_EQ(42, property.get());
+    EXPECT_EQ(42, property.get());
+    EXPECT_EQ(1, remote->gets);
+
+    // Announced changes are taken over without asking again
+    remote->set(43);
+    EXPECT_EQ(43, property.get());
+    property.refresh(44);
+    EXPECT_EQ(44, property.get());
+    EXPECT_EQ(1, remote->gets);
+    EXPECT_EQ(answered_locally + 3, media::RemotePropertyStatistics::instance().answered_locally.load());
+
+    // Values that change silently are asked for again once invalidated
+    remote->change_silently(45);
+    property.invalidate();
+    EXPECT_EQ(45, property.get());
+    EXPECT_EQ(2, remote->gets);
+}
+
+TEST(CachedRemoteProperty, writes_go_to_the_remote_object)
+{
+    auto remote = std::make_shared<RemoteProperty<double>>();
+    media::CachedRemoteProperty<double> property{remote};
+
+    int changes = 0;
+    core::ScopedConnection c{property.changed().connect([&changes](double) { ++changes; })};
+
+    property.set(.5);
+    EXPECT_DOUBLE_EQ(.5, remote->core::Property<double>::get());
+    EXPECT_DOUBLE_EQ(.5, property.get());
+    EXPECT_EQ(0, remote->gets);
+    EXPECT_EQ(1, changes);
+}
+
+TEST(ExtrapolatedPosition, position_moves_along_with_the_clock_while_playing)
+{
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+
+    auto remote = std::make_shared<RemoteProperty<std::int64_t>>();
+    Clock clock;
+    media::ExtrapolatedPosition position{remote, seconds{10}, std::bind(&Clock::now, &clock)};
+
+    // One second into the track, not playing
+    position.refresh(1000000000);
+    clock.t += seconds{1};
+    EXPECT_EQ(1000000000, position.get());
+
+    position.set_playing(true);
+    clock.t += milliseconds{500};
+    EXPECT_EQ(1500000000, position.get());
+
+    // Twice as fast from here
+    position.set_rate(2.);
+    clock.t += milliseconds{500};
+    EXPECT_EQ(2500000000, position.get());
+    EXPECT_EQ(0, remote->gets);
+
+    // Drift is made up for every now and then
+    remote->change_silently(13000000000);
+    clock.t += seconds{10};
+    EXPECT_EQ(13000000000, position.get());
+    EXPECT_EQ(1, remote->gets);
+
+    // A seek makes the next read ask the service
+    remote->change_silently(5000000000);
+    position.invalidate();
+    EXPECT_EQ(5000000000, position.get());
+    EXPECT_EQ(2, remote->gets);
+
+    position.set_playing(false);
+    clock.t += seconds{3};
+    EXPECT_EQ(5000000000, position.get());
+    EXPECT_EQ(2, remote->gets);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/apparmor/ubuntu.h"
+#include "core/media/client_quotas.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+media::ClientQuotas::Configuration configuration()
+{
+    media::ClientQuotas::Configuration config;
+    config.max_sessions = 2;
+    config.max_tracks = 100;
+    config.max_metadata_requests = 3;
+    return config;
+}
+}
+
+TEST(ClientQuotas, clients_are_told_apart_by_package_name)
+{
+    const media::apparmor::ubuntu::Context music{"com.ubuntu.music_music_1.3"};
+    const media::apparmor::ubuntu::Context unconfined{"unconfined"};
+
+    EXPECT_EQ("com.ubuntu.music", media::ClientQuotas::client_for(music, ":1.42"));
+    EXPECT_EQ("com.ubuntu.music", media::ClientQuotas::client_for(music, ":1.43"));
+    // Unconfined clients don't get to share a quota with each other
+    EXPECT_EQ(":1.42", media::ClientQuotas::client_for(unconfined, ":1.42"));
+}
+
+TEST(ClientQuotas, sessions_count_for_as_long_as_they_live)
+{
+    media::ClientQuotas quotas{configuration()};
+
+    std::vector<std::shared_ptr<int>> sessions;
+    while (const auto slot = quotas.admit_session("a"))
+    {
+        sessions.push_back(std::make_shared<int>(0));
+        quotas.bind_session("a", slot, sessions.back());
+    }
+
+    EXPECT_EQ(2u, sessions.size());
+    EXPECT_EQ(2u, quotas.usage("a").sessions);
+    // Other clients are not affected
+    EXPECT_NE(nullptr, quotas.admit_session("b"));
+
+    sessions.pop_back();
+    EXPECT_NE(nullptr, quotas.admit_session("a"));
+    EXPECT_EQ(1u, quotas.usage("a").sessions);
+
+    sessions.clear();
+    EXPECT_TRUE(quotas.usage().empty());
+}
+
+TEST(ClientQuotas, admitted_sessions_count_before_they_are_built)
+{
+    media::ClientQuotas quotas{configuration()};
+
+    // Both requests are admitted before either session exists
+    auto first = quotas.admit_session("a");
+    auto second = quotas.admit_session("a");
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    EXPECT_EQ(nullptr, quotas.admit_session("a"));
+    EXPECT_EQ(2u, quotas.usage("a").sessions);
+
+    // The first session got built, building the second one failed
+    auto session = std::make_shared<int>(0);
+    quotas.bind_session("a", first, session);
+    first.reset();
+    second.reset();
+    EXPECT_EQ(1u, quotas.usage("a").sessions);
+
+    session.reset();
+    EXPECT_TRUE(quotas.usage().empty());
+}
+
+TEST(ClientQuotas, tracks_and_metadata_requests_are_limited)
+{
+    media::ClientQuotas quotas{configuration()};
+
+    EXPECT_TRUE(quotas.acquire_tracks("a", 60));
+    // Nothing gets charged if the whole lot doesn't fit
+    EXPECT_FALSE(quotas.acquire_tracks("a", 41));
+    EXPECT_EQ(60u, quotas.usage("a").tracks);
+    EXPECT_TRUE(quotas.acquire_tracks("a", 40));
+    EXPECT_FALSE(quotas.acquire_tracks("a", 1));
+    quotas.release_tracks("a", 10);
+    EXPECT_TRUE(quotas.acquire_tracks("a", 10));
+
+    for (int i = 0; i < 3; i++)
+        EXPECT_TRUE(quotas.acquire_metadata_request("a"));
+    EXPECT_FALSE(quotas.acquire_metadata_request("a"));
+    EXPECT_TRUE(quotas.acquire_metadata_request("b"));
+    quotas.release_metadata_request("a");
+    EXPECT_TRUE(quotas.acquire_metadata_request("a"));
+
+    const auto usage = quotas.usage();
+    ASSERT_EQ(2u, usage.size());
+    EXPECT_EQ(100u, usage.at("a").tracks);
+    EXPECT_EQ(3u, usage.at("a").metadata_requests);
+    EXPECT_EQ(0u, usage.at("b").tracks);
+    EXPECT_EQ(1u, usage.at("b").metadata_requests);
+
+    // Releasing more than was charged does no harm
+    quotas.release_tracks("a", 1000);
+    EXPECT_EQ(0u, quotas.usage("a").tracks);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/dbus_client_death_observer.h"
+#include "core/media/hashed_keyed_player_store.h"
+#include "core/media/peer_departures.h"
+#include "core/media/session_registry.h"
+#include "core/media/session_resource_manager.h"
+#include "core/media/session_teardown.h"
+
+#include "fake_player.h"
+
+#include <core/media/player.h>
+
+#include <boost/asio/io_service.hpp>
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Wires a death observer to the session registry and the player store the
+// way the service does, with departures fed by hand instead of by a bus
+struct DBusClientDeathObserver : public ::testing::Test
+{
+    DBusClientDeathObserver()
+        : departures{std::make_shared<media::PeerDepartures>()},
+          players{std::make_shared<media::HashedKeyedPlayerStore>()},
+          observer{media::DBusClientDeathObserver::create(departures, io_service)}
+    {
+        observer->set_session_lookup(std::bind(
+                                         &media::sessions_to_tear_down,
+                                         std::ref(sessions),
+                                         std::cref(*players),
+                                         std::placeholders::_1));
+
+        // What the player implementation ends up with once its client is gone
+        connections.emplace_back(observer->on_client_with_key_died().connect([this](const media::Player::PlayerKey& key)
+        {
+            died.insert(key);
+            if (media::reclaim_session(*players, key))
+                resources.remove_session(key);
+        }));
+    }
+
+    // Registers a session attached to the given client
+    std::weak_ptr<media::Player> add_session(media::Player::PlayerKey key,
+                                             const std::string& sender,
+                                             media::Player::Lifetime lifetime = media::Player::Lifetime::normal)
+    {
+        sessions.add(key, "uuid-" + std::to_string(key));
+        sessions.set_owner(key, media::SessionRegistry::Owner{"app", true, sender});
+
+        const auto player = std::make_shared<testing::FakePlayer>(lifetime);
+        players->add_player_for_key(key, player);
+        // Played once, so it holds a pipeline
+        resources.add_session(key, player, []() { return true; });
+        resources.on_session_idle(key);
+        return player;
+    }
+
+    // Tells the observer that name left the bus, as NameOwnerChanged reports it
+    void leave(const std::string& name)
+    {
+        departures->on_name_owner_changed(name, name, std::string{});
+    }
+
+    boost::asio::io_service io_service;
+    media::PeerDepartures::Ptr departures;
+    media::SessionRegistry sessions;
+    std::shared_ptr<media::HashedKeyedPlayerStore> players;
+    media::SessionResourceManager resources{media::SessionResourceManager::Configuration{}};
+    media::DBusClientDeathObserver::Ptr observer;
+
+    std::set<media::Player::PlayerKey> died;
+    std::list<core::ScopedConnection> connections;
+};
+}
+
+TEST_F(DBusClientDeathObserver, sessions_of_departed_clients_release_their_pipelines)
+{
+    static const media::Player::PlayerKey resumable = 5;
+
+    // Client i owns sessions 2i and 2i + 1
+    const std::vector<std::string> clients{":1.10", ":1.11", ":1.12"};
+    std::map<media::Player::PlayerKey, std::weak_ptr<media::Player>> sessions_of_clients;
+    for (media::Player::PlayerKey i = 0; i < clients.size(); i++)
+        for (const auto key : {2 * i, 2 * i + 1})
+            sessions_of_clients[key] = add_session(
+                        key,
+                        clients[i],
+                        key == resumable ? media::Player::Lifetime::resumable : media::Player::Lifetime::normal);
+
+    leave(clients[0]);
+    leave(clients[2]);
+    // Well-known names changing hands are no departures
+    departures->on_name_owner_changed("com.example.Player", clients[1], std::string{});
+    io_service.run();
+
+    EXPECT_EQ((std::set<media::Player::PlayerKey>{0, 1, 4}), died);
+    // Only the sessions left over still count against the pipeline budget
+    EXPECT_EQ(3u, resources.loaded_pipelines());
+
+    for (const media::Player::PlayerKey key : {0, 1, 4})
+    {
+        EXPECT_TRUE(sessions_of_clients[key].expired());
+        EXPECT_FALSE(players->has_player_for_key(key));
+
+        media::SessionRegistry::Owner owner;
+        EXPECT_FALSE(sessions.owner(key, owner));
+    }
+
+    // Sessions of the client that is still around stay as they are
+    for (const media::Player::PlayerKey key : {2, 3})
+    {
+        EXPECT_FALSE(sessions_of_clients[key].expired());
+
+        media::SessionRegistry::Owner owner;
+        ASSERT_TRUE(sessions.owner(key, owner));
+        EXPECT_TRUE(owner.attached);
+        EXPECT_EQ(clients[1], owner.sender);
+    }
+
+    // Resumable ones wait for their owner to come back
+    EXPECT_FALSE(sessions_of_clients[resumable].expired());
+    media::SessionRegistry::Owner owner;
+    ASSERT_TRUE(sessions.owner(resumable, owner));
+    EXPECT_FALSE(owner.attached);
+    EXPECT_TRUE(owner.sender.empty());
+}
+
+TEST_F(DBusClientDeathObserver, clients_leaving_in_a_burst_are_torn_down_at_once)
+{
+    const auto first = add_session(0, ":1.20");
+    const auto second = add_session(1, ":1.21");
+
+    leave(":1.20");
+    leave(":1.21");
+    // Both got handled by the one tear down posted for the first
+    EXPECT_EQ(1u, io_service.poll_one());
+
+    EXPECT_EQ((std::set<media::Player::PlayerKey>{0, 1}), died);
+    EXPECT_TRUE(first.expired());
+    EXPECT_TRUE(second.expired());
+    EXPECT_EQ(0u, sessions.size());
+    EXPECT_EQ(0u, resources.loaded_pipelines());
+}
+
+TEST_F(DBusClientDeathObserver, sessions_already_gone_from_the_store_are_forgotten)
+{
+    add_session(0, ":1.30");
+    players->remove_player_for_key(0);
+
+    leave(":1.30");
+    io_service.run();
+
+    EXPECT_TRUE(died.empty());
+    EXPECT_EQ(0u, sessions.size());
+}
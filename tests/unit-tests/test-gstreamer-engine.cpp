@@ -24,6 +24,7 @@
 
 #include "core/media/xesam.h"
 #include "core/media/gstreamer/engine.h"
+#include "core/media/gstreamer/meta_data_extractor.h"
 
 #include "../test_data.h"
 #include "../waitable_state_transition.h"
@@ -35,7 +36,9 @@
 
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace media = core::ubuntu::media;
 
@@ -406,6 +409,108 @@ TEST(GStreamerEngine, provides_non_null_meta_data_extractor)
     EXPECT_NE(nullptr, engine.meta_data_extractor());
 }
 
+TEST(GStreamerEngine, engines_share_a_lazily_created_meta_data_extractor)
+{
+    const std::size_t n_sessions{30};
+    const auto shared = std::make_shared<gstreamer::SharedMetaDataExtractor>();
+
+    std::vector<std::unique_ptr<gstreamer::Engine>> engines;
+    for (std::size_t i = 0; i < n_sessions; i++)
+        engines.emplace_back(new gstreamer::Engine(i, shared));
+
+    for (const auto& engine : engines)
+        EXPECT_EQ(shared, engine->meta_data_extractor());
+    // Nobody asked for metadata yet
+    EXPECT_FALSE(shared->has_pipeline());
+}
+
+TEST(GStreamerEngine, shared_meta_data_extractor_serves_sessions_in_parallel_from_a_bounded_pool)
+{
+    const std::size_t n_sessions{6};
+    const std::size_t n_pipelines{2};
+    const std::string test_file{"/tmp/test.mp3"};
+    const std::string test_file_uri{"file:///tmp/test.mp3"};
+    std::remove(test_file.c_str());
+    ASSERT_TRUE(test::copy_test_media_file_to("test.mp3", test_file));
+
+    gstreamer::SharedMetaDataExtractor shared{n_pipelines};
+
+    std::vector<core::ubuntu::media::Track::MetaData> md(n_sessions);
+    std::vector<std::thread> sessions;
+    for (std::size_t i = 0; i < n_sessions; i++)
+        sessions.emplace_back([&shared, &md, &test_file_uri, i]()
+        {
+            EXPECT_NO_THROW({
+                md[i] = shared.meta_data_for_track_with_uri(test_file_uri);
+            });
+        });
+    for (auto& session : sessions)
+        session.join();
+
+    EXPECT_LE(shared.pipelines(), n_pipelines);
+    for (const auto& m : md)
+    {
+        if (0 < m.count(xesam::Artist::name))
+            EXPECT_EQ("Ezwa", m.get(xesam::Artist::name));
+    }
+}
+
+TEST(GStreamerEngine, released_pipeline_resumes_where_it_left_off)
+{
+    const std::string test_file{"/tmp/test-audio.ogg"};
+    const std::string test_file_uri{"file:///tmp/test-audio.ogg"};
+    std::remove(test_file.c_str());
+    ASSERT_TRUE(test::copy_test_media_file_to("test-audio.ogg", test_file));
+
+    gstreamer::Engine engine{0};
+    EXPECT_TRUE(engine.open_resource_for_uri(test_file_uri, false));
+    // Nothing loaded yet, so nothing to release
+    EXPECT_FALSE(engine.release_pipeline());
+
+    ASSERT_TRUE(engine.pause());
+    engine.seek_to(std::chrono::seconds{1});
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+
+    EXPECT_TRUE(engine.release_pipeline());
+    EXPECT_TRUE(engine.is_pipeline_released());
+    EXPECT_EQ(core::ubuntu::media::Engine::State::paused, engine.state().get());
+    EXPECT_LE(std::chrono::nanoseconds{std::chrono::milliseconds{900}}.count(),
+              static_cast<std::int64_t>(engine.position().get()));
+
+    EXPECT_TRUE(engine.play());
+    EXPECT_FALSE(engine.is_pipeline_released());
+    EXPECT_EQ(core::ubuntu::media::Engine::State::playing, engine.state().get());
+    EXPECT_TRUE(engine.stop());
+}
+
+TEST(GStreamerEngine, sessions_play_again_after_their_idle_pipelines_got_released)
+{
+    const std::size_t n_sessions{6};
+    const std::size_t n_busy{2};
+    const std::string test_file{"/tmp/test-audio.ogg"};
+    const std::string test_file_uri{"file:///tmp/test-audio.ogg"};
+    std::remove(test_file.c_str());
+    ASSERT_TRUE(test::copy_test_media_file_to("test-audio.ogg", test_file));
+
+    std::vector<std::unique_ptr<gstreamer::Engine>> engines;
+    for (std::size_t i = 0; i < n_sessions; i++)
+    {
+        engines.emplace_back(new gstreamer::Engine(i));
+        engines.back()->open_resource_for_uri(test_file_uri, false);
+        ASSERT_TRUE(engines.back()->pause());
+    }
+
+    for (std::size_t i = n_busy; i < n_sessions; i++)
+        EXPECT_TRUE(engines[i]->release_pipeline());
+
+    for (const auto& engine : engines)
+    {
+        EXPECT_TRUE(engine->play());
+        EXPECT_FALSE(engine->is_pipeline_released());
+        EXPECT_TRUE(engine->stop());
+    }
+}
+
 TEST(GStreamerEngine, meta_data_extractor_provides_correct_tags)
 {
     const std::string test_file{"/tmp/test.mp3"};
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/peer_cancellation.h"
+#include "core/media/util/worker_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+TEST(PeerCancellation, tokens_trip_once_their_peer_is_gone)
+{
+    media::PeerCancellation cancellation;
+
+    const auto a = cancellation.token_for(":1.42");
+    const auto b = cancellation.token_for(":1.43");
+    const auto a_again = cancellation.token_for(":1.42");
+    EXPECT_FALSE(a.is_cancelled());
+
+    cancellation.on_peer_gone(":1.42");
+    EXPECT_TRUE(a.is_cancelled());
+    EXPECT_TRUE(a_again.is_cancelled());
+    // Other peers are not affected
+    EXPECT_FALSE(b.is_cancelled());
+
+    // Nor is a peer that shows up under a name nobody held a token for
+    cancellation.on_peer_gone(":1.44");
+    EXPECT_FALSE(cancellation.token_for(":1.44").is_cancelled());
+
+    EXPECT_FALSE(media::CancellationToken{}.is_cancelled());
+}
+
+TEST(PeerCancellation, peers_are_forgotten_once_no_work_holds_a_token)
+{
+    media::PeerCancellation cancellation;
+
+    std::vector<media::CancellationToken> tokens;
+    for (int i = 0; i < 1000; i++)
+    {
+        const auto token = cancellation.token_for(":1." + std::to_string(i));
+        if (i % 10 == 0)
+            tokens.push_back(token);
+    }
+
+    EXPECT_EQ(100u, cancellation.size());
+    tokens.clear();
+    EXPECT_EQ(0u, cancellation.size());
+}
+
+TEST(PeerCancellation, queued_calls_of_a_peer_that_left_are_dropped)
+{
+    media::WorkerPool pool{1};
+    auto queue = media::SerialQueue::create(pool);
+    media::PeerCancellation cancellation;
+
+    // Holds the queue until all the calls are in
+    std::promise<void> go;
+    auto gate = go.get_future().share();
+    queue->post([gate]() { gate.wait(); });
+
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 100; i++)
+    {
+        const auto token = cancellation.token_for(i % 2 ? ":1.1" : ":1.2");
+        queue->post([token, &ran]()
+        {
+            if (token.is_cancelled())
+                return;
+
+            ++ran;
+        });
+    }
+
+    cancellation.on_peer_gone(":1.1");
+    go.set_value();
+
+    std::promise<void> done;
+    queue->post([&done]() { done.set_value(); });
+    ASSERT_EQ(std::future_status::ready, done.get_future().wait_for(std::chrono::seconds{5}));
+    EXPECT_EQ(50, ran.load());
+}
+
+TEST(PeerCancellation, tokens_trip_once_departures_tell_about_their_peer)
+{
+    const auto departures = std::make_shared<media::PeerDepartures>();
+    media::PeerCancellation cancellation{departures};
+
+    const auto unique = cancellation.token_for(":1.42");
+    const auto other = cancellation.token_for(":1.43");
+
+    // A well-known name changing hands says nothing about a peer
+    departures->on_name_owner_changed("com.ubuntu.music", ":1.42", "");
+    // Nor does a unique name showing up
+    departures->on_name_owner_changed(":1.42", "", ":1.42");
+    EXPECT_FALSE(unique.is_cancelled());
+
+    departures->on_name_owner_changed(":1.42", ":1.42", "");
+    EXPECT_TRUE(unique.is_cancelled());
+    EXPECT_FALSE(other.is_cancelled());
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "core/media/hashed_keyed_player_store.h"
+#include "core/media/peer_connection.h"
+#include "core/media/peer_endpoint.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+std::string test_address()
+{
+    std::stringstream ss;
+    ss << "unix:path=/tmp/test-peer-endpoint-" << ::getpid();
+    return ss.str();
+}
+}
+
+TEST(PeerEndpoint, credentials_are_those_of_the_process_on_the_other_end)
+{
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+    const auto credentials = media::PeerEndpoint::Credentials::of_socket(fds[0]);
+    EXPECT_EQ(::getpid(), credentials.pid);
+    EXPECT_EQ(::getuid(), credentials.uid);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(PeerEndpoint, only_unconfined_clients_and_the_shell_of_the_same_user_are_trusted)
+{
+    const uid_t uid = ::getuid();
+
+    EXPECT_TRUE(media::PeerEndpoint::is_trusted({1, uid, "unconfined"}));
+    EXPECT_TRUE(media::PeerEndpoint::is_trusted({1, uid, "unity8-dash"}));
+
+    EXPECT_FALSE(media::PeerEndpoint::is_trusted({1, uid + 1, "unconfined"}));
+    EXPECT_FALSE(media::PeerEndpoint::is_trusted({1, uid, "com.ubuntu.music_music_1.3"}));
+    // Labels that aren't AppArmor profiles we know of
+    EXPECT_FALSE(media::PeerEndpoint::is_trusted({1, uid, "/usr/bin/evince"}));
+    // The kernel couldn't tell the label
+    EXPECT_FALSE(media::PeerEndpoint::is_trusted({1, uid, ""}));
+}
+
+TEST(PeerEndpoint, calls_for_unknown_sessions_fail)
+{
+    media::PeerEndpoint::Configuration configuration;
+    configuration.address = test_address();
+
+    media::PeerEndpoint endpoint{configuration, std::make_shared<media::HashedKeyedPlayerStore>()};
+    EXPECT_EQ(0u, endpoint.address().find(configuration.address));
+
+    const auto connection = media::PeerConnection::open(configuration.address);
+    ASSERT_NE(nullptr, connection);
+    EXPECT_THROW(connection->play(42), std::runtime_error);
+    EXPECT_THROW(connection->position(42), std::runtime_error);
+}
+
+TEST(PeerEndpoint, nothing_is_opened_if_nobody_listens)
+{
+    EXPECT_EQ(nullptr, media::PeerConnection::open(test_address()));
+    EXPECT_EQ(nullptr, media::PeerConnection::open(std::string{}));
+}
+
+TEST(PeerEndpoint, sockets_left_behind_are_taken_over)
+{
+    const auto address = test_address();
+    const auto path = address.substr(std::string{"unix:path="}.size());
+
+    // Bound, but nobody listens anymore
+    sockaddr_un un;
+    std::memset(&un, 0, sizeof(un));
+    un.sun_family = AF_UNIX;
+    std::strncpy(un.sun_path, path.c_str(), sizeof(un.sun_path) - 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(0, ::bind(fd, reinterpret_cast<const sockaddr*>(&un), sizeof(un)));
+    ::close(fd);
+
+    media::PeerEndpoint::Configuration configuration;
+    configuration.address = address;
+    EXPECT_NO_THROW(media::PeerEndpoint(configuration, std::make_shared<media::HashedKeyedPlayerStore>()));
+}
+
+TEST(PeerEndpoint, endpoints_in_use_and_other_files_are_left_alone)
+{
+    media::PeerEndpoint::Configuration configuration;
+    configuration.address = test_address();
+    const auto path = configuration.address.substr(std::string{"unix:path="}.size());
+
+    {
+        media::PeerEndpoint endpoint{configuration, std::make_shared<media::HashedKeyedPlayerStore>()};
+        EXPECT_THROW(media::PeerEndpoint(configuration, std::make_shared<media::HashedKeyedPlayerStore>()),
+                     std::runtime_error);
+        // Still serving
+        EXPECT_NE(nullptr, media::PeerConnection::open(configuration.address));
+    }
+
+    ::unlink(path.c_str());
+    const int fd = ::open(path.c_str(), O_CREAT | O_WRONLY, 0600);
+    ASSERT_LE(0, fd);
+    ::close(fd);
+
+    EXPECT_THROW(media::PeerEndpoint(configuration, std::make_shared<media::HashedKeyedPlayerStore>()),
+                 std::runtime_error);
+    struct stat st;
+    EXPECT_EQ(0, ::stat(path.c_str(), &st));
+    EXPECT_TRUE(S_ISREG(st.st_mode));
+
+    ::unlink(path.c_str());
+}
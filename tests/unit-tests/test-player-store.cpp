@@ -26,42 +26,205 @@
 #include <core/media/service.h>
 #include <core/media/player.h>
 
+#include "fake_player.h"
+
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 namespace media = core::ubuntu::media;
 
-// FIXME: I can't get this test to reliably pass every time. What happens
-// is number of Player instances actually added to the HashedKeyedPlayerStore
-// sometimes is less than the actual number of Players added.
-TEST(PlayerStore, DISABLED_adding_players_from_multiple_threads_works)
+// Writers keep adding players while readers keep looking them up and
+// enumerating them.
+TEST(PlayerStore, adding_players_from_multiple_threads_works)
 {
     media::HashedKeyedPlayerStore store;
-    media::Player::PlayerKey key = 0;
 
     static constexpr uint16_t num_workers = 3;
-    size_t i;
+    static constexpr uint16_t num_readers = 3;
+    static constexpr size_t players_per_worker = 300;
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < num_readers; i++)
+    {
+        readers.push_back(std::thread([&store, &done]()
+        {
+            // Players only ever get added, so no snapshot may shrink
+            size_t last = 0;
+            while (not done)
+            {
+                size_t n = 0;
+                store.enumerate_players([&n](const media::Player::PlayerKey&, const std::shared_ptr<media::Player>&)
+                {
+                    ++n;
+                });
+                EXPECT_LE(last, n);
+                last = n;
+            }
+        }));
+    }
+
     std::vector<std::thread> workers;
-    for (i=0; i<num_workers; i++)
+    for (size_t i = 0; i < num_workers; i++)
     {
-        workers.push_back(std::thread([&store, i, &key]()
+        workers.push_back(std::thread([&store, i]()
         {
             const std::shared_ptr<media::Player> player;
-            const size_t num_players_before_add = store.number_of_players();
-            while (store.number_of_players() == num_players_before_add)
-                store.add_player_for_key(key, player);
+            for (size_t j = 0; j < players_per_worker; j++)
+                store.add_player_for_key(i * players_per_worker + j, player);
+        }));
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    ASSERT_EQ(num_workers * players_per_worker, store.number_of_players());
+    for (size_t key = 0; key < num_workers * players_per_worker; key++)
+        EXPECT_TRUE(store.has_player_for_key(key));
+}
 
-            std::cout << "Added Player instance with key: " << key << std::endl;
-            ++key;
+TEST(PlayerStore, enumerators_neither_block_writers_nor_deadlock)
+{
+    media::HashedKeyedPlayerStore store;
+    const std::shared_ptr<media::Player> player;
+    store.add_player_for_key(0, player);
+    store.add_player_for_key(1, player);
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool enumerating = false;
+    bool added = false;
+    bool added_while_enumerating = false;
+
+    // A slow enumerator, like one pausing other sessions, must not hold up writers.
+    // It stays within its first callback until the writer is done.
+    std::thread enumerator([&]()
+    {
+        bool first = true;
+        store.enumerate_players([&](const media::Player::PlayerKey&, const std::shared_ptr<media::Player>&)
+        {
+            if (not first)
+                return;
+            first = false;
+
+            std::unique_lock<std::mutex> ul{m};
+            enumerating = true;
+            cv.notify_all();
+            added_while_enumerating = cv.wait_for(ul, std::chrono::seconds{5}, [&added]() { return added; });
+        });
+    });
+
+    {
+        std::unique_lock<std::mutex> ul{m};
+        EXPECT_TRUE(cv.wait_for(ul, std::chrono::seconds{5}, [&enumerating]() { return enumerating; }));
+    }
+
+    store.add_player_for_key(2, player);
+    {
+        std::lock_guard<std::mutex> lg{m};
+        added = true;
+    }
+    cv.notify_all();
+    enumerator.join();
+
+    EXPECT_TRUE(added_while_enumerating);
+    EXPECT_EQ(3u, store.number_of_players());
+
+    // Enumerators may call back into the store
+    store.enumerate_players([&store](const media::Player::PlayerKey& key, const std::shared_ptr<media::Player>&)
+    {
+        store.remove_player_for_key(key);
+    });
+    EXPECT_EQ(0u, store.number_of_players());
+}
+
+TEST(PlayerStore, current_player_can_be_read_while_it_changes)
+{
+    media::HashedKeyedPlayerStore store;
+    const std::shared_ptr<media::Player> a = std::make_shared<testing::FakePlayer>();
+    const std::shared_ptr<media::Player> b = std::make_shared<testing::FakePlayer>();
+    store.add_player_for_key(0, a);
+    store.add_player_for_key(1, b);
+    store.set_current_player_for_key(0);
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 3; i++)
+    {
+        readers.push_back(std::thread([&]()
+        {
+            while (not done)
+            {
+                const auto current = store.current_player().get();
+                EXPECT_TRUE(current == a or current == b);
+            }
         }));
     }
 
-    for (i=0; i<workers.size(); i++)
-        workers[i].join();
+    for (size_t i = 0; i < 1000; i++)
+        store.set_current_player_for_key(i % 2);
+
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(b, store.current_player().get());
+}
+
+TEST(PlayerStore, current_player_changes_are_announced_with_the_store_unlocked)
+{
+    media::HashedKeyedPlayerStore store;
+    const std::shared_ptr<media::Player> player = std::make_shared<testing::FakePlayer>();
+    store.add_player_for_key(0, player);
+
+    std::vector<std::shared_ptr<media::Player>> announced;
+    std::thread writer;
+    std::mutex m;
+    std::condition_variable cv;
+    bool added = false;
+    bool added_while_announcing = false;
+
+    core::ScopedConnection connection
+    {
+        store.current_player().changed().connect([&](const std::shared_ptr<media::Player>& current)
+        {
+            announced.push_back(current);
+            if (current != player)
+                return;
+
+            // Observers hand work off to other threads, which must get at the store meanwhile
+            writer = std::thread([&]()
+            {
+                store.add_player_for_key(1, player);
+                std::lock_guard<std::mutex> lg{m};
+                added = true;
+                cv.notify_all();
+            });
+
+            std::unique_lock<std::mutex> ul{m};
+            added_while_announcing = cv.wait_for(ul, std::chrono::seconds{5}, [&added]() { return added; });
+        })
+    };
+
+    store.set_current_player_for_key(0);
+    writer.join();
+    EXPECT_TRUE(added_while_announcing);
+    EXPECT_EQ(player, store.current_player().get());
 
-    ASSERT_EQ(store.number_of_players(), workers.size());
+    store.remove_player_for_key(0);
+    EXPECT_EQ(nullptr, store.current_player().get());
+    EXPECT_EQ((std::vector<std::shared_ptr<media::Player>>{player, nullptr}), announced);
 }
@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/util/playlist_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Writes content into a fresh temporary file with the given suffix and returns its path.
+std::string write_playlist(const std::string& suffix, const std::string& content)
+{
+    char tmpl[] = "/tmp/media-hub-playlist-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    ::close(fd);
+    const std::string path = std::string{tmpl} + suffix;
+    std::rename(tmpl, path.c_str());
+
+    std::ofstream out{path};
+    out << content;
+    return path;
+}
+}
+
+TEST(PlaylistParser, parses_m3u_and_resolves_relative_entries)
+{
+    const auto path = write_playlist(".m3u",
+        "#EXTM3U\n"
+        "#EXTINF:123,Artist - Title\n"
+        "song.ogg\n"
+        "\n"
+        "/media/music/other.mp3\r\n"
+        "http://example.com/stream.mp3\n");
+
+    media::PlaylistParser parser{path};
+    EXPECT_EQ(media::PlaylistParser::Format::m3u, parser.format());
+
+    media::TrackList::ContainerURI uris;
+    EXPECT_FALSE(parser.read_entries(10, uris));
+
+    ASSERT_EQ(3u, uris.size());
+    EXPECT_EQ("file:///tmp/song.ogg", uris[0]);
+    EXPECT_EQ("file:///media/music/other.mp3", uris[1]);
+    EXPECT_EQ("http://example.com/stream.mp3", uris[2]);
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistParser, parses_pls)
+{
+    const auto path = write_playlist(".pls",
+        "[playlist]\n"
+        "File1=http://example.com/one.mp3\n"
+        "Title1=One\n"
+        "File2=/media/music/two.mp3\n"
+        "NumberOfEntries=2\n");
+
+    media::PlaylistParser parser{path};
+    EXPECT_EQ(media::PlaylistParser::Format::pls, parser.format());
+
+    media::TrackList::ContainerURI uris;
+    parser.read_entries(10, uris);
+
+    ASSERT_EQ(2u, uris.size());
+    EXPECT_EQ("http://example.com/one.mp3", uris[0]);
+    EXPECT_EQ("file:///media/music/two.mp3", uris[1]);
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistParser, parses_xspf_without_extension)
+{
+    const auto path = write_playlist("",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+        "  <location>http://example.com/playlist.xspf</location>\n"
+        "  <trackList>\n"
+        "    <track><location>http://example.com/a.ogg</location></track>\n"
+        "    <track>\n"
+        "      <location>\n"
+        "        http://example.com/b.ogg?x=1&amp;y=2\n"
+        "      </location>\n"
+        "    </track>\n"
+        "  </trackList>\n"
+        "</playlist>\n");
+
+    media::PlaylistParser parser{path};
+    EXPECT_EQ(media::PlaylistParser::Format::xspf, parser.format());
+
+    media::TrackList::ContainerURI uris;
+    parser.read_entries(10, uris);
+
+    ASSERT_EQ(2u, uris.size());
+    EXPECT_EQ("http://example.com/a.ogg", uris[0]);
+    EXPECT_EQ("http://example.com/b.ogg?x=1&y=2", uris[1]);
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistParser, missing_playlist_throws)
+{
+    EXPECT_THROW(media::PlaylistParser{"/tmp/this/playlist/does/not/exist.m3u"},
+                 media::PlaylistParser::Errors::FailedToOpenPlaylist);
+}
+
+// The first batch of a playlist is handed out as soon as it has been read,
+// without waiting for the rest. The playlist is a FIFO here, and the rest of
+// it only gets written once the first batch came through.
+TEST(PlaylistParser, first_batch_is_available_before_the_rest_of_the_playlist)
+{
+    const std::size_t n_entries{20000};
+    const std::size_t first_batch{8};
+    const std::size_t batch{512};
+
+    auto entries = [](std::size_t from, std::size_t to)
+    {
+        std::string content;
+        for (std::size_t i = from; i < to; i++)
+            content += "#EXTINF:180,Artist - Track " + std::to_string(i) + "\n"
+                       "/media/music/track-" + std::to_string(i) + ".ogg\n";
+        return content;
+    };
+
+    char tmpl[] = "/tmp/media-hub-playlist-XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(tmpl));
+    const std::string dir{tmpl};
+    const std::string path = dir + "/huge.m3u";
+    ASSERT_EQ(0, ::mkfifo(path.c_str(), 0600));
+
+    std::mutex guard;
+    std::condition_variable changed;
+    bool first_batch_read = false;
+    bool rest_written = false;
+
+    std::thread writer([&]()
+    {
+        std::ofstream out{path};
+        out << "#EXTM3U\n" << entries(0, first_batch) << std::flush;
+
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            // Gives up eventually, so that a parser reading ahead fails instead of hanging
+            changed.wait_for(ul, std::chrono::seconds{10}, [&first_batch_read]() { return first_batch_read; });
+            rest_written = true;
+        }
+
+        out << entries(first_batch, n_entries);
+    });
+
+    media::PlaylistParser parser{path};
+    media::TrackList::ContainerURI uris;
+    EXPECT_TRUE(parser.read_entries(first_batch, uris));
+
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        EXPECT_FALSE(rest_written);
+        first_batch_read = true;
+        changed.notify_all();
+    }
+
+    EXPECT_EQ(first_batch, uris.size());
+    EXPECT_EQ("file:///media/music/track-0.ogg", uris.front());
+
+    while (parser.read_entries(batch, uris));
+    writer.join();
+
+    EXPECT_EQ(n_entries, uris.size());
+    EXPECT_EQ("file:///media/music/track-" + std::to_string(n_entries - 1) + ".ogg", uris.back());
+
+    std::remove(path.c_str());
+    ::rmdir(dir.c_str());
+}
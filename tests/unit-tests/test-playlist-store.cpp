@@ -0,0 +1,224 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/util/playlist_store.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+std::string temporary_store()
+{
+    char tmpl[] = "/tmp/media-hub-playlists-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    ::close(fd);
+    std::remove(tmpl);
+    return tmpl;
+}
+
+std::vector<std::string> names_of(const std::vector<media::PlaylistStore::Playlist>& playlists)
+{
+    std::vector<std::string> names;
+    for (const auto& playlist : playlists)
+        names.push_back(playlist.name);
+    return names;
+}
+}
+
+TEST(PlaylistStore, orderings_are_kept_up_to_date)
+{
+    const auto path = temporary_store();
+    media::PlaylistStore store{path};
+
+    const auto rock = store.add("rock", "", {"file:///rock.ogg"});
+    const auto jazz = store.add("Jazz", "", {"file:///jazz.ogg"});
+    const auto blues = store.add("blues", "", {"file:///blues.ogg"});
+    EXPECT_EQ(3u, store.size());
+
+    typedef std::vector<std::string> Names;
+    EXPECT_EQ((Names{"blues", "Jazz", "rock"}),
+              names_of(store.playlists(0, 10, media::PlaylistStore::Ordering::alphabetical, false)));
+    EXPECT_EQ((Names{"rock", "Jazz", "blues"}),
+              names_of(store.playlists(0, 10, media::PlaylistStore::Ordering::creation_date, false)));
+    EXPECT_EQ((Names{"blues", "Jazz"}),
+              names_of(store.playlists(0, 2, media::PlaylistStore::Ordering::creation_date, true)));
+
+    EXPECT_TRUE(store.update(rock, "Rock", "", {"file:///rock.ogg", "file:///roll.ogg"}));
+    EXPECT_EQ((Names{"Jazz", "blues", "Rock"}),
+              names_of(store.playlists(0, 10, media::PlaylistStore::Ordering::modified_date, false)));
+
+    EXPECT_TRUE(store.mark_played(jazz));
+    EXPECT_EQ((Names{"Jazz"}),
+              names_of(store.playlists(0, 1, media::PlaylistStore::Ordering::last_play_date, true)));
+
+    EXPECT_TRUE(store.remove(blues));
+    EXPECT_FALSE(store.remove(blues));
+    EXPECT_EQ((Names{"Rock"}),
+              names_of(store.playlists(1, 10, media::PlaylistStore::Ordering::alphabetical, false)));
+    EXPECT_TRUE(store.playlists(2, 10, media::PlaylistStore::Ordering::alphabetical, false).empty());
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistStore, survives_a_restart)
+{
+    const auto path = temporary_store();
+    media::PlaylistStore::Id id = 0;
+    {
+        media::PlaylistStore store{path};
+        id = store.add("a", "file:///a.png", {"file:///1.ogg"});
+        store.add("b", "", {"file:///2.ogg"});
+        store.update(id, "c", "file:///c.png", {"file:///3.ogg", "file:///4.ogg"});
+        store.mark_played(id);
+        store.remove(id + 1);
+    }
+
+    media::PlaylistStore store{path};
+    ASSERT_EQ(1u, store.size());
+
+    media::PlaylistStore::Playlist playlist;
+    ASSERT_TRUE(store.playlist(id, playlist));
+    EXPECT_EQ("c", playlist.name);
+    EXPECT_EQ("file:///c.png", playlist.icon);
+    EXPECT_LE(playlist.created, playlist.modified);
+    EXPECT_LE(playlist.modified, playlist.last_played);
+
+    media::TrackList::ContainerURI uris;
+    ASSERT_TRUE(store.uris(id, uris));
+    EXPECT_EQ((media::TrackList::ContainerURI{"file:///3.ogg", "file:///4.ogg"}), uris);
+
+    // Ids are never handed out twice
+    EXPECT_NE(id, store.add("d", "", {}));
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistStore, imports_playlist_files)
+{
+    const auto path = temporary_store();
+    char tmpl[] = "/tmp/media-hub-playlist-dir-XXXXXX";
+    const std::string dir = ::mkdtemp(tmpl);
+    const std::string m3u = dir + "/Road Trip.m3u";
+    {
+        std::ofstream out{m3u};
+        out << "#EXTM3U\n/music/a.ogg\n/music/b.ogg\n";
+    }
+
+    media::PlaylistStore store{path};
+    EXPECT_TRUE(store.import_directory(dir));
+    // Nothing changed on disk since
+    EXPECT_FALSE(store.import_directory(dir));
+
+    const auto playlists = store.playlists(0, 10, media::PlaylistStore::Ordering::alphabetical, false);
+    ASSERT_EQ(1u, playlists.size());
+    EXPECT_EQ("Road Trip", playlists.front().name);
+
+    media::TrackList::ContainerURI uris;
+    ASSERT_TRUE(store.uris(playlists.front().id, uris));
+    EXPECT_EQ((media::TrackList::ContainerURI{"file:///music/a.ogg", "file:///music/b.ogg"}), uris);
+
+    std::remove(m3u.c_str());
+    EXPECT_TRUE(store.import_directory(dir));
+    EXPECT_EQ(0u, store.size());
+
+    ::rmdir(dir.c_str());
+    std::remove(path.c_str());
+}
+
+// Paging through all playlists in every ordering, the way an MPRIS client
+// populating a list view does, hands out every playlist exactly once.
+TEST(PlaylistStore, paging_hands_out_every_playlist_once)
+{
+    const std::size_t n_playlists{1000};
+    const std::size_t page_size{50};
+    const auto path = temporary_store();
+
+    {
+        media::PlaylistStore store{path};
+        for (std::size_t i = 0; i < n_playlists; i++)
+        {
+            // Names deliberately don't sort like the creation order does
+            const std::size_t k = (i * 7919) % n_playlists;
+            store.add("Playlist " + std::to_string(k), "", {"file:///music/" + std::to_string(k) + ".ogg"});
+        }
+    }
+
+    media::PlaylistStore store{path};
+    ASSERT_EQ(n_playlists, store.size());
+
+    const media::PlaylistStore::Ordering orderings[] =
+    {
+        media::PlaylistStore::Ordering::alphabetical,
+        media::PlaylistStore::Ordering::creation_date,
+        media::PlaylistStore::Ordering::modified_date,
+        media::PlaylistStore::Ordering::last_play_date
+    };
+
+    for (const auto ordering : orderings)
+    {
+        for (const bool reversed : {false, true})
+        {
+            std::set<media::PlaylistStore::Id> seen;
+            for (std::size_t index = 0; index < n_playlists; index += page_size)
+            {
+                const auto page = store.playlists(index, page_size, ordering, reversed);
+                ASSERT_EQ(page_size, page.size());
+                for (const auto& playlist : page)
+                    seen.insert(playlist.id);
+            }
+            EXPECT_EQ(n_playlists, seen.size());
+        }
+    }
+
+    const auto first = store.playlists(0, 1, media::PlaylistStore::Ordering::alphabetical, false);
+    ASSERT_EQ(1u, first.size());
+    EXPECT_EQ("Playlist 0", first.front().name);
+
+    std::remove(path.c_str());
+}
+
+TEST(PlaylistStore, cancelled_imports_leave_the_store_alone)
+{
+    const auto path = temporary_store();
+    char tmpl[] = "/tmp/media-hub-playlist-dir-XXXXXX";
+    const std::string dir = ::mkdtemp(tmpl);
+    const std::string m3u = dir + "/Road Trip.m3u";
+    {
+        std::ofstream out{m3u};
+        out << "#EXTM3U\n/music/a.ogg\n";
+    }
+
+    media::PlaylistStore store{path};
+    ASSERT_TRUE(store.import_directory(dir));
+    std::remove(m3u.c_str());
+
+    // Not even the deleted file gets noticed
+    EXPECT_FALSE(store.import_directory(dir, []() { return true; }));
+    EXPECT_EQ(1u, store.size());
+
+    ::rmdir(dir.c_str());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/mpris/properties_changed_batch.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Stands in for a dispatch queue, running what got scheduled when told to
+struct ManualScheduler
+{
+    void run()
+    {
+        std::vector<std::function<void()>> tasks;
+        tasks.swap(scheduled);
+        for (const auto& task : tasks)
+            task();
+    }
+
+    mpris::PropertiesChangedBatch::Scheduler scheduler()
+    {
+        return [this](const std::function<void()>& task) { scheduled.push_back(task); };
+    }
+
+    std::vector<std::function<void()>> scheduled;
+};
+
+template<typename T>
+core::dbus::types::Variant encode(const T& value)
+{
+    return core::dbus::types::Variant::encode(value);
+}
+}
+
+TEST(PropertiesChangedBatch, every_change_is_sent_right_away_without_a_scheduler)
+{
+    std::vector<mpris::PropertiesChangedBatch::Dictionary> sent;
+    const auto batch = mpris::PropertiesChangedBatch::create([&sent](const mpris::PropertiesChangedBatch::Dictionary& dict)
+    {
+        sent.push_back(dict);
+    });
+
+    batch->add("CanPlay", encode(true));
+    batch->add("CanPause", encode(true));
+
+    ASSERT_EQ(2u, sent.size());
+    EXPECT_EQ(1u, sent[0].count("CanPlay"));
+    EXPECT_EQ(1u, sent[1].count("CanPause"));
+}
+
+TEST(PropertiesChangedBatch, the_changes_of_a_track_change_go_out_as_one_message)
+{
+    std::vector<mpris::PropertiesChangedBatch::Dictionary> sent;
+    const auto batch = mpris::PropertiesChangedBatch::create([&sent](const mpris::PropertiesChangedBatch::Dictionary& dict)
+    {
+        sent.push_back(dict);
+    });
+
+    ManualScheduler queue;
+    batch->set_scheduler(queue.scheduler());
+
+    const auto messages_before = mpris::PropertiesChangedBatch::statistics().messages.load();
+
+    // What moving on to the next track sets, one property at a time
+    batch->add("PlaybackStatus", encode(std::string{"Stopped"}));
+    batch->add("CanPlay", encode(true));
+    batch->add("CanPause", encode(true));
+    batch->add("CanGoNext", encode(true));
+    batch->add("CanGoPrevious", encode(true));
+    batch->add("Duration", encode(std::int64_t{0}));
+    batch->add("Duration", encode(std::int64_t{180000000}));
+    batch->add("PlaybackStatus", encode(std::string{"Playing"}));
+
+    EXPECT_TRUE(sent.empty());
+    EXPECT_EQ(1u, queue.scheduled.size());
+
+    queue.run();
+    ASSERT_EQ(1u, sent.size());
+    EXPECT_EQ(6u, sent[0].size());
+    EXPECT_EQ(1u, mpris::PropertiesChangedBatch::statistics().messages.load() - messages_before);
+
+    // The next change starts a new batch
+    batch->add("CanGoNext", encode(false));
+    EXPECT_EQ(1u, queue.scheduled.size());
+    queue.run();
+    ASSERT_EQ(2u, sent.size());
+    EXPECT_EQ(1u, sent[1].size());
+}
+
+TEST(PropertiesChangedBatch, flushes_scheduled_for_a_batch_that_is_gone_do_nothing)
+{
+    ManualScheduler queue;
+    bool sent = false;
+    {
+        const auto batch = mpris::PropertiesChangedBatch::create([&sent](const mpris::PropertiesChangedBatch::Dictionary&)
+        {
+            sent = true;
+        });
+        batch->set_scheduler(queue.scheduler());
+        batch->add("CanPlay", encode(true));
+    }
+
+    queue.run();
+    EXPECT_FALSE(sent);
+}
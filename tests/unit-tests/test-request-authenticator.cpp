@@ -0,0 +1,148 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/apparmor/ubuntu.h"
+
+#include <gtest/gtest.h>
+
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace apparmor = core::ubuntu::media::apparmor;
+
+namespace
+{
+// The regex based checks the authenticator used to run, as reference
+bool reference_authenticate(const std::string& context_name, const std::string& uri)
+{
+    static const std::regex uri_re{R"delim(^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))?)delim"};
+    static const std::regex short_re{"(.*)_(.*)"};
+    static const std::regex full_re{"(.*)_(.*)_(.*)"};
+
+    if (context_name == apparmor::ubuntu::unconfined)
+        return true;
+
+    std::smatch uri_match;
+    std::regex_match(uri, uri_match, uri_re);
+    const std::string scheme = uri_match.str(2);
+    const std::string path = uri_match.str(5);
+
+    std::smatch match;
+    if (not std::regex_match(context_name, match, full_re))
+        std::regex_match(context_name, match, short_re);
+    const std::string package = match[1];
+    const std::string profile = std::string{match[1]} + "-" + std::string{match[2]};
+
+    const auto contains = [&path](const std::string& s) { return path.find(s) != std::string::npos; };
+
+    return contains(".local/share/" + package + "/") || contains(".cache/" + package + "/") ||
+           (contains("opt/click.ubuntu.com/") && contains(package)) ||
+           (package == "com.ubuntu.camera" && contains("/system/media/audio/ui/")) ||
+           ((package == "com.ubuntu.music" || package == "com.ubuntu.gallery") &&
+            (contains("Music/") || contains("Videos/") || contains("/media"))) ||
+           contains("/usr/share/sounds") ||
+           scheme == "http" || scheme == "https" || scheme == "rtsp";
+}
+
+std::vector<std::string> uris_of_an_album(std::size_t count)
+{
+    std::vector<std::string> uris;
+    for (std::size_t i = 0; i < count; i++)
+        uris.push_back("file:///home/phablet/Music/Album " + std::to_string(i % 50) + "/" + std::to_string(i) + ".ogg");
+    return uris;
+}
+}
+
+TEST(ExistingAuthenticator, agrees_with_the_regex_based_checks)
+{
+    const std::vector<std::string> contexts
+    {
+        "com.ubuntu.music_music_1.0",
+        "com.ubuntu.camera_camera",
+        "com.example.app_app_0.1"
+    };
+    const std::vector<std::string> uris
+    {
+        "file:///home/phablet/Music/a.ogg",
+        "file:///home/phablet/Videos/b.mp4",
+        "file:///media/phablet/sdcard/c.ogg",
+        "file:///home/phablet/media.ogg",
+        "file:///home/phablet/.local/share/com.example.app/d.ogg",
+        "file:///home/phablet/.cache/com.ubuntu.music/e.ogg",
+        "file:///opt/click.ubuntu.com/com.example.app/1.0/f.ogg",
+        "file:///opt/click.ubuntu.com/other/com.example.app.ogg",
+        "file:///system/media/audio/ui/camera_click.ogg",
+        "file:///usr/share/sounds/ubuntu/ringtones/g.ogg",
+        "file:///home/phablet/Documents/h.ogg",
+        "/home/phablet/Music/i.ogg",
+        "http://example.com/stream.mp3?id=1#start",
+        "https://example.com",
+        "rtsp://example.com/live",
+        "ftp://example.com/Music/j.ogg",
+        "k.ogg"
+    };
+
+    apparmor::ubuntu::ExistingAuthenticator authenticator;
+    // Twice, the second round is answered from the remembered decisions
+    for (int round = 0; round < 2; round++)
+    {
+        for (const auto& context_name : contexts)
+        {
+            const apparmor::ubuntu::Context context{context_name};
+            for (const auto& uri : uris)
+            {
+                EXPECT_EQ(reference_authenticate(context_name, uri),
+                          std::get<0>(authenticator.authenticate_open_uri_request(context, uri)))
+                        << context_name << " " << uri;
+            }
+        }
+    }
+}
+
+TEST(ExistingAuthenticator, context_names_are_split_like_app_ids)
+{
+    const apparmor::ubuntu::Context full{"com.ubuntu.music_music_1.0"};
+    EXPECT_EQ("com.ubuntu.music", full.package_name());
+    EXPECT_EQ("com.ubuntu.music-music", full.profile_name());
+
+    const apparmor::ubuntu::Context short_id{"com.ubuntu.music_music"};
+    EXPECT_EQ("com.ubuntu.music", short_id.package_name());
+    EXPECT_EQ("com.ubuntu.music-music", short_id.profile_name());
+
+    const apparmor::ubuntu::Context trusted{"messaging-app"};
+    EXPECT_EQ("messaging-app", trusted.package_name());
+    EXPECT_EQ("messaging-app", trusted.profile_name());
+
+    EXPECT_THROW(apparmor::ubuntu::Context{"not-an-app-id"}, std::logic_error);
+}
+
+// Decisions remembered per directory hold for every track of an album, and
+// stay with the app they were made for.
+TEST(ExistingAuthenticator, authorizes_all_uris_of_an_album_for_its_app_only)
+{
+    const auto uris = uris_of_an_album(500);
+
+    apparmor::ubuntu::ExistingAuthenticator authenticator;
+    const apparmor::ubuntu::Context music{"com.ubuntu.music_music_1.0"};
+    const apparmor::ubuntu::Context other{"com.example.app_app_0.1"};
+    for (const auto& uri : uris)
+    {
+        EXPECT_TRUE(std::get<0>(authenticator.authenticate_open_uri_request(music, uri))) << uri;
+        EXPECT_FALSE(std::get<0>(authenticator.authenticate_open_uri_request(other, uri))) << uri;
+    }
+}
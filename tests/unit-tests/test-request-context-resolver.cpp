@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/apparmor/ubuntu.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace apparmor = core::ubuntu::media::apparmor;
+
+namespace
+{
+// Stands in for the dbus daemon, answering queries only when told to
+struct FakeResolver : public apparmor::ubuntu::CachingRequestContextResolver
+{
+    void query_context_name_async(const std::string& name, std::function<void(const std::string&)> cb) override
+    {
+        queries.push_back(std::make_pair(name, cb));
+    }
+
+    void answer(const std::string& context_name)
+    {
+        auto query = queries.front();
+        queries.erase(queries.begin());
+        query.second(context_name);
+    }
+
+    std::vector<std::pair<std::string, std::function<void(const std::string&)>>> queries;
+};
+}
+
+TEST(CachingRequestContextResolver, queries_every_peer_only_once)
+{
+    FakeResolver resolver;
+    std::vector<std::string> resolved;
+    const auto collect = [&resolved](const apparmor::ubuntu::Context& context)
+    {
+        resolved.push_back(context.package_name());
+    };
+
+    // Concurrent requests of a new peer share one query
+    resolver.resolve_context_for_dbus_name_async(":1.7", collect);
+    resolver.resolve_context_for_dbus_name_async(":1.7", collect);
+    ASSERT_EQ(1u, resolver.queries.size());
+    EXPECT_TRUE(resolved.empty());
+
+    resolver.answer("com.ubuntu.music_music_1.0");
+    EXPECT_EQ((std::vector<std::string>{"com.ubuntu.music", "com.ubuntu.music"}), resolved);
+
+    // Later requests are answered right away
+    resolver.resolve_context_for_dbus_name_async(":1.7", collect);
+    EXPECT_TRUE(resolver.queries.empty());
+    EXPECT_EQ(3u, resolved.size());
+
+    const auto stats = resolver.statistics();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(2u, stats.misses);
+    EXPECT_DOUBLE_EQ(1. / 3, stats.hit_rate());
+
+    // Once the peer is gone it gets queried again
+    resolver.invalidate(":1.7");
+    resolver.resolve_context_for_dbus_name_async(":1.7", collect);
+    EXPECT_EQ(1u, resolver.queries.size());
+}
+
+TEST(CachingRequestContextResolver, failed_queries_are_not_cached)
+{
+    FakeResolver resolver;
+    int resolved = 0;
+    const auto count = [&resolved](const apparmor::ubuntu::Context&) { ++resolved; };
+
+    resolver.resolve_context_for_dbus_name_async(":1.8", count);
+    resolver.answer("");
+    EXPECT_EQ(0, resolved);
+
+    resolver.resolve_context_for_dbus_name_async(":1.8", count);
+    ASSERT_EQ(1u, resolver.queries.size());
+
+    // Invalidated while in flight, answered but not cached
+    resolver.invalidate(":1.8");
+    resolver.answer(apparmor::ubuntu::unconfined);
+    EXPECT_EQ(1, resolved);
+
+    resolver.resolve_context_for_dbus_name_async(":1.8", count);
+    EXPECT_EQ(1u, resolver.queries.size());
+}
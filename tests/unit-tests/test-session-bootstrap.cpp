@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/lazy_remote_signal.h"
+#include "core/media/session_bootstrap.h"
+#include "core/media/mpris/player.h"
+#include "core/media/mpris/service.h"
+
+#include <core/dbus/fixture.h>
+#include <core/dbus/message.h>
+#include <core/dbus/service.h>
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/variant.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dbus = core::dbus;
+namespace media = core::ubuntu::media;
+
+namespace
+{
+const std::string service_name{"core.ubuntu.media.test.SessionBootstrap"};
+const dbus::types::ObjectPath service_path{"/core/ubuntu/media/Service"};
+const dbus::types::ObjectPath session_path{"/core/ubuntu/media/Service/sessions/7"};
+const std::string session_uuid{"7cd1e5a4-5e2e-4ba0-9a25-2a4a8aa4e32c"};
+
+// Runs a private session bus with a connection for the service and one for
+// the client on it, both serviced by io_service
+struct SessionBootstrap : public ::testing::Test
+{
+    SessionBootstrap()
+        : fixture{dbus::Fixture::default_session_bus_config_file(),
+                  dbus::Fixture::default_system_bus_config_file()},
+          keep_alive{io_service},
+          service_bus{fixture.create_connection_to_session_bus()},
+          client_bus{fixture.create_connection_to_session_bus()}
+    {
+        service_bus->install_executor(dbus::asio::make_executor(service_bus, io_service));
+        client_bus->install_executor(dbus::asio::make_executor(client_bus, io_service));
+        worker = std::thread([this]() { io_service.run(); });
+
+        service = dbus::Service::add_service(service_bus, service_name);
+        skeleton = service->add_object_for_path(service_path);
+        stub = dbus::Service::use_service(client_bus, service_name)->object_for_path(service_path);
+    }
+
+    ~SessionBootstrap()
+    {
+        io_service.stop();
+        worker.join();
+    }
+
+    // Answers CreateSession like every version of the service does
+    void answer_create_session()
+    {
+        skeleton->install_method_handler<mpris::Service::CreateSession>([this](const dbus::Message::Ptr& msg)
+        {
+            auto reply = dbus::Message::make_method_return(msg);
+            reply->writer() << std::make_tuple(session_path, session_uuid);
+            service_bus->send(reply);
+        });
+    }
+
+    dbus::Fixture fixture;
+    boost::asio::io_service io_service;
+    boost::asio::io_service::work keep_alive;
+    dbus::Bus::Ptr service_bus;
+    dbus::Bus::Ptr client_bus;
+    std::thread worker;
+
+    dbus::Service::Ptr service;
+    dbus::Object::Ptr skeleton;
+    dbus::Object::Ptr stub;
+};
+
+// What bootstrap_session_async told about
+std::pair<std::exception_ptr, media::BootstrappedSession> bootstrap_async(const dbus::Object::Ptr& stub)
+{
+    auto promise = std::make_shared<std::promise<std::pair<std::exception_ptr, media::BootstrappedSession>>>();
+    auto future = promise->get_future();
+    media::bootstrap_session_async(stub, [promise](std::exception_ptr error, const media::BootstrappedSession& session)
+    {
+        promise->set_value(std::make_pair(error, session));
+    });
+
+    EXPECT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds{5}));
+    return future.get();
+}
+}
+
+TEST_F(SessionBootstrap, sessions_come_with_their_key_and_properties)
+{
+    answer_create_session();
+    skeleton->install_method_handler<mpris::Service::BootstrapSession>([this](const dbus::Message::Ptr& msg)
+    {
+        std::map<std::string, dbus::types::Variant> player, track_list;
+        player["CanPlay"] = dbus::types::Variant::encode(true);
+        track_list["CanEditTracks"] = dbus::types::Variant::encode(false);
+
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << std::make_tuple(session_path, session_uuid, media::Player::PlayerKey{7}, player, track_list);
+        service_bus->send(reply);
+    });
+
+    const auto session = media::bootstrap_session(stub);
+    EXPECT_EQ(session_path.as_string(), session.path.as_string());
+    EXPECT_EQ(session_uuid, session.uuid);
+    ASSERT_TRUE(session.state != nullptr);
+    EXPECT_EQ(media::Player::PlayerKey{7}, session.state->key);
+    EXPECT_TRUE(session.state->properties.at("CanPlay").as<bool>());
+    EXPECT_FALSE(session.state->track_list_properties.at("CanEditTracks").as<bool>());
+
+    const auto async = bootstrap_async(stub);
+    EXPECT_FALSE(async.first);
+    EXPECT_EQ(session_uuid, async.second.uuid);
+    EXPECT_TRUE(async.second.state != nullptr);
+}
+
+TEST_F(SessionBootstrap, services_without_bootstrap_session_are_asked_with_create_session)
+{
+    answer_create_session();
+    // What a service that predates BootstrapSession answers
+    skeleton->install_method_handler<mpris::Service::BootstrapSession>([this](const dbus::Message::Ptr& msg)
+    {
+        service_bus->send(dbus::Message::make_error(msg, "org.freedesktop.DBus.Error.UnknownMethod",
+                                                    "No such method"));
+    });
+
+    const auto session = media::bootstrap_session(stub);
+    EXPECT_EQ(session_path.as_string(), session.path.as_string());
+    EXPECT_EQ(session_uuid, session.uuid);
+    // The stub asks for the rest itself
+    EXPECT_TRUE(session.state == nullptr);
+
+    const auto async = bootstrap_async(stub);
+    EXPECT_FALSE(async.first);
+    EXPECT_EQ(session_path.as_string(), async.second.path.as_string());
+    EXPECT_EQ(session_uuid, async.second.uuid);
+    EXPECT_TRUE(async.second.state == nullptr);
+}
+
+TEST_F(SessionBootstrap, other_errors_are_not_taken_for_an_older_service)
+{
+    answer_create_session();
+    skeleton->install_method_handler<mpris::Service::BootstrapSession>([this](const dbus::Message::Ptr& msg)
+    {
+        service_bus->send(dbus::Message::make_error(msg, mpris::Service::Errors::CreatingSession::name(),
+                                                    "Too many sessions"));
+    });
+
+    EXPECT_THROW(media::bootstrap_session(stub), std::runtime_error);
+
+    const auto async = bootstrap_async(stub);
+    ASSERT_TRUE(async.first != nullptr);
+    EXPECT_THROW(std::rethrow_exception(async.first), std::runtime_error);
+}
+
+TEST_F(SessionBootstrap, signals_are_subscribed_to_once_a_client_asks_for_them)
+{
+    int subscriptions = 0;
+    media::LazyRemoteSignal<mpris::Player::Signals::Seeked> seeked{[this, &subscriptions]()
+    {
+        ++subscriptions;
+        return stub->get_signal<mpris::Player::Signals::Seeked>();
+    }};
+
+    // Nobody asked, so the bus isn't asked to deliver anything either
+    skeleton->get_signal<mpris::Player::Signals::Seeked>()->emit(13);
+    EXPECT_EQ(0, subscriptions);
+
+    std::mutex guard;
+    std::condition_variable arrived;
+    std::vector<std::int64_t> positions;
+    core::ScopedConnection c{seeked.get().connect([&](std::int64_t position)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        positions.push_back(position);
+        arrived.notify_all();
+    })};
+
+    // Asking again doesn't subscribe again
+    seeked.get();
+    EXPECT_EQ(1, subscriptions);
+
+    skeleton->get_signal<mpris::Player::Signals::Seeked>()->emit(42);
+
+    std::unique_lock<std::mutex> ul(guard);
+    ASSERT_TRUE(arrived.wait_for(ul, std::chrono::seconds{5}, [&positions]() { return not positions.empty(); }));
+    EXPECT_EQ(std::vector<std::int64_t>{42}, positions);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/session_registry.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+TEST(SessionRegistry, sessions_are_found_by_uuid_name_and_owner)
+{
+    media::SessionRegistry registry;
+
+    const auto a = registry.allocate_key();
+    const auto b = registry.allocate_key();
+    EXPECT_NE(a, b);
+
+    registry.add(a, "uuid-a");
+    registry.add(b, "", "fixed");
+    registry.set_owner(a, media::SessionRegistry::Owner{"app", true, ":1.42"});
+
+    media::Player::PlayerKey key;
+    ASSERT_TRUE(registry.key_for_uuid("uuid-a", key));
+    EXPECT_EQ(a, key);
+    ASSERT_TRUE(registry.key_for_name("fixed", key));
+    EXPECT_EQ(b, key);
+    EXPECT_FALSE(registry.key_for_uuid("", key));
+    EXPECT_EQ(std::vector<media::Player::PlayerKey>{a}, registry.sessions_owned_by(":1.42"));
+
+    // Detaching moves the session away from its sender
+    EXPECT_TRUE(registry.update_owner(a, [](media::SessionRegistry::Owner& owner)
+    {
+        owner.attached = false;
+        owner.sender.clear();
+    }));
+    EXPECT_TRUE(registry.sessions_owned_by(":1.42").empty());
+    EXPECT_FALSE(registry.update_owner(b, [](media::SessionRegistry::Owner&) {}));
+
+    media::SessionRegistry::Owner owner;
+    ASSERT_TRUE(registry.owner(a, owner));
+    EXPECT_EQ("app", owner.context);
+    EXPECT_FALSE(owner.attached);
+
+    registry.remove(a);
+    EXPECT_FALSE(registry.key_for_uuid("uuid-a", key));
+    EXPECT_FALSE(registry.owner(a, owner));
+    EXPECT_EQ(1u, registry.size());
+}
+
+// Clients creating, looking up and destroying sessions in parallel, the way
+// they hit the bus.
+TEST(SessionRegistry, creating_and_destroying_sessions_in_parallel)
+{
+    media::SessionRegistry registry;
+
+    static constexpr std::size_t num_clients = 8;
+    static constexpr std::size_t sessions_per_client = 2000;
+
+    std::vector<std::vector<media::Player::PlayerKey>> keys(num_clients);
+    std::vector<std::thread> clients;
+    for (std::size_t i = 0; i < num_clients; i++)
+    {
+        clients.push_back(std::thread([&registry, &keys, i]()
+        {
+            const std::string sender = ":1." + std::to_string(i);
+            for (std::size_t j = 0; j < sessions_per_client; j++)
+            {
+                const auto key = registry.allocate_key();
+                const std::string uuid = sender + "/" + std::to_string(j);
+                registry.add(key, uuid);
+                registry.set_owner(key, media::SessionRegistry::Owner{"app", true, sender});
+
+                media::Player::PlayerKey found;
+                if (registry.key_for_uuid(uuid, found) and found == key)
+                    keys[i].push_back(key);
+
+                // Keep every other session around
+                if (j % 2 == 1)
+                    registry.remove(key);
+            }
+        }));
+    }
+
+    for (auto& client : clients)
+        client.join();
+
+    std::set<media::Player::PlayerKey> all;
+    for (const auto& client_keys : keys)
+    {
+        EXPECT_EQ(sessions_per_client, client_keys.size());
+        all.insert(client_keys.begin(), client_keys.end());
+    }
+    // No key got handed out twice
+    EXPECT_EQ(num_clients * sessions_per_client, all.size());
+    EXPECT_EQ(num_clients * sessions_per_client / 2, registry.size());
+    EXPECT_EQ(sessions_per_client / 2, registry.sessions_owned_by(":1.0").size());
+}
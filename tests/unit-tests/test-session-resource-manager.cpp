@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/session_resource_manager.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Stands in for a player session, counting how often its pipeline got released
+struct FakeSession
+{
+    bool release()
+    {
+        if (not loaded)
+            return false;
+
+        loaded = false;
+        ++releases;
+        return true;
+    }
+
+    bool loaded = false;
+    int releases = 0;
+};
+
+struct SessionResourceManager : public ::testing::Test
+{
+    SessionResourceManager()
+        : manager{configuration()},
+          t0{media::SessionResourceManager::Clock::now()}
+    {
+    }
+
+    static media::SessionResourceManager::Configuration configuration()
+    {
+        media::SessionResourceManager::Configuration config;
+        config.idle_timeout = std::chrono::seconds{60};
+        config.max_pipelines = 2;
+        return config;
+    }
+
+    std::shared_ptr<FakeSession> add(media::Player::PlayerKey key)
+    {
+        auto session = std::make_shared<FakeSession>();
+        std::weak_ptr<FakeSession> weak{session};
+        manager.add_session(key, session, [weak]()
+        {
+            const auto sp = weak.lock();
+            return sp ? sp->release() : false;
+        });
+        return session;
+    }
+
+    void play(media::Player::PlayerKey key, FakeSession& session, const std::chrono::seconds& at)
+    {
+        session.loaded = true;
+        manager.on_session_active(key, t0 + at);
+    }
+
+    media::SessionResourceManager manager;
+    media::SessionResourceManager::Clock::time_point t0;
+};
+}
+
+TEST_F(SessionResourceManager, sessions_idle_past_the_timeout_lose_their_pipeline)
+{
+    auto a = add(0), b = add(1);
+    play(0, *a, std::chrono::seconds{0});
+    play(1, *b, std::chrono::seconds{0});
+    manager.on_session_idle(0, t0 + std::chrono::seconds{10});
+
+    EXPECT_EQ(0u, manager.enforce(t0 + std::chrono::seconds{30}));
+    EXPECT_EQ(1u, manager.enforce(t0 + std::chrono::seconds{70}));
+    EXPECT_FALSE(a->loaded);
+    // Playing sessions keep their pipeline no matter how long they play
+    EXPECT_TRUE(b->loaded);
+    EXPECT_EQ(1u, manager.loaded_pipelines());
+
+    // Playing again loads the pipeline and counts as using it
+    play(0, *a, std::chrono::seconds{80});
+    EXPECT_EQ(2u, manager.loaded_pipelines());
+}
+
+TEST_F(SessionResourceManager, least_recently_used_idle_sessions_go_first_when_over_budget)
+{
+    auto a = add(0), b = add(1), c = add(2);
+    play(0, *a, std::chrono::seconds{0});
+    manager.on_session_idle(0, t0 + std::chrono::seconds{1});
+    play(1, *b, std::chrono::seconds{2});
+    manager.on_session_idle(1, t0 + std::chrono::seconds{3});
+    // Touch a again, which makes b the least recently used one
+    play(0, *a, std::chrono::seconds{4});
+    manager.on_session_idle(0, t0 + std::chrono::seconds{5});
+
+    EXPECT_TRUE(manager.on_session_active(2, t0 + std::chrono::seconds{6}));
+    c->loaded = true;
+
+    EXPECT_EQ(1u, manager.enforce(t0 + std::chrono::seconds{7}));
+    EXPECT_TRUE(a->loaded);
+    EXPECT_FALSE(b->loaded);
+    EXPECT_TRUE(c->loaded);
+    EXPECT_EQ(2u, manager.loaded_pipelines());
+}
+
+TEST_F(SessionResourceManager, active_sessions_are_never_released_to_meet_the_budget)
+{
+    std::vector<std::shared_ptr<FakeSession>> sessions;
+    for (media::Player::PlayerKey key = 0; key < 4; key++)
+    {
+        sessions.push_back(add(key));
+        play(key, *sessions.back(), std::chrono::seconds{key});
+    }
+
+    EXPECT_EQ(0u, manager.enforce(t0 + std::chrono::seconds{10}));
+    EXPECT_EQ(4u, manager.loaded_pipelines());
+
+    for (const auto& session : sessions)
+        EXPECT_EQ(0, session->releases);
+}
+
+TEST_F(SessionResourceManager, sessions_that_are_gone_are_forgotten)
+{
+    auto a = add(0);
+    play(0, *a, std::chrono::seconds{0});
+    manager.on_session_idle(0, t0 + std::chrono::seconds{1});
+    a.reset();
+
+    EXPECT_EQ(0u, manager.enforce(t0 + std::chrono::seconds{120}));
+    EXPECT_EQ(0u, manager.loaded_pipelines());
+}
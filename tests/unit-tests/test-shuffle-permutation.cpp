@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/util/shuffle_permutation.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+TEST(ShufflePermutation, is_a_bijection_for_any_size)
+{
+    const media::ShufflePermutation permutation{42};
+
+    for (std::size_t n : {1, 2, 3, 7, 64, 100, 1000, 4097})
+    {
+        std::vector<bool> seen(n, false);
+        for (std::size_t position = 0; position < n; position++)
+        {
+            const std::size_t index = permutation.at(position, n);
+            ASSERT_LT(index, n);
+            ASSERT_FALSE(seen[index]);
+            seen[index] = true;
+
+            EXPECT_EQ(position, permutation.position_of(index, n));
+        }
+    }
+}
+
+TEST(ShufflePermutation, order_only_depends_on_seed)
+{
+    const std::size_t n{50};
+    const media::ShufflePermutation a{1234}, b{1234}, c{4321};
+
+    bool differs = false;
+    for (std::size_t position = 0; position < n; position++)
+    {
+        EXPECT_EQ(a.at(position, n), b.at(position, n));
+        differs |= a.at(position, n) != c.at(position, n);
+    }
+
+    EXPECT_TRUE(differs);
+}
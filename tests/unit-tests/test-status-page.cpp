@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "core/media/status_page.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef F_GET_SEALS
+#define F_GET_SEALS 1034
+#endif
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+namespace media = core::ubuntu::media;
+
+TEST(StatusPage, readers_see_what_the_writer_published)
+{
+    const auto writer = media::StatusPageWriter::create("test-status-page");
+    ASSERT_NE(nullptr, writer);
+
+    writer->update([](media::StatusPage::Snapshot& snapshot)
+    {
+        snapshot.playback_status = media::Player::PlaybackStatus::paused;
+        snapshot.position = 42;
+        snapshot.duration = 1000;
+        snapshot.volume = 0.5;
+        snapshot.metadata_generation = 3;
+    });
+
+    const auto reader = media::StatusPageReader::map(writer->fd());
+    ASSERT_NE(nullptr, reader);
+
+    media::StatusPage::Snapshot snapshot;
+    ASSERT_TRUE(reader->read(snapshot));
+    EXPECT_EQ(media::Player::PlaybackStatus::paused, snapshot.playback_status);
+    EXPECT_EQ(42, snapshot.position);
+    EXPECT_EQ(1000, snapshot.duration);
+    EXPECT_DOUBLE_EQ(0.5, snapshot.volume);
+    EXPECT_EQ(3u, snapshot.metadata_generation);
+
+    // Clients can't scribble over the page
+    EXPECT_EQ(MAP_FAILED, ::mmap(nullptr, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd(), 0));
+}
+
+TEST(StatusPage, reopening_the_page_does_not_make_it_writable)
+{
+    const auto writer = media::StatusPageWriter::create("test-status-page");
+    ASSERT_NE(nullptr, writer);
+
+    const std::string path{"/proc/self/fd/" + std::to_string(writer->fd())};
+    const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    ASSERT_LE(0, fd);
+
+    // Nobody can pull the page out from under the readers
+    EXPECT_GT(0, ::ftruncate(fd, 0));
+
+    // Before Linux 5.1 there is no sealing the page against writes
+    if (not (::fcntl(fd, F_GET_SEALS) & F_SEAL_FUTURE_WRITE))
+    {
+        ::close(fd);
+        return;
+    }
+
+    EXPECT_EQ(MAP_FAILED, ::mmap(nullptr, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    const int value = 42;
+    EXPECT_GT(0, ::write(fd, &value, sizeof(value)));
+
+    ::close(fd);
+}
+
+TEST(StatusPage, the_position_moves_along_while_playing)
+{
+    media::StatusPage::Snapshot snapshot;
+    snapshot.position = 1000;
+    snapshot.anchor = 5000;
+    snapshot.duration = 10000;
+    snapshot.rate = 2.;
+
+    snapshot.playback_status = media::Player::PlaybackStatus::paused;
+    EXPECT_EQ(1000, snapshot.position_at(6000));
+
+    snapshot.playback_status = media::Player::PlaybackStatus::playing;
+    EXPECT_EQ(3000, snapshot.position_at(6000));
+    // Never past the end of the track
+    EXPECT_EQ(10000, snapshot.position_at(50000));
+}
+
+TEST(StatusPage, reads_never_see_half_a_write)
+{
+    const auto writer = media::StatusPageWriter::create("test-status-page");
+    ASSERT_NE(nullptr, writer);
+    const auto reader = media::StatusPageReader::map(writer->fd());
+    ASSERT_NE(nullptr, reader);
+
+    std::atomic<bool> done{false};
+    std::thread writing([&]()
+    {
+        for (std::int64_t i = 1; i <= 100000; i++)
+        {
+            writer->update([i](media::StatusPage::Snapshot& snapshot)
+            {
+                snapshot.position = i;
+                snapshot.duration = 2 * i;
+                snapshot.metadata_generation = i;
+            });
+        }
+        done = true;
+    });
+
+    std::uint64_t last = 0;
+    while (not done)
+    {
+        media::StatusPage::Snapshot snapshot;
+        if (not reader->read(snapshot))
+            continue;
+
+        EXPECT_EQ(2 * snapshot.position, snapshot.duration);
+        EXPECT_EQ(static_cast<std::uint64_t>(snapshot.position), snapshot.metadata_generation);
+        EXPECT_LE(last, snapshot.metadata_generation);
+        last = snapshot.metadata_generation;
+    }
+
+    writing.join();
+}
+
+TEST(StatusPage, only_pages_are_mapped)
+{
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+    EXPECT_EQ(nullptr, media::StatusPageReader::map(fds[0]));
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(StatusPage, properties_fall_back_while_there_is_no_page)
+{
+    const auto writer = media::StatusPageWriter::create("test-status-page");
+    ASSERT_NE(nullptr, writer);
+    writer->update([](media::StatusPage::Snapshot& snapshot) { snapshot.duration = 1000; });
+
+    media::StatusPageReader::Ptr reader;
+    const auto fallback = std::make_shared<core::Property<std::int64_t>>(42);
+    media::StatusPageProperty<std::int64_t> duration
+    {
+        [&reader]() { return reader; },
+        [](const media::StatusPage::Snapshot& snapshot) { return snapshot.duration; },
+        fallback
+    };
+
+    EXPECT_EQ(42, duration.get());
+
+    reader = media::StatusPageReader::map(writer->fd());
+    EXPECT_EQ(1000, duration.get());
+}
+
+TEST(StatusPage, properties_announce_changes_of_the_fallback)
+{
+    const auto writer = media::StatusPageWriter::create("test-status-page");
+    ASSERT_NE(nullptr, writer);
+    writer->update([](media::StatusPage::Snapshot& snapshot) { snapshot.duration = 1000; });
+
+    const auto reader = media::StatusPageReader::map(writer->fd());
+    const auto fallback = std::make_shared<core::Property<std::int64_t>>(42);
+    media::StatusPageProperty<std::int64_t> duration
+    {
+        [&reader]() { return reader; },
+        [](const media::StatusPage::Snapshot& snapshot) { return snapshot.duration; },
+        fallback
+    };
+
+    std::vector<std::int64_t> announced;
+    duration.changed().connect([&announced](std::int64_t value) { announced.push_back(value); });
+
+    // Reading the page in between doesn't swallow changes
+    EXPECT_EQ(1000, duration.get());
+    fallback->set(1000);
+    fallback->set(2000);
+
+    EXPECT_EQ((std::vector<std::int64_t>{1000, 2000}), announced);
+}
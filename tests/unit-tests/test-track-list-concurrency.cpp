@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/track_list_implementation.h"
+#include "core/media/util/worker_pool.h"
+
+#include "track_lists.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Lets a test hold the writer lane, as a long edit would
+struct LaneHoldingTrackList : public media::TrackListImplementation
+{
+    using media::TrackListImplementation::TrackListImplementation;
+    using media::TrackListSkeleton::writer_lane;
+};
+
+// A snapshot is consistent if its current track points into its own list of tracks
+void expect_consistent(const media::TrackListSkeleton::Snapshot::Ptr& snapshot)
+{
+    ASSERT_NE(nullptr, snapshot);
+    EXPECT_LE(snapshot->current, snapshot->tracks.size());
+}
+}
+
+// Adds and removes tracks from several threads while another one keeps
+// transitioning to the next track, like the about-to-finish path does.
+TEST(TrackListConcurrency, edits_during_track_transitions_keep_the_list_consistent)
+{
+    const auto track_list = testing::a_track_list();
+    track_list->on_loop_status_changed(media::Player::LoopStatus::playlist);
+
+    const std::size_t n_rounds{500};
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+
+    for (std::size_t w = 0; w < 2; w++)
+    {
+        writers.push_back(std::thread([track_list, w, n_rounds]()
+        {
+            std::mt19937 rng(w);
+            for (std::size_t i = 0; i < n_rounds; i++)
+            {
+                const media::TrackList::ContainerURI uris
+                {
+                    "file:///tmp/" + std::to_string(w) + "-" + std::to_string(i) + "-a.ogg",
+                    "file:///tmp/" + std::to_string(w) + "-" + std::to_string(i) + "-b.ogg"
+                };
+                track_list->add_tracks_with_uri_at(uris, media::TrackList::after_empty_track());
+
+                const auto snapshot = track_list->snapshot();
+                if (not snapshot->tracks.empty())
+                    track_list->remove_track(snapshot->tracks[rng() % snapshot->tracks.size()]);
+            }
+        }));
+    }
+
+    std::thread transitions([track_list, &done]()
+    {
+        while (not done)
+        {
+            const auto id = track_list->next();
+            // The id just switched to might be removed concurrently, but never a dangling one
+            if (not id.empty())
+                track_list->query_uri_for_track(id);
+        }
+    });
+
+    std::thread readers([track_list, &done]()
+    {
+        while (not done)
+            expect_consistent(track_list->snapshot());
+    });
+
+    for (auto& writer : writers)
+        writer.join();
+    done = true;
+    transitions.join();
+    readers.join();
+
+    // Every round adds two tracks and removes at most one, both writers might
+    // have picked the same track to remove though
+    const auto snapshot = track_list->snapshot();
+    expect_consistent(snapshot);
+    EXPECT_LE(2 * n_rounds, snapshot->tracks.size());
+    EXPECT_GE(4 * n_rounds, snapshot->tracks.size());
+    EXPECT_EQ(track_list->tracks().get(), snapshot->tracks);
+
+    for (const auto& id : snapshot->tracks)
+        EXPECT_FALSE(track_list->query_uri_for_track(id).empty());
+}
+
+TEST(TrackListConcurrency, snapshots_are_not_affected_by_later_edits)
+{
+    const auto track_list = testing::a_track_list();
+
+    track_list->add_tracks_with_uri_at({"file:///tmp/a.ogg", "file:///tmp/b.ogg", "file:///tmp/c.ogg"},
+                                       media::TrackList::after_empty_track());
+    const auto before = track_list->snapshot();
+    ASSERT_EQ(3u, before->tracks.size());
+    EXPECT_EQ("file:///tmp/a.ogg", track_list->query_uri_for_track(before->tracks.front()));
+
+    track_list->next();
+    track_list->remove_track(before->tracks[0]);
+    track_list->replace_tracks({"file:///tmp/d.ogg"}, 0, std::chrono::microseconds{0});
+
+    // The old snapshot still describes the TrackList as it was when it was taken
+    EXPECT_EQ(3u, before->tracks.size());
+    EXPECT_EQ(3u, before->current);
+
+    const auto after = track_list->snapshot();
+    ASSERT_EQ(1u, after->tracks.size());
+    EXPECT_EQ(0u, after->current);
+    EXPECT_EQ("file:///tmp/d.ogg", track_list->query_uri_for_track(after->tracks.front()));
+}
+
+TEST(TrackListConcurrency, snapshots_name_the_track_to_go_to_next)
+{
+    const auto track_list = testing::a_track_list();
+
+    track_list->add_tracks_with_uri_at({"file:///tmp/a.ogg", "file:///tmp/b.ogg"},
+                                       media::TrackList::after_empty_track());
+    const auto tracks = track_list->snapshot()->tracks;
+    ASSERT_EQ(2u, tracks.size());
+
+    track_list->go_to(tracks[1]);
+    EXPECT_TRUE(track_list->snapshot()->next.empty());
+
+    track_list->on_loop_status_changed(media::Player::LoopStatus::playlist);
+    EXPECT_EQ(tracks[0], track_list->snapshot()->next);
+
+    track_list->on_loop_status_changed(media::Player::LoopStatus::track);
+    EXPECT_EQ(tracks[1], track_list->snapshot()->next);
+}
+
+// The about-to-finish path advances from a snapshot while an edit holds the
+// writer lane, and the TrackList catches up on the dispatch queue afterwards.
+TEST(TrackListConcurrency, advancing_from_a_snapshot_does_not_wait_for_edits)
+{
+    media::WorkerPool pool{1};
+    const auto queue = media::SerialQueue::create(pool);
+
+    const auto track_list = testing::a_track_list<LaneHoldingTrackList>(queue);
+
+    track_list->add_tracks_with_uri_at({"file:///tmp/a.ogg", "file:///tmp/b.ogg"},
+                                       media::TrackList::after_empty_track());
+    const auto tracks = track_list->snapshot()->tracks;
+    track_list->go_to(tracks[0]);
+
+    std::promise<media::Track::Id> changed_to;
+    core::ScopedConnection connection
+    {
+        track_list->on_track_changed().connect([&changed_to](const media::Track::Id& id)
+        {
+            changed_to.set_value(id);
+        })
+    };
+
+    std::mutex guard;
+    std::condition_variable cv;
+    bool holding = false, release = false;
+    std::thread edit([&]()
+    {
+        std::lock_guard<std::recursive_mutex> lane(track_list->writer_lane());
+        std::unique_lock<std::mutex> lk(guard);
+        holding = true;
+        cv.notify_all();
+        cv.wait(lk, [&]() { return release; });
+    });
+
+    {
+        std::unique_lock<std::mutex> lk(guard);
+        cv.wait(lk, [&]() { return holding; });
+    }
+
+    // Would deadlock here if it waited for the writer lane
+    EXPECT_EQ(tracks[1], track_list->advance_from(track_list->snapshot()));
+
+    {
+        std::lock_guard<std::mutex> lk(guard);
+        release = true;
+    }
+    cv.notify_all();
+    edit.join();
+
+    EXPECT_EQ(tracks[1], changed_to.get_future().get());
+    EXPECT_EQ(tracks[1], track_list->current());
+}
+
+TEST(TrackListConcurrency, track_ids_are_not_reused_after_a_reset)
+{
+    const auto track_list = testing::a_track_list();
+
+    track_list->add_track_with_uri_at("file:///tmp/a.ogg", media::TrackList::after_empty_track(), false);
+    const auto before = track_list->snapshot()->tracks;
+    ASSERT_EQ(1u, before.size());
+
+    track_list->reset();
+    track_list->add_track_with_uri_at("file:///tmp/b.ogg", media::TrackList::after_empty_track(), false);
+    const auto after = track_list->snapshot()->tracks;
+    ASSERT_EQ(1u, after.size());
+
+    EXPECT_NE(before.front(), after.front());
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/util/track_list_journal.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+std::string temporary_journal()
+{
+    char tmpl[] = "/tmp/media-hub-journal-XXXXXX";
+    const int fd = ::mkstemp(tmpl);
+    ::close(fd);
+    std::remove(tmpl);
+    return tmpl;
+}
+
+std::string id(std::size_t i)
+{
+    return "/core/ubuntu/media/Service/sessions/0/TrackList/" + std::to_string(i);
+}
+
+std::string uri(std::size_t i)
+{
+    return "file:///media/music/track-" + std::to_string(i) + ".ogg";
+}
+}
+
+TEST(TrackListJournal, replays_all_kinds_of_edits)
+{
+    const auto path = temporary_journal();
+    {
+        media::TrackListJournal journal{path};
+        journal.tracks_inserted(media::Track::Id{}, {id(0), id(1), id(2)}, {uri(0), uri(1), uri(2)});
+        // Inserted in front of track 1
+        journal.tracks_inserted(id(1), {id(3)}, {uri(3)});
+        journal.track_moved(id(0), id(2));
+        journal.track_removed(id(1));
+        journal.current_changed(id(3));
+        journal.shuffle_changed(true, 0x1234567890abcdefULL);
+        journal.loop_status_changed(media::Player::LoopStatus::playlist);
+        journal.position_changed(std::chrono::seconds{42});
+    }
+
+    media::TrackListJournal::State state;
+    ASSERT_TRUE(media::TrackListJournal::load(path, state));
+
+    const media::TrackList::Container expected{id(3), id(0), id(2)};
+    EXPECT_EQ(expected, state.tracks);
+    EXPECT_EQ(3u, state.meta_data.size());
+    EXPECT_EQ(uri(3), std::get<0>(state.meta_data.at(id(3))));
+    EXPECT_EQ(id(3), state.current);
+    EXPECT_TRUE(state.shuffle);
+    EXPECT_EQ(0x1234567890abcdefULL, state.shuffle_seed);
+    EXPECT_EQ(media::Player::LoopStatus::playlist, state.loop_status);
+    EXPECT_EQ(std::chrono::microseconds{std::chrono::seconds{42}}, state.position);
+
+    std::remove(path.c_str());
+}
+
+TEST(TrackListJournal, truncated_last_record_is_ignored)
+{
+    const auto path = temporary_journal();
+    {
+        media::TrackListJournal journal{path};
+        journal.tracks_inserted(media::Track::Id{}, {id(0)}, {uri(0)});
+        journal.tracks_inserted(media::Track::Id{}, {id(1)}, {uri(1)});
+    }
+
+    // Cut the second record in half, like a crash in the middle of writing it would
+    std::FILE *f = std::fopen(path.c_str(), "r");
+    std::fseek(f, 0, SEEK_END);
+    const long size = std::ftell(f);
+    std::fclose(f);
+    ASSERT_EQ(0, ::truncate(path.c_str(), size - 10));
+
+    media::TrackListJournal::State state;
+    ASSERT_TRUE(media::TrackListJournal::load(path, state));
+    EXPECT_EQ(media::TrackList::Container{id(0)}, state.tracks);
+
+    std::remove(path.c_str());
+}
+
+TEST(TrackListJournal, compaction_keeps_the_state)
+{
+    const auto path = temporary_journal();
+    media::TrackListJournal journal{path};
+    for (std::size_t i = 0; i < 2000; i++)
+        journal.tracks_inserted(media::Track::Id{}, {id(i)}, {uri(i)});
+    for (std::size_t i = 0; i < 1900; i++)
+        journal.track_removed(id(i));
+    journal.current_changed(id(1999));
+    EXPECT_TRUE(journal.needs_compaction(100));
+
+    media::TrackListJournal::State before;
+    ASSERT_TRUE(media::TrackListJournal::load(path, before));
+    ASSERT_EQ(100u, before.tracks.size());
+
+    journal.compact(before);
+    EXPECT_FALSE(journal.needs_compaction(100));
+    // Appending carries on after compacting
+    journal.track_removed(id(1900));
+
+    media::TrackListJournal::State after;
+    ASSERT_TRUE(media::TrackListJournal::load(path, after));
+    ASSERT_EQ(99u, after.tracks.size());
+    EXPECT_EQ(id(1901), after.tracks.front());
+    EXPECT_EQ(id(1999), after.current);
+
+    std::remove(path.c_str());
+}
+
+TEST(TrackListJournal, missing_journal_is_not_loaded)
+{
+    media::TrackListJournal::State state;
+    EXPECT_FALSE(media::TrackListJournal::load("/tmp/this/journal/does/not/exist", state));
+}
+
+// A 10k entry queue that was built one AddTrack at a time restores the same
+// before and after compaction.
+TEST(TrackListJournal, discarded_journal_is_gone_for_good)
+{
+    const auto path = temporary_journal();
+    media::TrackListJournal journal{path};
+    journal.tracks_inserted(media::Track::Id{}, {id(0)}, {uri(0)});
+
+    journal.discard();
+    EXPECT_NE(0, ::access(path.c_str(), F_OK));
+
+    // Neither edits nor compaction bring it back
+    journal.tracks_inserted(media::Track::Id{}, {id(1)}, {uri(1)});
+    media::TrackListJournal::State state;
+    state.tracks = {id(0), id(1)};
+    journal.compact(state);
+    EXPECT_NE(0, ::access(path.c_str(), F_OK));
+    EXPECT_FALSE(media::TrackListJournal::load(path, state));
+}
+
+TEST(TrackListJournal, restores_a_10k_entry_queue_before_and_after_compaction)
+{
+    const std::size_t n_tracks{10000};
+    const auto path = temporary_journal();
+    media::TrackListJournal journal{path};
+    for (std::size_t i = 0; i < n_tracks; i++)
+        journal.tracks_inserted(media::Track::Id{}, {id(i)}, {uri(i)});
+    journal.current_changed(id(n_tracks / 2));
+
+    media::TrackListJournal::State replayed;
+    ASSERT_TRUE(media::TrackListJournal::load(path, replayed));
+    ASSERT_EQ(n_tracks, replayed.tracks.size());
+    EXPECT_EQ(id(n_tracks / 2), replayed.current);
+
+    journal.compact(replayed);
+
+    media::TrackListJournal::State compacted;
+    ASSERT_TRUE(media::TrackListJournal::load(path, compacted));
+    EXPECT_EQ(replayed.tracks, compacted.tracks);
+    EXPECT_EQ(replayed.current, compacted.current);
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/track_list_implementation.h"
+
+#include "track_lists.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace media = core::ubuntu::media;
+
+namespace
+{
+// Counts what a TrackList announces while a test runs
+struct Announcements
+{
+    explicit Announcements(const std::shared_ptr<media::TrackListImplementation>& track_list)
+    {
+        connections.emplace_back(track_list->on_track_list_replaced().connect(
+            [this](const media::TrackList::ContainerTrackIdTuple& t) { replaced.push_back(t); }));
+        connections.emplace_back(track_list->on_tracks_added().connect(
+            [this](const media::TrackList::ContainerURI&) { ++tracks_added; }));
+        connections.emplace_back(track_list->on_track_removed().connect(
+            [this](const media::Track::Id&) { ++tracks_removed; }));
+        connections.emplace_back(track_list->on_go_to_track_at().connect(
+            [this](const media::TrackListSkeleton::TrackIdPositionTuple& t) { went_to.push_back(t); }));
+        connections.emplace_back(track_list->on_end_of_tracklist().connect(
+            [this]() { ++ends; }));
+    }
+
+    std::vector<media::TrackList::ContainerTrackIdTuple> replaced;
+    std::vector<media::TrackListSkeleton::TrackIdPositionTuple> went_to;
+    int tracks_added = 0;
+    int tracks_removed = 0;
+    int ends = 0;
+    std::vector<core::ScopedConnection> connections;
+};
+}
+
+TEST(ReplaceTracks, replaces_all_tracks_with_a_single_announcement)
+{
+    const auto track_list = testing::a_track_list();
+    track_list->add_tracks_with_uri_at({"file:///tmp/a.ogg", "file:///tmp/b.ogg", "file:///tmp/c.ogg"},
+                                       media::TrackList::after_empty_track());
+    const auto old_tracks = track_list->tracks().get();
+
+    Announcements announcements{track_list};
+    track_list->replace_tracks({"file:///tmp/d.ogg", "file:///tmp/e.ogg"}, 1, std::chrono::seconds{5});
+
+    const auto tracks = track_list->tracks().get();
+    ASSERT_EQ(2u, tracks.size());
+    for (const auto& id : tracks)
+        EXPECT_EQ(old_tracks.end(), std::find(old_tracks.begin(), old_tracks.end(), id));
+    EXPECT_EQ("file:///tmp/d.ogg", track_list->query_uri_for_track(tracks[0]));
+    EXPECT_EQ("file:///tmp/e.ogg", track_list->query_uri_for_track(tracks[1]));
+
+    // The replacement is announced as a whole, never track by track
+    ASSERT_EQ(1u, announcements.replaced.size());
+    EXPECT_EQ(tracks, std::get<0>(announcements.replaced.front()));
+    EXPECT_EQ(tracks[1], std::get<1>(announcements.replaced.front()));
+    EXPECT_EQ(0, announcements.tracks_added);
+    EXPECT_EQ(0, announcements.tracks_removed);
+
+    // Playback moves on to the requested track, from the requested position
+    EXPECT_EQ(tracks[1], track_list->current());
+    EXPECT_EQ(1u, track_list->snapshot()->current);
+    ASSERT_EQ(1u, announcements.went_to.size());
+    EXPECT_EQ(tracks[1], std::get<0>(announcements.went_to.front()));
+    EXPECT_EQ(std::chrono::microseconds{std::chrono::seconds{5}}, std::get<1>(announcements.went_to.front()));
+    EXPECT_EQ(0, announcements.ends);
+}
+
+TEST(ReplaceTracks, replacing_with_nothing_empties_the_list_and_ends_playback)
+{
+    const auto track_list = testing::a_track_list();
+    track_list->replace_tracks({"file:///tmp/a.ogg", "file:///tmp/b.ogg"}, 0, std::chrono::microseconds{0});
+
+    Announcements announcements{track_list};
+    track_list->replace_tracks({}, 0, std::chrono::microseconds{0});
+
+    EXPECT_TRUE(track_list->tracks().get().empty());
+    EXPECT_TRUE(track_list->current().empty());
+    EXPECT_EQ(0u, track_list->snapshot()->current);
+
+    ASSERT_EQ(1u, announcements.replaced.size());
+    EXPECT_TRUE(std::get<0>(announcements.replaced.front()).empty());
+    EXPECT_TRUE(std::get<1>(announcements.replaced.front()).empty());
+    EXPECT_TRUE(announcements.went_to.empty());
+    EXPECT_EQ(1, announcements.ends);
+}
+
+TEST(ReplaceTracks, playback_carries_on_if_the_current_track_stays_the_same)
+{
+    const auto track_list = testing::a_track_list();
+    track_list->replace_tracks({"file:///tmp/a.ogg", "file:///tmp/b.ogg"}, 1, std::chrono::microseconds{0});
+
+    Announcements announcements{track_list};
+    track_list->replace_tracks({"file:///tmp/c.ogg", "file:///tmp/b.ogg", "file:///tmp/d.ogg"},
+                               1, std::chrono::seconds{30});
+
+    const auto tracks = track_list->tracks().get();
+    ASSERT_EQ(3u, tracks.size());
+    EXPECT_EQ(tracks[1], track_list->current());
+    EXPECT_EQ(1u, announcements.replaced.size());
+    // The pipeline isn't reloaded, so the position is left alone
+    EXPECT_TRUE(announcements.went_to.empty());
+    EXPECT_EQ(0, announcements.ends);
+}
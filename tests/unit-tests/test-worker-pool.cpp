@@ -0,0 +1,394 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "core/media/util/uri_check.h"
+#include "core/media/util/worker_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace media = core::ubuntu::media;
+
+TEST(WorkerPool, runs_all_posted_tasks)
+{
+    std::atomic<std::size_t> n_done{0};
+    {
+        media::WorkerPool pool{4};
+        for (std::size_t i = 0; i < 1000; i++)
+            pool.post([&n_done]() { ++n_done; });
+        // The destructor drains the queue before joining the workers
+    }
+
+    EXPECT_EQ(1000u, n_done.load());
+}
+
+TEST(WorkerPool, survives_tasks_that_throw)
+{
+    std::atomic<std::size_t> n_done{0};
+    {
+        media::WorkerPool pool{2};
+        for (std::size_t i = 0; i < 100; i++)
+        {
+            pool.post([]() { throw std::runtime_error{"malformed message"}; });
+            pool.post([]() { throw 42; });
+            pool.post([&n_done]() { ++n_done; });
+        }
+    }
+
+    EXPECT_EQ(100u, n_done.load());
+}
+
+namespace
+{
+// Keeps the workers of a pool busy until released
+struct Gate
+{
+    void block(media::WorkerPool& pool)
+    {
+        pool.post([this]()
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            opened.wait(ul, [this]() { return open; });
+        }, media::WorkerPool::Priority::high);
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        open = true;
+        opened.notify_all();
+    }
+
+    std::mutex guard;
+    std::condition_variable opened;
+    bool open = false;
+};
+}
+
+TEST(WorkerPool, runs_higher_priorities_first)
+{
+    std::vector<std::string> order;
+    media::WorkerPool::Statistics stats;
+    {
+        // Outlives the pool, whose destructor waits for the gate to be left
+        Gate gate;
+        media::WorkerPool pool{1, std::chrono::hours{1}};
+        gate.block(pool);
+        // Wait for the worker to pick up the gate
+        while (pool.statistics().depth[0] > 0)
+            std::this_thread::yield();
+
+        pool.post([&order]() { order.push_back("AddTracks"); }, media::WorkerPool::Priority::bulk);
+        pool.post([&order]() { order.push_back("OpenUri"); });
+        pool.post([&order]() { order.push_back("GetTracksMetadata"); }, media::WorkerPool::Priority::bulk);
+        pool.post([&order]() { order.push_back("Play"); }, media::WorkerPool::Priority::high);
+
+        stats = pool.statistics();
+        gate.release();
+    }
+
+    EXPECT_EQ((std::vector<std::string>{"Play", "OpenUri", "AddTracks", "GetTracksMetadata"}), order);
+    EXPECT_EQ(1u, stats.depth[0]);
+    EXPECT_EQ(1u, stats.depth[1]);
+    EXPECT_EQ(2u, stats.depth[2]);
+    EXPECT_EQ(2u, stats.max_depth[2]);
+}
+
+TEST(WorkerPool, aging_keeps_bulk_work_from_starving)
+{
+    std::vector<std::string> order;
+    media::WorkerPool::Statistics stats;
+    {
+        // Outlives the pool, whose destructor waits for the gate to be left
+        Gate gate;
+        media::WorkerPool pool{1, std::chrono::milliseconds{10}};
+        gate.block(pool);
+        while (pool.statistics().depth[0] > 0)
+            std::this_thread::yield();
+
+        pool.post([&order]() { order.push_back("AddTracks"); }, media::WorkerPool::Priority::bulk);
+        // Waiting for three aging intervals makes up for the two levels between bulk and high
+        std::this_thread::sleep_for(std::chrono::milliseconds{30});
+        for (int i = 0; i < 10; i++)
+            pool.post([&order]() { order.push_back("Play"); }, media::WorkerPool::Priority::high);
+
+        gate.release();
+        while (pool.statistics().executed[0] < 11)
+            std::this_thread::yield();
+        stats = pool.statistics();
+    }
+
+    ASSERT_EQ(11u, order.size());
+    EXPECT_EQ("AddTracks", order.front());
+    EXPECT_EQ(1u, stats.aged);
+    EXPECT_EQ(1u, stats.executed[2]);
+}
+
+// Every uri gets checked once, no matter which worker picks it up
+TEST(WorkerPool, validates_local_uris_in_parallel)
+{
+    const std::size_t n_uris{500};
+
+    char tmpl[] = "/tmp/media-hub-uris-XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(tmpl));
+    const std::string dir{tmpl};
+
+    std::vector<std::string> uris;
+    for (std::size_t i = 0; i < n_uris; i++)
+    {
+        const std::string path = dir + "/track-" + std::to_string(i) + ".ogg";
+        // Every other one is missing
+        if (i % 2 == 0)
+            std::ofstream{path} << i;
+        uris.push_back("file://" + path);
+    }
+
+    std::atomic<std::size_t> next{0}, n_checked{0}, n_found{0};
+    {
+        media::WorkerPool pool{4};
+        for (std::size_t i = 0; i < pool.size(); i++)
+        {
+            pool.post([&]()
+            {
+                media::UriCheck uri_check;
+                for (std::size_t index = next++; index < uris.size(); index = next++)
+                {
+                    uri_check.set(uris[index]);
+                    ++n_checked;
+                    if (uri_check.file_exists())
+                        ++n_found;
+                }
+            });
+        }
+    }
+
+    EXPECT_EQ(n_uris, n_checked.load());
+    EXPECT_EQ(n_uris / 2, n_found.load());
+
+    for (std::size_t i = 0; i < n_uris; i += 2)
+        std::remove((dir + "/track-" + std::to_string(i) + ".ogg").c_str());
+    ::rmdir(dir.c_str());
+}
+
+TEST(SerialQueue, keeps_the_order_of_a_queue_while_queues_run_in_parallel)
+{
+    media::WorkerPool pool{4};
+    const auto a = media::SerialQueue::create(pool);
+    const auto b = media::SerialQueue::create(pool);
+
+    std::vector<int> order;
+    std::atomic<bool> b_ran{false};
+    std::mutex guard;
+    std::condition_variable done;
+    bool finished = false;
+
+    // a is stuck until b got to run, which requires queues to run in parallel
+    a->post([&b_ran]()
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+        while (not b_ran and std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    });
+    for (int i = 0; i < 100; i++)
+        a->post([&order, i]() { order.push_back(i); });
+    a->post([&]()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        finished = true;
+        done.notify_one();
+    });
+    b->post([&b_ran]() { b_ran = true; });
+
+    std::unique_lock<std::mutex> ul(guard);
+    ASSERT_TRUE(done.wait_for(ul, std::chrono::seconds{10}, [&finished]() { return finished; }));
+
+    EXPECT_TRUE(b_ran);
+    ASSERT_EQ(100u, order.size());
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(i, order[i]);
+}
+
+// Calls of unrelated sessions all get handled while one session is stuck in
+// a call, e.g. a Play waiting for a slow network stream to preroll, and the
+// calls the stuck session got meanwhile wait for it.
+TEST(SerialQueue, unrelated_sessions_are_not_held_up_by_a_stalled_one)
+{
+    static constexpr std::size_t n_sessions{20};
+    static constexpr std::size_t n_calls{50};
+
+    std::mutex guard;
+    std::condition_variable changed;
+    bool stalled_released = false;
+    std::size_t n_handled = 0;
+    std::vector<std::string> stalled_order;
+
+    media::WorkerPool pool{4};
+
+    const auto stalled = media::SerialQueue::create(pool);
+    stalled->post([&]()
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        // Gives up eventually, so that a broken queue fails instead of hanging
+        changed.wait_for(ul, std::chrono::seconds{10}, [&stalled_released]() { return stalled_released; });
+        stalled_order.push_back("Play");
+    });
+    stalled->post([&]()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        stalled_order.push_back("Pause");
+        changed.notify_all();
+    });
+
+    std::vector<media::SerialQueue::Ptr> sessions;
+    for (std::size_t i = 0; i < n_sessions; i++)
+        sessions.push_back(media::SerialQueue::create(pool));
+
+    for (std::size_t call = 0; call < n_calls; call++)
+    {
+        for (const auto& session : sessions)
+        {
+            session->post([&]()
+            {
+                std::lock_guard<std::mutex> lg(guard);
+                ++n_handled;
+                changed.notify_all();
+            });
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(changed.wait_for(ul, std::chrono::seconds{10}, [&n_handled]() { return n_handled == n_sessions * n_calls; }));
+        EXPECT_TRUE(stalled_order.empty());
+
+        stalled_released = true;
+        changed.notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(changed.wait_for(ul, std::chrono::seconds{10}, [&stalled_order]() { return stalled_order.size() == 2; }));
+        EXPECT_EQ((std::vector<std::string>{"Play", "Pause"}), stalled_order);
+    }
+}
+
+TEST(SerialQueue, takes_the_priority_of_its_most_urgent_task)
+{
+    std::vector<std::string> order;
+    {
+        // Outlives the pool, whose destructor waits for the gate to be left
+        Gate gate;
+        media::WorkerPool pool{1, std::chrono::hours{1}};
+        gate.block(pool);
+        while (pool.statistics().depth[0] > 0)
+            std::this_thread::yield();
+
+        const auto multimedia = media::SerialQueue::create(pool);
+        const auto other = media::SerialQueue::create(pool);
+        const auto alarm = media::SerialQueue::create(pool);
+        alarm->set_minimum_priority(media::WorkerPool::Priority::high);
+
+        multimedia->post([&order]() { order.push_back("AddTracks"); }, media::WorkerPool::Priority::bulk);
+        other->post([&order]() { order.push_back("OpenUri"); });
+        alarm->post([&order]() { order.push_back("Alarm GetTracksMetadata"); }, media::WorkerPool::Priority::bulk);
+        // Has to wait for the AddTracks before it, but takes it along ahead of the OpenUri
+        multimedia->post([&order]() { order.push_back("Pause"); }, media::WorkerPool::Priority::high);
+
+        gate.release();
+    }
+
+    EXPECT_EQ((std::vector<std::string>{"Alarm GetTracksMetadata", "AddTracks", "Pause", "OpenUri"}), order);
+}
+
+// 32 multimedia sessions flood the dispatch pool with tracklist edits while
+// an alarm session gets a call after every round of edits. Scheduled first
+// come first served, each of its calls waits for an edit of every other
+// session; with priorities, it is next in line.
+TEST(SerialQueue, alarm_sessions_are_not_held_up_by_bulk_work)
+{
+    static constexpr std::size_t n_sessions{32};
+    static constexpr std::size_t n_edits{20};
+
+    // Returns how many edits ran between posting each alarm call and running it
+    auto edits_passing_alarm_calls = [](bool prioritized)
+    {
+        // Only ever touched by the one worker
+        std::size_t n_edited = 0;
+        std::vector<std::size_t> passed;
+
+        {
+            // Outlives the pool, whose destructor waits for the gate to be left
+            Gate gate;
+            media::WorkerPool pool{1, std::chrono::hours{1}};
+            gate.block(pool);
+            while (pool.statistics().depth[0] > 0)
+                std::this_thread::yield();
+
+            std::vector<media::SerialQueue::Ptr> sessions;
+            for (std::size_t i = 0; i < n_sessions; i++)
+                sessions.push_back(media::SerialQueue::create(pool));
+            const auto alarm = media::SerialQueue::create(pool);
+            if (prioritized)
+                alarm->set_minimum_priority(media::WorkerPool::Priority::high);
+
+            const auto bulk = prioritized ? media::WorkerPool::Priority::bulk : media::WorkerPool::Priority::normal;
+            for (std::size_t edit = 0; edit < n_edits; edit++)
+            {
+                for (std::size_t i = 0; i < n_sessions; i++)
+                {
+                    sessions[i]->post([&n_edited, &passed, alarm, i]()
+                    {
+                        ++n_edited;
+                        if (i != 0)
+                            return;
+
+                        // Like a GetTracksMetadata of the alarm clock coming in meanwhile
+                        const auto posted = n_edited;
+                        alarm->post([&, posted]() { passed.push_back(n_edited - posted); });
+                    }, bulk);
+                }
+            }
+
+            gate.release();
+            // The destructor runs everything left
+        }
+
+        EXPECT_EQ(n_sessions * n_edits, n_edited);
+        EXPECT_EQ(n_edits, passed.size());
+        return passed;
+    };
+
+    for (const auto n : edits_passing_alarm_calls(false))
+        EXPECT_EQ(n_sessions - 1, n);
+
+    for (const auto n : edits_passing_alarm_calls(true))
+        EXPECT_EQ(0u, n);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2016 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef TESTING_TRACK_LISTS_H_
+#define TESTING_TRACK_LISTS_H_
+
+#include "core/media/the_session_bus.h"
+#include "core/media/track_list_implementation.h"
+
+#include <core/dbus/service.h>
+#include <core/dbus/types/object_path.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace testing
+{
+// Returns a TrackList, or one derived from it taking the same arguments,
+// exported on an object of its own on the session bus. The arguments given
+// are passed on after the ones all TrackLists take.
+template<typename T = core::ubuntu::media::TrackListImplementation, typename... Args>
+inline std::shared_ptr<T> a_track_list(Args&&... args)
+{
+    static std::size_t instance = 0;
+
+    const auto bus = core::ubuntu::media::the_session_bus();
+    const auto service = core::dbus::Service::add_service(bus, "core.ubuntu.media.test.TrackList"
+            + std::to_string(instance));
+    const auto object = service->add_object_for_path(core::dbus::types::ObjectPath{
+            "/core/ubuntu/media/test/TrackList" + std::to_string(instance++)});
+
+    // Only the D-Bus handlers make use of the apparmor helpers, none of which
+    // are exercised by the tests
+    return std::make_shared<T>(bus, object, nullptr, nullptr, nullptr, std::forward<Args>(args)...);
+}
+}
+
+#endif // TESTING_TRACK_LISTS_H_